@@ -0,0 +1,434 @@
+/**
+ * @file main.cpp
+ * @brief benchmarks of the FTP client against the in-process server of the tests
+ *
+ * Every benchmark keeps its client (and so its control connection) for all its iterations.
+ * The time is the wall-clock time : most of it is spent waiting for the server.
+ * The "_Wan" benchmarks go through a relay emulating a long distance link (see WAN_CONDITIONS).
+ *
+ * bench_ftpclient --benchmark_out=results.json --benchmark_out_format=json
+ */
+
+#include <benchmark/benchmark.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FTPClient.h"
+#include "FTPSessionPool.h"
+#include "test_server.h"
+#include "wan_relay.h"
+
+using namespace embeddedmz;
+
+namespace {
+
+// files of the wildcard download
+constexpr int SMALL_FILES_COUNT = 100;
+constexpr int SMALL_FILE_SIZE   = 4 * 1024;
+
+std::string s_strRootDir;   // served by the server
+std::string s_strLocalDir;  // downloaded files and files to upload
+std::unique_ptr<CFTPTestServer> s_pServer;
+std::unique_ptr<CWanRelay> s_pWanRelay;
+
+// an intercontinental link : 150 ms of RTT, 10 MB/s, a 200 ms stall every 1000 chunks of 16 KiB
+CWanRelay::Conditions WanConditions() {
+   CWanRelay::Conditions oConditions;
+   oConditions.uRttMs            = 150;
+   oConditions.ullBytesPerSecond = 10 * 1000 * 1000;
+   oConditions.dStallProbability = 0.001;
+   oConditions.uStallMs          = 200;
+   return oConditions;
+}
+
+std::string MakeTempDir() {
+   std::string strTemplate = "/tmp/ftpclient_bench_XXXXXX";
+   return (mkdtemp(&strTemplate[0]) != nullptr) ? strTemplate : std::string();
+}
+
+int RemoveEntry(const char* pszPath, const struct stat*, int, struct FTW*) { return remove(pszPath); }
+
+bool RemoveDirTree(const std::string& strDir) { return nftw(strDir.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS) == 0; }
+
+bool Exists(const std::string& strPath) {
+   struct stat st;
+   return stat(strPath.c_str(), &st) == 0;
+}
+
+bool WriteFile(const std::string& strPath, size_t uSize) {
+   std::string strBlock(64 * 1024, '\0');
+   for (size_t i = 0; i < strBlock.size(); ++i) strBlock[i] = static_cast<char>('a' + i % 26);
+
+   std::ofstream ofsFile(strPath, std::ofstream::binary);
+   while (uSize > 0 && ofsFile) {
+      const size_t uChunk = std::min(uSize, strBlock.size());
+      ofsFile.write(strBlock.data(), uChunk);
+      uSize -= uChunk;
+   }
+   return ofsFile.good();
+}
+
+// remote file of uSize bytes, created on the first use
+std::string RemoteFile(size_t uSize) {
+   const std::string strName = "/file_" + std::to_string(uSize) + ".bin";
+   if (!Exists(s_strRootDir + strName)) WriteFile(s_strRootDir + strName, uSize);
+   return strName;
+}
+
+// remote directory of uEntries empty files, created on the first use
+std::string RemoteDir(size_t uEntries) {
+   const std::string strName = "/dir_" + std::to_string(uEntries);
+   if (!Exists(s_strRootDir + strName)) {
+      mkdir((s_strRootDir + strName).c_str(), 0755);
+      for (size_t i = 0; i < uEntries; ++i) std::ofstream(s_strRootDir + strName + "/entry_" + std::to_string(i) + ".txt");
+   }
+   return strName + "/";
+}
+
+std::unique_ptr<CFTPClient> NewClient(bool bWan = false) {
+   std::unique_ptr<CFTPClient> pClient(new CFTPClient);
+   pClient->InitSession("127.0.0.1", bWan ? s_pWanRelay->GetPort() : s_pServer->GetPort(), s_pServer->GetUserName(),
+                        s_pServer->GetPassword());
+   return pClient;
+}
+
+bool GlobalBenchInit() {
+   s_strRootDir  = MakeTempDir();
+   s_strLocalDir = MakeTempDir();
+   if (s_strRootDir.empty() || s_strLocalDir.empty()) return false;
+
+   if (mkdir((s_strRootDir + "/upload").c_str(), 0755) != 0 || mkdir((s_strRootDir + "/small").c_str(), 0755) != 0 ||
+       mkdir((s_strLocalDir + "/wildcard").c_str(), 0755) != 0)
+      return false;
+   for (int i = 0; i < SMALL_FILES_COUNT; ++i)
+      if (!WriteFile(s_strRootDir + "/small/file_" + std::to_string(i) + ".bin", SMALL_FILE_SIZE)) return false;
+
+   s_pServer.reset(new CFTPTestServer(s_strRootDir));
+   if (!s_pServer->Start()) return false;
+
+   s_pWanRelay.reset(new CWanRelay("127.0.0.1", s_pServer->GetPort(), WanConditions()));
+   return s_pWanRelay->Start();
+}
+
+void GlobalBenchCleanUp() {
+   s_pWanRelay.reset();
+   s_pServer.reset();
+   if (!s_strRootDir.empty()) RemoveDirTree(s_strRootDir);
+   if (!s_strLocalDir.empty()) RemoveDirTree(s_strLocalDir);
+}
+
+}  // namespace
+
+/* Transfers */
+
+static void BM_DownloadFile(benchmark::State& state) {
+   const size_t uSize           = static_cast<size_t>(state.range(0));
+   const std::string strRemote  = RemoteFile(uSize);
+   const std::string strLocal   = s_strLocalDir + "/download.bin";
+   std::unique_ptr<CFTPClient> pClient = NewClient();
+
+   for (auto _ : state) {
+      if (!pClient->DownloadFile(strLocal, strRemote)) {
+         state.SkipWithError("download failed");
+         break;
+      }
+   }
+   state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(uSize));
+   remove(strLocal.c_str());
+}
+BENCHMARK(BM_DownloadFile)->Arg(1 << 20)->Arg(32 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_DownloadFileToMem(benchmark::State& state) {
+   const size_t uSize          = static_cast<size_t>(state.range(0));
+   const std::string strRemote = RemoteFile(uSize);
+   std::unique_ptr<CFTPClient> pClient = NewClient();
+
+   for (auto _ : state) {
+      std::vector<char> vecData;
+      if (!pClient->DownloadFile(strRemote, vecData) || vecData.size() != uSize) {
+         state.SkipWithError("download failed");
+         break;
+      }
+   }
+   state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(uSize));
+}
+BENCHMARK(BM_DownloadFileToMem)->Arg(1 << 20)->Arg(32 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_UploadFile(benchmark::State& state) {
+   const size_t uSize         = static_cast<size_t>(state.range(0));
+   const std::string strLocal = s_strLocalDir + "/upload_" + std::to_string(uSize) + ".bin";
+   if (!Exists(strLocal)) WriteFile(strLocal, uSize);
+   std::unique_ptr<CFTPClient> pClient = NewClient();
+
+   for (auto _ : state) {
+      if (!pClient->UploadFile(strLocal, "/upload/uploaded.bin")) {
+         state.SkipWithError("upload failed");
+         break;
+      }
+   }
+   state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(uSize));
+}
+BENCHMARK(BM_UploadFile)->Arg(1 << 20)->Arg(32 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_UploadStream(benchmark::State& state) {
+   const size_t uSize = static_cast<size_t>(state.range(0));
+   const std::string strContent(uSize, 'x');
+   std::unique_ptr<CFTPClient> pClient = NewClient();
+
+   for (auto _ : state) {
+      state.PauseTiming();
+      std::istringstream issContent(strContent);
+      state.ResumeTiming();
+      if (!pClient->UploadFile(issContent, "/upload/streamed.bin", false, static_cast<curl_off_t>(uSize))) {
+         state.SkipWithError("upload failed");
+         break;
+      }
+   }
+   state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(uSize));
+}
+BENCHMARK(BM_UploadStream)->Arg(1 << 20)->Arg(32 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// many small files : the cost is in the per-file requests, not in the data
+static void BM_DownloadWildcard(benchmark::State& state) {
+   const std::string strLocalDir = s_strLocalDir + "/wildcard";
+   std::unique_ptr<CFTPClient> pClient = NewClient();
+
+   for (auto _ : state) {
+      if (!pClient->DownloadWildcard(strLocalDir, "/small/*")) {
+         state.SkipWithError("wildcard download failed");
+         break;
+      }
+   }
+   state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * SMALL_FILES_COUNT);
+   state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * SMALL_FILES_COUNT * SMALL_FILE_SIZE);
+}
+BENCHMARK(BM_DownloadWildcard)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/* Directory listings */
+
+static void BM_List(benchmark::State& state) {
+   const size_t uEntries       = static_cast<size_t>(state.range(0));
+   const bool bOnlyNames       = state.range(1) != 0;
+   const std::string strFolder = RemoteDir(uEntries);
+   std::unique_ptr<CFTPClient> pClient = NewClient();
+
+   std::string strList;
+   for (auto _ : state) {
+      if (!pClient->List(strFolder, strList, bOnlyNames)) {
+         state.SkipWithError("list failed");
+         break;
+      }
+   }
+   state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(uEntries));
+}
+BENCHMARK(BM_List)
+    ->ArgNames({"entries", "names_only"})
+    ->Args({100, 1})
+    ->Args({100, 0})
+    ->Args({10000, 1})
+    ->Args({10000, 0})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/* Latency of the simple commands */
+
+static void BM_Info(benchmark::State& state) {
+   const std::string strRemote = RemoteFile(1024);
+   std::unique_ptr<CFTPClient> pClient = NewClient();
+
+   CFTPClient::FileInfo oInfo = {0, 0.0};
+   for (auto _ : state) {
+      if (!pClient->Info(strRemote, oInfo)) {
+         state.SkipWithError("info failed");
+         break;
+      }
+   }
+}
+BENCHMARK(BM_Info)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void BM_CreateDir(benchmark::State& state) {
+   const std::string strDir = s_strRootDir + "/upload/new_dir";
+   std::unique_ptr<CFTPClient> pClient = NewClient();
+
+   for (auto _ : state) {
+      if (!pClient->CreateDir("/upload/new_dir")) {
+         state.SkipWithError("mkdir failed");
+         break;
+      }
+      state.PauseTiming();
+      rmdir(strDir.c_str());
+      state.ResumeTiming();
+   }
+}
+BENCHMARK(BM_CreateDir)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void BM_RemoveFile(benchmark::State& state) {
+   const std::string strFile = s_strRootDir + "/upload/to_delete.txt";
+   std::unique_ptr<CFTPClient> pClient = NewClient();
+
+   for (auto _ : state) {
+      state.PauseTiming();
+      std::ofstream(strFile).put('x');
+      state.ResumeTiming();
+      if (!pClient->RemoveFile("/upload/to_delete.txt")) {
+         state.SkipWithError("delete failed");
+         break;
+      }
+   }
+}
+BENCHMARK(BM_RemoveFile)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+/* Long distance link */
+
+static void BM_Info_Wan(benchmark::State& state) {
+   const std::string strRemote = RemoteFile(1024);
+   std::unique_ptr<CFTPClient> pClient = NewClient(true);
+
+   // the connection and the login are not measured
+   CFTPClient::FileInfo oInfo = {0, 0.0};
+   pClient->Info(strRemote, oInfo);
+   for (auto _ : state) {
+      if (!pClient->Info(strRemote, oInfo)) {
+         state.SkipWithError("info failed");
+         break;
+      }
+   }
+}
+BENCHMARK(BM_Info_Wan)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// the same request without the reuse of the connection (connection, greeting and login each time)
+static void BM_InfoNewSession_Wan(benchmark::State& state) {
+   const std::string strRemote = RemoteFile(1024);
+
+   CFTPClient::FileInfo oInfo = {0, 0.0};
+   for (auto _ : state) {
+      std::unique_ptr<CFTPClient> pClient = NewClient(true);
+      const bool bOk                      = pClient->Info(strRemote, oInfo);
+      pClient->CleanupSession();
+      if (!bOk) {
+         state.SkipWithError("info failed");
+         break;
+      }
+   }
+}
+BENCHMARK(BM_InfoNewSession_Wan)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_DownloadFile_Wan(benchmark::State& state) {
+   const size_t uSize          = static_cast<size_t>(state.range(0));
+   const std::string strRemote = RemoteFile(uSize);
+   std::unique_ptr<CFTPClient> pClient = NewClient(true);
+
+   CFTPClient::FileInfo oInfo = {0, 0.0};
+   pClient->Info(strRemote, oInfo);
+   for (auto _ : state) {
+      std::vector<char> vecData;
+      if (!pClient->DownloadFile(strRemote, vecData) || vecData.size() != uSize) {
+         state.SkipWithError("download failed");
+         break;
+      }
+   }
+   state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(uSize));
+}
+BENCHMARK(BM_DownloadFile_Wan)->Arg(1 << 20)->Arg(16 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// 32 small files shared by range(0) sessions
+static void BM_ParallelDownloads_Wan(benchmark::State& state) {
+   const size_t uFiles = 32;
+   std::unique_ptr<CFTPClient> pClient = NewClient(true);
+   CFTPSessionPool oPool(*pClient, static_cast<unsigned>(state.range(0)));
+
+   for (auto _ : state) {
+      const size_t uFailed = oPool.Run(uFiles, [](CFTPClient& oSession, size_t uIndex) {
+         std::vector<char> vecData;
+         return oSession.DownloadFile("/small/file_" + std::to_string(uIndex) + ".bin", vecData);
+      });
+      if (uFailed > 0) {
+         state.SkipWithError("download failed");
+         break;
+      }
+   }
+   state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(uFiles));
+}
+BENCHMARK(BM_ParallelDownloads_Wan)->ArgName("sessions")->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/* URL building (no I/O) */
+
+// remote path of about uLength characters, a few of them reserved
+std::string MakeRemotePath(size_t uLength) {
+   std::string strPath;
+   for (int i = 0; strPath.size() < uLength; ++i) strPath += "folder " + std::to_string(i) + ((i % 4 == 3) ? "#/" : "/");
+   return strPath + "file 100%.txt";
+}
+
+// the previous implementation : two replace loops and an uppercase copy to check the scheme
+std::string LegacyParseURL(const std::string& strServer, const std::string& strRemoteFile) {
+   auto fnReplace = [](std::string& strSubject, const std::string& strSearch, const std::string& strReplace) {
+      size_t pos = 0;
+      while ((pos = strSubject.find(strSearch, pos)) != std::string::npos) {
+         strSubject.replace(pos, strSearch.length(), strReplace);
+         pos += strReplace.length();
+      }
+   };
+   std::string strURL = strServer + "/" + strRemoteFile;
+   fnReplace(strURL, "/", "//");
+   fnReplace(strURL, " ", "%20");
+
+   std::string strUri = strURL;
+   std::transform(strUri.begin(), strUri.end(), strUri.begin(), ::toupper);
+   if (strUri.compare(0, 4, "FTP:") != 0 && strUri.compare(0, 5, "SFTP:") != 0) strURL = "ftp://" + strURL;
+   return strURL;
+}
+
+static void BM_BuildURL(benchmark::State& state) {
+   const std::string strRemote = MakeRemotePath(static_cast<size_t>(state.range(0)));
+   CFTPClient oClient;
+   oClient.InitSession("127.0.0.1", 21, "user", "password");
+
+   std::string strURL;
+   for (auto _ : state) {
+      oClient.BuildURL(strURL, strRemote);
+      benchmark::DoNotOptimize(strURL.data());
+   }
+   state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(strRemote.size()));
+}
+BENCHMARK(BM_BuildURL)->Arg(32)->Arg(256)->Arg(4096);
+
+static void BM_LegacyParseURL(benchmark::State& state) {
+   const std::string strRemote = MakeRemotePath(static_cast<size_t>(state.range(0)));
+
+   for (auto _ : state) {
+      std::string strURL = LegacyParseURL("127.0.0.1", strRemote);
+      benchmark::DoNotOptimize(strURL.data());
+   }
+   state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(strRemote.size()));
+}
+BENCHMARK(BM_LegacyParseURL)->Arg(32)->Arg(256)->Arg(4096);
+
+int main(int argc, char** argv) {
+   benchmark::Initialize(&argc, argv);
+   if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+   if (!GlobalBenchInit()) {
+      std::cerr << "[ERROR] Unable to start the in-process FTP server !" << std::endl;
+      GlobalBenchCleanUp();
+      return 1;
+   }
+
+   benchmark::RunSpecifiedBenchmarks();
+   benchmark::Shutdown();
+
+   GlobalBenchCleanUp();
+   return 0;
+}
@@ -5,12 +5,21 @@
  */
 
 #include "FTPClient.h"
+#include "FTPControl.h"
+#include "FTPRingBuffer.h"
+#include "FTPSessionPool.h"
 
 #include <iterator>
 #include <stdexcept>
+#include <thread>
 
 #define UNUSED(x) static_cast<void>(x);
 
+// memory shared by the download and the upload of a relayed copy
+#define RELAY_BUFFER_SIZE (4 * 1024 * 1024)
+// commands sent in a single request by RemoveTree
+#define REMOVE_TREE_BATCH_SIZE 500
+
 namespace embeddedmz {
 
 // Static members initialization
@@ -35,8 +44,20 @@ CFTPClient::CFTPClient(LogFnCallback Logger)
       m_eSettingsFlags(NO_FLAGS),
       m_pCurlSession(nullptr),
       m_iCurlTimeout(0),
+      m_bRemoteFeaturesLoaded(false),
+      m_bRemoteModeZ(false),
+      m_bModeZ(false),
+      m_iCompressionLevel(-1),
+      m_uMetricsHost(0),
+      m_pObserver(nullptr),
+      m_bDumpTraceOnError(false),
       m_bProgressCallbackSet(false),
+      m_XferInfoInterval(100),
+      m_bProgressSnapshot(false),
+      m_ullSessionBytes(0),
+      m_pJobProgress(nullptr),
       m_oLog(std::move(Logger)),
+      m_eLogLevel(LogLevel::WARN),
       m_curlHandle(CurlHandle::instance())
 {
    if (!m_oLog) {
@@ -52,7 +73,7 @@ CFTPClient::CFTPClient(LogFnCallback Logger)
  */
 CFTPClient::~CFTPClient() {
    if (m_pCurlSession != nullptr) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_WARNING_OBJECT_NOT_CLEANED);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::WARN, LOG_WARNING_OBJECT_NOT_CLEANED);
 
       CleanupSession();
    }
@@ -85,18 +106,22 @@ bool CFTPClient::InitSession(const std::string &strHost, const unsigned &uPort,
                                    const std::string &strPassword, const FTP_PROTOCOL &eFtpProtocol /* = FTP */,
                                    const SettingsFlag &eSettingsFlags /* = NO_FLAGS */) {
    if (strHost.empty()) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_EMPTY_HOST_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_EMPTY_HOST_MSG);
 
       return false;
    }
 
    if (m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_ALREADY_INIT_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_ALREADY_INIT_MSG);
 
       return false;
    }
    m_pCurlSession = curl_easy_init();
 
+   m_bRemoteFeaturesLoaded = false;
+   m_mapRemoteHashCommands.clear();
+   m_bRemoteModeZ = false;
+
    m_strServer      = strHost;
    m_uPort          = uPort;
    m_strUserName    = strLogin;
@@ -104,6 +129,26 @@ bool CFTPClient::InitSession(const std::string &strHost, const unsigned &uPort,
    m_eFtpProtocol   = eFtpProtocol;
    m_eSettingsFlags = eSettingsFlags;
 
+   /* URLs prefix : the scheme (given or deduced from the protocol), the host and a path given
+    * with it (e.g. "host/base"), which is a prefix of every remote path. */
+   size_t uHost = strHost.find("://");
+   if (uHost != std::string::npos) {
+      uHost += 3;
+      m_strURLPrefix = strHost.substr(0, uHost);
+   } else {
+      uHost          = 0;
+      m_strURLPrefix = (eFtpProtocol == FTP_PROTOCOL::FTPS) ? "ftps://" : (eFtpProtocol == FTP_PROTOCOL::SFTP) ? "sftp://" : "ftp://";
+   }
+   const size_t uHostPath = std::min(strHost.find('/', uHost), strHost.size());
+   m_strURLPrefix.append(strHost, uHost, uHostPath - uHost);
+   AppendURLPath(m_strURLPrefix, strHost.c_str() + uHostPath, strHost.c_str() + strHost.size(), false);
+   m_strURLPrefix += "//";
+
+   // "ftp://host/" -> "host:port"
+   std::string strHostLabel = strHost.substr((strHost.find("://") != std::string::npos) ? strHost.find("://") + 3 : 0);
+   strHostLabel             = strHostLabel.substr(0, strHostLabel.find('/'));
+   m_uMetricsHost           = CFTPMetrics::GetInstance().GetHostIndex(strHostLabel + ":" + std::to_string(uPort));
+
    return (m_pCurlSession != nullptr);
 }
 
@@ -122,7 +167,7 @@ bool CFTPClient::InitSession(const std::string &strHost, const unsigned &uPort,
  */
 bool CFTPClient::CleanupSession() {
    if (!m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_NOT_INIT_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
 
       return false;
    }
@@ -139,6 +184,79 @@ bool CFTPClient::CleanupSession() {
    return true;
 }
 
+/**
+ * @brief creates a new client with the same server parameters and settings
+ *
+ * the progress function callback is not copied as its owner is tied to this
+ * object. The new client has its own cURL session, so it can be used from
+ * another thread.
+ *
+ * @retval std::unique_ptr<CFTPClient> the initialized clone or nullptr if this
+ * client's session is not initialized.
+ *
+ * Example Usage:
+ * @code
+ *    auto pWorker = m_pFTPClient->CloneSession();
+ *    std::thread([&pWorker]() { pWorker->DownloadFile("local.txt", "remote.txt"); }).join();
+ * @endcode
+ */
+std::unique_ptr<CFTPClient> CFTPClient::CloneSession() const {
+   if (!m_pCurlSession) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
+
+      return nullptr;
+   }
+
+   std::unique_ptr<CFTPClient> pClone(new CFTPClient(m_oLog));
+   pClone->m_eLogLevel = m_eLogLevel;
+   pClone->m_pLogSink  = m_pLogSink;
+   if (!pClone->InitSession(m_strServer, m_uPort, m_strUserName, m_strPassword, m_eFtpProtocol, m_eSettingsFlags)) return nullptr;
+
+   pClone->m_strProxy        = m_strProxy;
+   pClone->m_strProxyUserPwd = m_strProxyUserPwd;
+   pClone->m_bActive         = m_bActive;
+   pClone->m_bNoSignal       = m_bNoSignal;
+   pClone->m_bInsecure       = m_bInsecure;
+   pClone->m_iCurlTimeout    = m_iCurlTimeout;
+   pClone->m_bModeZ          = m_bModeZ;
+   pClone->m_iCompressionLevel = m_iCompressionLevel;
+   pClone->m_strSSLCertFile  = m_strSSLCertFile;
+   pClone->m_strSSLKeyFile   = m_strSSLKeyFile;
+   pClone->m_strSSLKeyPwd    = m_strSSLKeyPwd;
+   pClone->m_pObserver       = m_pObserver;
+   pClone->m_bProgressSnapshot = m_bProgressSnapshot;
+   if (m_pTrace) pClone->EnableTrace(m_pTrace->GetCapacity(), m_bDumpTraceOnError);
+
+   return pClone;
+}
+
+/**
+ * @brief enables the runtime protocol trace of the session, a previous trace is discarded
+ *
+ * @param [in] uRecords number of records kept (commands, replies, informations, data transfers)
+ * @param [in] bDumpOnError give the trace to the logger when a request fails
+ *
+ * Example Usage:
+ * @code
+ *    m_pFTPClient->EnableTrace(4096);
+ *    if (!m_pFTPClient->DownloadFile("local.txt", "remote.txt")) std::cerr << m_pFTPClient->DumpTrace();
+ * @endcode
+ */
+void CFTPClient::EnableTrace(size_t uRecords /* = 1024 */, bool bDumpOnError /* = false */) {
+   m_pTrace.reset(new CFTPTrace(uRecords));
+   m_bDumpTraceOnError = bDumpOnError;
+}
+
+void CFTPClient::DisableTrace() {
+   m_pTrace.reset();
+   m_bDumpTraceOnError = false;
+}
+
+/**
+ * @brief returns the records of the protocol trace (see EnableTrace), one per line
+ */
+std::string CFTPClient::DumpTrace() const { return m_pTrace ? m_pTrace->Dump() : std::string(); }
+
 /**
  * @brief sets the progress function callback and the owner of the client
  *
@@ -154,6 +272,19 @@ void CFTPClient::SetProgressFnCallback(void *pOwner, const ProgressFnCallback &f
    m_bProgressCallbackSet        = enable;
 }
 
+/**
+ * @brief sets the callback receiving the progress of the transfers with their smoothed rates
+ * and estimated remaining time
+ *
+ * @param [in] fnCallback any callable, an empty one removes the callback
+ * @param [in] uMinIntervalMs minimum time between two calls during a transfer (0 : every time
+ * libcurl reports the progress), the end of a transfer is always reported
+ */
+void CFTPClient::SetXferInfoFnCallback(const XferInfoFnCallback &fnCallback, unsigned uMinIntervalMs /* = 100 */) {
+   m_fnXferInfoCallback = fnCallback;
+   m_XferInfoInterval   = std::chrono::milliseconds(uMinIntervalMs);
+}
+
 /**
  * @brief sets the HTTP Proxy address to tunnel the operation through it
  *
@@ -185,11 +316,10 @@ void CFTPClient::SetProxyUserPwd(const std::string &strProxyUserPwd) {
 /**
  * @brief generates a URI
  *
- * '/' will be duplicated to be interpreted correctly by the Curl API.
- *
  * @param [in] strRemoteFile URL of the file.
+ * @param [in] bWildcard the last segment of strRemoteFile is a pattern.
  *
- * @retval std::string A complete URI containing the requested resource.
+ * @retval std::string A complete URI containing the requested resource (see BuildURL).
  *
  * Example Usage:
  * @code
@@ -197,36 +327,67 @@ void CFTPClient::SetProxyUserPwd(const std::string &strProxyUserPwd) {
  * "ftp://127.0.0.1//documents//info.txt"
  * @endcode
  */
-std::string CFTPClient::ParseURL(const std::string &strRemoteFile) const {
-   std::string strURL = m_strServer + "/" + strRemoteFile;
-
-   ReplaceString(strURL, "/", "//");
-   ReplaceString(strURL, " ", "%20"); //fixes folders with spaces not working
+std::string CFTPClient::ParseURL(const std::string &strRemoteFile, bool bWildcard /* = false */) const {
+   std::string strURL;
+   BuildURL(strURL, strRemoteFile, bWildcard);
+   return strURL;
+}
 
-   std::string strUri = strURL;
+void CFTPClient::BuildURL(std::string &strURL, const std::string &strRemoteFile, bool bWildcard /* = false */) const {
+   // the pattern (last segment) of a wildcard URL is matched by libcurl before being decoded
+   const size_t uPattern = bWildcard ? strRemoteFile.find_last_of('/') + 1 : strRemoteFile.size();
+   const char *pszRemoteFile = strRemoteFile.c_str();
 
-   // boost::to_upper(strUri);
-   std::transform(strUri.begin(), strUri.end(), strUri.begin(), ::toupper);
+   strURL.assign(m_strURLPrefix);
+   AppendURLPath(strURL, pszRemoteFile, pszRemoteFile + uPattern, false);
+   AppendURLPath(strURL, pszRemoteFile + uPattern, pszRemoteFile + strRemoteFile.size(), true);
+}
 
-   if (strUri.compare(0, 4, "FTP:") != 0 && strUri.compare(0, 5, "SFTP:") != 0) {
-      switch (m_eFtpProtocol) {
-         case FTP_PROTOCOL::FTP:
-         case FTP_PROTOCOL::FTPES:
-         default:
-            strURL = "ftp://" + strURL;
+/**
+ * @brief appends a path to a URL in a single pass
+ *
+ * '/' will be duplicated to be interpreted correctly by the Curl API, the characters
+ * allowed in a path segment (RFC 3986) are copied, the others are percent-encoded. ';' is
+ * encoded too : libcurl reads a ";type=" suffix in a FTP path.
+ *
+ * @param [in, out] strURL URL being built.
+ * @param [in] pBegin, pEnd path.
+ * @param [in] bWildcard the path is a pattern : only the spaces are encoded.
+ */
+void CFTPClient::AppendURLPath(std::string &strURL, const char *pBegin, const char *pEnd, bool bWildcard) {
+   static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+   // written in place : at most 3 characters per input character
+   const size_t uStart = strURL.size();
+   strURL.resize(uStart + 3 * static_cast<size_t>(pEnd - pBegin));
+   char *pOut = &strURL[uStart];
+
+   for (const char *p = pBegin; p != pEnd; ++p) {
+      const unsigned char c = static_cast<unsigned char>(*p);
+      bool bCopy;
+      switch (c) {
+         case '/':
+            *pOut++ = '/';
+            *pOut++ = '/';
+            continue;
+         case '-': case '.': case '_': case '~': case '!': case '$': case '&': case '\'':
+         case '(': case ')': case '*': case '+': case ',': case '=': case ':': case '@':
+            bCopy = true;
             break;
-
-         case FTP_PROTOCOL::FTPS:
-            strURL = "ftps://" + strURL;
+         default:
+            bCopy = (bWildcard) ? c != ' ' : (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
             break;
+      }
 
-         case FTP_PROTOCOL::SFTP:
-            strURL = "sftp://" + strURL;
-            break;
+      if (bCopy) {
+         *pOut++ = static_cast<char>(c);
+      } else {
+         *pOut++ = '%';
+         *pOut++ = HEX_DIGITS[c >> 4];
+         *pOut++ = HEX_DIGITS[c & 0x0F];
       }
    }
-
-   return strURL;
+   strURL.resize(static_cast<size_t>(pOut - &strURL[0]));
 }
 
 /**
@@ -247,7 +408,7 @@ bool CFTPClient::CreateDir(const std::string &strNewDir) const {
    if (strNewDir.empty()) return false;
 
    if (!m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_NOT_INIT_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
 
       return false;
    }
@@ -262,7 +423,7 @@ bool CFTPClient::CreateDir(const std::string &strNewDir) const {
    bool bRet = false;
 
    if (m_eFtpProtocol == FTP_PROTOCOL::SFTP) {
-      strRemoteFolder        = ParseURL("");
+      strRemoteFolder        = m_strURLPrefix;
       strRemoteNewFolderName = strNewDir;
 
       // Append the rmdir command
@@ -275,15 +436,13 @@ bool CFTPClient::CreateDir(const std::string &strNewDir) const {
          strRemoteNewFolderName = strNewDir.substr(uFound + 1);
       } else  // the dir. to be created is located in the root directory
       {
-         strRemoteFolder        = ParseURL("");
+         strRemoteFolder        = m_strURLPrefix;
          strRemoteNewFolderName = strNewDir;
       }
       // Append the MKD command
       strBuf += "MKD ";
    }
 
-   // Specify target
-   curl_easy_setopt(m_pCurlSession, CURLOPT_URL, strRemoteFolder.c_str());
 
    strBuf += strRemoteNewFolderName;
    headerlist = curl_slist_append(headerlist, strBuf.c_str());
@@ -296,12 +455,12 @@ bool CFTPClient::CreateDir(const std::string &strNewDir) const {
    /* enable TCP keep-alive for this transfer */
    curl_easy_setopt(m_pCurlSession, CURLOPT_TCP_KEEPALIVE, 0L);
 
-   CURLcode res = Perform();
+   CURLcode res = Perform(CFTPMetrics::Operation::MKDIR, strRemoteFolder);
 
    // Check for errors
    if (res != CURLE_OK) {
       if (m_eSettingsFlags & ENABLE_LOG)
-         m_oLog(StringFormat(LOG_ERROR_CURL_MKDIR_FORMAT, strRemoteNewFolderName.c_str(), res, curl_easy_strerror(res)));
+         Log(LogLevel::ERR, LOG_ERROR_CURL_MKDIR_FORMAT, strRemoteNewFolderName.c_str(), res, curl_easy_strerror(res));
    } else
       bRet = true;
 
@@ -333,7 +492,7 @@ bool CFTPClient::RemoveDir(const std::string &strDir) const {
    if (strDir.empty()) return false;
 
    if (!m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_NOT_INIT_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
 
       return false;
    }
@@ -348,7 +507,7 @@ bool CFTPClient::RemoveDir(const std::string &strDir) const {
    bool bRet = false;
 
    if (m_eFtpProtocol == FTP_PROTOCOL::SFTP) {
-      strRemoteFolder     = ParseURL("");
+      strRemoteFolder     = m_strURLPrefix;
       strRemoteFolderName = strDir;
 
       // Append the rmdir command
@@ -361,7 +520,7 @@ bool CFTPClient::RemoveDir(const std::string &strDir) const {
          strRemoteFolderName = strDir.substr(uFound + 1);
       } else  // the dir. to be removed is located in the root directory
       {
-         strRemoteFolder     = ParseURL("");
+         strRemoteFolder     = m_strURLPrefix;
          strRemoteFolderName = strDir;
       }
 
@@ -369,9 +528,7 @@ bool CFTPClient::RemoveDir(const std::string &strDir) const {
       strBuf += "RMD ";
    }
 
-   // Specify target
-   curl_easy_setopt(m_pCurlSession, CURLOPT_URL, strRemoteFolder.c_str());
-   
+
    strBuf += strRemoteFolderName;
    headerlist = curl_slist_append(headerlist, strBuf.c_str());
 
@@ -379,11 +536,11 @@ bool CFTPClient::RemoveDir(const std::string &strDir) const {
    curl_easy_setopt(m_pCurlSession, CURLOPT_NOBODY, 1L);
    curl_easy_setopt(m_pCurlSession, CURLOPT_HEADER, 1L);
 
-   CURLcode res = Perform();
+   CURLcode res = Perform(CFTPMetrics::Operation::REMOVE, strRemoteFolder);
 
    if (res != CURLE_OK) {
       if (m_eSettingsFlags & ENABLE_LOG)
-         m_oLog(StringFormat(LOG_ERROR_CURL_RMDIR_FORMAT, strRemoteFolderName.c_str(), res, curl_easy_strerror(res)));
+         Log(LogLevel::ERR, LOG_ERROR_CURL_RMDIR_FORMAT, strRemoteFolderName.c_str(), res, curl_easy_strerror(res));
    } else
       bRet = true;
 
@@ -411,7 +568,7 @@ bool CFTPClient::RemoveFile(const std::string &strRemoteFile) const {
    if (strRemoteFile.empty()) return false;
 
    if (!m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_NOT_INIT_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
 
       return false;
    }
@@ -427,7 +584,7 @@ bool CFTPClient::RemoveFile(const std::string &strRemoteFile) const {
    bool bRet = false;
 
    if (m_eFtpProtocol == FTP_PROTOCOL::SFTP) {
-      strRemoteFolder   = ParseURL("");
+      strRemoteFolder   = m_strURLPrefix;
       strRemoteFileName = strRemoteFile;
 
       // Append the rm command
@@ -440,7 +597,7 @@ bool CFTPClient::RemoveFile(const std::string &strRemoteFile) const {
          strRemoteFileName = strRemoteFile.substr(uFound + 1);
       } else  // the file to be deleted is located in the root directory
       {
-         strRemoteFolder   = ParseURL("");
+         strRemoteFolder   = m_strURLPrefix;
          strRemoteFileName = strRemoteFile;
       }
       
@@ -448,9 +605,7 @@ bool CFTPClient::RemoveFile(const std::string &strRemoteFile) const {
       strBuf += "DELE ";
    }
 
-   // Specify target
-   curl_easy_setopt(m_pCurlSession, CURLOPT_URL, strRemoteFolder.c_str());
-   
+
    strBuf += strRemoteFileName;
    headerlist = curl_slist_append(headerlist, strBuf.c_str());
 
@@ -458,12 +613,12 @@ bool CFTPClient::RemoveFile(const std::string &strRemoteFile) const {
    curl_easy_setopt(m_pCurlSession, CURLOPT_NOBODY, 1L);
    curl_easy_setopt(m_pCurlSession, CURLOPT_HEADER, 1L);
 
-   CURLcode res = Perform();
+   CURLcode res = Perform(CFTPMetrics::Operation::REMOVE, strRemoteFolder);
 
    // Check for errors
    if (res != CURLE_OK) {
       if (m_eSettingsFlags & ENABLE_LOG)
-         m_oLog(StringFormat(LOG_ERROR_CURL_REMOVE_FORMAT, strRemoteFile.c_str(), res, curl_easy_strerror(res)));
+         Log(LogLevel::ERR, LOG_ERROR_CURL_REMOVE_FORMAT, strRemoteFile.c_str(), res, curl_easy_strerror(res));
    } else
       bRet = true;
 
@@ -473,6 +628,305 @@ bool CFTPClient::RemoveFile(const std::string &strRemoteFile) const {
    return bRet;
 }
 
+/**
+ * @brief sends a list of raw commands in a single request
+ *
+ * With FTP, the commands (e.g. "DELE /upload/a.txt") are sent in a quote list, each one
+ * prefixed with '*' so that libcurl continues after a failure, and the replies are read
+ * from the headers : the last ones are the replies to the commands (no CWD is sent, the
+ * previous ones are the login's). SFTP commands (e.g. "rm /upload/a.txt") are sent one
+ * per request since libcurl doesn't report their individual results.
+ *
+ * @param [in] vecCommands FTP or SFTP commands, the paths are encoded in UTF-8 format.
+ * @param [out] vecResults result of each command
+ *
+ * @retval true   All the commands succeeded.
+ * @retval false  A command failed (see vecResults) or the request failed.
+ *
+ * Example Usage:
+ * @code
+ *    std::vector<CFTPClient::CommandResult> vecResults;
+ *    m_pFTPClient->SendCommands({"MKD /upload/a", "RNFR /upload/b.txt", "RNTO /upload/a/b.txt"}, vecResults);
+ * @endcode
+ */
+bool CFTPClient::SendCommands(const std::vector<std::string> &vecCommands, std::vector<CommandResult> &vecResults) const {
+   return SendCommands(vecCommands, vecResults, CFTPMetrics::Operation::COMMAND);
+}
+
+/**
+ * @brief SendCommands recording the request as eOperation in the metrics (see CFTPMetrics)
+ */
+bool CFTPClient::SendCommands(const std::vector<std::string> &vecCommands, std::vector<CommandResult> &vecResults,
+                              CFTPMetrics::Operation eOperation) const {
+   vecResults.clear();
+   if (vecCommands.empty()) return true;
+
+   if (!m_pCurlSession) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
+
+      return false;
+   }
+
+   // a CR or LF would end the command and send the rest of the line as other commands
+   const auto HasLineBreak = [](const std::string &strCommand) { return strCommand.find_first_of("\r\n") != std::string::npos; };
+   if (std::any_of(vecCommands.begin(), vecCommands.end(), HasLineBreak)) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_BATCH_CRLF_FORMAT, static_cast<unsigned>(vecCommands.size()));
+
+      for (const auto &strCommand : vecCommands) {
+         CommandResult oResult;
+         oResult.strCommand = strCommand;
+         oResult.strReply   = HasLineBreak(strCommand) ? "CR or LF in the command" : "not sent";
+         vecResults.push_back(oResult);
+      }
+      return false;
+   }
+
+   const std::string &strRoot = m_strURLPrefix;
+
+   if (m_eFtpProtocol == FTP_PROTOCOL::SFTP) {
+      bool bRet = true;
+      for (const auto &strCommand : vecCommands) {
+         // Reset is mandatory to avoid bad surprises
+         curl_easy_reset(m_pCurlSession);
+
+         struct curl_slist *pCommand = curl_slist_append(nullptr, strCommand.c_str());
+         curl_easy_setopt(m_pCurlSession, CURLOPT_QUOTE, pCommand);
+         curl_easy_setopt(m_pCurlSession, CURLOPT_NOBODY, 1L);
+
+         CURLcode res = Perform(eOperation, strRoot);
+         curl_slist_free_all(pCommand);
+
+         CommandResult oResult;
+         oResult.strCommand = strCommand;
+         oResult.bSucceeded = (res == CURLE_OK);
+         if (res != CURLE_OK) oResult.strReply = curl_easy_strerror(res);
+         bRet = bRet && oResult.bSucceeded;
+         vecResults.push_back(oResult);
+      }
+      return bRet;
+   }
+
+   // Reset is mandatory to avoid bad surprises
+   curl_easy_reset(m_pCurlSession);
+
+   struct curl_slist *pCommands = nullptr;
+   for (const auto &strCommand : vecCommands) pCommands = curl_slist_append(pCommands, ("*" + strCommand).c_str());
+
+   std::string strReplies;
+   curl_easy_setopt(m_pCurlSession, CURLOPT_QUOTE, pCommands);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_NOBODY, 1L);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_FTP_FILEMETHOD, CURLFTPMETHOD_NOCWD);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_HEADERFUNCTION, WriteInStringCallback);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_HEADERDATA, &strReplies);
+
+   CURLcode res = Perform(eOperation, strRoot);
+
+   curl_slist_free_all(pCommands);
+
+   if (res != CURLE_OK) {
+      if (m_eSettingsFlags & ENABLE_LOG)
+         Log(LogLevel::ERR, LOG_ERROR_CURL_BATCH_FORMAT, static_cast<unsigned>(vecCommands.size()), res, curl_easy_strerror(res));
+
+      return false;
+   }
+
+   /* RFC 959 : a multi-line reply starts with "xyz-" and ends with a line starting with "xyz " */
+   std::vector<std::pair<int, std::string>> vecReplies;
+   std::string strLine;
+   std::string strMultiLineCode;
+   std::istringstream ssReplies(strReplies);
+   while (std::getline(ssReplies, strLine)) {
+      if (!strLine.empty() && strLine.back() == '\r') strLine.pop_back();
+      if (strLine.size() < 4 || !isdigit(static_cast<unsigned char>(strLine[0]))) continue;
+
+      if (!strMultiLineCode.empty()) {
+         if (strLine.compare(0, 3, strMultiLineCode) != 0 || strLine[3] != ' ') continue;
+         strMultiLineCode.clear();
+      } else if (strLine[3] == '-') {
+         strMultiLineCode = strLine.substr(0, 3);
+         continue;
+      }
+      vecReplies.push_back(std::make_pair(atoi(strLine.c_str()), strLine));
+   }
+
+   if (vecReplies.size() < vecCommands.size()) {
+      if (m_eSettingsFlags & ENABLE_LOG)
+         Log(LogLevel::ERR, LOG_ERROR_BATCH_REPLIES_FORMAT, static_cast<unsigned>(vecReplies.size()),
+             static_cast<unsigned>(vecCommands.size()));
+
+      return false;
+   }
+
+   bool bRet             = true;
+   const size_t uOffset  = vecReplies.size() - vecCommands.size();
+   for (size_t i = 0; i < vecCommands.size(); ++i) {
+      CommandResult oResult;
+      oResult.strCommand = vecCommands[i];
+      oResult.iCode      = vecReplies[uOffset + i].first;
+      oResult.strReply   = vecReplies[uOffset + i].second;
+      oResult.bSucceeded = (oResult.iCode >= 200 && oResult.iCode < 400);
+      bRet               = bRet && oResult.bSucceeded;
+      vecResults.push_back(oResult);
+   }
+
+   return bRet;
+}
+
+/**
+ * @brief removes remote files in a single request (see SendCommands)
+ *
+ * @param [in] vecRemoteFiles URNs of the files encoded in UTF-8 format.
+ * @param [out] vecResults result of each removal
+ */
+bool CFTPClient::RemoveFiles(const std::vector<std::string> &vecRemoteFiles, std::vector<CommandResult> &vecResults) const {
+   std::vector<std::string> vecCommands;
+   vecCommands.reserve(vecRemoteFiles.size());
+   for (const auto &strFile : vecRemoteFiles) vecCommands.push_back(((m_eFtpProtocol == FTP_PROTOCOL::SFTP) ? "rm " : "DELE ") + strFile);
+
+   return SendCommands(vecCommands, vecResults, CFTPMetrics::Operation::REMOVE);
+}
+
+/**
+ * @brief creates remote directories in a single request (see SendCommands), the
+ * parents must be listed before their children.
+ *
+ * @param [in] vecRemoteDirs URNs of the directories encoded in UTF-8 format.
+ * @param [out] vecResults result of each creation
+ */
+bool CFTPClient::CreateDirs(const std::vector<std::string> &vecRemoteDirs, std::vector<CommandResult> &vecResults) const {
+   std::vector<std::string> vecCommands;
+   vecCommands.reserve(vecRemoteDirs.size());
+   for (const auto &strDir : vecRemoteDirs) vecCommands.push_back(((m_eFtpProtocol == FTP_PROTOCOL::SFTP) ? "mkdir " : "MKD ") + strDir);
+
+   return SendCommands(vecCommands, vecResults, CFTPMetrics::Operation::MKDIR);
+}
+
+/**
+ * @brief removes empty remote directories in a single request (see SendCommands),
+ * the children must be listed before their parents.
+ *
+ * @param [in] vecRemoteDirs URNs of the directories encoded in UTF-8 format.
+ * @param [out] vecResults result of each removal
+ */
+bool CFTPClient::RemoveDirs(const std::vector<std::string> &vecRemoteDirs, std::vector<CommandResult> &vecResults) const {
+   std::vector<std::string> vecCommands;
+   vecCommands.reserve(vecRemoteDirs.size());
+   for (const auto &strDir : vecRemoteDirs) vecCommands.push_back(((m_eFtpProtocol == FTP_PROTOCOL::SFTP) ? "rmdir " : "RMD ") + strDir);
+
+   return SendCommands(vecCommands, vecResults, CFTPMetrics::Operation::REMOVE);
+}
+
+/**
+ * @brief renames (or moves) remote files or directories in a single request (see SendCommands)
+ *
+ * @param [in] vecRenames pairs of current and new URNs encoded in UTF-8 format.
+ * @param [out] vecResults result of each rename, for FTP the one of RNTO, or of RNFR if it failed.
+ */
+bool CFTPClient::Rename(const std::vector<std::pair<std::string, std::string>> &vecRenames, std::vector<CommandResult> &vecResults) const {
+   std::vector<std::string> vecCommands;
+   for (const auto &oRename : vecRenames) {
+      if (m_eFtpProtocol == FTP_PROTOCOL::SFTP)
+         vecCommands.push_back("rename \"" + oRename.first + "\" \"" + oRename.second + "\"");
+      else {
+         vecCommands.push_back("RNFR " + oRename.first);
+         vecCommands.push_back("RNTO " + oRename.second);
+      }
+   }
+
+   bool bRet = SendCommands(vecCommands, vecResults);
+   if (m_eFtpProtocol == FTP_PROTOCOL::SFTP || vecResults.size() != vecCommands.size()) return bRet;
+
+   std::vector<CommandResult> vecPairs;
+   for (size_t i = 0; i + 1 < vecResults.size(); i += 2) vecPairs.push_back(vecResults[i].bSucceeded ? vecResults[i + 1] : vecResults[i]);
+   vecResults.swap(vecPairs);
+
+   return bRet;
+}
+
+/**
+ * @brief removes a remote directory with all its content
+ *
+ * The tree is walked first (see Walk), entries that the server doesn't list (e.g. hidden
+ * files) prevent the removal of their directory.
+ *
+ * @param [in] strRemoteDir URN of the directory encoded in UTF-8 format, the root ("/")
+ * is emptied but not removed.
+ * @param [in] uSessions maximum number of sessions removing the files in parallel,
+ * cloned from this one (see CFTPSessionPool), 1 : this session only.
+ *
+ * @retval true   The directory was removed.
+ * @retval false  Some entries couldn't be removed. Check the log messages for more information.
+ *
+ * Example Usage:
+ * @code
+ *    m_pFTPClient->RemoveTree("/archives/2019", 8);
+ * @endcode
+ */
+bool CFTPClient::RemoveTree(const std::string &strRemoteDir, unsigned uSessions /* = 4 */) const {
+   if (strRemoteDir.empty()) return false;
+
+   if (!m_pCurlSession) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
+
+      return false;
+   }
+
+   std::string strRoot = strRemoteDir;
+   while (strRoot.size() > 1 && strRoot.back() == '/') strRoot.pop_back();
+   const std::string strPrefix = (strRoot == "/") ? strRoot : strRoot + "/";
+
+   std::vector<RemoteEntry> vecEntries;
+   if (!Walk(strRoot, vecEntries, true)) return false;
+
+   std::vector<std::string> vecFiles;
+   std::vector<std::string> vecDirs;
+   for (const auto &oEntry : vecEntries) {
+      if (oEntry.eFileType == CURLFILETYPE_DIRECTORY)
+         vecDirs.push_back(strPrefix + oEntry.strPath);
+      else
+         vecFiles.push_back(strPrefix + oEntry.strPath);
+   }
+   vecEntries.clear();
+
+   // deepest first, so that directories are empty when they are removed
+   std::stable_sort(vecDirs.begin(), vecDirs.end(), [](const std::string &strLeft, const std::string &strRight) {
+      return std::count(strLeft.begin(), strLeft.end(), '/') > std::count(strRight.begin(), strRight.end(), '/');
+   });
+   if (strRoot != "/") vecDirs.push_back(strRoot);
+
+   std::atomic<size_t> uFailures(0);
+   auto fnRemoveBatch = [&uFailures](const CFTPClient &oSession, const std::vector<std::string> &vecPaths, size_t uBatch, bool bDirs) {
+      const size_t uBegin = uBatch * REMOVE_TREE_BATCH_SIZE;
+      const std::vector<std::string> vecBatch(vecPaths.begin() + uBegin,
+                                              vecPaths.begin() + std::min(vecPaths.size(), uBegin + REMOVE_TREE_BATCH_SIZE));
+      std::vector<CommandResult> vecResults;
+      if (bDirs ? oSession.RemoveDirs(vecBatch, vecResults) : oSession.RemoveFiles(vecBatch, vecResults)) return true;
+
+      // the whole batch failed if there is no result
+      size_t uBatchFailures = vecResults.empty() ? vecBatch.size() : 0;
+      for (const auto &oResult : vecResults) uBatchFailures += oResult.bSucceeded ? 0 : 1;
+      uFailures += uBatchFailures;
+      return false;
+   };
+
+   const size_t uFileBatches = (vecFiles.size() + REMOVE_TREE_BATCH_SIZE - 1) / REMOVE_TREE_BATCH_SIZE;
+   if (uSessions > 1 && uFileBatches > 1) {
+      CFTPSessionPool oPool(*this, static_cast<unsigned>(std::min<size_t>(uSessions, uFileBatches)));
+      oPool.Run(uFileBatches, [&](CFTPClient &oSession, size_t uBatch) { return fnRemoveBatch(oSession, vecFiles, uBatch, false); });
+   } else {
+      for (size_t uBatch = 0; uBatch < uFileBatches; ++uBatch) fnRemoveBatch(*this, vecFiles, uBatch, false);
+   }
+
+   // the order matters : a single session
+   const size_t uDirBatches = (vecDirs.size() + REMOVE_TREE_BATCH_SIZE - 1) / REMOVE_TREE_BATCH_SIZE;
+   for (size_t uBatch = 0; uBatch < uDirBatches; ++uBatch) fnRemoveBatch(*this, vecDirs, uBatch, true);
+
+   if (uFailures > 0 && (m_eSettingsFlags & ENABLE_LOG))
+      Log(LogLevel::ERR, LOG_ERROR_REMOVE_TREE_FORMAT, static_cast<unsigned>(uFailures.load()), strRemoteDir.c_str());
+
+   return uFailures == 0;
+}
+
 /**
  * @brief requests the mtime (epoch) and the size of a remote file.
  *
@@ -496,7 +950,7 @@ bool CFTPClient::Info(const std::string &strRemoteFile, struct FileInfo &oFileIn
    if (strRemoteFile.empty()) return false;
 
    if (!m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_NOT_INIT_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
 
       return false;
    }
@@ -508,8 +962,6 @@ bool CFTPClient::Info(const std::string &strRemoteFile, struct FileInfo &oFileIn
    oFileInfo.tFileMTime = 0;
    oFileInfo.dFileSize  = 0.0;
 
-   curl_easy_setopt(m_pCurlSession, CURLOPT_URL, ParseURL(strRemoteFile).c_str());
-
    /* No download if the file */
    curl_easy_setopt(m_pCurlSession, CURLOPT_NOBODY, 1L);
 
@@ -519,8 +971,11 @@ bool CFTPClient::Info(const std::string &strRemoteFile, struct FileInfo &oFileIn
    /* No header output: TODO 14.1 http-style HEAD output for ftp */
    curl_easy_setopt(m_pCurlSession, CURLOPT_HEADERFUNCTION, ThrowAwayCallback);
    curl_easy_setopt(m_pCurlSession, CURLOPT_HEADER, 0L);
+   // with NOBODY, libcurl writes the size and the date as HTTP-like headers in the body (stdout by default)
+   curl_easy_setopt(m_pCurlSession, CURLOPT_WRITEFUNCTION, ThrowAwayCallback);
 
-   CURLcode res = Perform();
+   BuildURL(m_strURL, strRemoteFile);
+   CURLcode res = Perform(CFTPMetrics::Operation::INFO, m_strURL);
 
    if (CURLE_OK == res) {
       long lFileTime = -1;
@@ -536,158 +991,743 @@ bool CFTPClient::Info(const std::string &strRemoteFile, struct FileInfo &oFileIn
          bRes = false;
       }
    } else if (m_eSettingsFlags & ENABLE_LOG)
-      m_oLog(StringFormat(LOG_ERROR_CURL_FILETIME_FORMAT, strRemoteFile.c_str(), res, curl_easy_strerror(res)));
+      Log(LogLevel::ERR, LOG_ERROR_CURL_FILETIME_FORMAT, strRemoteFile.c_str(), res, curl_easy_strerror(res));
 
    return bRes;
 }
 
 /**
- * @brief lists a remote folder
- * the list can contain only names or can be detailed
- * entries/names will be separated with LF ('\n')
+ * @brief requests the checksum of a remote file computed by the server
  *
- * @param [in] strRemoteFolder URL of the remote location to be listed encoded in UTF-8 format.
- * @param [out] strList will contain the directory entries (detailed or not) encoded in UTF-8 format.
- * @param [in] bOnlyNames detailed list or only names
+ * The HASH command (draft-bryan-ftpext-hash) is preferred, otherwise the
+ * XSHA256, XSHA1 (or XSHA), XMD5 or XCRC commands are used.
  *
- * @retval true   Successfully listed the remote folder and updated FtpFiles.
- * @retval false  The remote folder couldn't be listed.
+ * @param [in] strRemoteFile URL of the remote file encoded in UTF-8 format.
+ * @param [in] eAlgorithm checksum algorithm (CRC32, MD5, SHA1 or SHA256)
+ * @param [out] strHash lowercase hex digest, comparable with CFTPHash::Final()
+ *
+ * @retval true   Successfully got the checksum.
+ * @retval false  The server doesn't support the algorithm or the request failed.
  *
  * Example Usage:
  * @code
- *    std::string strList;
- *    m_pFTPClient->GetFileList("/", strList, false);
- *    // lists the root of the remote FTP server with all the infos.
+ *    std::string strHash;
+ *    m_pFTPClient->RemoteHash("/upload/image.iso", CFTPHash::Algorithm::SHA256, strHash);
  * @endcode
  */
-bool CFTPClient::List(const std::string &strRemoteFolder, std::string &strList, bool bOnlyNames /* = true */) const {
-   if (strRemoteFolder.empty()) return false;
+bool CFTPClient::RemoteHash(const std::string &strRemoteFile, const CFTPHash::Algorithm &eAlgorithm, std::string &strHash) const {
+   strHash.clear();
+   if (strRemoteFile.empty()) return false;
 
    if (!m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_NOT_INIT_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
 
       return false;
    }
-   // Reset is mandatory to avoid bad surprises
-   curl_easy_reset(m_pCurlSession);
 
-   bool bRet = false;
+   if (!LoadRemoteFeatures()) return false;
 
-   std::string strRemoteFile = ParseURL(strRemoteFolder);
+   auto itCommand = m_mapRemoteHashCommands.find(eAlgorithm);
+   if (itCommand == m_mapRemoteHashCommands.end()) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_HASH_UNSUPPORTED_FORMAT, CFTPHash::GetName(eAlgorithm));
 
-   curl_easy_setopt(m_pCurlSession, CURLOPT_URL, strRemoteFile.c_str());
+      return false;
+   }
 
-   if (bOnlyNames) curl_easy_setopt(m_pCurlSession, CURLOPT_DIRLISTONLY, 1L);
+   const bool bHashCommand = (itCommand->second == "HASH");
+   std::vector<std::string> vecCommands;
+   if (bHashCommand) vecCommands.push_back(std::string("OPTS HASH ") + CFTPHash::GetName(eAlgorithm));
+   vecCommands.push_back(itCommand->second + " " + strRemoteFile);
+
+   std::vector<CommandResult> vecResults;
+   if (!SendCommands(vecCommands, vecResults, CFTPMetrics::Operation::INFO) && vecResults.empty()) return false;
+
+   /* only the reply to the checksum command is parsed : "213 SHA-256 0-1234 <hex> file" (HASH)
+    * or "250 <hex>" (X commands) */
+   const CommandResult &oReply = vecResults.back();
+   std::istringstream ssTokens(oReply.strReply.substr(std::min<size_t>(4, oReply.strReply.size())));
+   std::string strAlgorithm, strRange, strToken;
+   if (bHashCommand) {
+      if (oReply.iCode == 213 && ssTokens >> strAlgorithm >> strRange >> strToken) {
+         std::transform(strAlgorithm.begin(), strAlgorithm.end(), strAlgorithm.begin(), ::toupper);
+         if (strAlgorithm != CFTPHash::GetName(eAlgorithm)) strToken.clear();
+      }
+   } else if (oReply.iCode == 250)
+      ssTokens >> strToken;
+
+   const size_t uDigits = (eAlgorithm == CFTPHash::Algorithm::CRC32) ? 8 : (eAlgorithm == CFTPHash::Algorithm::MD5) ? 32
+                          : (eAlgorithm == CFTPHash::Algorithm::SHA1) ? 40 : 64;
+   // some servers drop the leading zeros of CRC32 values
+   const size_t uMinDigits = (eAlgorithm == CFTPHash::Algorithm::CRC32) ? 1 : uDigits;
+   if (strToken.size() >= uMinDigits && strToken.size() <= uDigits &&
+       strToken.find_first_not_of("0123456789abcdefABCDEF") == std::string::npos) {
+      strHash = std::string(uDigits - strToken.size(), '0') + strToken;
+      std::transform(strHash.begin(), strHash.end(), strHash.begin(), ::tolower);
+      return true;
+   }
 
-   curl_easy_setopt(m_pCurlSession, CURLOPT_WRITEFUNCTION, WriteInStringCallback);
-   curl_easy_setopt(m_pCurlSession, CURLOPT_WRITEDATA, &strList);
+   if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_HASH_PARSE_FORMAT, CFTPHash::GetName(eAlgorithm), strRemoteFile.c_str());
 
-   CURLcode res = Perform();
+   return false;
+}
 
-   if (CURLE_OK == res)
-      bRet = true;
-   else if (m_eSettingsFlags & ENABLE_LOG)
-      m_oLog(StringFormat(LOG_ERROR_CURL_FILELIST_FORMAT, strRemoteFolder.c_str(), res, curl_easy_strerror(res)));
+/**
+ * @brief strongest checksum algorithm supported by the server
+ *
+ * @return SHA256, SHA1, MD5, CRC32 or NONE if the server doesn't compute checksums
+ */
+CFTPHash::Algorithm CFTPClient::GetRemoteHashAlgorithm() const {
+   if (!m_pCurlSession || !LoadRemoteFeatures()) return CFTPHash::Algorithm::NONE;
 
-   return bRet;
+   const CFTPHash::Algorithm arrPreferred[4] = {CFTPHash::Algorithm::SHA256, CFTPHash::Algorithm::SHA1, CFTPHash::Algorithm::MD5,
+                                                CFTPHash::Algorithm::CRC32};
+   for (const auto eAlgorithm : arrPreferred) {
+      if (m_mapRemoteHashCommands.count(eAlgorithm)) return eAlgorithm;
+   }
+
+   return CFTPHash::Algorithm::NONE;
 }
 
 /**
- * @brief downloads a remote file
+ * @brief sends FEAT once per session and records the checksum commands and MODE Z
  *
- * @param [in] strLocalFile complete path of the downloaded file encoded in UTF-8 format.
- * @param [in] strRemoteFile URL of the remote file encoded in UTF-8 format.
- *
- * @retval true   Successfully downloaded the file.
- * @retval false  The file couldn't be downloaded. Check the log messages for
- * more information.
- *
- * Example Usage:
- * @code
- *    m_pFTPClient->DownloadFile("C:\\Items_To_Upload\\imagination.jpg",
- * "upload/pictures/imagination.jpg");
- * @endcode
+ * @retval true   The features are known (SFTP has none).
+ * @retval false  FEAT failed.
  */
-bool CFTPClient::DownloadFile(const std::string &strLocalFile, const std::string &strRemoteFile) const {
-   if (strLocalFile.empty() || strRemoteFile.empty()) return false;
-
-   if (!m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_NOT_INIT_MSG);
+bool CFTPClient::LoadRemoteFeatures() const {
+   if (m_bRemoteFeaturesLoaded) return true;
 
-      return false;
+   if (m_eFtpProtocol == FTP_PROTOCOL::SFTP) {
+      m_bRemoteFeaturesLoaded = true;
+      return true;
    }
+
    // Reset is mandatory to avoid bad surprises
    curl_easy_reset(m_pCurlSession);
 
-   bool bRet = false;
+   struct curl_slist *pCommands = curl_slist_append(nullptr, "FEAT");
+   std::string strReplies;
+   const std::string &strRoot = m_strURLPrefix;
 
-   std::string strFile = ParseURL(strRemoteFile);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_QUOTE, pCommands);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_NOBODY, 1L);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_HEADERFUNCTION, WriteInStringCallback);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_HEADERDATA, &strReplies);
 
-   std::ofstream ofsOutput;
-   ofsOutput.open(
-       #ifdef LINUX
-       strLocalFile, // UTF-8
-       #else
-       Utf8ToUtf16(strLocalFile),
-       #endif
-       std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+   CURLcode res = Perform(CFTPMetrics::Operation::COMMAND, strRoot);
 
-   if (ofsOutput) {
-      curl_easy_setopt(m_pCurlSession, CURLOPT_URL, strFile.c_str());
-      curl_easy_setopt(m_pCurlSession, CURLOPT_WRITEFUNCTION, WriteToFileCallback);
-      curl_easy_setopt(m_pCurlSession, CURLOPT_WRITEDATA, &ofsOutput);
+   curl_slist_free_all(pCommands);
 
-      CURLcode res = Perform();
+   if (res != CURLE_OK) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_FEAT_FORMAT, m_strServer.c_str(), res, curl_easy_strerror(res));
 
-      if (res != CURLE_OK) {
-         if (m_eSettingsFlags & ENABLE_LOG)
-            m_oLog(StringFormat(LOG_ERROR_CURL_GETFILE_FORMAT, m_strServer.c_str(), strRemoteFile.c_str(), res, curl_easy_strerror(res)));
-      } else
-         bRet = true;
+      return false;
+   }
 
-      ofsOutput.close();
+   m_mapRemoteHashCommands.clear();
+   m_bRemoteModeZ = false;
+
+   // features are listed one per line, indented with a space
+   std::istringstream ssReplies(strReplies);
+   std::string strLine;
+   while (std::getline(ssReplies, strLine)) {
+      if (strLine.empty() || strLine[0] != ' ') continue;
+      if (strLine.back() == '\r') strLine.pop_back();
+
+      std::istringstream ssFeature(strLine);
+      std::string strName, strArgs;
+      ssFeature >> strName >> strArgs;
+      std::transform(strName.begin(), strName.end(), strName.begin(), ::toupper);
+
+      if (strName == "HASH") {
+         // e.g. "HASH SHA-256*;SHA-1;MD5;CRC32", '*' marks the selected one
+         std::istringstream ssArgs(strArgs);
+         std::string strAlgorithm;
+         while (std::getline(ssArgs, strAlgorithm, ';')) {
+            strAlgorithm.erase(std::remove(strAlgorithm.begin(), strAlgorithm.end(), '*'), strAlgorithm.end());
+            std::transform(strAlgorithm.begin(), strAlgorithm.end(), strAlgorithm.begin(), ::toupper);
+            for (const auto eAlgorithm : {CFTPHash::Algorithm::SHA256, CFTPHash::Algorithm::SHA1, CFTPHash::Algorithm::MD5,
+                                          CFTPHash::Algorithm::CRC32}) {
+               if (strAlgorithm == CFTPHash::GetName(eAlgorithm)) m_mapRemoteHashCommands[eAlgorithm] = "HASH";
+            }
+         }
+      } else if (strName == "XSHA256") {
+         m_mapRemoteHashCommands.insert(std::make_pair(CFTPHash::Algorithm::SHA256, strName));
+      } else if (strName == "XSHA1" || strName == "XSHA") {
+         m_mapRemoteHashCommands.insert(std::make_pair(CFTPHash::Algorithm::SHA1, strName));
+      } else if (strName == "XMD5") {
+         m_mapRemoteHashCommands.insert(std::make_pair(CFTPHash::Algorithm::MD5, strName));
+      } else if (strName == "XCRC") {
+         m_mapRemoteHashCommands.insert(std::make_pair(CFTPHash::Algorithm::CRC32, strName));
+      } else if (strName == "MODE" && (strArgs == "Z" || strArgs == "z")) {
+         m_bRemoteModeZ = true;
+      }
+   }
 
-      if (!bRet) remove(strLocalFile.c_str());
-   } else if (m_eSettingsFlags & ENABLE_LOG)
-      m_oLog(LOG_ERROR_FILE_GETFILE_FORMAT);
+   m_bRemoteFeaturesLoaded = true;
 
-   return bRet;
+   return true;
 }
+
 /**
- * @brief downloads a remote file to memory
+ * @brief picks the strongest remote checksum when a verification is requested without algorithm
  *
- * @param [in] strRemoteFile URI of remote file encoded in UTF-8 format.
- * @param [out] data vector of bytes
+ * @param [in, out] oOptions options of the transfer
  *
- * @retval true   Successfully downloaded the file.
+ * @retval true   The transfer can start.
+ * @retval false  The verification is impossible.
+ */
+bool CFTPClient::SelectVerifyHashAlgorithm(TransferOptions &oOptions) const {
+   if (!oOptions.bVerifyRemoteHash || oOptions.eHashAlgorithm != CFTPHash::Algorithm::NONE) return true;
+
+   oOptions.eHashAlgorithm = GetRemoteHashAlgorithm();
+   if (oOptions.eHashAlgorithm == CFTPHash::Algorithm::NONE) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_HASH_UNSUPPORTED_FORMAT, "any");
+
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * @brief compares the digest computed during a transfer with the server's one
+ *
+ * @param [in] strRemoteFile URL of the transferred remote file
+ * @param [in] oOptions options of the transfer (algorithm and local digest)
+ *
+ * @retval true   The checksums are equal.
+ * @retval false  The checksums differ or the remote one couldn't be obtained.
+ */
+bool CFTPClient::VerifyRemoteHash(const std::string &strRemoteFile, const TransferOptions &oOptions) const {
+   std::string strRemoteHash;
+   if (!RemoteHash(strRemoteFile, oOptions.eHashAlgorithm, strRemoteHash)) return false;
+
+   if (strRemoteHash != oOptions.strHash) {
+      if (m_eSettingsFlags & ENABLE_LOG)
+         Log(LogLevel::ERR, LOG_ERROR_HASH_MISMATCH_FORMAT, CFTPHash::GetName(oOptions.eHashAlgorithm), strRemoteFile.c_str(),
+             oOptions.strHash.c_str(), strRemoteHash.c_str());
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * @brief checks if the transfers can be compressed
+ *
+ * @retval true   The library was built with zlib and the server advertises MODE Z.
+ * @retval false  MODE Z can't be used.
+ */
+bool CFTPClient::IsModeZSupported() const {
+   if (!m_pCurlSession || !CFTPZStream::IsAvailable() || m_eFtpProtocol == FTP_PROTOCOL::SFTP) return false;
+
+   return LoadRemoteFeatures() && m_bRemoteModeZ;
+}
+
+/**
+ * @brief tells if the next transfer uses MODE Z : it must be enabled with SetModeZ()
+ * and supported, otherwise the data is transferred uncompressed.
+ */
+bool CFTPClient::UseModeZ() const { return m_bModeZ && IsModeZSupported(); }
+
+/**
+ * @brief switches the data connection to MODE Z for the next transfer only
+ *
+ * @param [out] pQuote commands sent before the transfer (the server's compression level is optional)
+ * @param [out] pPostQuote commands sent after the transfer, to restore the stream mode
+ */
+void CFTPClient::SetModeZCommands(struct curl_slist *&pQuote, struct curl_slist *&pPostQuote) const {
+   pQuote = curl_slist_append(pQuote, "MODE Z");
+   // '*' : libcurl ignores the failure of this command
+   if (m_iCompressionLevel >= 0) pQuote = curl_slist_append(pQuote, StringFormat("*OPTS MODE Z LEVEL %d", m_iCompressionLevel).c_str());
+   pPostQuote = curl_slist_append(pPostQuote, "MODE S");
+
+   curl_easy_setopt(m_pCurlSession, CURLOPT_QUOTE, pQuote);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_POSTQUOTE, pPostQuote);
+   // the size announced by the server is the uncompressed one
+   curl_easy_setopt(m_pCurlSession, CURLOPT_IGNORE_CONTENT_LENGTH, 1L);
+}
+
+/**
+ * @brief sends MODE S after a failed MODE Z transfer (the post-quote commands were
+ * not sent), so that the next requests of the session are not compressed.
+ */
+void CFTPClient::RestoreStreamMode() const {
+   curl_easy_reset(m_pCurlSession);
+
+   struct curl_slist *pCommands = curl_slist_append(nullptr, "MODE S");
+   const std::string &strRoot    = m_strURLPrefix;
+
+   curl_easy_setopt(m_pCurlSession, CURLOPT_QUOTE, pCommands);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_NOBODY, 1L);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_HEADERFUNCTION, ThrowAwayCallback);
+
+   Perform(CFTPMetrics::Operation::COMMAND, strRoot);
+
+   curl_slist_free_all(pCommands);
+}
+
+/**
+ * @brief checks the zlib stream of a MODE Z transfer and restores the stream mode on failure
+ *
+ * @param [in] res result of the transfer
+ * @param [in] oZStream stream used by the transfer callbacks
+ * @param [in] strRemote remote file or folder (for the log)
+ *
+ * @return res or CURLE_BAD_CONTENT_ENCODING if the zlib stream is corrupted or truncated
+ */
+CURLcode CFTPClient::EndModeZTransfer(CURLcode res, const CFTPZStream &oZStream, const std::string &strRemote) const {
+   if (!oZStream.IsValid() || (res == CURLE_OK && !oZStream.IsFinished())) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_MODEZ_STREAM_FORMAT, strRemote.c_str());
+
+      if (res == CURLE_OK) res = CURLE_BAD_CONTENT_ENCODING;
+   }
+
+   if (res != CURLE_OK) RestoreStreamMode();
+
+   return res;
+}
+
+/**
+ * @brief lists a remote folder
+ * the list can contain only names or can be detailed
+ * entries/names will be separated with LF ('\n')
+ *
+ * @param [in] strRemoteFolder URL of the remote location to be listed encoded in UTF-8 format.
+ * @param [out] strList will contain the directory entries (detailed or not) encoded in UTF-8 format.
+ * @param [in] bOnlyNames detailed list or only names
+ *
+ * @retval true   Successfully listed the remote folder and updated FtpFiles.
+ * @retval false  The remote folder couldn't be listed.
+ *
+ * Example Usage:
+ * @code
+ *    std::string strList;
+ *    m_pFTPClient->GetFileList("/", strList, false);
+ *    // lists the root of the remote FTP server with all the infos.
+ * @endcode
+ */
+bool CFTPClient::List(const std::string &strRemoteFolder, std::string &strList, bool bOnlyNames /* = true */) const {
+   if (strRemoteFolder.empty()) return false;
+
+   if (!m_pCurlSession) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
+
+      return false;
+   }
+
+   bool bRet = false;
+
+   CFTPStringSink oSink(strList);
+   CURLcode res = PerformDownload(strRemoteFolder, oSink, bOnlyNames, 0, CFTPMetrics::Operation::LIST);
+
+   if (CURLE_OK == res)
+      bRet = true;
+   else if (m_eSettingsFlags & ENABLE_LOG)
+      Log(LogLevel::ERR, LOG_ERROR_CURL_FILELIST_FORMAT, strRemoteFolder.c_str(), res, curl_easy_strerror(res));
+
+   return bRet;
+}
+
+/**
+ * @brief collects the entries of a remote folder (and of its sub-folders)
+ * name, size, mtime, permissions and type are taken from the LIST output parsed
+ * by libcurl's wildcard machinery, every item is skipped so no file is downloaded.
+ * NB : like DownloadWildcard, it doesn't work with SFTP.
+ *
+ * @param [in] strRemoteFolder URL of the remote folder to walk encoded in UTF-8 format.
+ * @param [out] vecEntries will contain the entries, their paths are relative to strRemoteFolder.
+ * @param [in] bRecursive walk the sub-folders too
+ *
+ * @retval true   Successfully walked the remote folder.
+ * @retval false  The remote folder (or one of its sub-folders) couldn't be listed.
+ *
+ * Example Usage:
+ * @code
+ *    std::vector<CFTPClient::RemoteEntry> vecEntries;
+ *    m_pFTPClient->Walk("/pictures", vecEntries);
+ *    CFTPSnapshot oSnapshot(vecEntries);
+ * @endcode
+ */
+bool CFTPClient::Walk(const std::string &strRemoteFolder, std::vector<RemoteEntry> &vecEntries, bool bRecursive /* = true */) const {
+   if (strRemoteFolder.empty()) return false;
+
+   if (!m_pCurlSession) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
+
+      return false;
+   }
+
+   vecEntries.clear();
+
+   std::string strBaseUrl = strRemoteFolder;
+   if (strBaseUrl.back() != '/') strBaseUrl += "/";
+
+   // folders remaining to be listed, relative to strRemoteFolder
+   std::vector<std::string> vecPending(1, std::string());
+   std::string strPattern;
+
+   while (!vecPending.empty()) {
+      WalkCallbackData data;
+      data.pEntries  = &vecEntries;
+      data.strPrefix = vecPending.back();
+      vecPending.pop_back();
+
+      // Reset is mandatory to avoid bad surprises
+      curl_easy_reset(m_pCurlSession);
+
+      BuildURL(strPattern, strBaseUrl + data.strPrefix + "*", true);
+
+      curl_easy_setopt(m_pCurlSession, CURLOPT_WILDCARDMATCH, 1L);
+      curl_easy_setopt(m_pCurlSession, CURLOPT_CHUNK_BGN_FUNCTION, WalkEntryCallback);
+      curl_easy_setopt(m_pCurlSession, CURLOPT_CHUNK_DATA, &data);
+
+      CURLcode res = Perform(CFTPMetrics::Operation::LIST, strPattern);
+
+      /* an empty folder gives CURLE_REMOTE_FILE_NOT_FOUND */
+      if (res != CURLE_OK && res != CURLE_REMOTE_FILE_NOT_FOUND) {
+         if (m_eSettingsFlags & ENABLE_LOG)
+            Log(LogLevel::ERR, LOG_ERROR_CURL_WALK_FORMAT, (strBaseUrl + data.strPrefix).c_str(), res, curl_easy_strerror(res));
+         return false;
+      }
+
+      if (bRecursive) {
+         for (const auto &Dir : data.vecDirList) vecPending.push_back(data.strPrefix + Dir + "/");
+      }
+   }
+
+   return true;
+}
+
+/**
+ * @brief downloads a remote file
+ *
+ * @param [in] strLocalFile complete path of the downloaded file encoded in UTF-8 format.
+ * @param [in] strRemoteFile URL of the remote file encoded in UTF-8 format.
+ *
+ * @retval true   Successfully downloaded the file.
+ * @retval false  The file couldn't be downloaded. Check the log messages for
+ * more information.
+ *
+ * Example Usage:
+ * @code
+ *    m_pFTPClient->DownloadFile("C:\\Items_To_Upload\\imagination.jpg",
+ * "upload/pictures/imagination.jpg");
+ * @endcode
+ */
+bool CFTPClient::DownloadFile(const std::string &strLocalFile, const std::string &strRemoteFile) const {
+   TransferOptions oOptions;
+   return DownloadFile(strLocalFile, strRemoteFile, oOptions);
+}
+
+/**
+ * @brief downloads a remote file with extra options
+ *
+ * @param [in] strLocalFile complete path of the downloaded file encoded in UTF-8 format.
+ * @param [in] strRemoteFile URL of the remote file encoded in UTF-8 format.
+ * @param [in, out] oOptions if a hash algorithm is set, oOptions.strHash receives the
+ * digest of the downloaded content. With oOptions.eResume, the data is downloaded in
+ * strLocalFile + ".part" which is kept on failure (or if the process is killed) with
+ * strLocalFile + ".part.info", holding the remote size and mtime, so that the next call
+ * can check that the remote file didn't change before continuing it (otherwise the
+ * download restarts from the beginning).
+ *
+ * @retval true   Successfully downloaded the file.
+ * @retval false  The file couldn't be downloaded. Check the log messages for
+ * more information.
+ *
+ * Example Usage:
+ * @code
+ *    CFTPClient::TransferOptions oOptions;
+ *    oOptions.eHashAlgorithm = CFTPHash::Algorithm::SHA256;
+ *    oOptions.eResume        = CFTPClient::ResumeMode::AUTO;
+ *    while (!m_pFTPClient->DownloadFile("C:\\Downloads\\image.iso", "isos/image.iso", oOptions))
+ *       std::this_thread::sleep_for(std::chrono::seconds(10));
+ *    std::cout << oOptions.strHash << std::endl;
+ * @endcode
+ */
+bool CFTPClient::DownloadFile(const std::string &strLocalFile, const std::string &strRemoteFile, TransferOptions &oOptions) const {
+   oOptions.strHash.clear();
+   if (strLocalFile.empty() || strRemoteFile.empty()) return false;
+
+   if (!m_pCurlSession) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
+
+      return false;
+   }
+
+   if (!SelectVerifyHashAlgorithm(oOptions)) return false;
+
+   bool bRet     = false;
+   bool bRenamed = false;  // strLocalFile was replaced by the downloaded data
+
+   const bool bResume               = (oOptions.eResume != ResumeMode::NONE);
+   const std::string strOutputFile = bResume ? strLocalFile + ".part" : strLocalFile;
+   CFTPHash oHash(oOptions.eHashAlgorithm);
+
+   // the remote size and mtime identify the content of a partial file, without them it isn't kept
+   FileInfo oRemoteInfo   = {0, 0.0};
+   bool bResumable        = bResume && Info(strRemoteFile, oRemoteInfo) && oRemoteInfo.tFileMTime > 0;
+   oOptions.llResumedFrom = bResumable ? GetResumeOffset(strOutputFile, oRemoteInfo) : 0;
+
+   // the kept data is hashed too
+   if (oOptions.llResumedFrom > 0 && oOptions.eHashAlgorithm != CFTPHash::Algorithm::NONE) {
+      std::ifstream ifsPartial;
+      ifsPartial.open(
+          #ifdef LINUX
+          strOutputFile,
+          #else
+          Utf8ToUtf16(strOutputFile),
+          #endif
+          std::ifstream::in | std::ifstream::binary);
+
+      if (!HashStreamPrefix(ifsPartial, oOptions.llResumedFrom, oHash)) {
+         oHash.Reset();
+         oOptions.llResumedFrom = 0;
+      }
+   }
+
+   std::ofstream ofsOutput;
+   ofsOutput.open(
+       #ifdef LINUX
+       strOutputFile, // UTF-8
+       #else
+       Utf8ToUtf16(strOutputFile),
+       #endif
+       std::ofstream::out | std::ofstream::binary | ((oOptions.llResumedFrom > 0) ? std::ofstream::app : std::ofstream::trunc));
+
+   if (ofsOutput) {
+      // recorded before the transfer so that a partial file left by a killed process can be continued too
+      // a partial file that can't be identified isn't kept
+      if (bResumable && oOptions.llResumedFrom == 0 && !WriteResumeInfo(strOutputFile, oRemoteInfo)) {
+         bResumable = false;
+         if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::WARN, LOG_WARNING_RESUME_INFO_FORMAT, strOutputFile.c_str());
+      }
+
+      CFTPStreamSink oFileSink(ofsOutput);
+      CFTPPipeline oPipeline(oFileSink);
+      if (oOptions.eHashAlgorithm != CFTPHash::Algorithm::NONE) oPipeline.Emplace<CFTPHashStage>(oHash);
+
+      CURLcode res = PerformDownload(strRemoteFile, oPipeline, false, oOptions.llResumedFrom);
+
+      if (res != CURLE_OK) {
+         if (m_eSettingsFlags & ENABLE_LOG)
+            Log(LogLevel::ERR, LOG_ERROR_CURL_GETFILE_FORMAT, m_strServer.c_str(), strRemoteFile.c_str(), res, curl_easy_strerror(res));
+      } else {
+         oOptions.strHash = oHash.Final();
+         bRet             = true;
+      }
+
+      ofsOutput.close();
+
+      if (bResume) {
+         if (bRet) {
+#ifdef LINUX
+            bRet = (rename(strOutputFile.c_str(), strLocalFile.c_str()) == 0);
+#else
+            _wremove(Utf8ToUtf16(strLocalFile).c_str());
+            bRet = (_wrename(Utf8ToUtf16(strOutputFile).c_str(), Utf8ToUtf16(strLocalFile).c_str()) == 0);
+#endif
+            if (!bRet && (m_eSettingsFlags & ENABLE_LOG))
+               Log(LogLevel::ERR, LOG_ERROR_FILE_RENAME_FORMAT, strOutputFile.c_str(), strLocalFile.c_str());
+            bRenamed = bRet;
+         } else if (bResumable) {
+            // kept for the next attempt
+            return false;
+         }
+         remove((strOutputFile + ".info").c_str());
+      }
+
+      // a corrupted file is removed too
+      if (bRet && oOptions.bVerifyRemoteHash) bRet = VerifyRemoteHash(strRemoteFile, oOptions);
+
+      if (!bRet) remove(strOutputFile.c_str());
+      // the previous copy of the file is only lost once replaced
+      if (!bRet && bRenamed) remove(strLocalFile.c_str());
+   } else if (m_eSettingsFlags & ENABLE_LOG)
+      Log(LogLevel::ERR, LOG_ERROR_FILE_GETFILE_FORMAT, strOutputFile.c_str());
+
+   return bRet;
+}
+
+/**
+ * @brief checks if a partial file left by a resumable download can be continued :
+ * the remote size and mtime recorded in strPartFile + ".info" when it was created
+ * (see WriteResumeInfo) must be the current ones and its size lower than or equal
+ * to the remote one.
+ *
+ * @param [in] strPartFile path of the partial file encoded in UTF-8 format.
+ * @param [in] oRemoteInfo size and mtime of the remote file
+ *
+ * @return the number of bytes to keep, 0 to restart the download
+ */
+curl_off_t CFTPClient::GetResumeOffset(const std::string &strPartFile, const FileInfo &oRemoteInfo) const {
+#ifdef LINUX
+   struct stat oPartInfo;
+   if (stat(strPartFile.c_str(), &oPartInfo) != 0) return 0;
+#else
+   struct _stat64 oPartInfo;
+   if (_wstat64(Utf8ToUtf16(strPartFile).c_str(), &oPartInfo) != 0) return 0;
+#endif
+
+   std::ifstream ifsInfo;
+   ifsInfo.open(
+       #ifdef LINUX
+       strPartFile + ".info",
+       #else
+       Utf8ToUtf16(strPartFile + ".info"),
+       #endif
+       std::ifstream::in);
+
+   long long llRecordedSize = -1, llRecordedMTime = -1;
+   if (!(ifsInfo >> llRecordedSize >> llRecordedMTime)) return 0;
+
+   const curl_off_t llPartSize   = static_cast<curl_off_t>(oPartInfo.st_size);
+   const curl_off_t llRemoteSize = static_cast<curl_off_t>(oRemoteInfo.dFileSize);
+   if (llRecordedSize != llRemoteSize || llRecordedMTime != static_cast<long long>(oRemoteInfo.tFileMTime) || llPartSize > llRemoteSize)
+      return 0;
+
+   return llPartSize;
+}
+
+/**
+ * @brief records the size and mtime of the remote file whose content is downloaded
+ * in strPartFile, in strPartFile + ".info" (see GetResumeOffset)
+ *
+ * @param [in] strPartFile path of the partial file encoded in UTF-8 format.
+ * @param [in] oRemoteInfo size and mtime of the remote file
+ *
+ * @retval true   Successfully written.
+ * @retval false  The file couldn't be written, the download can't be continued.
+ */
+bool CFTPClient::WriteResumeInfo(const std::string &strPartFile, const FileInfo &oRemoteInfo) {
+   std::ofstream ofsInfo;
+   ofsInfo.open(
+       #ifdef LINUX
+       strPartFile + ".info",
+       #else
+       Utf8ToUtf16(strPartFile + ".info"),
+       #endif
+       std::ofstream::out | std::ofstream::trunc);
+
+   ofsInfo << static_cast<long long>(oRemoteInfo.dFileSize) << ' ' << static_cast<long long>(oRemoteInfo.tFileMTime) << '\n';
+   ofsInfo.close();
+
+   return !ofsInfo.fail();
+}
+
+/**
+ * @brief downloads a remote file to memory
+ *
+ * @param [in] strRemoteFile URI of remote file encoded in UTF-8 format.
+ * @param [out] data vector of bytes
+ *
+ * @retval true   Successfully downloaded the file.
  * @retval false  The file couldn't be downloaded. Check the log messages for
  * more information.
  */
 bool CFTPClient::DownloadFile(const std::string &strRemoteFile, std::vector<char> &data) const {
    if (strRemoteFile.empty()) return false;
    if (!m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_NOT_INIT_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
       return false;
    }
-   curl_easy_reset(m_pCurlSession);
-   std::string strFile = ParseURL(strRemoteFile);
 
    data.clear();
 
-   curl_easy_setopt(m_pCurlSession, CURLOPT_URL, strFile.c_str());
-   curl_easy_setopt(m_pCurlSession, CURLOPT_WRITEFUNCTION, WriteToMemory);
-   curl_easy_setopt(m_pCurlSession, CURLOPT_WRITEDATA, &data);
+   CFTPMemorySink oSink(data);
+   return DownloadFile(strRemoteFile, oSink);
+}
 
-   CURLcode res = Perform();
+/**
+ * @brief downloads a remote file through a sink, usually a CFTPPipeline chaining
+ * transforms (hash, line endings conversion, tee...) in front of the destination.
+ * MODE Z data is inflated before reaching the sink.
+ *
+ * @param [in] strRemoteFile URI of remote file encoded in UTF-8 format.
+ * @param [in] oSink receives the data, its Finish() method is called once the
+ * file is downloaded.
+ *
+ * @retval true   Successfully downloaded the file.
+ * @retval false  The file couldn't be downloaded or the sink failed. Check the log
+ * messages for more information.
+ *
+ * Example Usage:
+ * @code
+ *    std::ofstream ofsOutput("report.csv", std::ofstream::binary);
+ *    CFTPStreamSink oFileSink(ofsOutput);
+ *    CFTPPipeline oPipeline(oFileSink);
+ *    oPipeline.Emplace<CFTPLineEndingStage>(CFTPLineEndingStage::Mode::TO_LF);
+ *    m_pFTPClient->DownloadFile("reports/report.csv", oPipeline);
+ * @endcode
+ */
+bool CFTPClient::DownloadFile(const std::string &strRemoteFile, CFTPSink &oSink) const {
+   if (strRemoteFile.empty()) return false;
+   if (!m_pCurlSession) {
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
+      return false;
+   }
+
+   CURLcode res = PerformDownload(strRemoteFile, oSink, false);
 
    if (res != CURLE_OK) {
       if (m_eSettingsFlags & ENABLE_LOG)
-         m_oLog(StringFormat(LOG_ERROR_CURL_GETFILE_FORMAT, m_strServer.c_str(), strRemoteFile.c_str(), res, curl_easy_strerror(res)));
+         Log(LogLevel::ERR, LOG_ERROR_CURL_GETFILE_FORMAT, m_strServer.c_str(), strRemoteFile.c_str(), res, curl_easy_strerror(res));
       return false;
    } else
       return true;
 }
 
+/**
+ * @brief common part of the downloads and lists : the data received by libcurl goes
+ * through the MODE Z inflate stage (if used) then through oSink.
+ *
+ * @param [in] strRemote remote file or folder
+ * @param [in] oSink destination of the data, finished on success
+ * @param [in] bDirListOnly NLST instead of LIST for a folder
+ * @param [in] llResumeFrom offset of the first byte to download (REST)
+ * @param [in] eOperation kind of request recorded in the metrics
+ *
+ * @return the result of the transfer, CURLE_WRITE_ERROR if the sink failed
+ */
+CURLcode CFTPClient::PerformDownload(const std::string &strRemote, CFTPSink &oSink, bool bDirListOnly, curl_off_t llResumeFrom /* = 0 */,
+                                     CFTPMetrics::Operation eOperation /* = CFTPMetrics::Operation::DOWNLOAD */) const {
+   const bool bModeZ = UseModeZ();
+
+   // Reset is mandatory to avoid bad surprises
+   curl_easy_reset(m_pCurlSession);
+
+   BuildURL(m_strURL, strRemote);
+   const std::string &strURL = m_strURL;
+
+   if (bDirListOnly) curl_easy_setopt(m_pCurlSession, CURLOPT_DIRLISTONLY, 1L);
+   if (llResumeFrom > 0) {
+      curl_easy_setopt(m_pCurlSession, CURLOPT_RESUME_FROM_LARGE, llResumeFrom);
+      Log(LogLevel::INFO, LOG_INFO_RESUME_FORMAT, strRemote.c_str(), static_cast<long long>(llResumeFrom));
+   }
+
+   CFTPInflateStage oInflate;
+   oInflate.SetNext(&oSink);
+   CFTPSink *pEntry = bModeZ ? static_cast<CFTPSink *>(&oInflate) : &oSink;
+
+   struct curl_slist *pQuote = nullptr, *pPostQuote = nullptr;
+   if (bModeZ) SetModeZCommands(pQuote, pPostQuote);
+
+   curl_easy_setopt(m_pCurlSession, CURLOPT_WRITEFUNCTION, CFTPPipeline::WriteCallback);
+   curl_easy_setopt(m_pCurlSession, CURLOPT_WRITEDATA, pEntry);
+
+   CURLcode res = Perform(eOperation, strURL);
+
+   curl_slist_free_all(pQuote);
+   curl_slist_free_all(pPostQuote);
+   if (bModeZ) res = EndModeZTransfer(res, oInflate.GetZStream(), strRemote);
+
+   if (res == CURLE_OK && !pEntry->Finish()) res = CURLE_WRITE_ERROR;
+
+   return res;
+}
+
 /**
  * @brief downloads all elements according that match the wildcarded URL
  *
@@ -704,10 +1744,40 @@ bool CFTPClient::DownloadFile(const std::string &strRemoteFile, std::vector<char
  * @endcode
  */
 bool CFTPClient::DownloadWildcard(const std::string &strLocalDir, const std::string &strRemoteWildcard) const {
+   return DownloadWildcard(strLocalDir, strRemoteWildcard, nullptr, std::string());
+}
+
+/**
+ * @brief downloads the elements that match the wildcarded URL and the filter
+ *
+ * @param [in] strLocalFile Complete path where the elements will be downloaded encoded in UTF-8 format.
+ * @param [in] strRemoteWildcard Wildcarded pattern to be downloaded encoded in UTF-8 format.
+ * @param [in] oFilter rules evaluated for each listed entry, rejected files and folders are
+ * skipped before their transfer starts.
+ *
+ * @retval true   All the accepted elements have been downloaded.
+ * @retval false  Some or all files or dir have not been downloaded or resp.
+ * created.
+ *
+ * Example Usage:
+ * @code
+ *    CFTPClient::WildcardFilter oFilter;
+ *    oFilter.vecIncludeGlobs.push_back("*.jpg");
+ *    oFilter.llMaxSize = 10 * 1024 * 1024;
+ *    m_pFTPClient->DownloadWildcard("C:\\pictures", "/pictures/" "*", oFilter);
+ * @endcode
+ */
+bool CFTPClient::DownloadWildcard(const std::string &strLocalDir, const std::string &strRemoteWildcard,
+                                  const WildcardFilter &oFilter) const {
+   return DownloadWildcard(strLocalDir, strRemoteWildcard, &oFilter, std::string());
+}
+
+bool CFTPClient::DownloadWildcard(const std::string &strLocalDir, const std::string &strRemoteWildcard, const WildcardFilter *pFilter,
+                                  const std::string &strRelativeDir) const {
    if (strLocalDir.empty() || strRemoteWildcard.empty()) return false;
 
    if (!m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_NOT_INIT_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
 
       return false;
    }
@@ -717,13 +1787,15 @@ bool CFTPClient::DownloadWildcard(const std::string &strLocalDir, const std::str
    bool bRet = false;
 
    WildcardTransfersCallbackData data;
+   data.pFilter        = pFilter;
+   data.strRelativeDir = strRelativeDir;
 #ifdef LINUX
    data.strOutputPath = strLocalDir + ((strLocalDir.back() != '/') ? "/" : "");
 #else
    data.strOutputPath = strLocalDir + ((strLocalDir.back() != '\\') ? "\\" : "");
 #endif
 
-   std::string strPattern = ParseURL(strRemoteWildcard);
+   std::string strPattern = ParseURL(strRemoteWildcard, true);
 
    struct stat info;
    if (stat(data.strOutputPath.c_str(), &info) == 0 && (info.st_mode & S_IFDIR))  // S_ISDIR() doesn't exist on windows
@@ -745,17 +1817,14 @@ bool CFTPClient::DownloadWildcard(const std::string &strLocalDir, const std::str
       curl_easy_setopt(m_pCurlSession, CURLOPT_WRITEDATA, &data);
       /* curl_easy_setopt(m_pCurlSession, CURLOPT_VERBOSE, 1L); */
 
-      /* set an URL containing wildcard pattern (only in the last part) */
-      curl_easy_setopt(m_pCurlSession, CURLOPT_URL, strPattern.c_str());
 
       /* and start transfer! */
-      CURLcode res = Perform();
+      CURLcode res = Perform(CFTPMetrics::Operation::DOWNLOAD, strPattern);
 
       /* in case we have an empty FTP folder, error 78 will be returned */
       if (res != CURLE_OK && res != CURLE_REMOTE_FILE_NOT_FOUND) {
          if (m_eSettingsFlags & ENABLE_LOG)
-            m_oLog(
-                StringFormat(LOG_ERROR_CURL_GETWILD_FORMAT, m_strServer.c_str(), strRemoteWildcard.c_str(), res, curl_easy_strerror(res)));
+            Log(LogLevel::ERR, LOG_ERROR_CURL_GETWILD_FORMAT, m_strServer.c_str(), strRemoteWildcard.c_str(), res, curl_easy_strerror(res));
       }
       /* folders need to be copied integrally */
       else if (!data.vecDirList.empty() && strRemoteWildcard.back() == '*') {
@@ -767,16 +1836,15 @@ bool CFTPClient::DownloadWildcard(const std::string &strLocalDir, const std::str
          bRet = true;
          for (const auto &Dir : data.vecDirList) {
             if ((Dir == ".") || (Dir == "..")) continue;
-            if (!DownloadWildcard(data.strOutputPath + Dir, strBaseUrl + Dir + "/*")) {
-               m_oLog(
-                   StringFormat(LOG_ERROR_CURL_GETWILD_REC_FORMAT, (strBaseUrl + Dir + "/*").c_str(), (data.strOutputPath + Dir).c_str()));
+            if (!DownloadWildcard(data.strOutputPath + Dir, strBaseUrl + Dir + "/*", pFilter, strRelativeDir + Dir + "/")) {
+               Log(LogLevel::ERR, LOG_ERROR_CURL_GETWILD_REC_FORMAT, (strBaseUrl + Dir + "/*").c_str(), (data.strOutputPath + Dir).c_str());
                bRet = false;
             }
          }
       } else
          bRet = true;
    } else if (m_eSettingsFlags & ENABLE_LOG)
-      m_oLog(StringFormat(LOG_ERROR_DIR_GETWILD_FORMAT, data.strOutputPath.c_str()));
+      Log(LogLevel::ERR, LOG_ERROR_DIR_GETWILD_FORMAT, data.strOutputPath.c_str());
 
    return bRet;
 }
@@ -797,14 +1865,28 @@ bool CFTPClient::DownloadWildcard(const std::string &strLocalDir, const std::str
  */
 bool CFTPClient::UploadFile(CFTPClient::CurlReadFn readFn, void *userData, const std::string &strRemoteFile,
                             const bool &bCreateDir, curl_off_t fileSize) const {
+   return UploadData(readFn, userData, strRemoteFile, bCreateDir, fileSize, false);
+}
+
+/**
+ * @brief common part of the uploads (STOR or APPE)
+ *
+ * @param [in] bAppend the data is appended to the remote file (APPE)
+ * @param [in] strRenameTo if not empty, strRemoteFile is renamed to it once the data is sent
+ */
+bool CFTPClient::UploadData(CurlReadFn readFn, void *userData, const std::string &strRemoteFile, const bool &bCreateDir,
+                            curl_off_t fileSize, bool bAppend, const std::string &strRenameTo /* = std::string() */) const {
    if (readFn == nullptr || strRemoteFile.empty())
       return false;
 
    if (!m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_NOT_INIT_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
 
       return false;
    }
+
+   const bool bModeZ = UseModeZ();
+
    // Reset is mandatory to avoid bad surprises
    curl_easy_reset(m_pCurlSession);
 
@@ -812,8 +1894,23 @@ bool CFTPClient::UploadFile(CFTPClient::CurlReadFn readFn, void *userData, const
 
    bool bRes = false;
 
-   /* specify target */
-   curl_easy_setopt(m_pCurlSession, CURLOPT_URL, strLocalRemoteFile.c_str());
+
+   /* MODE Z : the data read by readFn is compressed before being sent, its size is unknown */
+   CFTPZStream oZStream(CFTPZStream::Mode::DEFLATE, m_iCompressionLevel);
+   ZStreamData oZData = {&oZStream, readFn, userData, std::string()};
+   struct curl_slist *pQuote = nullptr, *pPostQuote = nullptr;
+   if (bModeZ) {
+      SetModeZCommands(pQuote, pPostQuote);
+      readFn   = ReadDeflatingCallback;
+      userData = &oZData;
+      fileSize = -1;
+   }
+
+   /* the post-quote commands are only sent after a successful transfer */
+   if (!strRenameTo.empty()) {
+      AppendRenameCommands(pPostQuote, strRemoteFile, strRenameTo);
+      curl_easy_setopt(m_pCurlSession, CURLOPT_POSTQUOTE, pPostQuote);
+   }
 
    /* we want to use our own read function */
    curl_easy_setopt(m_pCurlSession, CURLOPT_READFUNCTION, readFn);
@@ -829,14 +1926,19 @@ bool CFTPClient::UploadFile(CFTPClient::CurlReadFn readFn, void *userData, const
 
    /* enable uploading */
    curl_easy_setopt(m_pCurlSession, CURLOPT_UPLOAD, 1L);
+   if (bAppend) curl_easy_setopt(m_pCurlSession, CURLOPT_APPEND, 1L);
 
    if (bCreateDir) curl_easy_setopt(m_pCurlSession, CURLOPT_FTP_CREATE_MISSING_DIRS, CURLFTP_CREATE_DIR);
 
-   CURLcode res = Perform();
+   CURLcode res = Perform(CFTPMetrics::Operation::UPLOAD, strLocalRemoteFile);
+
+   curl_slist_free_all(pQuote);
+   curl_slist_free_all(pPostQuote);
+   if (bModeZ) res = EndModeZTransfer(res, oZStream, strRemoteFile);
 
    if (res != CURLE_OK) {
       if (m_eSettingsFlags & ENABLE_LOG)
-         m_oLog(StringFormat(LOG_ERROR_CURL_UPLOAD_FORMAT, strRemoteFile.c_str(), res, curl_easy_strerror(res)));
+         Log(LogLevel::ERR, LOG_ERROR_CURL_UPLOAD_FORMAT, strRemoteFile.c_str(), res, curl_easy_strerror(res));
    } else
       bRes = true;
 
@@ -889,8 +1991,38 @@ bool CFTPClient::UploadFile(std::istream &inputStream, const std::string &strRem
  * @endcode
  */
 bool CFTPClient::UploadFile(const std::string &strLocalFile, const std::string &strRemoteFile, const bool &bCreateDir) const {
+   TransferOptions oOptions;
+   return UploadFile(strLocalFile, strRemoteFile, bCreateDir, oOptions);
+}
+
+/**
+ * @brief uploads a local file to a remote folder with extra options
+ *
+ * @param [in] strLocalFile Complete path of the file to upload encoded in UTF-8 format.
+ * @param [in] strRemoteFile Complete URN of the remote location (with the file
+ * name) encoded in UTF-8 format.
+ * @param [in] bCreateDir Enable or disable creation of remote missing
+ * directories contained in the URN.
+ * @param [in, out] oOptions if a hash algorithm is set, oOptions.strHash receives the
+ * digest of the uploaded content (the whole file, even if the upload was resumed).
+ * With oOptions.eResume, a remote file smaller than the local one is considered as an
+ * interrupted upload : only the rest of the local file is sent (APPE), after having
+ * compared the checksums of the remote file and the local prefix with AUTO_HASH.
+ * Otherwise, the file is uploaded again. With oOptions.bAtomic, the data is uploaded
+ * under a temporary name (strRemoteFile + ".part", the one that is resumed), renamed
+ * to strRemoteFile by the same request.
+ *
+ * @retval true   Successfully uploaded the file.
+ * @retval false  The file couldn't be uploaded. Check the log messages for more
+ * information.
+ */
+bool CFTPClient::UploadFile(const std::string &strLocalFile, const std::string &strRemoteFile, const bool &bCreateDir,
+                            TransferOptions &oOptions) const {
+   oOptions.strHash.clear();
    if (strLocalFile.empty() || strRemoteFile.empty()) return false;
 
+   if (m_pCurlSession && !SelectVerifyHashAlgorithm(oOptions)) return false;
+
    std::ifstream InputFile;
 
    struct stat file_info;
@@ -907,16 +2039,108 @@ bool CFTPClient::UploadFile(const std::string &strLocalFile, const std::string &
       InputFile.open(wstrLocalFile, std::ifstream::in | std::ifstream::binary);
    #endif
       if (!InputFile) {
-         if (m_eSettingsFlags & ENABLE_LOG) m_oLog(StringFormat(LOG_ERROR_FILE_UPLOAD_FORMAT, strLocalFile.c_str()));
+         if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_FILE_UPLOAD_FORMAT, strLocalFile.c_str());
 
          return false;
       }
 
-      bRes = UploadFile(InputFile, strRemoteFile, bCreateDir, file_info.st_size);
+      CFTPHash oHash(oOptions.eHashAlgorithm);
+      const std::string strTargetFile = oOptions.bAtomic ? strRemoteFile + ".part" : strRemoteFile;
+      const std::string strRenameTo   = oOptions.bAtomic ? strRemoteFile : std::string();
+
+      oOptions.llResumedFrom = 0;
+      if (oOptions.eResume != ResumeMode::NONE && m_pCurlSession)
+         oOptions.llResumedFrom = GetUploadResumeOffset(InputFile, file_info.st_size, strTargetFile, oOptions, oHash);
+      const curl_off_t llToSend = static_cast<curl_off_t>(file_info.st_size) - oOptions.llResumedFrom;
+      const bool bAppend        = (oOptions.llResumedFrom > 0);
+
+      if (oOptions.eHashAlgorithm != CFTPHash::Algorithm::NONE) {
+         HashingStreamData oHashingData = {&InputFile, &oHash};
+
+         bRes = UploadData(ReadFromStreamHashingCallback, &oHashingData, strTargetFile, bCreateDir, llToSend, bAppend, strRenameTo);
+         if (bRes) oOptions.strHash = oHash.Final();
+         if (bRes && oOptions.bVerifyRemoteHash) bRes = VerifyRemoteHash(strRemoteFile, oOptions);
+      } else
+         bRes = UploadData(ReadFromStreamCallback, &InputFile, strTargetFile, bCreateDir, llToSend, bAppend, strRenameTo);
+   }
+   InputFile.close();
+
+   return bRes;
+}
+
+/**
+ * @brief appends the commands renaming a remote file to a quote list, like
+ * RemoveFile, SFTP needs full paths whereas the FTP commands are sent from the
+ * folder of the transferred file.
+ *
+ * @param [in, out] pCommands list of commands (CURLOPT_QUOTE or CURLOPT_POSTQUOTE)
+ * @param [in] strFrom current URN of the file
+ * @param [in] strTo new URN of the file, in the same folder
+ */
+void CFTPClient::AppendRenameCommands(struct curl_slist *&pCommands, const std::string &strFrom, const std::string &strTo) const {
+   if (m_eFtpProtocol == FTP_PROTOCOL::SFTP) {
+      pCommands = curl_slist_append(pCommands, ("rename \"" + strFrom + "\" \"" + strTo + "\"").c_str());
+   } else {
+      pCommands = curl_slist_append(pCommands, ("RNFR " + strFrom.substr(strFrom.find_last_of('/') + 1)).c_str());
+      pCommands = curl_slist_append(pCommands, ("RNTO " + strTo.substr(strTo.find_last_of('/') + 1)).c_str());
+   }
+}
+
+/**
+ * @brief finds where an interrupted upload of a local file stopped
+ *
+ * @param [in, out] inputFile local file, positioned at the returned offset.
+ * @param [in] llLocalSize size of the local file.
+ * @param [in] strRemoteFile URL of the remote file.
+ * @param [in] oOptions options of the transfer (resume mode and hash algorithm).
+ * @param [in, out] oHash updated with the local bytes preceding the returned offset.
+ *
+ * @return the size of the remote file if it is a prefix of the local one, 0 to upload
+ * the whole file.
+ */
+curl_off_t CFTPClient::GetUploadResumeOffset(std::istream &inputFile, curl_off_t llLocalSize, const std::string &strRemoteFile,
+                                             const TransferOptions &oOptions, CFTPHash &oHash) const {
+   FileInfo oRemoteInfo = {0, 0.0};
+   if (!Info(strRemoteFile, oRemoteInfo)) return 0;
+
+   const curl_off_t llRemoteSize = static_cast<curl_off_t>(oRemoteInfo.dFileSize);
+   if (llRemoteSize <= 0 || llRemoteSize >= llLocalSize) return 0;
+
+   /* the streaming digest continues from the prefix's one, which is also compared with the
+    * remote checksum when the algorithms are the same (the prefix is read only once) */
+   const bool bHashing = (oHash.GetAlgorithm() != CFTPHash::Algorithm::NONE);
+   if (oOptions.eResume == ResumeMode::AUTO_HASH) {
+      const CFTPHash::Algorithm eAlgorithm = bHashing ? oHash.GetAlgorithm() : GetRemoteHashAlgorithm();
+
+      std::string strRemoteHash;
+      if (eAlgorithm == CFTPHash::Algorithm::NONE || !RemoteHash(strRemoteFile, eAlgorithm, strRemoteHash)) return 0;
+
+      CFTPHash oPrefixHash(eAlgorithm);
+      if (!HashStreamPrefix(inputFile, llRemoteSize, oPrefixHash)) {
+         inputFile.clear();
+         inputFile.seekg(0);
+         return 0;
+      }
+      if (bHashing) oHash = oPrefixHash;
+
+      if (oPrefixHash.Final() != strRemoteHash) {
+         if (m_eSettingsFlags & ENABLE_LOG)
+            Log(LogLevel::WARN, LOG_WARNING_RESUME_PREFIX_FORMAT, CFTPHash::GetName(eAlgorithm), strRemoteFile.c_str());
+
+         oHash.Reset();
+         inputFile.seekg(0);
+         return 0;
+      }
+   } else if (bHashing && !HashStreamPrefix(inputFile, llRemoteSize, oHash)) {
+      oHash.Reset();
+      inputFile.clear();
+      inputFile.seekg(0);
+      return 0;
    }
-   InputFile.close();
 
-   return bRes;
+   inputFile.seekg(static_cast<std::streamoff>(llRemoteSize));
+   Log(LogLevel::INFO, LOG_INFO_RESUME_FORMAT, strRemoteFile.c_str(), static_cast<long long>(llRemoteSize));
+   return llRemoteSize;
 }
 
 bool CFTPClient::AppendFile(const std::string &strLocalFile, const size_t fileOffset, const std::string &strRemoteFile,
@@ -924,7 +2148,7 @@ bool CFTPClient::AppendFile(const std::string &strLocalFile, const size_t fileOf
    if (strLocalFile.empty() || strRemoteFile.empty()) return false;
 
    if (!m_pCurlSession) {
-      if (m_eSettingsFlags & ENABLE_LOG) m_oLog(LOG_ERROR_CURL_NOT_INIT_MSG);
+      if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
 
       return false;
    }
@@ -948,7 +2172,7 @@ bool CFTPClient::AppendFile(const std::string &strLocalFile, const size_t fileOf
       InputFile.open(wstrLocalFile, std::ifstream::in | std::ifstream::binary);
 #endif
       if (!InputFile) {
-         if (m_eSettingsFlags & ENABLE_LOG) m_oLog(StringFormat(LOG_ERROR_FILE_UPLOAD_FORMAT, strLocalFile.c_str()));
+         if (m_eSettingsFlags & ENABLE_LOG) Log(LogLevel::ERR, LOG_ERROR_FILE_UPLOAD_FORMAT, strLocalFile.c_str());
 
          return false;
       }
@@ -956,14 +2180,12 @@ bool CFTPClient::AppendFile(const std::string &strLocalFile, const size_t fileOf
       // check of the offset is less than the file size
       if (fileOffset >= file_info.st_size) {
          if (m_eSettingsFlags & ENABLE_LOG)
-            m_oLog("ERROR Incorrect offset !");  // if this code is OK use existing coding style for log msgs
+            Log(LogLevel::ERR, "ERROR Incorrect offset !");  // if this code is OK use existing coding style for log msgs
          return false;
       }
 
       InputFile.seekg(fileOffset, InputFile.beg);  // Sets the position of the next character to be extracted from the input stream.
 
-      /* specify target */
-      curl_easy_setopt(m_pCurlSession, CURLOPT_URL, strLocalRemoteFile.c_str());
 
       /* we want to use our own read function */
       curl_easy_setopt(m_pCurlSession, CURLOPT_READFUNCTION, ReadFromStreamCallback);
@@ -983,13 +2205,11 @@ bool CFTPClient::AppendFile(const std::string &strLocalFile, const size_t fileOf
 
       if (bCreateDir) curl_easy_setopt(m_pCurlSession, CURLOPT_FTP_CREATE_MISSING_DIRS, CURLFTP_CREATE_DIR);
 
-      // TODO add the possibility to rename the file upon upload finish....
-
-      CURLcode res = Perform();
+      CURLcode res = Perform(CFTPMetrics::Operation::UPLOAD, strLocalRemoteFile);
 
       if (res != CURLE_OK) {
          if (m_eSettingsFlags & ENABLE_LOG)
-            m_oLog(StringFormat(LOG_ERROR_CURL_UPLOAD_FORMAT, strLocalFile.c_str(), res, curl_easy_strerror(res)));
+            Log(LogLevel::ERR, LOG_ERROR_CURL_UPLOAD_FORMAT, strLocalFile.c_str(), res, curl_easy_strerror(res));
       } else
          bRes = true;
    }
@@ -998,6 +2218,209 @@ bool CFTPClient::AppendFile(const std::string &strLocalFile, const size_t fileOf
    return bRes;
 }
 
+/**
+ * @brief copies a remote file to another server
+ *
+ * With FXP, the destination server listens (PASV) and the source one connects to it (PORT),
+ * the data doesn't go through this host. It is usually refused by the servers (e.g. vsftpd's
+ * pasv_promiscuous/port_promiscuous options) as it allows "FTP bounce" attacks. Otherwise,
+ * the file is downloaded and uploaded at the same time through a memory buffer (the progress
+ * callback of oSource is then called by another thread).
+ *
+ * @param [in] oSource client connected to the server having the file
+ * @param [in] strSourceFile URN of the file to copy encoded in UTF-8 format.
+ * @param [in] oDestination client connected to the destination server
+ * @param [in] strDestinationFile URN of the copy encoded in UTF-8 format.
+ * @param [in] eMode with CopyMode::AUTO, the file is relayed by this host if FXP fails
+ *
+ * @retval true   The file was copied.
+ * @retval false  The copy failed. Check the log messages for more information.
+ *
+ * Example Usage:
+ * @code
+ *    CFTPClient::CopyBetweenServers(oParisClient, "/backup/db.tar", oLyonClient, "/backup/db.tar");
+ * @endcode
+ */
+bool CFTPClient::CopyBetweenServers(const CFTPClient &oSource, const std::string &strSourceFile, const CFTPClient &oDestination,
+                                    const std::string &strDestinationFile, CopyMode eMode /* = CopyMode::AUTO */) {
+   if (strSourceFile.empty() || strDestinationFile.empty()) return false;
+
+   if (!oSource.m_pCurlSession || !oDestination.m_pCurlSession) {
+      if (oDestination.m_eSettingsFlags & ENABLE_LOG) oDestination.Log(LogLevel::ERR, LOG_ERROR_CURL_NOT_INIT_MSG);
+
+      return false;
+   }
+
+   if (eMode != CopyMode::RELAY) {
+      std::string strError;
+      if (CopyFXP(oSource, strSourceFile, oDestination, strDestinationFile, strError)) return true;
+
+      if (eMode == CopyMode::FXP) {
+         if (oDestination.m_eSettingsFlags & ENABLE_LOG)
+            oDestination.Log(LogLevel::ERR, LOG_ERROR_FXP_FORMAT, strSourceFile.c_str(), strDestinationFile.c_str(), strError.c_str());
+         return false;
+      }
+      // recovered by the relay
+      if (oDestination.m_eSettingsFlags & ENABLE_LOG)
+         oDestination.Log(LogLevel::WARN, LOG_WARNING_FXP_FALLBACK_FORMAT, strSourceFile.c_str(), strDestinationFile.c_str(),
+                          strError.c_str());
+   }
+
+   return CopyRelay(oSource, strSourceFile, oDestination, strDestinationFile);
+}
+
+/**
+ * @brief logs in and keeps the control connection for raw commands (see CFTPControlConnection),
+ * the session can't be used for other requests afterwards.
+ */
+bool CFTPClient::ConnectControl() const {
+   curl_easy_reset(m_pCurlSession);
+
+   const std::string &strRoot = m_strURLPrefix;
+   curl_easy_setopt(m_pCurlSession, CURLOPT_CONNECT_ONLY, 1L);
+
+   return Perform(CFTPMetrics::Operation::COMMAND, strRoot) == CURLE_OK;
+}
+
+/**
+ * @brief FXP part of CopyBetweenServers, on dedicated sessions since their control
+ * connections are driven directly (the STOR and RETR replies are interleaved).
+ *
+ * @param [out] strError reason of the failure
+ */
+bool CFTPClient::CopyFXP(const CFTPClient &oSource, const std::string &strSourceFile, const CFTPClient &oDestination,
+                         const std::string &strDestinationFile, std::string &strError) {
+   // the paths are sent as is on the control connections : a CR or LF would inject other commands
+   if (strSourceFile.find_first_of("\r\n") != std::string::npos || strDestinationFile.find_first_of("\r\n") != std::string::npos) {
+      strError = "invalid file name";
+      return false;
+   }
+
+   // a TLS data connection between the servers would need SSCN or CPSV
+   if (oSource.m_eFtpProtocol != FTP_PROTOCOL::FTP || oDestination.m_eFtpProtocol != FTP_PROTOCOL::FTP) {
+      strError = "only plain FTP is supported";
+      return false;
+   }
+
+   std::unique_ptr<CFTPClient> pSource      = oSource.CloneSession();
+   std::unique_ptr<CFTPClient> pDestination = oDestination.CloneSession();
+   if (!pSource || !pDestination) {
+      strError = "unable to create the sessions";
+      return false;
+   }
+
+   bool bRet = false;
+   if (pSource->ConnectControl() && pDestination->ConnectControl()) {
+      CFTPControlConnection oSourceControl(pSource->m_pCurlSession, pSource->m_iCurlTimeout * 1000L);
+      CFTPControlConnection oDestinationControl(pDestination->m_pCurlSession, pDestination->m_iCurlTimeout * 1000L);
+
+      bRet = ExchangeFXP(oSourceControl, strSourceFile, oDestinationControl, strDestinationFile, strError);
+   } else
+      strError = "unable to log in";
+
+   pSource->CleanupSession();
+   pDestination->CleanupSession();
+
+   return bRet;
+}
+
+/**
+ * @brief sends the FXP commands on the control connections of the source and
+ * destination servers.
+ *
+ * @param [out] strError reason of the failure
+ */
+bool CFTPClient::ExchangeFXP(CFTPControlConnection &oSourceControl, const std::string &strSourceFile,
+                             CFTPControlConnection &oDestinationControl, const std::string &strDestinationFile,
+                             std::string &strError) {
+   int iCode = 0;
+   std::string strReply;
+   if (!oSourceControl.Command("TYPE I", iCode, strReply) || iCode / 100 != 2 ||
+       !oDestinationControl.Command("TYPE I", iCode, strReply) || iCode / 100 != 2) {
+      strError = strReply.empty() ? "TYPE I failed" : strReply;
+      return false;
+   }
+
+   /* "227 Entering Passive Mode (h1,h2,h3,h4,p1,p2)", the parenthesis are optional */
+   unsigned arrAddress[6];
+   if (!oDestinationControl.Command("PASV", iCode, strReply) || iCode != 227) {
+      strError = strReply.empty() ? "PASV failed" : strReply;
+      return false;
+   }
+   const size_t uStart = strReply.find_first_of("0123456789", 4);
+   if (uStart == std::string::npos || sscanf(strReply.c_str() + uStart, "%u,%u,%u,%u,%u,%u", &arrAddress[0], &arrAddress[1],
+                                             &arrAddress[2], &arrAddress[3], &arrAddress[4], &arrAddress[5]) != 6) {
+      strError = strReply;
+      return false;
+   }
+
+   if (!oSourceControl.Command(StringFormat("PORT %u,%u,%u,%u,%u,%u", arrAddress[0], arrAddress[1], arrAddress[2], arrAddress[3],
+                                            arrAddress[4], arrAddress[5]),
+                               iCode, strReply) ||
+       iCode / 100 != 2) {
+      strError = strReply.empty() ? "PORT failed" : strReply;
+      return false;
+   }
+
+   /* the destination may only reply once the source connected to it : both commands are sent
+    * before reading the preliminary (1xx) then the completion (2xx) replies */
+   if (!oDestinationControl.Send("STOR " + strDestinationFile) || !oSourceControl.Send("RETR " + strSourceFile)) {
+      strError = "unable to send the transfer commands";
+      return false;
+   }
+
+   strReply.clear();
+   bool bRet = oSourceControl.ReadReply(iCode, strReply) && iCode / 100 == 1;
+   bRet      = bRet && oDestinationControl.ReadReply(iCode, strReply) && iCode / 100 == 1;
+   bRet      = bRet && oSourceControl.ReadReply(iCode, strReply) && iCode / 100 == 2;
+   bRet      = bRet && oDestinationControl.ReadReply(iCode, strReply) && iCode / 100 == 2;
+   if (!bRet) strError = strReply.empty() ? "the transfer failed" : strReply;
+
+   return bRet;
+}
+
+/**
+ * @brief copy through this host : the file is downloaded by a thread into a ring buffer
+ * while the calling thread uploads its content, nothing is written on the local disk.
+ * The upload is paced by the download (and vice versa when the buffer is full).
+ */
+bool CFTPClient::CopyRelay(const CFTPClient &oSource, const std::string &strSourceFile, const CFTPClient &oDestination,
+                           const std::string &strDestinationFile) {
+   // a session can't perform two requests at the same time
+   std::unique_ptr<CFTPClient> pClone;
+   const CFTPClient *pSource = &oSource;
+   if (pSource == &oDestination) {
+      pClone = oSource.CloneSession();
+      if (!pClone) return false;
+      pSource = pClone.get();
+   }
+
+   CFTPRingBuffer oBuffer(RELAY_BUFFER_SIZE);
+   bool bDownloaded = false;
+
+   std::thread oDownloader([&]() {
+      bDownloaded = pSource->DownloadFile(strSourceFile, oBuffer);
+      if (bDownloaded)
+         oBuffer.Finish();
+      else
+         oBuffer.Abort();
+   });
+
+   bool bRet = oDestination.UploadFile(CFTPRingBuffer::ReadCallback, &oBuffer, strDestinationFile);
+   // unblocks the download
+   if (!bRet) oBuffer.Cancel();
+
+   oDownloader.join();
+   if (pClone) pClone->CleanupSession();
+
+   bRet = bRet && bDownloaded;
+
+   if (!bRet && (oDestination.m_eSettingsFlags & ENABLE_LOG))
+      oDestination.Log(LogLevel::ERR, LOG_ERROR_RELAY_FORMAT, strSourceFile.c_str(), strDestinationFile.c_str());
+
+   return bRet;
+}
+
 /**
  * @brief performs the chosen FTP request
  * sets up the common settings (Timeout, proxy,...)
@@ -1007,9 +2430,11 @@ bool CFTPClient::AppendFile(const std::string &strLocalFile, const size_t fileOf
  * @retval false  The request couldn't be performed.
  *
  */
- CURLcode CFTPClient::Perform() const {
+ CURLcode CFTPClient::Perform(CFTPMetrics::Operation eOperation, const std::string &strURL) const {
    CURLcode res = CURLE_OK;
 
+   curl_easy_setopt(m_pCurlSession, CURLOPT_URL, strURL.c_str());
+
    curl_easy_setopt(m_pCurlSession, CURLOPT_PORT, m_uPort);
    curl_easy_setopt(m_pCurlSession, CURLOPT_USERPWD, (m_strUserName + ":" + m_strPassword).c_str());
 
@@ -1036,9 +2461,24 @@ bool CFTPClient::AppendFile(const std::string &strLocalFile, const size_t fileOf
       }
    }
 
-   if (m_bProgressCallbackSet) {
-      curl_easy_setopt(m_pCurlSession, CURLOPT_PROGRESSFUNCTION, *GetProgressFnCallback());
-      curl_easy_setopt(m_pCurlSession, CURLOPT_PROGRESSDATA, &m_ProgressStruct);
+   RequestCallbackData oCallbackData(this, eOperation, &strURL);
+   if (m_pObserver != nullptr) {
+      m_pObserver->OnRequestStart(eOperation, strURL);
+
+#if LIBCURL_VERSION_NUM >= 0x075000
+      curl_easy_setopt(m_pCurlSession, CURLOPT_PREREQFUNCTION, ObserverPrereqCallback);
+      curl_easy_setopt(m_pCurlSession, CURLOPT_PREREQDATA, &oCallbackData);
+#endif
+   }
+
+   const bool bPublish = (m_bProgressSnapshot || m_pJobProgress != nullptr);
+   if (bPublish) PublishProgress(oCallbackData, CFTPProgressSnapshot::State::CONNECTING);
+
+   // the observer's first byte event, the progress functions and the published progress
+   const bool bXferInfo = (m_pObserver != nullptr || m_bProgressCallbackSet || m_fnXferInfoCallback || bPublish);
+   if (bXferInfo) {
+      curl_easy_setopt(m_pCurlSession, CURLOPT_XFERINFOFUNCTION, XferInfoCallback);
+      curl_easy_setopt(m_pCurlSession, CURLOPT_XFERINFODATA, &oCallbackData);
       curl_easy_setopt(m_pCurlSession, CURLOPT_NOPROGRESS, 0L);
    }
 
@@ -1066,6 +2506,12 @@ bool CFTPClient::AppendFile(const std::string &strLocalFile, const size_t fileOf
    StartCurlDebug();
 #endif
 
+   if (m_pTrace) {
+      curl_easy_setopt(m_pCurlSession, CURLOPT_VERBOSE, 1L);
+      curl_easy_setopt(m_pCurlSession, CURLOPT_DEBUGFUNCTION, CFTPTrace::DebugCallback);
+      curl_easy_setopt(m_pCurlSession, CURLOPT_DEBUGDATA, m_pTrace.get());
+   }
+
    // Perform the requested operation
    res = curl_easy_perform(m_pCurlSession);
 
@@ -1073,9 +2519,200 @@ bool CFTPClient::AppendFile(const std::string &strLocalFile, const size_t fileOf
    EndCurlDebug();
 #endif
 
+   CollectStats(res, eOperation);
+
+   if (res != CURLE_OK && m_pTrace && m_bDumpTraceOnError)
+      WriteLog(LOG_ERROR_TRACE_FORMAT "%s", strURL.c_str(), res, curl_easy_strerror(res), m_pTrace->Dump().c_str());
+
+   // oCallbackData goes out of scope
+   if (bXferInfo) {
+      curl_easy_setopt(m_pCurlSession, CURLOPT_XFERINFOFUNCTION, nullptr);
+
+      // the last progress of a completed transfer may have been throttled
+      if (res == CURLE_OK && m_fnXferInfoCallback && !oCallbackData.bReported) m_fnXferInfoCallback(oCallbackData.oProgress);
+   }
+
+   if (bPublish) {
+      TransferProgress &oProgress = oCallbackData.oProgress;
+      oProgress.llDownloaded      = std::max(oProgress.llDownloaded, m_oLastStats.llBytesDownloaded);
+      oProgress.llUploaded        = std::max(oProgress.llUploaded, m_oLastStats.llBytesUploaded);
+      if (res == CURLE_OK) oProgress.dEta = 0;
+      PublishProgress(oCallbackData, (res == CURLE_OK) ? CFTPProgressSnapshot::State::COMPLETED : CFTPProgressSnapshot::State::FAILED);
+      m_ullSessionBytes += static_cast<uint64_t>(oProgress.llDownloaded + oProgress.llUploaded);
+   }
+
+   if (m_pObserver != nullptr) {
+#if LIBCURL_VERSION_NUM >= 0x075000
+      curl_easy_setopt(m_pCurlSession, CURLOPT_PREREQFUNCTION, nullptr);
+#endif
+      m_pObserver->OnRequestEnd(eOperation, strURL, m_oLastStats);
+   }
+
    return res;
 }
 
+/**
+ * @brief keeps the measures of the request performed by libcurl (see GetLastStats)
+ * and adds them to the process-wide metrics (see CFTPMetrics)
+ *
+ * @param [in] eResult result of the request
+ * @param [in] eOperation kind of request
+ */
+void CFTPClient::CollectStats(CURLcode eResult, CFTPMetrics::Operation eOperation) const {
+   m_oLastStats         = TransferStats();
+   m_oLastStats.eResult = eResult;
+
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_RESPONSE_CODE, &m_oLastStats.lResponseCode);
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_NAMELOOKUP_TIME_T, &m_oLastStats.llNameLookupUs);
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_CONNECT_TIME_T, &m_oLastStats.llConnectUs);
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_APPCONNECT_TIME_T, &m_oLastStats.llAppConnectUs);
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_PRETRANSFER_TIME_T, &m_oLastStats.llPreTransferUs);
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_STARTTRANSFER_TIME_T, &m_oLastStats.llStartTransferUs);
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_TOTAL_TIME_T, &m_oLastStats.llTotalUs);
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_SIZE_UPLOAD_T, &m_oLastStats.llBytesUploaded);
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_SIZE_DOWNLOAD_T, &m_oLastStats.llBytesDownloaded);
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_SPEED_UPLOAD_T, &m_oLastStats.llSpeedUpload);
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_SPEED_DOWNLOAD_T, &m_oLastStats.llSpeedDownload);
+   curl_easy_getinfo(m_pCurlSession, CURLINFO_NUM_CONNECTS, &m_oLastStats.lNewConnections);
+
+   char *pszURL = nullptr;
+   if (curl_easy_getinfo(m_pCurlSession, CURLINFO_EFFECTIVE_URL, &pszURL) == CURLE_OK && pszURL != nullptr) m_oLastStats.strURL = pszURL;
+
+   CFTPMetrics::Sample oSample;
+   oSample.bSucceeded         = (eResult == CURLE_OK);
+   oSample.ullDurationUs      = static_cast<uint64_t>(std::max<curl_off_t>(m_oLastStats.llTotalUs, 0));
+   oSample.ullConnectUs       = static_cast<uint64_t>(std::max<curl_off_t>(m_oLastStats.llConnectUs, 0));
+   oSample.ullBytesUploaded   = static_cast<uint64_t>(std::max<curl_off_t>(m_oLastStats.llBytesUploaded, 0));
+   oSample.ullBytesDownloaded = static_cast<uint64_t>(std::max<curl_off_t>(m_oLastStats.llBytesDownloaded, 0));
+   oSample.uNewConnections    = static_cast<unsigned>(std::max<long>(m_oLastStats.lNewConnections, 0));
+   CFTPMetrics::GetInstance().Record(eOperation, m_uMetricsHost, oSample);
+}
+
+/**
+ * @brief notifies the request observer that the connection is ready (CURLOPT_PREREQFUNCTION)
+ *
+ * @param clientp pointer to a RequestCallbackData
+ *
+ * @return CURL_PREREQFUNC_OK
+ */
+int CFTPClient::ObserverPrereqCallback(void *clientp, char *conn_primary_ip, char * /*conn_local_ip*/, int conn_primary_port,
+                                       int /*conn_local_port*/) {
+   auto *pData = reinterpret_cast<RequestCallbackData *>(clientp);
+   pData->pClient->m_pObserver->OnConnected(pData->eOperation, *pData->pURL, (conn_primary_ip != nullptr) ? conn_primary_ip : "",
+                                            conn_primary_port);
+#if LIBCURL_VERSION_NUM >= 0x075000
+   return CURL_PREREQFUNC_OK;
+#else
+   return 0;
+#endif
+}
+
+/**
+ * @brief progress of the request (CURLOPT_XFERINFOFUNCTION) : notifies the request observer of
+ * the first byte of data, calls the progress function and the throttled xferinfo callback
+ *
+ * @param clientp pointer to a RequestCallbackData
+ *
+ * @return the callbacks' result, 0 to continue the transfer
+ */
+int CFTPClient::XferInfoCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
+   auto *pData               = reinterpret_cast<RequestCallbackData *>(clientp);
+   const CFTPClient *pClient = pData->pClient;
+
+   if (pClient->m_pObserver != nullptr && !pData->bFirstByte && (dlnow > 0 || ulnow > 0)) {
+      pData->bFirstByte = true;
+      pClient->m_pObserver->OnFirstByte(pData->eOperation, *pData->pURL);
+   }
+
+   if (pClient->m_bProgressCallbackSet) {
+      const int iRet =
+          pClient->m_fnProgressCallback(const_cast<ProgressFnStruct *>(&pClient->m_ProgressStruct), static_cast<double>(dltotal),
+                                        static_cast<double>(dlnow), static_cast<double>(ultotal), static_cast<double>(ulnow));
+      if (iRet != 0) return iRet;
+   }
+
+   const bool bPublish = (pClient->m_bProgressSnapshot || pClient->m_pJobProgress != nullptr);
+   if (!pClient->m_fnXferInfoCallback && !bPublish) return 0;
+
+   const auto tNow       = std::chrono::steady_clock::now();
+   const double dElapsed = std::chrono::duration<double>(tNow - pData->tStart).count();
+   pData->oDownloadRate.Update(dElapsed, dlnow);
+   pData->oUploadRate.Update(dElapsed, ulnow);
+
+   TransferProgress &oProgress = pData->oProgress;
+   if (dlnow != oProgress.llDownloaded || ulnow != oProgress.llUploaded || dltotal != oProgress.llDownloadTotal ||
+       ultotal != oProgress.llUploadTotal)
+      pData->bReported = false;
+   oProgress.llDownloadTotal = dltotal;
+   oProgress.llDownloaded    = dlnow;
+   oProgress.llUploadTotal   = ultotal;
+   oProgress.llUploaded      = ulnow;
+   oProgress.dDownloadRate   = pData->oDownloadRate.GetRate();
+   oProgress.dUploadRate     = pData->oUploadRate.GetRate();
+   oProgress.dElapsed        = dElapsed;
+   oProgress.dEta            = (ultotal > 0 || ulnow > 0) ? pData->oUploadRate.GetEta(ulnow, ultotal)
+                                                          : pData->oDownloadRate.GetEta(dlnow, dltotal);
+
+   if (bPublish)
+      pClient->PublishProgress(*pData, (dlnow > 0 || ulnow > 0) ? CFTPProgressSnapshot::State::RUNNING : CFTPProgressSnapshot::State::CONNECTING);
+   if (!pClient->m_fnXferInfoCallback) return 0;
+
+   // the completion is reported once without waiting for the interval
+   const bool bCompleted = (dltotal > 0 && dlnow >= dltotal) || (ultotal > 0 && ulnow >= ultotal);
+   if (tNow - pData->tLastReport < pClient->m_XferInfoInterval && !(bCompleted && !pData->bReported)) return 0;
+
+   pData->tLastReport = tNow;
+   pData->bReported   = true;
+   return pClient->m_fnXferInfoCallback(oProgress);
+}
+
+/**
+ * @brief publishes the progress of the request performed : adds its new bytes to the job
+ * (see SetJobProgress) and updates the snapshot (see EnableProgressSnapshot)
+ *
+ * @param [in, out] oData state of the request
+ * @param [in] eState state to publish
+ */
+void CFTPClient::PublishProgress(RequestCallbackData &oData, CFTPProgressSnapshot::State eState) const {
+   const TransferProgress &oProgress = oData.oProgress;
+   const curl_off_t llRequestBytes   = oProgress.llDownloaded + oProgress.llUploaded;
+
+   if (m_pJobProgress != nullptr && llRequestBytes > oData.llJobBytes) {
+      m_pJobProgress->AddBytes(static_cast<uint64_t>(llRequestBytes - oData.llJobBytes));
+      oData.llJobBytes = llRequestBytes;
+   }
+
+   if (!m_bProgressSnapshot) return;
+
+   const bool bUpload = (oProgress.llUploadTotal > 0 || oProgress.llUploaded > 0);
+   CFTPProgressSnapshot::Values oValues;
+   oValues.eState          = eState;
+   oValues.llBytesDone     = bUpload ? oProgress.llUploaded : oProgress.llDownloaded;
+   oValues.llBytesTotal    = bUpload ? oProgress.llUploadTotal : oProgress.llDownloadTotal;
+   oValues.dRate           = bUpload ? oProgress.dUploadRate : oProgress.dDownloadRate;
+   oValues.dEta            = oProgress.dEta;
+   oValues.ullSessionBytes = m_ullSessionBytes + static_cast<uint64_t>(llRequestBytes);
+   m_oProgressSnapshot.Store(oValues);
+}
+
+/**
+ * @brief updates a digest with the next llSize bytes of a stream
+ *
+ * @retval true   llSize bytes were hashed.
+ * @retval false  The stream ended before.
+ */
+bool CFTPClient::HashStreamPrefix(std::istream &inputStream, curl_off_t llSize, CFTPHash &oHash) {
+   std::vector<char> vecBuffer(CURL_MAX_WRITE_SIZE);
+   curl_off_t llHashed = 0;
+   while (inputStream && llHashed < llSize) {
+      inputStream.read(vecBuffer.data(),
+                       static_cast<std::streamsize>(std::min<curl_off_t>(static_cast<curl_off_t>(vecBuffer.size()), llSize - llHashed)));
+      oHash.Update(vecBuffer.data(), static_cast<size_t>(inputStream.gcount()));
+      llHashed += inputStream.gcount();
+   }
+   return llHashed == llSize;
+}
+
 // STRING HELPERS
 
 /**
@@ -1098,39 +2735,6 @@ std::string CFTPClient::StringFormat(std::string strFormat, ...) {
    return &vec[0];
 }
 
-void CFTPClient::ReplaceString(std::string &strSubject, const std::string &strSearch, const std::string &strReplace) {
-   if (strSearch.empty()) return;
-
-   size_t pos = 0;
-   while ((pos = strSubject.find(strSearch, pos)) != std::string::npos) {
-      strSubject.replace(pos, strSearch.length(), strReplace);
-      pos += strReplace.length();
-   }
-}
-/*
-void CFTPClient::ReplaceString(std::string& str, const std::string& from, const
-std::string& to)
-{
-   if(from.empty())
-      return;
-
-   string wsRet;
-   wsRet.reserve(str.length());
-   size_t start_pos = 0, pos;
-
-   while((pos = str.find(from, start_pos)) != std::string::npos)
-   {
-      wsRet += str.substr(start_pos, pos - start_pos);
-      wsRet += to;
-      pos += from.length();
-      start_pos = pos;
-   }
-
-   wsRet += str.substr(start_pos);
-   str.swap(wsRet); // faster than str = wsRet;
-}
-*/
-
 // CURL CALLBACKS
 
 size_t CFTPClient::ThrowAwayCallback(void *ptr, size_t size, size_t nmemb, void *data) {
@@ -1162,63 +2766,80 @@ size_t CFTPClient::WriteInStringCallback(void *ptr, size_t size, size_t nmemb, v
 }
 
 /**
- * @brief stores the server response in an already opened file stream
- * used by DownloadFile()
+ * @brief reads the content of an already opened file stream
+ * used by UploadFile()
  *
- * @param buff pointer of max size (size*nmemb) to read data from it
+ * @param ptr pointer of max size (size*nmemb) to write data to it
  * @param size size parameter
  * @param nmemb memblock parameter
- * @param userdata pointer to user data (file stream)
+ * @param stream pointer to user data (input stream)
  *
  * @return (size * nmemb)
  */
-size_t CFTPClient::WriteToFileCallback(void *buff, size_t size, size_t nmemb, void *data) {
-   if ((size == 0) || (nmemb == 0) || ((size * nmemb) < 1) || (data == nullptr)) return 0;
-
-   std::ofstream *pFileStream = reinterpret_cast<std::ofstream *>(data);
-   if (pFileStream->is_open()) {
-      pFileStream->write(reinterpret_cast<char *>(buff), size * nmemb);
+size_t CFTPClient::ReadFromStreamCallback(void *ptr, size_t size, size_t nmemb, void *stream) {
+   auto *pFileStream = reinterpret_cast<std::istream *>(stream);
+   if (!pFileStream->fail()) {
+      pFileStream->read(reinterpret_cast<char *>(ptr), size * nmemb);
+      return pFileStream->gcount();
    }
-
-   return size * nmemb;
+   return 0;
 }
+
 /**
- * @brief stores the server response in std::vector<char>
+ * @brief reads the content of an input stream and hashes it
  *
- * @param buff pointer of max size (size*nmemb) to read data from it
+ * @param ptr pointer of max size (size*nmemb) to read data from it
  * @param size size parameter
  * @param nmemb memblock parameter
- * @param userdata pointer to user data (file stream)
+ * @param data pointer to a HashingStreamData
  *
- * @return (size * nmemb)
+ * @return number of bytes read from the stream
  */
-size_t CFTPClient::WriteToMemory(void *buff, size_t size, size_t nmemb, void *data) {
-   if ((size == 0) || (nmemb == 0) || ((size * nmemb) < 1) || (data == nullptr)) return 0;
+size_t CFTPClient::ReadFromStreamHashingCallback(void *ptr, size_t size, size_t nmemb, void *data) {
+   auto *pData = reinterpret_cast<HashingStreamData *>(data);
+   if (pData->pInput->fail()) return 0;
 
-   auto *vec    = reinterpret_cast<std::vector<char> *>(data);
-   size_t ssize = size * nmemb;
-   std::copy((char *)buff, (char *)buff + ssize, std::back_inserter(*vec));
+   pData->pInput->read(reinterpret_cast<char *>(ptr), size * nmemb);
+   const size_t uRead = static_cast<size_t>(pData->pInput->gcount());
+   pData->pHash->Update(ptr, uRead);
 
-   return ssize;
+   return uRead;
 }
+
 /**
- * @brief reads the content of an already opened file stream
- * used by UploadFile()
+ * @brief reads data with the wrapped read callback and deflates it for a MODE Z upload
  *
- * @param ptr pointer of max size (size*nmemb) to write data to it
+ * @param ptr pointer of max size (size*nmemb) to write compressed data to it
  * @param size size parameter
  * @param nmemb memblock parameter
- * @param stream pointer to user data (input stream)
+ * @param data pointer to a ZStreamData
  *
- * @return (size * nmemb)
+ * @return number of bytes written to ptr, 0 once the zlib stream is over
  */
-size_t CFTPClient::ReadFromStreamCallback(void *ptr, size_t size, size_t nmemb, void *stream) {
-   auto *pFileStream = reinterpret_cast<std::istream *>(stream);
-   if (!pFileStream->fail()) {
-      pFileStream->read(reinterpret_cast<char *>(ptr), size * nmemb);
-      return pFileStream->gcount();
+size_t CFTPClient::ReadDeflatingCallback(void *ptr, size_t size, size_t nmemb, void *data) {
+   auto *pData          = reinterpret_cast<ZStreamData *>(data);
+   const size_t uWanted = size * nmemb;
+   char arrInput[CURL_MAX_WRITE_SIZE];
+
+   const auto fnAppend = [pData](const char *pChunk, size_t uSize) {
+      pData->strPending.append(pChunk, uSize);
+      return true;
+   };
+
+   while (pData->strPending.size() < uWanted && !pData->pZStream->IsFinished()) {
+      const size_t uRead = pData->fnCallback(arrInput, 1, sizeof(arrInput), pData->pCallbackData);
+      if (uRead == CURL_READFUNC_ABORT) return CURL_READFUNC_ABORT;
+      if (uRead > sizeof(arrInput)) return CURL_READFUNC_ABORT;  // CURL_READFUNC_PAUSE isn't supported
+
+      // the end of the input finishes the zlib stream
+      if (!pData->pZStream->Process(arrInput, uRead, uRead == 0, fnAppend)) return CURL_READFUNC_ABORT;
    }
-   return 0;
+
+   const size_t uCopied = std::min(uWanted, pData->strPending.size());
+   memcpy(ptr, pData->strPending.data(), uCopied);
+   pData->strPending.erase(0, uCopied);
+
+   return uCopied;
 }
 
 // WILDCARD DOWNLOAD CALLBACKS
@@ -1238,6 +2859,9 @@ long CFTPClient::FileIsComingCallback(struct curl_fileinfo *finfo, WildcardTrans
    // long)finfo->size);
     UNUSED(remains)
 
+    if (data->pFilter != nullptr && !data->pFilter->Matches(MakeRemoteEntry(finfo, data->strRelativeDir)))
+        return CURL_CHUNK_BGN_FUNC_SKIP;
+
     switch (finfo->filetype) {
     case CURLFILETYPE_DIRECTORY:
         // printf(" DIR\n");
@@ -1339,6 +2963,223 @@ size_t CFTPClient::WriteItCallback(char *buff, size_t size, size_t nmemb, void *
    return written;
 }
 
+/**
+ * @brief checks whether a listed entry must be downloaded
+ *
+ * @param oEntry file or folder, its path is relative to the wildcarded folder
+ *
+ * @return false if the entry must be skipped
+ */
+bool CFTPClient::WildcardFilter::Matches(const RemoteEntry &oEntry) const {
+   const size_t uSlash       = oEntry.strPath.rfind('/');
+   const std::string strName = (uSlash == std::string::npos) ? oEntry.strPath : oEntry.strPath.substr(uSlash + 1);
+
+   for (const auto &strGlob : vecExcludeGlobs)
+      if (GlobMatch(strGlob, strName)) return false;
+   for (const auto &oRegex : vecExcludeRegexes)
+      if (std::regex_search(oEntry.strPath, oRegex)) return false;
+
+   if (oEntry.eFileType == CURLFILETYPE_FILE) {
+      if (!vecIncludeGlobs.empty() || !vecIncludeRegexes.empty()) {
+         bool bIncluded = false;
+         for (const auto &strGlob : vecIncludeGlobs)
+            if ((bIncluded = GlobMatch(strGlob, strName))) break;
+         for (size_t i = 0; !bIncluded && i < vecIncludeRegexes.size(); ++i) bIncluded = std::regex_search(oEntry.strPath, vecIncludeRegexes[i]);
+         if (!bIncluded) return false;
+      }
+
+      if (llMinSize >= 0 && oEntry.llSize < llMinSize) return false;
+      if (llMaxSize >= 0 && oEntry.llSize > llMaxSize) return false;
+      /* an unknown mtime doesn't exclude the file */
+      if (tNewerThan > 0 && oEntry.tMTime > 0 && oEntry.tMTime <= tNewerThan) return false;
+   }
+
+   return !fnPredicate || fnPredicate(oEntry);
+}
+
+/**
+ * @brief matches a name against a glob pattern ('*', '?', '[abc]', '[a-z]', '[!a]' and '\' escapes)
+ *
+ * @param strPattern glob pattern
+ * @param strName file name
+ *
+ * @return true if the whole name matches the pattern
+ */
+bool CFTPClient::WildcardFilter::GlobMatch(const std::string &strPattern, const std::string &strName) {
+   size_t p = 0, n = 0;
+   // position of the last '*' and of the name character it currently stands for
+   size_t uStarP = std::string::npos, uStarN = 0;
+
+   while (n < strName.size()) {
+      bool bAdvanced = false;
+
+      if (p < strPattern.size()) {
+         const char c = strPattern[p];
+         if (c == '*') {
+            uStarP = p++;
+            uStarN = n;
+            continue;
+         } else if (c == '?') {
+            ++p;
+            bAdvanced = true;
+         } else if (c == '[') {
+            size_t q = p + 1;
+            bool bNegate = false, bMatched = false;
+            if (q < strPattern.size() && (strPattern[q] == '!' || strPattern[q] == '^')) {
+               bNegate = true;
+               ++q;
+            }
+            const size_t uFirst = q;
+            while (q < strPattern.size() && (strPattern[q] != ']' || q == uFirst)) {
+               if (q + 2 < strPattern.size() && strPattern[q + 1] == '-' && strPattern[q + 2] != ']') {
+                  if (strName[n] >= strPattern[q] && strName[n] <= strPattern[q + 2]) bMatched = true;
+                  q += 3;
+               } else {
+                  if (strName[n] == strPattern[q]) bMatched = true;
+                  ++q;
+               }
+            }
+            if (q < strPattern.size()) {
+               if (bMatched != bNegate) {
+                  p = q + 1;
+                  bAdvanced = true;
+               }
+            } else if (strName[n] == c) {
+               // an unterminated '[' is a literal
+               ++p;
+               bAdvanced = true;
+            }
+         } else if (c == '\\' && p + 1 < strPattern.size()) {
+            if (strName[n] == strPattern[p + 1]) {
+               p += 2;
+               bAdvanced = true;
+            }
+         } else if (strName[n] == c) {
+            ++p;
+            bAdvanced = true;
+         }
+      }
+
+      if (bAdvanced) {
+         ++n;
+      } else if (uStarP != std::string::npos) {
+         // let the last '*' absorb one more character
+         p = uStarP + 1;
+         n = ++uStarN;
+      } else
+         return false;
+   }
+
+   while (p < strPattern.size() && strPattern[p] == '*') ++p;
+
+   return p == strPattern.size();
+}
+
+// WALK CALLBACKS
+
+/**
+ * @brief records an item listed during a Walk() then skips its download
+ *
+ * @param finfo
+ * @param data
+ * @param remains
+ *
+ * @return CURL_CHUNK_BGN_FUNC_SKIP (the item is never transferred)
+ */
+long CFTPClient::WalkEntryCallback(struct curl_fileinfo *finfo, WalkCallbackData *data, int remains) {
+   UNUSED(remains)
+
+   const std::string strName = finfo->filename;
+   if (strName == "." || strName == "..") return CURL_CHUNK_BGN_FUNC_SKIP;
+
+   if (finfo->filetype == CURLFILETYPE_DIRECTORY) data->vecDirList.push_back(strName);
+
+   data->pEntries->push_back(MakeRemoteEntry(finfo, data->strPrefix));
+
+   return CURL_CHUNK_BGN_FUNC_SKIP;
+}
+
+/**
+ * @brief converts a wildcard matching entry
+ *
+ * @param finfo entry listed by libcurl
+ * @param strPrefix path of its folder, '/' terminated (or empty)
+ *
+ * @return the entry with a path relative to the walked folder
+ */
+CFTPClient::RemoteEntry CFTPClient::MakeRemoteEntry(const struct curl_fileinfo *finfo, const std::string &strPrefix) {
+   RemoteEntry oEntry;
+   oEntry.strPath      = strPrefix + finfo->filename;
+   oEntry.llSize       = (finfo->flags & CURLFINFOFLAG_KNOWN_SIZE) ? finfo->size : 0;
+   oEntry.uPermissions = (finfo->flags & CURLFINFOFLAG_KNOWN_PERM) ? finfo->perm : 0;
+   oEntry.eFileType    = finfo->filetype;
+   /* libcurl doesn't fill finfo->time, we have to parse the LIST date ourselves */
+   oEntry.tMTime       = (finfo->strings.time != nullptr) ? ParseListTime(finfo->strings.time) : 0;
+
+   return oEntry;
+}
+
+/**
+ * @brief converts a LIST date ("Jan 18 15:04" or "Jan 18  2016") to an epoch (UTC)
+ *
+ * when the year is omitted, the server means the last 6 months : the current
+ * year is assumed unless it gives a date in the future.
+ *
+ * @param pszTime date as printed by the server
+ *
+ * @return epoch or 0 if the date couldn't be parsed
+ */
+time_t CFTPClient::ParseListTime(const char *pszTime) {
+   static const char *s_arrMonths[12] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+   char szMonth[4] = {0};
+   int iDay = 0, iHour = 0, iMinute = 0, iYear = 0;
+   bool bHasYear = false;
+
+   if (sscanf(pszTime, "%3s %d %d:%d", szMonth, &iDay, &iHour, &iMinute) != 4) {
+      if (sscanf(pszTime, "%3s %d %d", szMonth, &iDay, &iYear) != 3) return 0;
+      bHasYear = true;
+      iHour = iMinute = 0;
+   }
+
+   int iMonth = -1;
+   for (int i = 0; i < 12; ++i) {
+      if (strcmp(szMonth, s_arrMonths[i]) == 0) {
+         iMonth = i;
+         break;
+      }
+   }
+   if (iMonth < 0 || iDay < 1 || iDay > 31) return 0;
+
+   // days from civil (proleptic Gregorian calendar), avoids timegm() portability issues
+   auto ToEpoch = [&](int y) -> time_t {
+      const int m   = iMonth + 1;
+      y            -= (m <= 2) ? 1 : 0;
+      const int era = (y >= 0 ? y : y - 399) / 400;
+      const int yoe = y - era * 400;
+      const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + iDay - 1;
+      const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+      const long long llDays = static_cast<long long>(era) * 146097 + doe - 719468;
+      return static_cast<time_t>(llDays * 86400 + iHour * 3600 + iMinute * 60);
+   };
+
+   if (bHasYear) return ToEpoch(iYear);
+
+   // the listings may be parsed by several clients at once : no shared static buffer
+   const time_t tNow = time(nullptr);
+   struct tm tmNow;
+#ifdef WINDOWS
+   gmtime_s(&tmNow, &tNow);
+#else
+   gmtime_r(&tNow, &tmNow);
+#endif
+   time_t tResult = ToEpoch(tmNow.tm_year + 1900);
+   // tolerate clocks skew (one day) before deciding the date belongs to last year
+   if (tResult > tNow + 86400) tResult = ToEpoch(tmNow.tm_year + 1899);
+
+   return tResult;
+}
+
 // CURL DEBUG INFO CALLBACKS
 
 #ifdef DEBUG_CURL
@@ -14,6 +14,7 @@
 #include <curl/curl.h>
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstddef>  // std::size_t
 #include <cstdio>   // snprintf
 #include <cstdlib>
@@ -30,13 +31,25 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <regex>
 #include <sstream>
 #include <string>
 #include <vector>
 #include "CurlHandle.h"
+#include "FTPHash.h"
+#include "FTPLogSink.h"
+#include "FTPMetrics.h"
+#include "FTPProgress.h"
+#include "FTPTrace.h"
+#include "FTPPipeline.h"
+#include "FTPZStream.h"
 
 namespace embeddedmz {
 
+class CFTPControlConnection;
+
 class CFTPClient {
   public:
    // Public definitions
@@ -44,13 +57,25 @@ class CFTPClient {
    using LogFnCallback      = std::function<void(const std::string &)>;
    using CurlReadFn         = size_t (*) (void *, size_t, size_t, void *);
 
+   // a message is logged if its level is lower or equal to the client's one (see SetLogLevel)
+   enum class LogLevel : unsigned char {
+      ERR,   // failed operations
+      WARN,  // recovered failures (e.g. an unsupported feature)
+      INFO   // details of the operations (e.g. resumed transfers)
+   };
+
+   struct WildcardFilter;
+
    // Used to download many items at once
    struct WildcardTransfersCallbackData {
+      WildcardTransfersCallbackData() : pFilter(nullptr) {}
       std::ofstream ofsOutput;
       std::string strOutputPath;
       std::vector<std::string> vecDirList;
       // will be used to call GetWildcard recursively to download subdirectories
       // content...
+      const WildcardFilter *pFilter;
+      std::string strRelativeDir;  // path of the current folder relative to the first wildcard, '/' terminated
    };
 
    // Progress Function Data Object - parameter void* of ProgressFnCallback
@@ -66,12 +91,141 @@ class CFTPClient {
       void *pOwner;
    };
 
+   // See SetXferInfoFnCallback.
+   struct TransferProgress {
+      TransferProgress()
+          : llDownloadTotal(0), llDownloaded(0), llUploadTotal(0), llUploaded(0), dDownloadRate(0), dUploadRate(0), dElapsed(0), dEta(-1) {}
+      curl_off_t llDownloadTotal;  // 0 if unknown
+      curl_off_t llDownloaded;
+      curl_off_t llUploadTotal;  // 0 if unknown
+      curl_off_t llUploaded;
+      double dDownloadRate;  // bytes per second, smoothed (see CFTPRateEstimator)
+      double dUploadRate;    // bytes per second, smoothed
+      double dElapsed;       // seconds since the beginning of the request
+      double dEta;           // seconds remaining, -1 if unknown
+   };
+   // returning a non-zero value aborts the transfer
+   using XferInfoFnCallback = std::function<int(const TransferProgress &)>;
+
    // See Info method.
    struct FileInfo {
       time_t tFileMTime;
       double dFileSize;
    };
 
+   // See Walk method and CFTPSnapshot.
+   struct RemoteEntry {
+      RemoteEntry() : llSize(0), tMTime(0), uPermissions(0), eFileType(CURLFILETYPE_UNKNOWN) {}
+      std::string strPath;  // relative to the walked folder, '/' separated
+      curl_off_t llSize;
+      time_t tMTime;  // LIST resolution : minutes (or days for entries older than 6 months)
+      unsigned uPermissions;
+      curlfiletype eFileType;
+   };
+
+   // See DownloadWildcard method : entries rejected by the filter are skipped before
+   // any data connection is opened.
+   struct WildcardFilter {
+      WildcardFilter() : llMinSize(-1), llMaxSize(-1), tNewerThan(0) {}
+
+      // globs ('*', '?', '[a-z]', '[!a]') matched against the file name, regexes searched in
+      // the path relative to the wildcarded folder. If any include rule is set, a file must
+      // match one of them. Excludes also apply to folders (their content is not downloaded).
+      std::vector<std::string> vecIncludeGlobs;
+      std::vector<std::string> vecExcludeGlobs;
+      std::vector<std::regex> vecIncludeRegexes;
+      std::vector<std::regex> vecExcludeRegexes;
+      curl_off_t llMinSize;  // files only, -1 : no limit
+      curl_off_t llMaxSize;  // files only, -1 : no limit
+      time_t tNewerThan;     // files only, keeps files modified after this epoch, 0 : no limit
+      // called last, for files and folders, return false to skip the entry
+      std::function<bool(const RemoteEntry &)> fnPredicate;
+
+      bool Matches(const RemoteEntry &oEntry) const;
+      static bool GlobMatch(const std::string &strPattern, const std::string &strName);
+   };
+
+   // See GetLastStats method : what libcurl measured during the last request of the session.
+   struct TransferStats {
+      TransferStats()
+          : eResult(CURLE_OK), lResponseCode(0), llNameLookupUs(0), llConnectUs(0), llAppConnectUs(0), llPreTransferUs(0),
+            llStartTransferUs(0), llTotalUs(0), llBytesUploaded(0), llBytesDownloaded(0), llSpeedUpload(0), llSpeedDownload(0),
+            lNewConnections(0) {}
+      CURLcode eResult;
+      long lResponseCode;  // last FTP reply code
+      // microseconds elapsed from the start of the request until :
+      curl_off_t llNameLookupUs;     // the name was resolved
+      curl_off_t llConnectUs;        // the TCP connection was established
+      curl_off_t llAppConnectUs;     // the TLS handshake was completed (0 without TLS)
+      curl_off_t llPreTransferUs;    // the login and the commands (CWD, PASV...) were done
+      curl_off_t llStartTransferUs;  // the first byte of data was received
+      curl_off_t llTotalUs;          // the request completed
+      curl_off_t llBytesUploaded;
+      curl_off_t llBytesDownloaded;
+      curl_off_t llSpeedUpload;    // bytes per second
+      curl_off_t llSpeedDownload;  // bytes per second
+      long lNewConnections;        // 0 : a cached connection was reused (no connect and login)
+      std::string strURL;
+   };
+
+   /* See SetRequestObserver : notified by the thread performing each request (e.g. to open and
+    * close a trace span), the methods must be fast. strURL is the URL given to libcurl. */
+   class RequestObserver {
+     public:
+      virtual ~RequestObserver() {}
+
+      virtual void OnRequestStart(CFTPMetrics::Operation /*eOperation*/, const std::string & /*strURL*/) {}
+      // the control connection is established (or reused from the cache) and logged in
+      virtual void OnConnected(CFTPMetrics::Operation /*eOperation*/, const std::string & /*strURL*/,
+                               const std::string & /*strServerIP*/, int /*iServerPort*/) {}
+      // the first byte of data was received or sent, not called by requests without data (commands...)
+      virtual void OnFirstByte(CFTPMetrics::Operation /*eOperation*/, const std::string & /*strURL*/) {}
+      // oStats has the outcome, the bytes transferred and the timings of the request
+      virtual void OnRequestEnd(CFTPMetrics::Operation /*eOperation*/, const std::string & /*strURL*/,
+                                const TransferStats & /*oStats*/) {}
+   };
+
+   // See SendCommands and the other batches.
+   struct CommandResult {
+      CommandResult() : bSucceeded(false), iCode(0) {}
+      std::string strCommand;
+      bool bSucceeded;       // positive completion (2xx) or intermediate (3xx) reply
+      int iCode;             // FTP reply code, 0 with SFTP
+      std::string strReply;  // last line of the FTP reply, libcurl's error with SFTP
+   };
+
+   enum class CopyMode : unsigned char {
+      AUTO,   // FXP, relayed by this host if it is refused
+      FXP,    // the servers exchange the data directly (PASV on the destination, PORT on the source)
+      RELAY   // downloaded from the source and uploaded to the destination by this host
+   };
+
+   enum class ResumeMode : unsigned char {
+      NONE,      // the transfer always starts from the beginning
+      AUTO,      // continues a previous attempt when the sizes (and mtime for downloads) are consistent
+      AUTO_HASH  // uploads : the remote part must also have the digest of the local prefix (RemoteHash)
+   };
+
+   // See DownloadFile and UploadFile methods.
+   struct TransferOptions {
+      TransferOptions() : eHashAlgorithm(CFTPHash::Algorithm::NONE), bVerifyRemoteHash(false), eResume(ResumeMode::NONE), llResumedFrom(0), bAtomic(false) {}
+      // digest computed by the transfer callbacks, the file doesn't need to be read again
+      CFTPHash::Algorithm eHashAlgorithm;
+      // compares strHash with RemoteHash() once transferred, if eHashAlgorithm is NONE,
+      // GetRemoteHashAlgorithm() is used (and stored in eHashAlgorithm)
+      bool bVerifyRemoteHash;
+      std::string strHash;  // [out] lowercase hex digest of the transferred content
+      // DownloadFile : the data is written to "<local file>.part", renamed once complete. A failed
+      // download keeps it (with the remote size and mtime in "<local file>.part.info") and the next
+      // call continues it if they didn't change.
+      // UploadFile : a remote file smaller than the local one is completed with APPE.
+      ResumeMode eResume;
+      curl_off_t llResumedFrom;  // [out] bytes kept from a previous attempt
+      // UploadFile : the data is sent to "<remote file>.part" which is renamed by the same request
+      // once complete (RNFR/RNTO or SFTP rename), the remote file never appears partially written.
+      bool bAtomic;
+   };
+
    enum SettingsFlag {
       NO_FLAGS   = 0x00,
       ENABLE_LOG = 0x01,
@@ -120,13 +274,48 @@ class CFTPClient {
 
    // Setters - Getters (for unit tests)
    void SetProgressFnCallback(void *pOwner, const ProgressFnCallback &fnCallback, const bool enable = true);
+   /* Any callable (e.g. a capturing lambda), called at most every uMinIntervalMs during a transfer
+    * and once at its end, an empty one removes it. Can be used with the progress function. */
+   void SetXferInfoFnCallback(const XferInfoFnCallback &fnCallback, unsigned uMinIntervalMs = 100);
    void SetProxy(const std::string &strProxy);
    void SetProxyUserPwd(const std::string &strProxyUserPwd);
+   /* pObserver is not owned (nullptr to remove it), it is given to the clones (see CloneSession)
+    * and must then support calls from several threads. */
+   inline void SetRequestObserver(RequestObserver *pObserver) { m_pObserver = pObserver; }
+   inline RequestObserver *GetRequestObserver() const { return m_pObserver; }
+   /* Runtime protocol trace : the last uRecords commands, replies, libcurl informations and data
+    * transfers of the session are kept in memory (see CFTPTrace). With bDumpOnError, the trace is
+    * given to the logger when a request fails. Must not be called during a request. */
+   void EnableTrace(size_t uRecords = 1024, bool bDumpOnError = false);
+   void DisableTrace();
+   inline bool IsTraceEnabled() const { return m_pTrace != nullptr; }
+   // can be called by another thread during a request, empty if the trace is disabled
+   std::string DumpTrace() const;
+   // default is WARN, nothing is logged without ENABLE_LOG
+   inline void SetLogLevel(LogLevel eLevel) { m_eLogLevel = eLevel; }
+   inline LogLevel GetLogLevel() const { return m_eLogLevel; }
+   /* With a sink, the messages are formatted and given to its output function by its thread
+    * instead of the logger (nullptr to log synchronously again). Given to the clones. */
+   inline void SetLogSink(const std::shared_ptr<CFTPLogSink> &pSink) { m_pLogSink = pSink; }
+   inline const std::shared_ptr<CFTPLogSink> &GetLogSink() const { return m_pLogSink; }
    inline void SetTimeout(const int &iTimeout) { m_iCurlTimeout = iTimeout; }
    inline void SetActive(const bool &bEnable) { m_bActive = bEnable; }
    inline void SetNoSignal(const bool &bNoSignal) { m_bNoSignal = bNoSignal; }
    inline void SetInsecure(const bool &bInsecure) { m_bInsecure = bInsecure; }
+   // MODE Z : compressed data connections for DownloadFile, UploadFile and List when the server supports it
+   inline void SetModeZ(const bool &bEnable) { m_bModeZ = bEnable; }
+   // 0 to 9, -1 is zlib's default : used for uploads and requested to the server for downloads
+   inline void SetCompressionLevel(const int &iLevel) { m_iCompressionLevel = (iLevel >= -1 && iLevel <= 9) ? iLevel : -1; }
+   // nullptr if the progress function is not a plain function (see GetXferInfoFnCallback)
    inline auto GetProgressFnCallback() const { return m_fnProgressCallback.target<int (*)(void *, double, double, double, double)>(); }
+   inline const XferInfoFnCallback &GetXferInfoFnCallback() const { return m_fnXferInfoCallback; }
+   /* The progress of the requests (state, bytes, smoothed rate) is published for other threads,
+    * which can poll it with GetProgressSnapshot() without lock (see CFTPProgressSnapshot). */
+   inline void EnableProgressSnapshot(const bool &bEnable = true) { m_bProgressSnapshot = bEnable; }
+   inline CFTPProgressSnapshot::Values GetProgressSnapshot() const { return m_oProgressSnapshot.Load(); }
+   /* The bytes transferred by the requests are added to pJob (not owned, nullptr to remove it),
+    * e.g. by CFTPSessionPool::Run. Must not be called during a request. */
+   inline void SetJobProgress(CFTPJobProgress *pJob) { m_pJobProgress = pJob; }
    inline void *GetProgressFnCallbackOwner() const { return m_ProgressStruct.pOwner; }
    inline std::string   GetProxy() const { return m_strProxy; }
    inline std::string   GetProxyUserPwd() const { return m_strProxyUserPwd; }
@@ -135,10 +324,15 @@ class CFTPClient {
    inline bool          GetActive() { return m_bActive; }
    inline bool          GetNoSignal() const { return m_bNoSignal; }
    inline bool          GetInsecure() const { return m_bInsecure; }
+   inline bool          GetModeZ() const { return m_bModeZ; }
+   inline int           GetCompressionLevel() const { return m_iCompressionLevel; }
    inline std::string   GetURL() const { return m_strServer; }
    inline std::string   GetUsername() const { return m_strUserName; }
    inline std::string   GetPassword() const { return m_strPassword; }
    inline unsigned char GetSettingsFlags() const { return m_eSettingsFlags; }
+   /* Statistics of the last request, some methods send several requests (e.g. UploadFile with
+    * TransferOptions::bVerifyRemoteHash : the checksum request). */
+   inline const TransferStats &GetLastStats() const { return m_oLastStats; }
    inline FTP_PROTOCOL  GetProtocol() const { return m_eFtpProtocol; }
 
    // Session
@@ -147,6 +341,17 @@ class CFTPClient {
    virtual bool CleanupSession();
    const CURL *GetCurlPointer() const { return m_pCurlSession; }
 
+   /* Writes in strURL (its capacity is reused) the URL given to libcurl for a remote path, e.g.
+    * "ftp://127.0.0.1//documents//info.txt" for "documents/info.txt" : the scheme and the host
+    * are computed by InitSession, the '/' are doubled and the characters reserved in a URL are
+    * percent-encoded (e.g. "100%.txt" -> "100%25.txt"). With bWildcard, the last segment is a
+    * pattern matched by libcurl as is : only its spaces are encoded. */
+   void BuildURL(std::string &strURL, const std::string &strRemoteFile, bool bWildcard = false) const;
+
+   /* Creates a new client sharing the logger, server parameters and settings of this one,
+    * with its own initialized session (e.g. to run requests in parallel). */
+   std::unique_ptr<CFTPClient> CloneSession() const;
+
    // FTP requests
    bool CreateDir(const std::string &strNewDir) const;
 
@@ -154,17 +359,49 @@ class CFTPClient {
 
    bool RemoveFile(const std::string &strRemoteFile) const;
 
+   /* Batches : the commands are sent in a single request and the failure of one of them doesn't stop
+    * the next ones. They return true if all the commands succeeded, vecResults has an entry per item. */
+   bool SendCommands(const std::vector<std::string> &vecCommands, std::vector<CommandResult> &vecResults) const;
+   bool RemoveFiles(const std::vector<std::string> &vecRemoteFiles, std::vector<CommandResult> &vecResults) const;
+   bool CreateDirs(const std::vector<std::string> &vecRemoteDirs, std::vector<CommandResult> &vecResults) const;
+   bool RemoveDirs(const std::vector<std::string> &vecRemoteDirs, std::vector<CommandResult> &vecResults) const;
+   // pairs of (current URN, new URN)
+   bool Rename(const std::vector<std::pair<std::string, std::string>> &vecRenames, std::vector<CommandResult> &vecResults) const;
+
+   /* Removes a remote directory and its content : the files are removed by batches with uSessions
+    * sessions in parallel (see CFTPSessionPool), then the directories from the deepest ones. */
+   bool RemoveTree(const std::string &strRemoteDir, unsigned uSessions = 4) const;
+
    /* Checks a single file's size and mtime from an FTP server */
    bool Info(const std::string &strRemoteFile, struct FileInfo &oFileInfo) const;
 
    bool List(const std::string &strRemoteFolder, std::string &strList, bool bOnlyNames = true) const;
 
+   /* Collects the entries (name, size, mtime, type) of a remote folder without any download */
+   bool Walk(const std::string &strRemoteFolder, std::vector<RemoteEntry> &vecEntries, bool bRecursive = true) const;
+
+   /* Asks the server for a file checksum (HASH, XSHA256, XSHA1, XMD5 or XCRC extension, as
+    * advertised by FEAT) : only CRC32, MD5, SHA1 and SHA256 can be requested. */
+   bool RemoteHash(const std::string &strRemoteFile, const CFTPHash::Algorithm &eAlgorithm, std::string &strHash) const;
+
+   /* Strongest algorithm usable with RemoteHash(), Algorithm::NONE if the server has none. */
+   CFTPHash::Algorithm GetRemoteHashAlgorithm() const;
+
+   /* True if the transfers can be compressed : the library was built with zlib and FEAT advertises MODE Z. */
+   bool IsModeZSupported() const;
+
    bool DownloadFile(const std::string &strLocalFile, const std::string &strRemoteFile) const;
 
+   bool DownloadFile(const std::string &strLocalFile, const std::string &strRemoteFile, TransferOptions &oOptions) const;
+
    bool DownloadFile(const std::string &strRemoteFile, std::vector<char> &data) const;
 
+   bool DownloadFile(const std::string &strRemoteFile, CFTPSink &oSink) const;
+
    bool DownloadWildcard(const std::string &strLocalDir, const std::string &strRemoteWildcard) const;
 
+   bool DownloadWildcard(const std::string &strLocalDir, const std::string &strRemoteWildcard, const WildcardFilter &oFilter) const;
+
    bool UploadFile(CurlReadFn readFn, void *userData, const std::string &strRemoteFile, const bool &bCreateDir = false,
                    curl_off_t fileSize = -1) const;
 
@@ -173,9 +410,17 @@ class CFTPClient {
 
    bool UploadFile(const std::string &strLocalFile, const std::string &strRemoteFile, const bool &bCreateDir = false) const;
 
+   bool UploadFile(const std::string &strLocalFile, const std::string &strRemoteFile, const bool &bCreateDir,
+                   TransferOptions &oOptions) const;
+
    bool AppendFile(const std::string &strLocalFile, const size_t fileOffset, const std::string &strRemoteFile,
                    const bool &bCreateDir = false) const;
 
+   /* Copies a file from a server to another one (or the same), the sessions of both clients must be initialized.
+    * FXP only works with plain FTP and servers accepting data connections with a third host. */
+   static bool CopyBetweenServers(const CFTPClient &oSource, const std::string &strSourceFile, const CFTPClient &oDestination,
+                                  const std::string &strDestinationFile, CopyMode eMode = CopyMode::AUTO);
+
    // SSL certs
    void SetSSLCertFile(const std::string &strPath) { m_strSSLCertFile = strPath; }
    std::string GetSSLCertFile() const { return m_strSSLCertFile; }
@@ -197,24 +442,120 @@ class CFTPClient {
 
   private:
    /* common operations are performed here */
-   inline CURLcode Perform() const;
-   inline std::string ParseURL(const std::string &strURL) const;
+   inline CURLcode Perform(CFTPMetrics::Operation eOperation, const std::string &strURL) const;
+   void CollectStats(CURLcode eResult, CFTPMetrics::Operation eOperation) const;
+   inline std::string ParseURL(const std::string &strRemoteFile, bool bWildcard = false) const;
+   static void AppendURLPath(std::string &strURL, const char *pBegin, const char *pEnd, bool bWildcard);
+
+   bool DownloadWildcard(const std::string &strLocalDir, const std::string &strRemoteWildcard, const WildcardFilter *pFilter,
+                         const std::string &strRelativeDir) const;
+
+   CURLcode PerformDownload(const std::string &strRemote, CFTPSink &oSink, bool bDirListOnly, curl_off_t llResumeFrom = 0,
+                            CFTPMetrics::Operation eOperation = CFTPMetrics::Operation::DOWNLOAD) const;
+   bool SendCommands(const std::vector<std::string> &vecCommands, std::vector<CommandResult> &vecResults,
+                     CFTPMetrics::Operation eOperation) const;
+   curl_off_t GetResumeOffset(const std::string &strPartFile, const FileInfo &oRemoteInfo) const;
+   curl_off_t GetUploadResumeOffset(std::istream &inputFile, curl_off_t llLocalSize, const std::string &strRemoteFile,
+                                    const TransferOptions &oOptions, CFTPHash &oHash) const;
+   bool UploadData(CurlReadFn readFn, void *userData, const std::string &strRemoteFile, const bool &bCreateDir,
+                   curl_off_t fileSize, bool bAppend, const std::string &strRenameTo = std::string()) const;
+   void AppendRenameCommands(struct curl_slist *&pCommands, const std::string &strFrom, const std::string &strTo) const;
+   bool ConnectControl() const;
+   static bool CopyFXP(const CFTPClient &oSource, const std::string &strSourceFile, const CFTPClient &oDestination,
+                       const std::string &strDestinationFile, std::string &strError);
+   static bool ExchangeFXP(CFTPControlConnection &oSource, const std::string &strSourceFile, CFTPControlConnection &oDestination,
+                           const std::string &strDestinationFile, std::string &strError);
+   static bool CopyRelay(const CFTPClient &oSource, const std::string &strSourceFile, const CFTPClient &oDestination,
+                         const std::string &strDestinationFile);
+
+   bool LoadRemoteFeatures() const;
+   bool SelectVerifyHashAlgorithm(TransferOptions &oOptions) const;
+   bool VerifyRemoteHash(const std::string &strRemoteFile, const TransferOptions &oOptions) const;
+
+   // MODE Z helpers, UseModeZ() must be called before curl_easy_reset (FEAT may be sent)
+   bool UseModeZ() const;
+   void SetModeZCommands(struct curl_slist *&pQuote, struct curl_slist *&pPostQuote) const;
+   void RestoreStreamMode() const;
+   CURLcode EndModeZTransfer(CURLcode res, const CFTPZStream &oZStream, const std::string &strRemote) const;
 
    // Curl callbacks
    static size_t WriteInStringCallback(void *ptr, size_t size, size_t nmemb, void *data);
-   static size_t WriteToFileCallback(void *ptr, size_t size, size_t nmemb, void *data);
    static size_t ReadFromStreamCallback(void *ptr, size_t size, size_t nmemb, void *stream);
+
+   // Streams hashed while uploaded
+   struct HashingStreamData {
+      std::istream *pInput;
+      CFTPHash *pHash;
+   };
+   static size_t ReadFromStreamHashingCallback(void *ptr, size_t size, size_t nmemb, void *data);
+   // MODE Z uploads : the data read by the wrapped callback is deflated (downloads are inflated by a CFTPInflateStage)
+   struct ZStreamData {
+      CFTPZStream *pZStream;
+      CurlReadFn fnCallback;
+      void *pCallbackData;
+      std::string strPending;  // deflated bytes not yet given to libcurl
+   };
+   static size_t ReadDeflatingCallback(void *ptr, size_t size, size_t nmemb, void *data);
    static size_t ThrowAwayCallback(void *ptr, size_t size, size_t nmemb, void *data);
-   static size_t WriteToMemory(void *ptr, size_t size, size_t nmemb, void *data);
+
+   // Request observer and progress callbacks, state of the request performed
+   struct RequestCallbackData {
+      RequestCallbackData(const CFTPClient *pClient, CFTPMetrics::Operation eOperation, const std::string *pURL)
+          : pClient(pClient), eOperation(eOperation), pURL(pURL), bFirstByte(false), tStart(std::chrono::steady_clock::now()),
+            tLastReport(tStart), bReported(true), llJobBytes(0) {}
+      const CFTPClient *pClient;
+      CFTPMetrics::Operation eOperation;
+      const std::string *pURL;
+      bool bFirstByte;  // OnFirstByte was called
+      std::chrono::steady_clock::time_point tStart;
+      std::chrono::steady_clock::time_point tLastReport;  // last call of the xferinfo callback
+      CFTPRateEstimator oDownloadRate;
+      CFTPRateEstimator oUploadRate;
+      TransferProgress oProgress;
+      bool bReported;         // oProgress was given to the xferinfo callback
+      curl_off_t llJobBytes;  // bytes of the request added to m_pJobProgress
+   };
+   static int ObserverPrereqCallback(void *clientp, char *conn_primary_ip, char *conn_local_ip, int conn_primary_port,
+                                     int conn_local_port);
+   static int XferInfoCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+   void PublishProgress(RequestCallbackData &oData, CFTPProgressSnapshot::State eState) const;
+
+   // Walk callbacks
+   struct WalkCallbackData {
+      std::vector<RemoteEntry> *pEntries;
+      std::string strPrefix;
+      std::vector<std::string> vecDirList;
+   };
+   static long WalkEntryCallback(struct curl_fileinfo *finfo, WalkCallbackData *data, int remains);
+   static RemoteEntry MakeRemoteEntry(const struct curl_fileinfo *finfo, const std::string &strPrefix);
+   static time_t ParseListTime(const char *pszTime);
 
    // Wildcard transfers callbacks
    static long FileIsComingCallback(struct curl_fileinfo *finfo, WildcardTransfersCallbackData *data, int remains);
    static long FileIsDownloadedCallback(WildcardTransfersCallbackData *data);
    static size_t WriteItCallback(char *buff, size_t size, size_t nmemb, void *cb_data);
 
+   static bool WriteResumeInfo(const std::string &strPartFile, const FileInfo &oRemoteInfo);
+   static bool HashStreamPrefix(std::istream &inputStream, curl_off_t llSize, CFTPHash &oHash);
+
+   /* Nothing is formatted if the message is filtered out, but its arguments are evaluated :
+    * costly ones must be guarded by IsLogged(). */
+   inline bool IsLogged(LogLevel eLevel) const { return (m_eSettingsFlags & ENABLE_LOG) && eLevel <= m_eLogLevel; }
+   template <typename... Args>
+   void Log(LogLevel eLevel, const char *pszFormat, const Args &...args) const {
+      if (IsLogged(eLevel)) WriteLog(pszFormat, args...);
+   }
+   // without any filtering (e.g. the trace requested by EnableTrace)
+   template <typename... Args>
+   void WriteLog(const char *pszFormat, const Args &...args) const {
+      if (m_pLogSink)
+         m_pLogSink->Push(pszFormat, args...);
+      else
+         m_oLog(CFTPLogSink::Format(pszFormat, args...));
+   }
+
    // String Helpers
    static std::string StringFormat(std::string strFormat, ...);
-   static void ReplaceString(std::string &strSubject, const std::string &strSearch, const std::string &strReplace);
 
 // Curl Debug informations
 #ifdef DEBUG_CURL
@@ -226,6 +567,8 @@ class CFTPClient {
    std::string m_strUserName;
    std::string m_strPassword;
    std::string m_strServer;
+   std::string m_strURLPrefix;  // "scheme://host//", see BuildURL
+   mutable std::string m_strURL;  // URL of the current request (Info, downloads)
    std::string m_strProxy;
    std::string m_strProxyUserPwd;
 
@@ -245,13 +588,39 @@ class CFTPClient {
    mutable CURL *m_pCurlSession;
    int m_iCurlTimeout;
 
+   // FEAT cache of the session : hash algorithm -> command (see RemoteHash)
+   mutable bool m_bRemoteFeaturesLoaded;
+   mutable std::map<CFTPHash::Algorithm, std::string> m_mapRemoteHashCommands;
+   mutable bool m_bRemoteModeZ;
+
+   // MODE Z
+   bool m_bModeZ;
+   int m_iCompressionLevel;
+
+   mutable TransferStats m_oLastStats;
+   size_t m_uMetricsHost;  // see CFTPMetrics::GetHostIndex
+   RequestObserver *m_pObserver;
+
+   std::unique_ptr<CFTPTrace> m_pTrace;
+   bool m_bDumpTraceOnError;
+
    // Progress function
    ProgressFnCallback m_fnProgressCallback;
    ProgressFnStruct m_ProgressStruct;
    bool m_bProgressCallbackSet;
+   XferInfoFnCallback m_fnXferInfoCallback;
+   std::chrono::milliseconds m_XferInfoInterval;
+
+   // progress read by other threads
+   bool m_bProgressSnapshot;
+   mutable CFTPProgressSnapshot m_oProgressSnapshot;
+   mutable uint64_t m_ullSessionBytes;  // transferred by the completed requests
+   CFTPJobProgress *m_pJobProgress;
 
    // Log printer callback
    LogFnCallback m_oLog;
+   LogLevel m_eLogLevel;
+   std::shared_ptr<CFTPLogSink> m_pLogSink;
 
 #ifdef DEBUG_CURL
    static std::string s_strCurlTraceLogDirectory;
@@ -272,6 +641,10 @@ inline CFTPClient::SettingsFlag operator|(CFTPClient::SettingsFlag a, CFTPClient
    "[FTPClient][Warning] Object was freed before calling " \
    "CFTPClient::CleanupSession()."                         \
    " The API session was cleaned though."
+#define LOG_WARNING_FXP_FALLBACK_FORMAT "[FTPClient][Warning] FXP copy of %s to %s failed (%s), relaying it."
+#define LOG_WARNING_RESUME_INFO_FORMAT "[FTPClient][Warning] Unable to write %s.info, the download can't be resumed."
+#define LOG_WARNING_RESUME_PREFIX_FORMAT "[FTPClient][Warning] The %s checksum of %s doesn't match the local file, uploading it again."
+#define LOG_INFO_RESUME_FORMAT "[FTPClient][Info] Resuming the transfer of %s at byte %lld."
 #define LOG_ERROR_EMPTY_HOST_MSG "[FTPClient][Error] Empty hostname."
 #define LOG_ERROR_CURL_ALREADY_INIT_MSG                        \
    "[FTPClient][Error] Curl session is already initialized ! " \
@@ -293,6 +666,19 @@ inline CFTPClient::SettingsFlag operator|(CFTPClient::SettingsFlag a, CFTPClient
 #define LOG_ERROR_CURL_GETWILD_REC_FORMAT "[FTPClient][Error] Encountered a problem while importing %s to %s."
 #define LOG_ERROR_CURL_MKDIR_FORMAT "[FTPClient][Error] Unable to create directory %s (Error = %d | %s)."
 #define LOG_ERROR_CURL_RMDIR_FORMAT "[FTPClient][Error] Unable to remove directory %s (Error = %d | %s)."
+#define LOG_ERROR_CURL_WALK_FORMAT "[FTPClient][Error] Unable to walk remote folder %s (Error = %d | %s)."
+#define LOG_ERROR_CURL_FEAT_FORMAT "[FTPClient][Error] Unable to get the features of %s (Error = %d | %s)."
+#define LOG_ERROR_HASH_UNSUPPORTED_FORMAT "[FTPClient][Error] The server doesn't compute %s checksums of remote files."
+#define LOG_ERROR_CURL_BATCH_FORMAT "[FTPClient][Error] Unable to send a batch of %u commands (Error = %d | %s)."
+#define LOG_ERROR_BATCH_CRLF_FORMAT "[FTPClient][Error] A command of a batch of %u contains CR or LF, none was sent."
+#define LOG_ERROR_BATCH_REPLIES_FORMAT "[FTPClient][Error] Got %u replies to a batch of %u commands."
+#define LOG_ERROR_REMOVE_TREE_FORMAT "[FTPClient][Error] %u entries of %s couldn't be removed."
+#define LOG_ERROR_HASH_PARSE_FORMAT "[FTPClient][Error] Unexpected reply to the %s checksum request of %s."
+#define LOG_ERROR_HASH_MISMATCH_FORMAT "[FTPClient][Error] %s checksum mismatch for %s (local %s, remote %s)."
+#define LOG_ERROR_MODEZ_STREAM_FORMAT "[FTPClient][Error] Corrupted or truncated MODE Z data for %s."
+#define LOG_ERROR_FXP_FORMAT "[FTPClient][Error] FXP copy of %s to %s failed (%s)."
+#define LOG_ERROR_RELAY_FORMAT "[FTPClient][Error] Unable to relay %s to %s."
+#define LOG_ERROR_TRACE_FORMAT "[FTPClient][Error] Request %s failed (Error = %d | %s), trace :\n"
 
 #define LOG_ERROR_FILE_UPLOAD_FORMAT                     \
    "[FTPClient][Error] Unable to open local file %s in " \
@@ -300,6 +686,7 @@ inline CFTPClient::SettingsFlag operator|(CFTPClient::SettingsFlag a, CFTPClient
 #define LOG_ERROR_FILE_GETFILE_FORMAT                    \
    "[FTPClient][Error] Unable to open local file %s in " \
    "CFTPClient::DownloadFile()."
+#define LOG_ERROR_FILE_RENAME_FORMAT "[FTPClient][Error] Unable to rename local file %s to %s."
 #define LOG_ERROR_DIR_GETWILD_FORMAT                               \
    "[FTPClient][Error] %s is not a directory or it doesn't exist " \
    "in CFTPClient::DownloadWildcard()."
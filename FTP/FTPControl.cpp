@@ -0,0 +1,99 @@
+/**
+ * @file FTPControl.cpp
+ * @brief implementation of the raw control connection
+ */
+
+#include "FTPControl.h"
+
+#include <cstdlib>
+
+#ifdef LINUX
+#include <sys/select.h>
+#endif
+
+namespace embeddedmz {
+
+bool CFTPControlConnection::Send(const std::string &strCommand) {
+   // a single command per line
+   if (strCommand.find_first_of("\r\n") != std::string::npos) return false;
+
+   const std::string strLine = strCommand + "\r\n";
+
+   size_t uSent = 0;
+   while (uSent < strLine.size()) {
+      size_t uChunk = 0;
+      CURLcode res  = curl_easy_send(m_pCurl, strLine.data() + uSent, strLine.size() - uSent, &uChunk);
+      if (res == CURLE_AGAIN) {
+         if (!WaitSocket(false)) return false;
+         continue;
+      }
+      if (res != CURLE_OK) return false;
+      uSent += uChunk;
+   }
+   return true;
+}
+
+bool CFTPControlConnection::ReadReply(int &iCode, std::string &strReply) {
+   iCode = 0;
+   strReply.clear();
+
+   /* RFC 959 : a multi-line reply starts with "xyz-" and ends with a line starting with "xyz " */
+   std::string strLine;
+   if (!ReadLine(strLine) || strLine.size() < 3) return false;
+   const std::string strCode = strLine.substr(0, 3);
+   if (strLine.size() > 3 && strLine[3] == '-') {
+      do {
+         if (!ReadLine(strLine)) return false;
+      } while (strLine.size() < 4 || strLine.compare(0, 3, strCode) != 0 || strLine[3] != ' ');
+   }
+
+   iCode    = atoi(strCode.c_str());
+   strReply = strLine;
+   return iCode >= 100;
+}
+
+bool CFTPControlConnection::Command(const std::string &strCommand, int &iCode, std::string &strReply) {
+   return Send(strCommand) && ReadReply(iCode, strReply);
+}
+
+bool CFTPControlConnection::WaitSocket(bool bForRecv) const {
+   curl_socket_t sockfd = CURL_SOCKET_BAD;
+   if (curl_easy_getinfo(m_pCurl, CURLINFO_ACTIVESOCKET, &sockfd) != CURLE_OK || sockfd == CURL_SOCKET_BAD) return false;
+
+   fd_set fdSet;
+   FD_ZERO(&fdSet);
+   FD_SET(sockfd, &fdSet);
+
+   struct timeval tv;
+   tv.tv_sec  = m_lTimeoutMs / 1000;
+   tv.tv_usec = (m_lTimeoutMs % 1000) * 1000;
+
+   // the first parameter is ignored by Windows
+   int iRes = select(static_cast<int>(sockfd) + 1, bForRecv ? &fdSet : nullptr, bForRecv ? nullptr : &fdSet, nullptr,
+                     (m_lTimeoutMs > 0) ? &tv : nullptr);
+   return iRes > 0;
+}
+
+bool CFTPControlConnection::ReadLine(std::string &strLine) {
+   for (;;) {
+      const size_t uEnd = m_strBuffer.find('\n');
+      if (uEnd != std::string::npos) {
+         strLine = m_strBuffer.substr(0, (uEnd > 0 && m_strBuffer[uEnd - 1] == '\r') ? uEnd - 1 : uEnd);
+         m_strBuffer.erase(0, uEnd + 1);
+         return true;
+      }
+
+      char szBuffer[1024];
+      size_t uReceived = 0;
+      CURLcode res     = curl_easy_recv(m_pCurl, szBuffer, sizeof(szBuffer), &uReceived);
+      if (res == CURLE_AGAIN) {
+         if (!WaitSocket(true)) return false;
+         continue;
+      }
+      // uReceived is 0 when the server closed the connection
+      if (res != CURLE_OK || uReceived == 0) return false;
+      m_strBuffer.append(szBuffer, uReceived);
+   }
+}
+
+}  // namespace embeddedmz
@@ -0,0 +1,45 @@
+/*
+ * @file FTPControl.h
+ * @brief raw commands on an FTP control connection opened by libcurl
+ */
+
+#ifndef INCLUDE_FTPCONTROL_H_
+#define INCLUDE_FTPCONTROL_H_
+
+#include <curl/curl.h>
+
+#include <string>
+
+namespace embeddedmz {
+
+/* Wraps a handle on which curl_easy_perform() was called with CURLOPT_CONNECT_ONLY : libcurl
+ * logged in (and negotiated TLS), the commands are then exchanged with curl_easy_send/recv.
+ * Needed by the requests libcurl can't express, like the two interleaved transfers of FXP. */
+class CFTPControlConnection {
+  public:
+   // lTimeoutMs : maximum wait for each reply, 0 : no limit
+   explicit CFTPControlConnection(CURL *pCurl, long lTimeoutMs = 0) : m_pCurl(pCurl), m_lTimeoutMs(lTimeoutMs) {}
+
+   CFTPControlConnection(const CFTPControlConnection &) = delete;
+   CFTPControlConnection &operator=(const CFTPControlConnection &) = delete;
+
+   // strCommand without CRLF, a command containing CR or LF is refused
+   bool Send(const std::string &strCommand);
+   /* Reads a complete reply (multi-line ones too), iCode is its 3 digits code and strReply its
+    * last line. */
+   bool ReadReply(int &iCode, std::string &strReply);
+   // Send + ReadReply
+   bool Command(const std::string &strCommand, int &iCode, std::string &strReply);
+
+  private:
+   bool WaitSocket(bool bForRecv) const;
+   bool ReadLine(std::string &strLine);
+
+   CURL *m_pCurl;
+   long m_lTimeoutMs;
+   std::string m_strBuffer;  // received, not yet consumed
+};
+
+}  // namespace embeddedmz
+
+#endif
@@ -0,0 +1,551 @@
+/**
+ * @file FTPHash.cpp
+ * @brief implementation of the streaming digests
+ */
+
+#include "FTPHash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "FTPClient.h"  // Utf8ToUtf16
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define FTPHASH_CRC32C_SSE42
+#define FTPHASH_SSE42_TARGET __attribute__((target("sse4.2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <nmmintrin.h>
+#define FTPHASH_CRC32C_SSE42
+#define FTPHASH_SSE42_TARGET
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define FTPHASH_CRC32C_ARMV8
+#endif
+
+namespace embeddedmz {
+
+namespace {
+
+/* reflected polynomials */
+const uint32_t CRC32C_POLY = 0x82F63B78;  // Castagnoli
+const uint32_t CRC32_POLY  = 0xEDB88320;  // ISO-HDLC
+
+// slicing-by-8 tables
+struct CrcTables {
+   uint32_t arrTable[8][256];
+
+   explicit CrcTables(uint32_t uPoly) {
+      for (uint32_t i = 0; i < 256; ++i) {
+         uint32_t uCrc = i;
+         for (int j = 0; j < 8; ++j) uCrc = (uCrc >> 1) ^ ((uCrc & 1) ? uPoly : 0);
+         arrTable[0][i] = uCrc;
+      }
+      for (uint32_t i = 0; i < 256; ++i)
+         for (int k = 1; k < 8; ++k) arrTable[k][i] = (arrTable[k - 1][i] >> 8) ^ arrTable[0][arrTable[k - 1][i] & 0xFF];
+   }
+};
+
+const CrcTables &GetCrc32cTables() {
+   static const CrcTables s_oTables(CRC32C_POLY);
+   return s_oTables;
+}
+
+const CrcTables &GetCrc32Tables() {
+   static const CrcTables s_oTables(CRC32_POLY);
+   return s_oTables;
+}
+
+inline uint32_t ReadLE32(const unsigned char *p) {
+   return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+          (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint64_t ReadLE64(const unsigned char *p) { return static_cast<uint64_t>(ReadLE32(p)) | (static_cast<uint64_t>(ReadLE32(p + 4)) << 32); }
+
+inline uint32_t ReadBE32(const unsigned char *p) {
+   return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) |
+          static_cast<uint32_t>(p[3]);
+}
+
+uint32_t CrcSoftware(const CrcTables &oTables, uint32_t uCrc, const unsigned char *p, size_t n) {
+   const auto &T = oTables.arrTable;
+
+   while (n >= 8) {
+      const uint32_t uLow  = ReadLE32(p) ^ uCrc;
+      const uint32_t uHigh = ReadLE32(p + 4);
+      uCrc = T[7][uLow & 0xFF] ^ T[6][(uLow >> 8) & 0xFF] ^ T[5][(uLow >> 16) & 0xFF] ^ T[4][uLow >> 24] ^ T[3][uHigh & 0xFF] ^
+             T[2][(uHigh >> 8) & 0xFF] ^ T[1][(uHigh >> 16) & 0xFF] ^ T[0][uHigh >> 24];
+      p += 8;
+      n -= 8;
+   }
+   while (n--) uCrc = (uCrc >> 8) ^ T[0][(uCrc ^ *p++) & 0xFF];
+
+   return uCrc;
+}
+
+#if defined(FTPHASH_CRC32C_SSE42)
+FTPHASH_SSE42_TARGET uint32_t Crc32cHardware(uint32_t uCrc, const unsigned char *p, size_t n) {
+#if defined(__x86_64__) || defined(_M_X64)
+   uint64_t ullCrc = uCrc;
+   for (; n >= 8; p += 8, n -= 8) {
+      uint64_t ullWord;
+      memcpy(&ullWord, p, sizeof(ullWord));
+      ullCrc = _mm_crc32_u64(ullCrc, ullWord);
+   }
+   uCrc = static_cast<uint32_t>(ullCrc);
+#endif
+   for (; n >= 4; p += 4, n -= 4) {
+      uint32_t uWord;
+      memcpy(&uWord, p, sizeof(uWord));
+      uCrc = _mm_crc32_u32(uCrc, uWord);
+   }
+   while (n--) uCrc = _mm_crc32_u8(uCrc, *p++);
+
+   return uCrc;
+}
+
+bool DetectCrc32cHardware() {
+#if defined(_MSC_VER)
+   int arrInfo[4];
+   __cpuid(arrInfo, 1);
+   return (arrInfo[2] & (1 << 20)) != 0;
+#else
+   return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#elif defined(FTPHASH_CRC32C_ARMV8)
+uint32_t Crc32cHardware(uint32_t uCrc, const unsigned char *p, size_t n) {
+   for (; n >= 8; p += 8, n -= 8) {
+      uint64_t ullWord;
+      memcpy(&ullWord, p, sizeof(ullWord));
+      uCrc = __crc32cd(uCrc, ullWord);
+   }
+   while (n--) uCrc = __crc32cb(uCrc, *p++);
+
+   return uCrc;
+}
+
+// the instructions are guaranteed by the compilation target (e.g. -march=armv8-a+crc)
+bool DetectCrc32cHardware() { return true; }
+#endif
+
+/* SHA-1 / SHA-256 */
+inline uint32_t RotL32(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+inline uint32_t RotR32(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be,
+    0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa,
+    0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85,
+    0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
+    0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+const uint32_t MD5_K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1,
+    0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453,
+    0xd8a1e681, 0xe7d3fbc8, 0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a, 0xfffa3942,
+    0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665, 0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d,
+    0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+
+const int MD5_SHIFTS[16] = {7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21};
+
+/* XXH64 */
+const uint64_t XXH_P1 = 11400714785074694791ULL;
+const uint64_t XXH_P2 = 14029467366897019727ULL;
+const uint64_t XXH_P3 = 1609587929392839161ULL;
+const uint64_t XXH_P4 = 9650029242287828579ULL;
+const uint64_t XXH_P5 = 2870177450012600261ULL;
+
+inline uint64_t RotL64(uint64_t x, int n) { return (x << n) | (x >> (64 - n)); }
+
+inline uint64_t Xxh64Round(uint64_t ullAcc, uint64_t ullInput) {
+   ullAcc += ullInput * XXH_P2;
+   ullAcc = RotL64(ullAcc, 31);
+   return ullAcc * XXH_P1;
+}
+
+inline uint64_t Xxh64Merge(uint64_t ullHash, uint64_t ullAcc) {
+   ullHash ^= Xxh64Round(0, ullAcc);
+   return ullHash * XXH_P1 + XXH_P4;
+}
+
+std::string ToHex(const unsigned char *p, size_t n) {
+   static const char s_szDigits[] = "0123456789abcdef";
+   std::string strHex(n * 2, '0');
+   for (size_t i = 0; i < n; ++i) {
+      strHex[2 * i]     = s_szDigits[p[i] >> 4];
+      strHex[2 * i + 1] = s_szDigits[p[i] & 0x0F];
+   }
+   return strHex;
+}
+
+std::string ToHex(uint64_t ullValue, size_t uBytes) {
+   unsigned char arrBytes[8];
+   for (size_t i = 0; i < uBytes; ++i) arrBytes[i] = static_cast<unsigned char>(ullValue >> (8 * (uBytes - 1 - i)));
+   return ToHex(arrBytes, uBytes);
+}
+
+}  // namespace
+
+CFTPHash::CFTPHash(Algorithm eAlgorithm /* = Algorithm::NONE */) : m_eAlgorithm(eAlgorithm) { Reset(); }
+
+void CFTPHash::Reset(Algorithm eAlgorithm) {
+   m_eAlgorithm = eAlgorithm;
+   Reset();
+}
+
+void CFTPHash::Reset() {
+   m_ullLength = 0;
+   m_uBuffered = 0;
+   m_uCrc      = 0xFFFFFFFF;
+
+   if (m_eAlgorithm == Algorithm::SHA1) {
+      const uint32_t arrInit[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+      memcpy(m_arrState, arrInit, sizeof(arrInit));
+   } else if (m_eAlgorithm == Algorithm::SHA256) {
+      const uint32_t arrInit[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+      memcpy(m_arrState, arrInit, sizeof(arrInit));
+   } else if (m_eAlgorithm == Algorithm::MD5) {
+      const uint32_t arrInit[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+      memcpy(m_arrState, arrInit, sizeof(arrInit));
+   } else if (m_eAlgorithm == Algorithm::XXH64) {
+      m_arrAccumulators[0] = XXH_P1 + XXH_P2;
+      m_arrAccumulators[1] = XXH_P2;
+      m_arrAccumulators[2] = 0;
+      m_arrAccumulators[3] = 0 - XXH_P1;
+   }
+}
+
+/**
+ * @brief hashes a chunk of data, can be called as many times as needed
+ *
+ * @param [in] pData data to hash
+ * @param [in] uSize size in bytes of pData
+ */
+void CFTPHash::Update(const void *pData, size_t uSize) {
+   const unsigned char *p = static_cast<const unsigned char *>(pData);
+   m_ullLength += uSize;
+
+   switch (m_eAlgorithm) {
+      case Algorithm::NONE:
+         break;
+
+      case Algorithm::CRC32C:
+#if defined(FTPHASH_CRC32C_SSE42) || defined(FTPHASH_CRC32C_ARMV8)
+         if (IsCRC32CAccelerated()) {
+            m_uCrc = Crc32cHardware(m_uCrc, p, uSize);
+            break;
+         }
+#endif
+         m_uCrc = CrcSoftware(GetCrc32cTables(), m_uCrc, p, uSize);
+         break;
+
+      case Algorithm::CRC32:
+         m_uCrc = CrcSoftware(GetCrc32Tables(), m_uCrc, p, uSize);
+         break;
+
+      case Algorithm::SHA1:
+      case Algorithm::SHA256:
+      case Algorithm::MD5:
+      case Algorithm::XXH64: {
+         const size_t uBlockSize = (m_eAlgorithm == Algorithm::XXH64) ? 32 : 64;
+
+         if (m_uBuffered > 0) {
+            const size_t uCopy = std::min(uBlockSize - m_uBuffered, uSize);
+            memcpy(m_arrBuffer + m_uBuffered, p, uCopy);
+            m_uBuffered += uCopy;
+            p += uCopy;
+            uSize -= uCopy;
+            if (m_uBuffered < uBlockSize) break;
+
+            ProcessBlock(m_arrBuffer);
+            m_uBuffered = 0;
+         }
+
+         for (; uSize >= uBlockSize; p += uBlockSize, uSize -= uBlockSize) ProcessBlock(p);
+
+         memcpy(m_arrBuffer, p, uSize);
+         m_uBuffered = uSize;
+         break;
+      }
+   }
+}
+
+std::string CFTPHash::Final() {
+   switch (m_eAlgorithm) {
+      case Algorithm::CRC32C:
+      case Algorithm::CRC32:
+         return ToHex(~m_uCrc, 4);
+      case Algorithm::SHA1:
+         return FinalSha(false);
+      case Algorithm::SHA256:
+         return FinalSha(true);
+      case Algorithm::MD5:
+         return FinalMd5();
+      case Algorithm::XXH64:
+         return FinalXxh64();
+      default:
+         return std::string();
+   }
+}
+
+void CFTPHash::ProcessBlock(const unsigned char *pBlock) {
+   switch (m_eAlgorithm) {
+      case Algorithm::SHA1:
+         Sha1Block(pBlock);
+         break;
+      case Algorithm::SHA256:
+         Sha256Block(pBlock);
+         break;
+      case Algorithm::MD5:
+         Md5Block(pBlock);
+         break;
+      case Algorithm::XXH64:
+         Xxh64Stripe(pBlock);
+         break;
+      default:
+         break;
+   }
+}
+
+void CFTPHash::Sha1Block(const unsigned char *pBlock) {
+   uint32_t w[80];
+   for (int i = 0; i < 16; ++i) w[i] = ReadBE32(pBlock + 4 * i);
+   for (int i = 16; i < 80; ++i) w[i] = RotL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+   uint32_t a = m_arrState[0], b = m_arrState[1], c = m_arrState[2], d = m_arrState[3], e = m_arrState[4];
+   for (int i = 0; i < 80; ++i) {
+      uint32_t f, k;
+      if (i < 20) {
+         f = (b & c) | (~b & d);
+         k = 0x5A827999;
+      } else if (i < 40) {
+         f = b ^ c ^ d;
+         k = 0x6ED9EBA1;
+      } else if (i < 60) {
+         f = (b & c) | (b & d) | (c & d);
+         k = 0x8F1BBCDC;
+      } else {
+         f = b ^ c ^ d;
+         k = 0xCA62C1D6;
+      }
+      const uint32_t t = RotL32(a, 5) + f + e + k + w[i];
+      e                = d;
+      d                = c;
+      c                = RotL32(b, 30);
+      b                = a;
+      a                = t;
+   }
+
+   m_arrState[0] += a;
+   m_arrState[1] += b;
+   m_arrState[2] += c;
+   m_arrState[3] += d;
+   m_arrState[4] += e;
+}
+
+void CFTPHash::Sha256Block(const unsigned char *pBlock) {
+   uint32_t w[64];
+   for (int i = 0; i < 16; ++i) w[i] = ReadBE32(pBlock + 4 * i);
+   for (int i = 16; i < 64; ++i) {
+      const uint32_t s0 = RotR32(w[i - 15], 7) ^ RotR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      const uint32_t s1 = RotR32(w[i - 2], 17) ^ RotR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i]              = w[i - 16] + s0 + w[i - 7] + s1;
+   }
+
+   uint32_t s[8];
+   memcpy(s, m_arrState, sizeof(s));
+   for (int i = 0; i < 64; ++i) {
+      const uint32_t S1 = RotR32(s[4], 6) ^ RotR32(s[4], 11) ^ RotR32(s[4], 25);
+      const uint32_t ch = (s[4] & s[5]) ^ (~s[4] & s[6]);
+      const uint32_t t1 = s[7] + S1 + ch + SHA256_K[i] + w[i];
+      const uint32_t S0 = RotR32(s[0], 2) ^ RotR32(s[0], 13) ^ RotR32(s[0], 22);
+      const uint32_t mj = (s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]);
+      memmove(s + 1, s, 7 * sizeof(uint32_t));
+      s[4] += t1;
+      s[0] = t1 + S0 + mj;
+   }
+
+   for (int i = 0; i < 8; ++i) m_arrState[i] += s[i];
+}
+
+void CFTPHash::Md5Block(const unsigned char *pBlock) {
+   uint32_t m[16];
+   for (int i = 0; i < 16; ++i) m[i] = ReadLE32(pBlock + 4 * i);
+
+   uint32_t a = m_arrState[0], b = m_arrState[1], c = m_arrState[2], d = m_arrState[3];
+   for (int i = 0; i < 64; ++i) {
+      uint32_t f;
+      int g;
+      if (i < 16) {
+         f = (b & c) | (~b & d);
+         g = i;
+      } else if (i < 32) {
+         f = (d & b) | (~d & c);
+         g = (5 * i + 1) % 16;
+      } else if (i < 48) {
+         f = b ^ c ^ d;
+         g = (3 * i + 5) % 16;
+      } else {
+         f = c ^ (b | ~d);
+         g = (7 * i) % 16;
+      }
+      const uint32_t t = d;
+      d                = c;
+      c                = b;
+      b                = b + RotL32(a + f + MD5_K[i] + m[g], MD5_SHIFTS[(i / 16) * 4 + i % 4]);
+      a                = t;
+   }
+
+   m_arrState[0] += a;
+   m_arrState[1] += b;
+   m_arrState[2] += c;
+   m_arrState[3] += d;
+}
+
+void CFTPHash::Xxh64Stripe(const unsigned char *pStripe) {
+   for (int i = 0; i < 4; ++i) m_arrAccumulators[i] = Xxh64Round(m_arrAccumulators[i], ReadLE64(pStripe + 8 * i));
+}
+
+void CFTPHash::Pad(bool bBigEndianLength) {
+   const uint64_t ullBits = m_ullLength * 8;
+
+   // padding : 0x80, zeros, then the length in bits
+   unsigned char arrPadding[72] = {0x80};
+   const size_t uPadding        = (m_uBuffered < 56) ? (56 - m_uBuffered) : (120 - m_uBuffered);
+   for (int i = 0; i < 8; ++i)
+      arrPadding[uPadding + i] = static_cast<unsigned char>(ullBits >> (bBigEndianLength ? (56 - 8 * i) : (8 * i)));
+   Update(arrPadding, uPadding + 8);
+}
+
+std::string CFTPHash::FinalMd5() {
+   Pad(false);
+
+   unsigned char arrDigest[16];
+   for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 4; ++j) arrDigest[4 * i + j] = static_cast<unsigned char>(m_arrState[i] >> (8 * j));
+
+   return ToHex(arrDigest, sizeof(arrDigest));
+}
+
+std::string CFTPHash::FinalSha(bool bSha256) {
+   Pad(true);
+
+   const size_t uWords = bSha256 ? 8 : 5;
+   unsigned char arrDigest[32];
+   for (size_t i = 0; i < uWords; ++i)
+      for (int j = 0; j < 4; ++j) arrDigest[4 * i + j] = static_cast<unsigned char>(m_arrState[i] >> (24 - 8 * j));
+
+   return ToHex(arrDigest, 4 * uWords);
+}
+
+std::string CFTPHash::FinalXxh64() {
+   uint64_t h;
+   if (m_ullLength >= 32) {
+      const uint64_t *v = m_arrAccumulators;
+      h = RotL64(v[0], 1) + RotL64(v[1], 7) + RotL64(v[2], 12) + RotL64(v[3], 18);
+      for (int i = 0; i < 4; ++i) h = Xxh64Merge(h, v[i]);
+   } else
+      h = XXH_P5;
+
+   h += m_ullLength;
+
+   const unsigned char *p = m_arrBuffer;
+   size_t n               = m_uBuffered;
+   for (; n >= 8; p += 8, n -= 8) {
+      h ^= Xxh64Round(0, ReadLE64(p));
+      h = RotL64(h, 27) * XXH_P1 + XXH_P4;
+   }
+   if (n >= 4) {
+      h ^= static_cast<uint64_t>(ReadLE32(p)) * XXH_P1;
+      h = RotL64(h, 23) * XXH_P2 + XXH_P3;
+      p += 4;
+      n -= 4;
+   }
+   for (; n > 0; ++p, --n) {
+      h ^= (*p) * XXH_P5;
+      h = RotL64(h, 11) * XXH_P1;
+   }
+
+   h ^= h >> 33;
+   h *= XXH_P2;
+   h ^= h >> 29;
+   h *= XXH_P3;
+   h ^= h >> 32;
+
+   return ToHex(h, 8);
+}
+
+std::string CFTPHash::Compute(Algorithm eAlgorithm, const void *pData, size_t uSize) {
+   CFTPHash oHash(eAlgorithm);
+   oHash.Update(pData, uSize);
+   return oHash.Final();
+}
+
+/**
+ * @brief hashes a local file
+ *
+ * @param [in] eAlgorithm digest to compute
+ * @param [in] strLocalFile path of the file encoded in UTF-8 format.
+ * @param [out] strDigest lowercase hex digest
+ *
+ * @retval true   The file was successfully read.
+ * @retval false  The file couldn't be read.
+ */
+bool CFTPHash::ComputeFile(Algorithm eAlgorithm, const std::string &strLocalFile, std::string &strDigest) {
+   std::ifstream ifsInput(
+#ifdef LINUX
+       strLocalFile,
+#else
+       CFTPClient::Utf8ToUtf16(strLocalFile),
+#endif
+       std::ifstream::in | std::ifstream::binary);
+   if (!ifsInput) return false;
+
+   CFTPHash oHash(eAlgorithm);
+   std::vector<char> vecBuffer(64 * 1024);
+   while (ifsInput) {
+      ifsInput.read(vecBuffer.data(), vecBuffer.size());
+      oHash.Update(vecBuffer.data(), static_cast<size_t>(ifsInput.gcount()));
+   }
+   if (!ifsInput.eof()) return false;
+
+   strDigest = oHash.Final();
+   return true;
+}
+
+const char *CFTPHash::GetName(Algorithm eAlgorithm) {
+   switch (eAlgorithm) {
+      case Algorithm::CRC32C:
+         return "CRC32C";
+      case Algorithm::SHA1:
+         return "SHA-1";
+      case Algorithm::SHA256:
+         return "SHA-256";
+      case Algorithm::XXH64:
+         return "XXH64";
+      case Algorithm::CRC32:
+         return "CRC32";
+      case Algorithm::MD5:
+         return "MD5";
+      default:
+         return "NONE";
+   }
+}
+
+bool CFTPHash::IsCRC32CAccelerated() {
+#if defined(FTPHASH_CRC32C_SSE42) || defined(FTPHASH_CRC32C_ARMV8)
+   static const bool s_bAccelerated = DetectCrc32cHardware();
+   return s_bAccelerated;
+#else
+   return false;
+#endif
+}
+
+}  // namespace embeddedmz
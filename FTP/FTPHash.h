@@ -0,0 +1,66 @@
+/*
+ * @file FTPHash.h
+ * @brief incremental content digests computed while the data is transferred
+ */
+
+#ifndef INCLUDE_FTPHASH_H_
+#define INCLUDE_FTPHASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace embeddedmz {
+
+class CFTPHash {
+  public:
+   enum class Algorithm : unsigned char {
+      NONE,
+      CRC32C,  // Castagnoli, SSE 4.2 or ARMv8 CRC instructions when available
+      SHA1,
+      SHA256,
+      XXH64,  // xxHash64, seed 0
+      CRC32,  // ISO-HDLC (zlib, XCRC)
+      MD5
+   };
+
+   explicit CFTPHash(Algorithm eAlgorithm = Algorithm::NONE);
+
+   inline Algorithm GetAlgorithm() const { return m_eAlgorithm; }
+
+   void Reset();
+   void Reset(Algorithm eAlgorithm);
+   void Update(const void *pData, size_t uSize);
+   /* Returns the lowercase hex digest (empty with Algorithm::NONE), Reset() must be
+    * called before hashing other data. */
+   std::string Final();
+
+   // Helpers
+   static std::string Compute(Algorithm eAlgorithm, const void *pData, size_t uSize);
+   static bool ComputeFile(Algorithm eAlgorithm, const std::string &strLocalFile, std::string &strDigest);
+   static const char *GetName(Algorithm eAlgorithm);
+   static bool IsCRC32CAccelerated();
+
+  private:
+   void Sha1Block(const unsigned char *pBlock);
+   void Sha256Block(const unsigned char *pBlock);
+   void Md5Block(const unsigned char *pBlock);
+   void Xxh64Stripe(const unsigned char *pStripe);
+   void ProcessBlock(const unsigned char *pBlock);
+   void Pad(bool bBigEndianLength);
+   std::string FinalSha(bool bSha256);
+   std::string FinalMd5();
+   std::string FinalXxh64();
+
+   Algorithm m_eAlgorithm;
+   uint64_t m_ullLength;        // bytes hashed so far
+   uint32_t m_uCrc;             // CRC32C / CRC32
+   uint32_t m_arrState[8];      // SHA-1 (5 words) / SHA-256 / MD5 (4 words)
+   uint64_t m_arrAccumulators[4];  // XXH64
+   unsigned char m_arrBuffer[64];  // pending partial block
+   size_t m_uBuffered;
+};
+
+}  // namespace embeddedmz
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * @file FTPLogSink.cpp
+ * @brief implementation of the asynchronous log sink
+ */
+
+#include "FTPLogSink.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+
+namespace embeddedmz {
+
+namespace {
+
+// the sleeping consumer checks the queue at least at this interval (a wake up can be missed)
+const std::chrono::milliseconds IDLE_WAIT(50);
+
+}  // namespace
+
+CFTPLogSink::CFTPLogSink(OutputFn fnOutput, size_t uCapacity /* = 4096 */)
+    : m_fnOutput(std::move(fnOutput)),
+      m_uMask(0),
+      m_uEnqueue(0),
+      m_uDequeue(0),
+      m_uWritten(0),
+      m_ullDropped(0),
+      m_bStop(false),
+      m_bSleeping(false) {
+   size_t uSize = 2;
+   while (uSize < uCapacity) uSize <<= 1;
+   m_uMask = uSize - 1;
+
+   m_arrCells.reset(new Cell[uSize]);
+   for (size_t i = 0; i < uSize; ++i) m_arrCells[i].uSequence.store(i, std::memory_order_relaxed);
+
+   m_Thread = std::thread(&CFTPLogSink::Run, this);
+}
+
+CFTPLogSink::~CFTPLogSink() {
+   m_bStop = true;
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Wake.notify_one();
+   }
+   m_Thread.join();
+}
+
+/* D. Vyukov's bounded queue : a cell can be filled when its sequence equals the enqueue
+ * position and read when it equals the position + 1. */
+bool CFTPLogSink::Push(Message &&fnMessage) {
+   size_t uPosition = m_uEnqueue.load(std::memory_order_relaxed);
+   Cell *pCell      = nullptr;
+   for (;;) {
+      pCell                  = &m_arrCells[uPosition & m_uMask];
+      const size_t uSequence = pCell->uSequence.load(std::memory_order_acquire);
+      const intptr_t iDiff   = static_cast<intptr_t>(uSequence) - static_cast<intptr_t>(uPosition);
+      if (iDiff == 0) {
+         if (m_uEnqueue.compare_exchange_weak(uPosition, uPosition + 1, std::memory_order_relaxed)) break;
+      } else if (iDiff < 0) {
+         // full
+         m_ullDropped.fetch_add(1, std::memory_order_relaxed);
+         return false;
+      } else
+         uPosition = m_uEnqueue.load(std::memory_order_relaxed);
+   }
+
+   pCell->fnMessage = std::move(fnMessage);
+   pCell->uSequence.store(uPosition + 1, std::memory_order_release);
+
+   if (m_bSleeping.load(std::memory_order_relaxed)) m_Wake.notify_one();
+   return true;
+}
+
+bool CFTPLogSink::Pop(Message &fnMessage) {
+   Cell &oCell = m_arrCells[m_uDequeue & m_uMask];
+   if (oCell.uSequence.load(std::memory_order_acquire) != m_uDequeue + 1) return false;
+
+   fnMessage       = std::move(oCell.fnMessage);
+   oCell.fnMessage = nullptr;
+   oCell.uSequence.store(m_uDequeue + m_uMask + 1, std::memory_order_release);
+   ++m_uDequeue;
+   return true;
+}
+
+void CFTPLogSink::Run() {
+   Message fnMessage;
+   for (;;) {
+      while (Pop(fnMessage)) {
+         if (fnMessage) m_fnOutput(fnMessage());
+         m_uWritten.fetch_add(1, std::memory_order_release);
+      }
+      if (m_bStop) {
+         // a producer may have reserved a cell without filling it yet
+         if (m_uWritten.load(std::memory_order_relaxed) == m_uEnqueue.load(std::memory_order_acquire)) return;
+         std::this_thread::yield();
+         continue;
+      }
+
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_bSleeping = true;
+      m_Wake.wait_for(lock, IDLE_WAIT);
+      m_bSleeping = false;
+   }
+}
+
+void CFTPLogSink::Flush() {
+   const size_t uTarget = m_uEnqueue.load(std::memory_order_acquire);
+   while (m_uWritten.load(std::memory_order_acquire) < uTarget) {
+      m_Wake.notify_one();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   }
+}
+
+std::string CFTPLogSink::Format(const char *pszFormat, ...) {
+   va_list args;
+   va_start(args, pszFormat);
+   va_list argsCopy;
+   va_copy(argsCopy, args);
+   const int iLength = vsnprintf(nullptr, 0, pszFormat, args);
+   va_end(args);
+
+   std::string strMessage;
+   if (iLength > 0) {
+      strMessage.resize(static_cast<size_t>(iLength) + 1);
+      vsnprintf(&strMessage[0], strMessage.size(), pszFormat, argsCopy);
+      strMessage.resize(static_cast<size_t>(iLength));
+   }
+   va_end(argsCopy);
+   return strMessage;
+}
+
+}  // namespace embeddedmz
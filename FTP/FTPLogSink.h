@@ -0,0 +1,109 @@
+/*
+ * @file FTPLogSink.h
+ * @brief asynchronous logging : the messages are formatted and written by a background thread
+ */
+
+#ifndef INCLUDE_FTPLOGSINK_H_
+#define INCLUDE_FTPLOGSINK_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+namespace embeddedmz {
+
+/* Bounded multi-producer single-consumer queue of deferred messages : the clients (see
+ * CFTPClient::SetLogSink) only copy the format and its arguments, the formatting and the call
+ * to the output function are done by the sink's thread. Push() never waits : when the queue
+ * is full, the message is dropped and counted. A sink can be shared by many clients. */
+class CFTPLogSink {
+  public:
+   using OutputFn = std::function<void(const std::string &)>;
+   // returns the formatted message
+   using Message = std::function<std::string()>;
+
+   // uCapacity is rounded up to a power of two
+   explicit CFTPLogSink(OutputFn fnOutput, size_t uCapacity = 4096);
+   // the queued messages are written before the thread stops
+   ~CFTPLogSink();
+
+   CFTPLogSink(const CFTPLogSink &) = delete;
+   CFTPLogSink &operator=(const CFTPLogSink &) = delete;
+
+   bool Push(Message &&fnMessage);
+
+   /* pszFormat must be a string literal (it is kept), the C strings arguments are copied,
+    * the other ones must be printf compatible values. */
+   template <typename... Args>
+   bool Push(const char *pszFormat, const Args &...args) {
+      auto tArgs = std::make_tuple(Copy(args)...);
+      return Push(Message([pszFormat, tArgs]() { return Apply(pszFormat, tArgs, std::index_sequence_for<Args...>()); }));
+   }
+
+   // waits until the messages pushed before the call are written
+   void Flush();
+
+   inline uint64_t GetDropped() const { return m_ullDropped.load(std::memory_order_relaxed); }
+
+   // printf-like formatting in a std::string
+   static std::string Format(const char *pszFormat, ...);
+
+  private:
+   struct Cell {
+      Cell() : uSequence(0) {}
+
+      std::atomic<size_t> uSequence;
+      Message fnMessage;
+   };
+
+   template <typename T>
+   static const T &Copy(const T &value) {
+      return value;
+   }
+   static std::string Copy(const char *psz) { return (psz != nullptr) ? psz : "(null)"; }
+   static std::string Copy(char *psz) { return Copy(static_cast<const char *>(psz)); }
+   template <size_t N>
+   static std::string Copy(const char (&sz)[N]) {
+      return sz;
+   }
+
+   template <typename T>
+   static const T &Arg(const T &value) {
+      return value;
+   }
+   static const char *Arg(const std::string &str) { return str.c_str(); }
+
+   template <typename Tuple, size_t... I>
+   static std::string Apply(const char *pszFormat, const Tuple &tArgs, std::index_sequence<I...>) {
+      return Format(pszFormat, Arg(std::get<I>(tArgs))...);
+   }
+
+   bool Pop(Message &fnMessage);
+   void Run();
+
+   OutputFn m_fnOutput;
+   size_t m_uMask;
+   std::unique_ptr<Cell[]> m_arrCells;
+   std::atomic<size_t> m_uEnqueue;
+   size_t m_uDequeue;  // consumer only
+   std::atomic<size_t> m_uWritten;
+   std::atomic<uint64_t> m_ullDropped;
+
+   std::atomic<bool> m_bStop;
+   std::atomic<bool> m_bSleeping;
+   std::mutex m_Mutex;
+   std::condition_variable m_Wake;
+   std::thread m_Thread;
+};
+
+}  // namespace embeddedmz
+
+#endif
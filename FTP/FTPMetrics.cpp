@@ -0,0 +1,285 @@
+/**
+ * @file FTPMetrics.cpp
+ * @brief implementation of the process-wide metrics
+ */
+
+#include "FTPMetrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+namespace embeddedmz {
+
+constexpr size_t CFTPMetrics::OPERATIONS;
+constexpr size_t CFTPMetrics::MAX_HOSTS;
+constexpr unsigned CFTPMetrics::HISTOGRAM_SUB_BITS;
+constexpr unsigned CFTPMetrics::HISTOGRAM_MIN_EXP;
+constexpr unsigned CFTPMetrics::HISTOGRAM_MAX_EXP;
+constexpr size_t CFTPMetrics::HISTOGRAM_BUCKETS;
+
+namespace {
+
+const size_t OTHER_HOST = CFTPMetrics::MAX_HOSTS - 1;
+
+// microseconds to seconds without the trailing zeros, e.g. 1536 -> "0.001536"
+std::string FormatSeconds(uint64_t ullUs) {
+   char szBuffer[32];
+   snprintf(szBuffer, sizeof(szBuffer), "%llu.%06llu", static_cast<unsigned long long>(ullUs / 1000000),
+            static_cast<unsigned long long>(ullUs % 1000000));
+
+   std::string strSeconds(szBuffer);
+   strSeconds.erase(strSeconds.find_last_not_of('0') + 1);
+   if (strSeconds.back() == '.') strSeconds.pop_back();
+   return strSeconds;
+}
+
+std::string EscapeLabel(const std::string &strValue) {
+   std::string strEscaped;
+   strEscaped.reserve(strValue.size());
+   for (char c : strValue) {
+      if (c == '\\' || c == '"')
+         strEscaped += '\\';
+      else if (c == '\n') {
+         strEscaped += "\\n";
+         continue;
+      }
+      strEscaped += c;
+   }
+   return strEscaped;
+}
+
+}  // namespace
+
+CFTPMetrics::Shard::Shard() {
+   for (auto &pHost : arrHosts) pHost.store(nullptr, std::memory_order_relaxed);
+}
+
+CFTPMetrics::Shard::~Shard() {
+   for (auto &pHost : arrHosts) delete pHost.load(std::memory_order_relaxed);
+}
+
+CFTPMetrics &CFTPMetrics::GetInstance() {
+   static CFTPMetrics s_oInstance;
+   return s_oInstance;
+}
+
+size_t CFTPMetrics::GetHostIndex(const std::string &strHost) {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+
+   auto itHost = std::find(m_vecHosts.begin(), m_vecHosts.end(), strHost);
+   if (itHost != m_vecHosts.end()) return static_cast<size_t>(itHost - m_vecHosts.begin());
+   if (m_vecHosts.size() >= OTHER_HOST) return OTHER_HOST;
+
+   m_vecHosts.push_back(strHost);
+   return m_vecHosts.size() - 1;
+}
+
+void CFTPMetrics::Record(Operation eOperation, size_t uHost, const Sample &oSample) {
+   if (uHost >= MAX_HOSTS) uHost = OTHER_HOST;
+
+   Shard &oShard      = GetThreadShard();
+   HostCells *pCells = oShard.arrHosts[uHost].load(std::memory_order_relaxed);
+   if (pCells == nullptr) {
+      pCells = new HostCells();
+      // publishes the zeroed cells to the readers
+      oShard.arrHosts[uHost].store(pCells, std::memory_order_release);
+   }
+
+   Cell &oCell = pCells->arrCells[static_cast<size_t>(eOperation)];
+   oCell.oRequests.Add(1);
+   if (!oSample.bSucceeded) oCell.oFailures.Add(1);
+   oCell.oBytesUploaded.Add(oSample.ullBytesUploaded);
+   oCell.oBytesDownloaded.Add(oSample.ullBytesDownloaded);
+   Add(oCell.oDuration, oSample.ullDurationUs);
+   if (oSample.uNewConnections > 0) {
+      oCell.oConnections.Add(oSample.uNewConnections);
+      Add(oCell.oConnect, oSample.ullConnectUs);
+   }
+}
+
+CFTPMetrics::Counters CFTPMetrics::Get(Operation eOperation, const std::string &strHost) const {
+   Counters oCounters;
+   std::lock_guard<std::mutex> lock(m_Mutex);
+
+   size_t uHost = OTHER_HOST;
+   if (strHost != "other") {
+      auto itHost = std::find(m_vecHosts.begin(), m_vecHosts.end(), strHost);
+      if (itHost == m_vecHosts.end()) return oCounters;
+      uHost = static_cast<size_t>(itHost - m_vecHosts.begin());
+   }
+
+   Merge(uHost, eOperation, oCounters);
+   return oCounters;
+}
+
+std::string CFTPMetrics::ToPrometheus() const {
+   struct Series {
+      std::string strLabels;
+      Counters oCounters;
+   };
+   std::vector<Series> vecSeries;
+
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      for (size_t uHost = 0; uHost < MAX_HOSTS; ++uHost) {
+         if (uHost >= m_vecHosts.size() && uHost != OTHER_HOST) continue;
+         const std::string strHost = (uHost == OTHER_HOST) ? "other" : m_vecHosts[uHost];
+
+         for (size_t uOperation = 0; uOperation < OPERATIONS; ++uOperation) {
+            Series oSeries;
+            Merge(uHost, static_cast<Operation>(uOperation), oSeries.oCounters);
+            if (oSeries.oCounters.ullRequests == 0) continue;
+
+            oSeries.strLabels = std::string("operation=\"") + GetName(static_cast<Operation>(uOperation)) + "\",host=\"" +
+                                EscapeLabel(strHost) + "\"";
+            vecSeries.push_back(std::move(oSeries));
+         }
+      }
+   }
+
+   std::ostringstream ssOutput;
+
+   auto WriteCounter = [&](const char *pszName, const char *pszHelp, uint64_t Counters::*pValue) {
+      ssOutput << "# HELP " << pszName << ' ' << pszHelp << "\n# TYPE " << pszName << " counter\n";
+      for (const auto &oSeries : vecSeries) ssOutput << pszName << '{' << oSeries.strLabels << "} " << oSeries.oCounters.*pValue << '\n';
+   };
+   auto WriteHistogram = [&](const char *pszName, const char *pszHelp, Histogram Counters::*pHistogram) {
+      ssOutput << "# HELP " << pszName << ' ' << pszHelp << "\n# TYPE " << pszName << " histogram\n";
+      for (const auto &oSeries : vecSeries) {
+         const Histogram &oHistogram = oSeries.oCounters.*pHistogram;
+         uint64_t ullCumulated       = 0;
+         for (size_t i = 0; i + 1 < HISTOGRAM_BUCKETS; ++i) {
+            ullCumulated += oHistogram.vecBuckets[i];
+            ssOutput << pszName << "_bucket{" << oSeries.strLabels << ",le=\"" << FormatSeconds(GetBucketUpperBound(i)) << "\"} "
+                     << ullCumulated << '\n';
+         }
+         ssOutput << pszName << "_bucket{" << oSeries.strLabels << ",le=\"+Inf\"} " << oHistogram.ullCount << '\n';
+         ssOutput << pszName << "_sum{" << oSeries.strLabels << "} " << FormatSeconds(oHistogram.ullSumUs) << '\n';
+         ssOutput << pszName << "_count{" << oSeries.strLabels << "} " << oHistogram.ullCount << '\n';
+      }
+   };
+
+   WriteCounter("ftpclient_requests_total", "Requests performed.", &Counters::ullRequests);
+   WriteCounter("ftpclient_request_failures_total", "Requests which failed.", &Counters::ullFailures);
+   WriteCounter("ftpclient_uploaded_bytes_total", "Bytes uploaded.", &Counters::ullBytesUploaded);
+   WriteCounter("ftpclient_downloaded_bytes_total", "Bytes downloaded.", &Counters::ullBytesDownloaded);
+   WriteCounter("ftpclient_connections_total", "Connections opened.", &Counters::ullConnections);
+   WriteHistogram("ftpclient_request_duration_seconds", "Duration of the requests.", &Counters::oDuration);
+   WriteHistogram("ftpclient_connect_duration_seconds", "Connection time of the requests which opened one.", &Counters::oConnect);
+
+   return ssOutput.str();
+}
+
+const char *CFTPMetrics::GetName(Operation eOperation) {
+   switch (eOperation) {
+      case Operation::DOWNLOAD:
+         return "download";
+      case Operation::UPLOAD:
+         return "upload";
+      case Operation::LIST:
+         return "list";
+      case Operation::INFO:
+         return "info";
+      case Operation::MKDIR:
+         return "mkdir";
+      case Operation::REMOVE:
+         return "remove";
+      case Operation::COMMAND:
+         return "command";
+   }
+   return "";
+}
+
+size_t CFTPMetrics::GetBucketIndex(uint64_t ullUs) {
+   const size_t uSubBuckets = size_t(1) << HISTOGRAM_SUB_BITS;
+
+   // the upper bounds are inclusive ("le")
+   if (ullUs > 0) --ullUs;
+
+   // linear below 2^MIN_EXP
+   if (ullUs < (uint64_t(1) << HISTOGRAM_MIN_EXP)) return static_cast<size_t>(ullUs >> (HISTOGRAM_MIN_EXP - HISTOGRAM_SUB_BITS));
+
+   unsigned uExp = HISTOGRAM_MIN_EXP;
+   while (uExp < 63 && (ullUs >> (uExp + 1)) != 0) ++uExp;
+   if (uExp > HISTOGRAM_MAX_EXP) return HISTOGRAM_BUCKETS - 1;
+
+   // the SUB_BITS bits following the most significant one
+   const size_t uSub = static_cast<size_t>(ullUs >> (uExp - HISTOGRAM_SUB_BITS)) & (uSubBuckets - 1);
+   return uSubBuckets * (uExp - HISTOGRAM_MIN_EXP + 1) + uSub;
+}
+
+uint64_t CFTPMetrics::GetBucketUpperBound(size_t uIndex) {
+   const size_t uSubBuckets = size_t(1) << HISTOGRAM_SUB_BITS;
+   if (uIndex >= HISTOGRAM_BUCKETS - 1) return 0;
+
+   if (uIndex < uSubBuckets) return uint64_t(uIndex + 1) << (HISTOGRAM_MIN_EXP - HISTOGRAM_SUB_BITS);
+
+   const unsigned uExp = HISTOGRAM_MIN_EXP + static_cast<unsigned>(uIndex / uSubBuckets) - 1;
+   const uint64_t ullSub = uIndex % uSubBuckets;
+   return (uint64_t(1) << uExp) + ((ullSub + 1) << (uExp - HISTOGRAM_SUB_BITS));
+}
+
+CFTPMetrics::Shard &CFTPMetrics::GetThreadShard() {
+   // gives the shard back when the thread exits, the next thread created will reuse it
+   struct ThreadShard {
+      ThreadShard() : pShard(CFTPMetrics::GetInstance().AcquireShard()) {}
+      ~ThreadShard() { CFTPMetrics::GetInstance().ReleaseShard(pShard); }
+
+      Shard *pShard;
+   };
+   static thread_local ThreadShard s_oThreadShard;
+
+   return *s_oThreadShard.pShard;
+}
+
+CFTPMetrics::Shard *CFTPMetrics::AcquireShard() {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+
+   if (!m_vecFreeShards.empty()) {
+      Shard *pShard = m_vecFreeShards.back();
+      m_vecFreeShards.pop_back();
+      return pShard;
+   }
+
+   m_vecShards.emplace_back(new Shard());
+   return m_vecShards.back().get();
+}
+
+void CFTPMetrics::ReleaseShard(Shard *pShard) {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   m_vecFreeShards.push_back(pShard);
+}
+
+// m_Mutex must be locked
+void CFTPMetrics::Merge(size_t uHost, Operation eOperation, Counters &oCounters) const {
+   for (const auto &pShard : m_vecShards) {
+      const HostCells *pCells = pShard->arrHosts[uHost].load(std::memory_order_acquire);
+      if (pCells == nullptr) continue;
+
+      const Cell &oCell = pCells->arrCells[static_cast<size_t>(eOperation)];
+      oCounters.ullRequests += oCell.oRequests.Load();
+      oCounters.ullFailures += oCell.oFailures.Load();
+      oCounters.ullBytesUploaded += oCell.oBytesUploaded.Load();
+      oCounters.ullBytesDownloaded += oCell.oBytesDownloaded.Load();
+      oCounters.ullConnections += oCell.oConnections.Load();
+      Merge(oCell.oDuration, oCounters.oDuration);
+      Merge(oCell.oConnect, oCounters.oConnect);
+   }
+}
+
+void CFTPMetrics::Add(SharedHistogram &oHistogram, uint64_t ullUs) {
+   oHistogram.arrBuckets[GetBucketIndex(ullUs)].Add(1);
+   oHistogram.oSumUs.Add(ullUs);
+}
+
+void CFTPMetrics::Merge(const SharedHistogram &oHistogram, Histogram &oMerged) {
+   for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+      const uint64_t ullCount = oHistogram.arrBuckets[i].Load();
+      oMerged.vecBuckets[i] += ullCount;
+      oMerged.ullCount += ullCount;
+   }
+   oMerged.ullSumUs += oHistogram.oSumUs.Load();
+}
+
+}  // namespace embeddedmz
@@ -0,0 +1,162 @@
+/*
+ * @file FTPMetrics.h
+ * @brief process-wide counters and latency histograms of the requests performed by the clients
+ */
+
+#ifndef INCLUDE_FTPMETRICS_H_
+#define INCLUDE_FTPMETRICS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace embeddedmz {
+
+/* Every request performed by a CFTPClient is recorded here, per operation and per host.
+ * Each thread updates its own shard without any lock or atomic read-modify-write, the
+ * shards are merged when the metrics are read (Get, ToPrometheus). */
+class CFTPMetrics {
+  public:
+   enum class Operation : unsigned char {
+      DOWNLOAD,  // files, wildcards
+      UPLOAD,    // files, appends
+      LIST,      // List, Walk
+      INFO,      // Info, RemoteHash
+      MKDIR,
+      REMOVE,    // files and directories
+      COMMAND    // raw commands, FEAT, control connections...
+   };
+   static constexpr size_t OPERATIONS = 7;
+
+   // the hosts registered beyond this limit share the "other" label
+   static constexpr size_t MAX_HOSTS = 64;
+
+   /* Log-linear latency buckets (in microseconds) : 4 linear buckets below 2^10 us then 4
+    * buckets for each power of two up to 2^32 us (~72 minutes), the last one counts the
+    * longer requests. */
+   static constexpr unsigned HISTOGRAM_SUB_BITS = 2;
+   static constexpr unsigned HISTOGRAM_MIN_EXP  = 10;
+   static constexpr unsigned HISTOGRAM_MAX_EXP  = 31;
+   static constexpr size_t HISTOGRAM_BUCKETS =
+       (size_t(1) << HISTOGRAM_SUB_BITS) * (HISTOGRAM_MAX_EXP - HISTOGRAM_MIN_EXP + 2) + 1;
+
+   // a finished request
+   struct Sample {
+      Sample() : bSucceeded(false), ullDurationUs(0), ullConnectUs(0), ullBytesUploaded(0), ullBytesDownloaded(0), uNewConnections(0) {}
+
+      bool bSucceeded;
+      uint64_t ullDurationUs;
+      uint64_t ullConnectUs;  // only recorded if uNewConnections > 0
+      uint64_t ullBytesUploaded;
+      uint64_t ullBytesDownloaded;
+      unsigned uNewConnections;
+   };
+
+   struct Histogram {
+      Histogram() : vecBuckets(HISTOGRAM_BUCKETS, 0), ullCount(0), ullSumUs(0) {}
+
+      // not cumulative, see GetBucketUpperBound
+      std::vector<uint64_t> vecBuckets;
+      uint64_t ullCount;
+      uint64_t ullSumUs;
+   };
+
+   // merged values of an operation on a host
+   struct Counters {
+      Counters() : ullRequests(0), ullFailures(0), ullBytesUploaded(0), ullBytesDownloaded(0), ullConnections(0) {}
+
+      uint64_t ullRequests;
+      uint64_t ullFailures;
+      uint64_t ullBytesUploaded;
+      uint64_t ullBytesDownloaded;
+      uint64_t ullConnections;  // new connections opened by the requests
+      Histogram oDuration;
+      Histogram oConnect;  // TCP connection time of the requests which opened one
+   };
+
+   static CFTPMetrics &GetInstance();
+
+   CFTPMetrics(const CFTPMetrics &) = delete;
+   CFTPMetrics &operator=(const CFTPMetrics &) = delete;
+
+   /* Returns the index of a host label (e.g. "ftp.example.com:21"), it is registered the
+    * first time, clients call it once per session. */
+   size_t GetHostIndex(const std::string &strHost);
+   void Record(Operation eOperation, size_t uHost, const Sample &oSample);
+
+   Counters Get(Operation eOperation, const std::string &strHost) const;
+   // Prometheus text exposition format (version 0.0.4)
+   std::string ToPrometheus() const;
+
+   static const char *GetName(Operation eOperation);
+   // the first bucket whose upper bound is >= ullUs
+   static size_t GetBucketIndex(uint64_t ullUs);
+   // returns 0 for the last bucket (no upper bound)
+   static uint64_t GetBucketUpperBound(size_t uIndex);
+
+  private:
+   // written by a single thread, read by any
+   class Counter {
+     public:
+      Counter() : m_ullValue(0) {}
+
+      inline void Add(uint64_t ullValue) {
+         m_ullValue.store(m_ullValue.load(std::memory_order_relaxed) + ullValue, std::memory_order_relaxed);
+      }
+      inline uint64_t Load() const { return m_ullValue.load(std::memory_order_relaxed); }
+
+     private:
+      std::atomic<uint64_t> m_ullValue;
+   };
+
+   struct SharedHistogram {
+      Counter arrBuckets[HISTOGRAM_BUCKETS];
+      Counter oSumUs;
+   };
+
+   struct Cell {
+      Counter oRequests;
+      Counter oFailures;
+      Counter oBytesUploaded;
+      Counter oBytesDownloaded;
+      Counter oConnections;
+      SharedHistogram oDuration;
+      SharedHistogram oConnect;
+   };
+
+   struct HostCells {
+      Cell arrCells[OPERATIONS];
+   };
+
+   // a thread's metrics, the cells of a host are allocated by its first request
+   struct Shard {
+      Shard();
+      ~Shard();
+
+      std::atomic<HostCells *> arrHosts[MAX_HOSTS];
+   };
+
+   CFTPMetrics() = default;
+
+   Shard &GetThreadShard();
+   Shard *AcquireShard();
+   void ReleaseShard(Shard *pShard);
+
+   void Merge(size_t uHost, Operation eOperation, Counters &oCounters) const;
+
+   static void Add(SharedHistogram &oHistogram, uint64_t ullUs);
+   static void Merge(const SharedHistogram &oHistogram, Histogram &oMerged);
+
+   mutable std::mutex m_Mutex;
+   std::vector<std::unique_ptr<Shard>> m_vecShards;  // never freed, the exited threads' ones are reused
+   std::vector<Shard *> m_vecFreeShards;
+   std::vector<std::string> m_vecHosts;
+};
+
+}  // namespace embeddedmz
+
+#endif
@@ -0,0 +1,401 @@
+/**
+ * @file FTPMirror.cpp
+ * @brief implementation of the local/remote mirror engine
+ */
+
+#include "FTPMirror.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#ifdef LINUX
+#include <dirent.h>
+#include <unistd.h>  // rmdir
+#include <utime.h>
+#else
+#include <sys/utime.h>
+#endif
+
+#include "FTPSessionPool.h"
+
+namespace embeddedmz {
+
+namespace {
+
+// LIST mtimes have a one minute resolution
+const time_t MTIME_TOLERANCE = 60;
+
+bool IsLocalDir(const std::string &strPath) {
+#ifdef LINUX
+   struct stat info;
+   return stat(strPath.c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+#else
+   struct _stat64i32 info;
+   return _wstat64i32(CFTPClient::Utf8ToUtf16(strPath).c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+#endif
+}
+
+bool MakeLocalDir(const std::string &strPath) {
+#ifdef LINUX
+   return mkdir(strPath.c_str(), ACCESSPERMS) == 0 || errno == EEXIST;
+#else
+   return _wmkdir(CFTPClient::Utf8ToUtf16(strPath).c_str()) == 0 || errno == EEXIST;
+#endif
+}
+
+bool RemoveLocalDir(const std::string &strPath) {
+#ifdef LINUX
+   return rmdir(strPath.c_str()) == 0;
+#else
+   return _wrmdir(CFTPClient::Utf8ToUtf16(strPath).c_str()) == 0;
+#endif
+}
+
+bool RemoveLocalFile(const std::string &strPath) {
+#ifdef LINUX
+   return remove(strPath.c_str()) == 0;
+#else
+   return _wremove(CFTPClient::Utf8ToUtf16(strPath).c_str()) == 0;
+#endif
+}
+
+bool SetLocalMTime(const std::string &strPath, time_t tMTime) {
+#ifdef LINUX
+   struct utimbuf times;
+   times.actime  = tMTime;
+   times.modtime = tMTime;
+   return utime(strPath.c_str(), &times) == 0;
+#else
+   struct _utimbuf times;
+   times.actime  = tMTime;
+   times.modtime = tMTime;
+   return _wutime(CFTPClient::Utf8ToUtf16(strPath).c_str(), &times) == 0;
+#endif
+}
+
+#ifndef LINUX
+std::string Utf16ToUtf8(const std::wstring &wstr) {
+   std::string ret;
+   int len = WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), wstr.length(), nullptr, 0, nullptr, nullptr);
+   if (len > 0) {
+      ret.resize(len);
+      WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), wstr.length(), &ret[0], len, nullptr, nullptr);
+   }
+   return ret;
+}
+#endif
+
+bool WalkLocalDir(const std::string &strRoot, const std::string &strPrefix, std::vector<CFTPClient::RemoteEntry> &vecEntries) {
+#ifdef LINUX
+   const std::string strDir = strRoot + "/" + strPrefix;
+   DIR *pDir                = opendir(strDir.c_str());
+   if (pDir == nullptr) return false;
+
+   std::vector<std::string> vecSubDirs;
+   bool bRet = true;
+   while (struct dirent *pEntry = readdir(pDir)) {
+      const std::string strName = pEntry->d_name;
+      if (strName == "." || strName == "..") continue;
+
+      struct stat info;
+      if (stat((strDir + strName).c_str(), &info) != 0) {
+         bRet = false;
+         continue;
+      }
+
+      CFTPClient::RemoteEntry oEntry;
+      oEntry.strPath      = strPrefix + strName;
+      oEntry.tMTime       = info.st_mtime;
+      oEntry.uPermissions = info.st_mode & 0777;
+      if (S_ISDIR(info.st_mode)) {
+         oEntry.eFileType = CURLFILETYPE_DIRECTORY;
+         vecSubDirs.push_back(oEntry.strPath + "/");
+      } else if (S_ISREG(info.st_mode)) {
+         oEntry.eFileType = CURLFILETYPE_FILE;
+         oEntry.llSize    = static_cast<curl_off_t>(info.st_size);
+      }
+      vecEntries.push_back(std::move(oEntry));
+   }
+   closedir(pDir);
+#else
+   std::string strDir = strRoot + "\\" + strPrefix;
+   std::replace(strDir.begin(), strDir.end(), '/', '\\');
+
+   WIN32_FIND_DATAW findData;
+   HANDLE hFind = FindFirstFileW(CFTPClient::Utf8ToUtf16(strDir + "*").c_str(), &findData);
+   if (hFind == INVALID_HANDLE_VALUE) return false;
+
+   std::vector<std::string> vecSubDirs;
+   bool bRet = true;
+   do {
+      const std::string strName = Utf16ToUtf8(findData.cFileName);
+      if (strName == "." || strName == "..") continue;
+
+      // FILETIME is in 100ns units since 1601-01-01
+      const unsigned long long ullTime =
+          (static_cast<unsigned long long>(findData.ftLastWriteTime.dwHighDateTime) << 32) | findData.ftLastWriteTime.dwLowDateTime;
+
+      CFTPClient::RemoteEntry oEntry;
+      oEntry.strPath = strPrefix + strName;
+      oEntry.tMTime  = static_cast<time_t>((ullTime - 116444736000000000ULL) / 10000000ULL);
+      if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+         oEntry.eFileType = CURLFILETYPE_DIRECTORY;
+         vecSubDirs.push_back(oEntry.strPath + "/");
+      } else {
+         oEntry.eFileType = CURLFILETYPE_FILE;
+         oEntry.llSize    = static_cast<curl_off_t>((static_cast<unsigned long long>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow);
+      }
+      vecEntries.push_back(std::move(oEntry));
+   } while (FindNextFileW(hFind, &findData));
+   FindClose(hFind);
+#endif
+
+   for (const auto &strSubDir : vecSubDirs) {
+      if (!WalkLocalDir(strRoot, strSubDir, vecEntries)) bRet = false;
+   }
+
+   return bRet;
+}
+
+bool ByPath(const CFTPClient::RemoteEntry &a, const CFTPClient::RemoteEntry &b) { return a.strPath < b.strPath; }
+
+size_t Depth(const std::string &strPath) { return std::count(strPath.begin(), strPath.end(), '/'); }
+
+}  // namespace
+
+CFTPMirror::CFTPMirror(const CFTPClient &oClient, const std::string &strLocalDir, const std::string &strRemoteDir,
+                       Direction eDirection /* = Direction::DOWNLOAD */)
+    : m_oClient(oClient),
+      m_strLocalDir(strLocalDir),
+      m_strRemoteDir(strRemoteDir),
+      m_eDirection(eDirection),
+      m_eCompareMode(CompareMode::SIZE_AND_MTIME),
+      m_bDeleteExtraneous(false),
+      m_uSessions(4) {
+   while (m_strLocalDir.size() > 1 && (m_strLocalDir.back() == '/' || m_strLocalDir.back() == '\\')) m_strLocalDir.pop_back();
+   while (m_strRemoteDir.size() > 1 && m_strRemoteDir.back() == '/') m_strRemoteDir.pop_back();
+}
+
+/**
+ * @brief lists a local directory recursively
+ *
+ * @param [in] strLocalDir directory to walk encoded in UTF-8 format.
+ * @param [out] vecEntries files and directories found, paths are relative to
+ * strLocalDir and '/' separated.
+ *
+ * @retval true   Successfully walked the directory.
+ * @retval false  The directory (or one of its entries) couldn't be read.
+ */
+bool CFTPMirror::WalkLocal(const std::string &strLocalDir, std::vector<CFTPClient::RemoteEntry> &vecEntries) {
+   vecEntries.clear();
+   return WalkLocalDir(strLocalDir, std::string(), vecEntries);
+}
+
+std::string CFTPMirror::LocalPath(const std::string &strRelativePath) const {
+#ifdef LINUX
+   return m_strLocalDir + "/" + strRelativePath;
+#else
+   std::string strPath = m_strLocalDir + "\\" + strRelativePath;
+   std::replace(strPath.begin(), strPath.end(), '/', '\\');
+   return strPath;
+#endif
+}
+
+std::string CFTPMirror::RemotePath(const std::string &strRelativePath) const {
+   return (m_strRemoteDir == "/") ? "/" + strRelativePath : m_strRemoteDir + "/" + strRelativePath;
+}
+
+bool CFTPMirror::IsOutdated(const CFTPClient::RemoteEntry &oSource, const CFTPClient::RemoteEntry &oDestination) const {
+   if (oSource.llSize != oDestination.llSize) return true;
+   if (m_eCompareMode == CompareMode::SIZE) return false;
+
+   if (m_eCompareMode == CompareMode::SIZE_AND_HASH) {
+      const CFTPHash::Algorithm eAlgorithm = m_oClient.GetRemoteHashAlgorithm();
+      if (eAlgorithm != CFTPHash::Algorithm::NONE) {
+         const std::string &strPath = oSource.strPath;
+         std::string strLocalHash, strRemoteHash;
+         if (!CFTPHash::ComputeFile(eAlgorithm, LocalPath(strPath), strLocalHash) ||
+             !m_oClient.RemoteHash(RemotePath(strPath), eAlgorithm, strRemoteHash))
+            return true;
+
+         return strLocalHash != strRemoteHash;
+      }
+   }
+
+   if (m_eDirection == Direction::DOWNLOAD)
+      // the local copies get the remote mtime once downloaded (see Execute)
+      return oSource.tMTime > oDestination.tMTime;
+
+   // a remote copy's mtime is the time of its upload
+   return oSource.tMTime > oDestination.tMTime + MTIME_TOLERANCE;
+}
+
+/**
+ * @brief compares the local and the remote trees
+ *
+ * @param [out] oPlan actions to be performed on the destination tree
+ *
+ * @retval true   Successfully computed the plan.
+ * @retval false  One of the trees couldn't be walked.
+ *
+ * Example Usage:
+ * @code
+ *    CFTPMirror oMirror(*m_pFTPClient, "/home/amine/pictures", "/pictures", CFTPMirror::Direction::DOWNLOAD);
+ *    CFTPMirror::Plan oPlan;
+ *    if (oMirror.ComputePlan(oPlan) && !oPlan.Empty()) oMirror.Execute(oPlan);
+ * @endcode
+ */
+bool CFTPMirror::ComputePlan(Plan &oPlan) const {
+   oPlan.vecActions.clear();
+   oPlan.llBytesToTransfer = 0;
+
+   if (m_eDirection == Direction::DOWNLOAD && !IsLocalDir(m_strLocalDir) && !MakeLocalDir(m_strLocalDir)) return false;
+
+   std::vector<CFTPClient::RemoteEntry> vecLocal, vecRemote;
+   if (!WalkLocal(m_strLocalDir, vecLocal)) return false;
+
+   if (!m_oClient.Walk(m_strRemoteDir, vecRemote)) {
+      // the remote destination may not exist yet
+      if (m_eDirection != Direction::UPLOAD || !m_oClient.CreateDir(m_strRemoteDir) || !m_oClient.Walk(m_strRemoteDir, vecRemote))
+         return false;
+   }
+
+   std::vector<CFTPClient::RemoteEntry> &vecSource      = (m_eDirection == Direction::UPLOAD) ? vecLocal : vecRemote;
+   std::vector<CFTPClient::RemoteEntry> &vecDestination = (m_eDirection == Direction::UPLOAD) ? vecRemote : vecLocal;
+   std::sort(vecSource.begin(), vecSource.end(), ByPath);
+   std::sort(vecDestination.begin(), vecDestination.end(), ByPath);
+
+   std::vector<Action> vecRemovals;
+   auto AddSource = [&](const CFTPClient::RemoteEntry &oSource, const CFTPClient::RemoteEntry *pDestination) {
+      if (oSource.eFileType == CURLFILETYPE_DIRECTORY) {
+         if (pDestination == nullptr) oPlan.vecActions.emplace_back(Action::CREATE_DIR, oSource.strPath, 0);
+      } else if (oSource.eFileType == CURLFILETYPE_FILE) {
+         if (pDestination == nullptr || IsOutdated(oSource, *pDestination)) {
+            oPlan.vecActions.emplace_back(Action::TRANSFER, oSource.strPath, oSource.llSize);
+            oPlan.vecActions.back().tMTime = oSource.tMTime;
+            oPlan.llBytesToTransfer += oSource.llSize;
+         }
+      }
+   };
+   auto AddExtraneous = [&](const CFTPClient::RemoteEntry &oDestination) {
+      if (!m_bDeleteExtraneous) return;
+      vecRemovals.emplace_back((oDestination.eFileType == CURLFILETYPE_DIRECTORY) ? Action::REMOVE_DIR : Action::REMOVE_FILE,
+                               oDestination.strPath, 0);
+   };
+
+   size_t i = 0, j = 0;
+   while (i < vecSource.size() && j < vecDestination.size()) {
+      if (vecSource[i].strPath < vecDestination[j].strPath) {
+         AddSource(vecSource[i++], nullptr);
+      } else if (vecDestination[j].strPath < vecSource[i].strPath) {
+         AddExtraneous(vecDestination[j++]);
+      } else {
+         AddSource(vecSource[i++], &vecDestination[j++]);
+      }
+   }
+   for (; i < vecSource.size(); ++i) AddSource(vecSource[i], nullptr);
+   for (; j < vecDestination.size(); ++j) AddExtraneous(vecDestination[j]);
+
+   // directories must be removed after their content, deepest first
+   std::stable_sort(vecRemovals.begin(), vecRemovals.end(), [](const Action &a, const Action &b) {
+      if (a.eType != b.eType) return a.eType == Action::REMOVE_FILE;
+      return Depth(a.strPath) > Depth(b.strPath);
+   });
+   oPlan.vecActions.insert(oPlan.vecActions.end(), vecRemovals.begin(), vecRemovals.end());
+
+   return true;
+}
+
+/**
+ * @brief performs the actions of a plan computed by ComputePlan()
+ *
+ * @param [in, out] oPlan the plan, each action's bSucceeded is updated
+ *
+ * @retval true   All the actions succeeded.
+ * @retval false  Some actions failed (check bSucceeded and the log messages).
+ */
+bool CFTPMirror::Execute(Plan &oPlan) const {
+   std::vector<Action *> vecCreateDirs, vecTransfers, vecRemoveFiles, vecRemoveDirs;
+   for (auto &oAction : oPlan.vecActions) {
+      oAction.bSucceeded = false;
+      switch (oAction.eType) {
+         case Action::CREATE_DIR:
+            vecCreateDirs.push_back(&oAction);
+            break;
+         case Action::TRANSFER:
+            vecTransfers.push_back(&oAction);
+            break;
+         case Action::REMOVE_FILE:
+            vecRemoveFiles.push_back(&oAction);
+            break;
+         case Action::REMOVE_DIR:
+            vecRemoveDirs.push_back(&oAction);
+            break;
+      }
+   }
+
+   const bool bUpload = (m_eDirection == Direction::UPLOAD);
+   size_t uFailures   = 0;
+   m_oProgress.Start(oPlan.vecActions.size(), static_cast<uint64_t>(std::max<curl_off_t>(oPlan.llBytesToTransfer, 0)));
+
+   // parents are sorted before their children
+   for (Action *pAction : vecCreateDirs) {
+      pAction->bSucceeded = bUpload ? m_oClient.CreateDir(RemotePath(pAction->strPath)) : MakeLocalDir(LocalPath(pAction->strPath));
+      if (!pAction->bSucceeded) ++uFailures;
+      m_oProgress.TaskDone(pAction->bSucceeded);
+   }
+
+   CFTPSessionPool oPool(m_oClient, m_uSessions);
+
+   uFailures += oPool.Run(vecTransfers.size(), [&](CFTPClient &oSession, size_t uIndex) {
+      Action &oAction = *vecTransfers[uIndex];
+      if (bUpload) {
+         oAction.bSucceeded = oSession.UploadFile(LocalPath(oAction.strPath), RemotePath(oAction.strPath), true);
+      } else {
+         const std::string strLocalFile = LocalPath(oAction.strPath);
+         oAction.bSucceeded             = oSession.DownloadFile(strLocalFile, RemotePath(oAction.strPath));
+         // the mtime is used to detect remote modifications next time
+         if (oAction.bSucceeded && oAction.tMTime > 0) SetLocalMTime(strLocalFile, oAction.tMTime);
+      }
+      return oAction.bSucceeded;
+   }, &m_oProgress);
+
+   uFailures += oPool.Run(vecRemoveFiles.size(), [&](CFTPClient &oSession, size_t uIndex) {
+      Action &oAction    = *vecRemoveFiles[uIndex];
+      oAction.bSucceeded = bUpload ? oSession.RemoveFile(RemotePath(oAction.strPath)) : RemoveLocalFile(LocalPath(oAction.strPath));
+      return oAction.bSucceeded;
+   }, &m_oProgress);
+
+   // deepest first
+   for (Action *pAction : vecRemoveDirs) {
+      pAction->bSucceeded = bUpload ? m_oClient.RemoveDir(RemotePath(pAction->strPath)) : RemoveLocalDir(LocalPath(pAction->strPath));
+      if (!pAction->bSucceeded) ++uFailures;
+      m_oProgress.TaskDone(pAction->bSucceeded);
+   }
+
+   m_oProgress.Finish(uFailures == 0);
+   return uFailures == 0;
+}
+
+/**
+ * @brief synchronizes the destination tree with the source tree
+ *
+ * @retval true   The trees are synchronized.
+ * @retval false  The plan couldn't be computed or some actions failed.
+ *
+ * Example Usage:
+ * @code
+ *    CFTPMirror oMirror(*m_pFTPClient, "C:\\backup", "/backup", CFTPMirror::Direction::UPLOAD);
+ *    oMirror.SetDeleteExtraneous(true);
+ *    oMirror.SetSessions(8);
+ *    oMirror.Run();
+ * @endcode
+ */
+bool CFTPMirror::Run() const {
+   Plan oPlan;
+   if (!ComputePlan(oPlan)) return false;
+
+   return Execute(oPlan);
+}
+
+}  // namespace embeddedmz
@@ -0,0 +1,102 @@
+/*
+ * @file FTPMirror.h
+ * @brief incremental synchronization of a local tree with a remote one
+ */
+
+#ifndef INCLUDE_FTPMIRROR_H_
+#define INCLUDE_FTPMIRROR_H_
+
+#include <string>
+#include <vector>
+
+#include "FTPClient.h"
+
+namespace embeddedmz {
+
+class CFTPMirror {
+  public:
+   enum class Direction : unsigned char {
+      UPLOAD,   // the remote tree becomes a copy of the local one
+      DOWNLOAD  // the local tree becomes a copy of the remote one
+   };
+
+   enum class CompareMode : unsigned char {
+      SIZE,            // only the sizes are compared
+      SIZE_AND_MTIME,  // a file is also transferred if the source is more recent than the destination
+      SIZE_AND_HASH    // files having the same size are compared with their checksums (see CFTPClient::RemoteHash),
+                       // falls back to SIZE_AND_MTIME if the server can't compute them
+   };
+
+   struct Action {
+      enum Type : unsigned char { CREATE_DIR, TRANSFER, REMOVE_FILE, REMOVE_DIR };
+
+      Action(Type type, const std::string &path, curl_off_t size)
+          : eType(type), strPath(path), llSize(size), tMTime(0), bSucceeded(false) {}
+      Type eType;
+      std::string strPath;  // relative to the mirrored folders, '/' separated
+      curl_off_t llSize;    // source size for transfers
+      time_t tMTime;        // source mtime for transfers
+      bool bSucceeded;      // updated by Execute()
+   };
+
+   // actions to perform on the destination tree
+   struct Plan {
+      std::vector<Action> vecActions;
+      curl_off_t llBytesToTransfer = 0;
+
+      inline bool Empty() const { return vecActions.empty(); }
+   };
+
+   /* oClient walks the remote tree and creates/removes the directories, the transfers use
+    * sessions cloned from it (see CFTPClient::CloneSession). Its session must be initialized. */
+   CFTPMirror(const CFTPClient &oClient, const std::string &strLocalDir, const std::string &strRemoteDir,
+              Direction eDirection = Direction::DOWNLOAD);
+
+   CFTPMirror(const CFTPMirror &) = delete;
+   CFTPMirror &operator=(const CFTPMirror &) = delete;
+
+   // Setters - Getters
+   inline void SetDirection(const Direction &eDirection) { m_eDirection = eDirection; }
+   inline void SetCompareMode(const CompareMode &eMode) { m_eCompareMode = eMode; }
+   // removes the destination entries that don't exist in the source tree
+   inline void SetDeleteExtraneous(const bool &bDelete) { m_bDeleteExtraneous = bDelete; }
+   inline void SetSessions(const unsigned &uSessions) { m_uSessions = (uSessions > 0) ? uSessions : 1; }
+   inline Direction GetDirection() const { return m_eDirection; }
+   inline CompareMode GetCompareMode() const { return m_eCompareMode; }
+   inline bool GetDeleteExtraneous() const { return m_bDeleteExtraneous; }
+   inline unsigned GetSessions() const { return m_uSessions; }
+   // progress of the current (or last) Execute(), can be polled by any thread
+   inline CFTPJobProgress::Values GetProgress() const { return m_oProgress.Load(); }
+
+   /* Walks both trees and computes the minimal set of actions. */
+   bool ComputePlan(Plan &oPlan) const;
+
+   /* Performs the actions of a plan : directories are created first, files are then transferred
+    * and deleted in parallel over GetSessions() sessions, extraneous directories are removed
+    * last, deepest first. Returns true if every action succeeded. */
+   bool Execute(Plan &oPlan) const;
+
+   // ComputePlan() + Execute()
+   bool Run() const;
+
+   // local tree helper (files and directories, paths relative to strLocalDir)
+   static bool WalkLocal(const std::string &strLocalDir, std::vector<CFTPClient::RemoteEntry> &vecEntries);
+
+  private:
+   std::string LocalPath(const std::string &strRelativePath) const;
+   std::string RemotePath(const std::string &strRelativePath) const;
+   bool IsOutdated(const CFTPClient::RemoteEntry &oSource, const CFTPClient::RemoteEntry &oDestination) const;
+
+   const CFTPClient &m_oClient;
+   std::string m_strLocalDir;
+   std::string m_strRemoteDir;
+   Direction m_eDirection;
+   CompareMode m_eCompareMode;
+   bool m_bDeleteExtraneous;
+   unsigned m_uSessions;
+   mutable CFTPJobProgress m_oProgress;
+};
+
+}  // namespace embeddedmz
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * @file FTPPipeline.cpp
+ * @brief implementation of the transform pipeline, its stages and sinks
+ */
+
+#include "FTPPipeline.h"
+
+#include <cstring>
+
+namespace embeddedmz {
+
+// CFTPPipeline
+
+CFTPStage &CFTPPipeline::Add(std::unique_ptr<CFTPStage> pStage) {
+   pStage->SetNext(&m_oSink);
+   if (!m_vecStages.empty()) m_vecStages.back()->SetNext(pStage.get());
+
+   m_vecStages.push_back(std::move(pStage));
+   return *m_vecStages.back();
+}
+
+bool CFTPPipeline::Write(const char *pData, size_t uSize) {
+   return m_vecStages.empty() ? m_oSink.Write(pData, uSize) : m_vecStages.front()->Write(pData, uSize);
+}
+
+bool CFTPPipeline::Finish() { return m_vecStages.empty() ? m_oSink.Finish() : m_vecStages.front()->Finish(); }
+
+/**
+ * @brief gives the data received by libcurl to a sink (usually a pipeline)
+ *
+ * @param ptr pointer of max size (size*nmemb) to read data from it
+ * @param size size parameter
+ * @param nmemb memblock parameter
+ * @param data pointer to a CFTPSink
+ *
+ * @return (size * nmemb) or 0 to abort the transfer
+ */
+size_t CFTPPipeline::WriteCallback(void *ptr, size_t size, size_t nmemb, void *data) {
+   if ((size == 0) || (nmemb == 0) || (data == nullptr)) return 0;
+
+   auto *pSink = reinterpret_cast<CFTPSink *>(data);
+   return pSink->Write(reinterpret_cast<const char *>(ptr), size * nmemb) ? size * nmemb : 0;
+}
+
+// Sinks
+
+bool CFTPStreamSink::Write(const char *pData, size_t uSize) {
+   m_oStream.write(pData, static_cast<std::streamsize>(uSize));
+   return !m_oStream.fail();
+}
+
+bool CFTPStreamSink::Finish() {
+   m_oStream.flush();
+   return !m_oStream.fail();
+}
+
+bool CFTPMemorySink::Write(const char *pData, size_t uSize) {
+   m_vecData.insert(m_vecData.end(), pData, pData + uSize);
+   return true;
+}
+
+bool CFTPStringSink::Write(const char *pData, size_t uSize) {
+   m_strData.append(pData, uSize);
+   return true;
+}
+
+// Stages
+
+bool CFTPInflateStage::Write(const char *pData, size_t uSize) {
+   return m_oZStream.Process(pData, uSize, false, [this](const char *pChunk, size_t uChunk) { return Forward(pChunk, uChunk); });
+}
+
+bool CFTPInflateStage::Finish() { return m_oZStream.IsValid() && m_oZStream.IsFinished() && CFTPStage::Finish(); }
+
+bool CFTPHashStage::Write(const char *pData, size_t uSize) {
+   m_oHash.Update(pData, uSize);
+   return Forward(pData, uSize);
+}
+
+bool CFTPLineEndingStage::Write(const char *pData, size_t uSize) {
+   m_strBuffer.clear();
+   m_strBuffer.reserve(uSize + ((m_eMode == Mode::TO_CRLF) ? uSize / 8 : 1));
+
+   if (m_eMode == Mode::TO_LF) {
+      // a '\r' is only dropped when followed by '\n', even across buffers
+      if (m_bPendingCR && uSize > 0 && pData[0] != '\n') m_strBuffer += '\r';
+      m_bPendingCR = false;
+
+      const char *pEnd = pData + uSize;
+      for (const char *p = pData; p < pEnd;) {
+         const char *pCR = static_cast<const char *>(memchr(p, '\r', static_cast<size_t>(pEnd - p)));
+         if (pCR == nullptr) {
+            m_strBuffer.append(p, pEnd);
+            break;
+         }
+         m_strBuffer.append(p, pCR);
+         if (pCR + 1 == pEnd)
+            m_bPendingCR = true;
+         else if (pCR[1] != '\n')
+            m_strBuffer += '\r';
+         p = pCR + 1;
+      }
+   } else {
+      for (size_t i = 0; i < uSize; ++i) {
+         if (pData[i] == '\n' && !m_bLastWasCR) m_strBuffer += '\r';
+         m_strBuffer += pData[i];
+         m_bLastWasCR = (pData[i] == '\r');
+      }
+   }
+
+   return Forward(m_strBuffer.data(), m_strBuffer.size());
+}
+
+bool CFTPLineEndingStage::Finish() {
+   if (m_bPendingCR) {
+      m_bPendingCR = false;
+      if (!Forward("\r", 1)) return false;
+   }
+   return CFTPStage::Finish();
+}
+
+bool CFTPTeeStage::Write(const char *pData, size_t uSize) { return m_oBranch.Write(pData, uSize) && Forward(pData, uSize); }
+
+bool CFTPTeeStage::Finish() { return m_oBranch.Finish() && CFTPStage::Finish(); }
+
+}  // namespace embeddedmz
@@ -0,0 +1,182 @@
+/*
+ * @file FTPPipeline.h
+ * @brief chain of transforms between libcurl's write callback and the final destination
+ */
+
+#ifndef INCLUDE_FTPPIPELINE_H_
+#define INCLUDE_FTPPIPELINE_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FTPHash.h"
+#include "FTPZStream.h"
+
+namespace embeddedmz {
+
+// End of a chain : receives the downloaded bytes.
+class CFTPSink {
+  public:
+   virtual ~CFTPSink() {}
+
+   // pData is only valid during the call, returns false to abort the transfer
+   virtual bool Write(const char *pData, size_t uSize) = 0;
+   // called once all the data was written, returns false if it is incomplete
+   virtual bool Finish() { return true; }
+};
+
+// Transforms the data and forwards it to the next element of the chain.
+class CFTPStage : public CFTPSink {
+  public:
+   CFTPStage() : m_pNext(nullptr) {}
+
+   inline void SetNext(CFTPSink *pNext) { m_pNext = pNext; }
+   inline CFTPSink *GetNext() const { return m_pNext; }
+
+   bool Finish() override { return m_pNext == nullptr || m_pNext->Finish(); }
+
+  protected:
+   inline bool Forward(const char *pData, size_t uSize) { return uSize == 0 || m_pNext == nullptr || m_pNext->Write(pData, uSize); }
+
+   CFTPSink *m_pNext;
+};
+
+/* Stages added in order, in front of a sink (not owned), e.g. :
+ *    CFTPStreamSink oFile(ofsOutput);
+ *    CFTPPipeline oPipeline(oFile);
+ *    oPipeline.Emplace<CFTPLineEndingStage>(CFTPLineEndingStage::Mode::TO_LF);
+ *    oPipeline.Emplace<CFTPHashStage>(oHash);
+ * Stages that don't modify the data (hash, tee) forward the buffers they receive, without copy.
+ * A pipeline is a sink too, so it can be nested (e.g. behind a MODE Z inflate stage). */
+class CFTPPipeline : public CFTPSink {
+  public:
+   explicit CFTPPipeline(CFTPSink &oSink) : m_oSink(oSink) {}
+
+   CFTPPipeline(const CFTPPipeline &) = delete;
+   CFTPPipeline &operator=(const CFTPPipeline &) = delete;
+
+   // appends a stage behind the previous ones
+   CFTPStage &Add(std::unique_ptr<CFTPStage> pStage);
+
+   template <class Stage, class... Args>
+   Stage &Emplace(Args &&...args) {
+      return static_cast<Stage &>(Add(std::unique_ptr<CFTPStage>(new Stage(std::forward<Args>(args)...))));
+   }
+
+   inline bool Empty() const { return m_vecStages.empty(); }
+
+   bool Write(const char *pData, size_t uSize) override;
+   bool Finish() override;
+
+   // CURLOPT_WRITEFUNCTION, CURLOPT_WRITEDATA must be a CFTPSink*
+   static size_t WriteCallback(void *ptr, size_t size, size_t nmemb, void *data);
+
+  private:
+   CFTPSink &m_oSink;
+   std::vector<std::unique_ptr<CFTPStage>> m_vecStages;
+};
+
+// Sinks
+
+class CFTPStreamSink : public CFTPSink {
+  public:
+   explicit CFTPStreamSink(std::ostream &oStream) : m_oStream(oStream) {}
+   bool Write(const char *pData, size_t uSize) override;
+   bool Finish() override;
+
+  private:
+   std::ostream &m_oStream;
+};
+
+class CFTPMemorySink : public CFTPSink {
+  public:
+   explicit CFTPMemorySink(std::vector<char> &vecData) : m_vecData(vecData) {}
+   bool Write(const char *pData, size_t uSize) override;
+
+  private:
+   std::vector<char> &m_vecData;
+};
+
+class CFTPStringSink : public CFTPSink {
+  public:
+   explicit CFTPStringSink(std::string &strData) : m_strData(strData) {}
+   bool Write(const char *pData, size_t uSize) override;
+
+  private:
+   std::string &m_strData;
+};
+
+class CFTPFunctionSink : public CFTPSink {
+  public:
+   using WriteFn = std::function<bool(const char *, size_t)>;
+
+   explicit CFTPFunctionSink(const WriteFn &fnWrite) : m_fnWrite(fnWrite) {}
+   bool Write(const char *pData, size_t uSize) override { return m_fnWrite(pData, uSize); }
+
+  private:
+   WriteFn m_fnWrite;
+};
+
+// Stages
+
+// MODE Z data (or any zlib stream), Finish() fails if the stream is truncated
+class CFTPInflateStage : public CFTPStage {
+  public:
+   CFTPInflateStage() : m_oZStream(CFTPZStream::Mode::INFLATE) {}
+   bool Write(const char *pData, size_t uSize) override;
+   bool Finish() override;
+
+   inline const CFTPZStream &GetZStream() const { return m_oZStream; }
+
+  private:
+   CFTPZStream m_oZStream;
+};
+
+// updates a digest with the data going through it (see TransferOptions)
+class CFTPHashStage : public CFTPStage {
+  public:
+   explicit CFTPHashStage(CFTPHash &oHash) : m_oHash(oHash) {}
+   bool Write(const char *pData, size_t uSize) override;
+
+  private:
+   CFTPHash &m_oHash;
+};
+
+// e.g. text files downloaded from a Windows server
+class CFTPLineEndingStage : public CFTPStage {
+  public:
+   enum class Mode : unsigned char {
+      TO_LF,   // CRLF -> LF
+      TO_CRLF  // LF -> CRLF (existing CRLF are kept)
+   };
+
+   explicit CFTPLineEndingStage(Mode eMode) : m_eMode(eMode), m_bPendingCR(false), m_bLastWasCR(false) {}
+   bool Write(const char *pData, size_t uSize) override;
+   bool Finish() override;
+
+  private:
+   Mode m_eMode;
+   bool m_bPendingCR;  // TO_LF : a '\r' ended the previous buffer
+   bool m_bLastWasCR;  // TO_CRLF : last byte of the previous buffer
+   std::string m_strBuffer;
+};
+
+// copies the data to a second sink (not owned) before forwarding it
+class CFTPTeeStage : public CFTPStage {
+  public:
+   explicit CFTPTeeStage(CFTPSink &oBranch) : m_oBranch(oBranch) {}
+   bool Write(const char *pData, size_t uSize) override;
+   bool Finish() override;
+
+  private:
+   CFTPSink &m_oBranch;
+};
+
+}  // namespace embeddedmz
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * @file FTPProgress.cpp
+ * @brief implementation of the transfer rate estimation and of the progress snapshots
+ */
+
+#include "FTPProgress.h"
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace embeddedmz {
+
+namespace {
+
+// shorter measures are merged with the next one (libcurl can call the callbacks very often)
+const double MIN_MEASURE_DURATION = 0.05;
+
+int64_t NowUs() {
+   return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+CFTPRateEstimator::CFTPRateEstimator(double dTimeConstant /* = 3.0 */) : m_dTimeConstant(dTimeConstant) { Reset(); }
+
+void CFTPRateEstimator::Reset() {
+   m_dLastTime   = 0;
+   m_llLastBytes = 0;
+   m_dRate       = 0;
+   m_bMeasured   = false;
+}
+
+void CFTPRateEstimator::Update(double dTime, curl_off_t llBytes) {
+   // a new transfer, measured from now
+   if (llBytes < m_llLastBytes) {
+      Reset();
+      m_dLastTime   = dTime;
+      m_llLastBytes = llBytes;
+      return;
+   }
+
+   // the first measure begins with the first byte
+   if (llBytes == 0 && m_llLastBytes == 0) {
+      m_dLastTime = dTime;
+      return;
+   }
+
+   const double dDuration = dTime - m_dLastTime;
+   if (dDuration < MIN_MEASURE_DURATION) return;
+
+   const double dMeasure = static_cast<double>(llBytes - m_llLastBytes) / dDuration;
+   if (!m_bMeasured) {
+      m_dRate     = dMeasure;
+      m_bMeasured = true;
+   } else
+      m_dRate += (1.0 - std::exp(-dDuration / m_dTimeConstant)) * (dMeasure - m_dRate);
+
+   m_dLastTime   = dTime;
+   m_llLastBytes = llBytes;
+}
+
+double CFTPRateEstimator::GetEta(curl_off_t llBytes, curl_off_t llTotal) const {
+   if (llTotal <= 0) return -1;
+   if (llBytes >= llTotal) return 0;
+   return (m_dRate > 0) ? static_cast<double>(llTotal - llBytes) / m_dRate : -1;
+}
+
+CFTPProgressSnapshot::CFTPProgressSnapshot()
+    : m_ullSequence(0),
+      m_eState(State::IDLE),
+      m_llBytesDone(0),
+      m_llBytesTotal(0),
+      m_dRate(0),
+      m_dEta(-1),
+      m_ullSessionBytes(0) {}
+
+void CFTPProgressSnapshot::Store(const Values &oValues) {
+   const uint64_t ullSequence = m_ullSequence.load(std::memory_order_relaxed);
+   m_ullSequence.store(ullSequence + 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+
+   m_eState.store(oValues.eState, std::memory_order_relaxed);
+   m_llBytesDone.store(oValues.llBytesDone, std::memory_order_relaxed);
+   m_llBytesTotal.store(oValues.llBytesTotal, std::memory_order_relaxed);
+   m_dRate.store(oValues.dRate, std::memory_order_relaxed);
+   m_dEta.store(oValues.dEta, std::memory_order_relaxed);
+   m_ullSessionBytes.store(oValues.ullSessionBytes, std::memory_order_relaxed);
+
+   m_ullSequence.store(ullSequence + 2, std::memory_order_release);
+}
+
+CFTPProgressSnapshot::Values CFTPProgressSnapshot::Load() const {
+   Values oValues;
+   for (;;) {
+      const uint64_t ullSequence = m_ullSequence.load(std::memory_order_acquire);
+      if (ullSequence & 1) {
+         std::this_thread::yield();
+         continue;
+      }
+
+      oValues.eState          = m_eState.load(std::memory_order_relaxed);
+      oValues.llBytesDone     = m_llBytesDone.load(std::memory_order_relaxed);
+      oValues.llBytesTotal    = m_llBytesTotal.load(std::memory_order_relaxed);
+      oValues.dRate           = m_dRate.load(std::memory_order_relaxed);
+      oValues.dEta            = m_dEta.load(std::memory_order_relaxed);
+      oValues.ullSessionBytes = m_ullSessionBytes.load(std::memory_order_relaxed);
+
+      // the values were not overwritten meanwhile
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (m_ullSequence.load(std::memory_order_relaxed) == ullSequence) {
+         oValues.ullVersion = ullSequence / 2;
+         return oValues;
+      }
+   }
+}
+
+CFTPJobProgress::CFTPJobProgress()
+    : m_eState(State::IDLE),
+      m_ullTasks(0),
+      m_ullTasksDone(0),
+      m_ullTasksFailed(0),
+      m_ullBytesTotal(0),
+      m_ullBytesDone(0),
+      m_llStartUs(0),
+      m_llEndUs(0) {}
+
+void CFTPJobProgress::Start(uint64_t ullTasks, uint64_t ullBytesTotal) {
+   m_ullTasks.store(ullTasks, std::memory_order_relaxed);
+   m_ullTasksDone.store(0, std::memory_order_relaxed);
+   m_ullTasksFailed.store(0, std::memory_order_relaxed);
+   m_ullBytesTotal.store(ullBytesTotal, std::memory_order_relaxed);
+   m_ullBytesDone.store(0, std::memory_order_relaxed);
+   m_llStartUs.store(NowUs(), std::memory_order_relaxed);
+   m_llEndUs.store(0, std::memory_order_relaxed);
+   m_eState.store(State::RUNNING, std::memory_order_release);
+}
+
+void CFTPJobProgress::TaskDone(bool bSucceeded) {
+   if (!bSucceeded) m_ullTasksFailed.fetch_add(1, std::memory_order_relaxed);
+   m_ullTasksDone.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CFTPJobProgress::Finish(bool bSucceeded) {
+   m_llEndUs.store(NowUs(), std::memory_order_relaxed);
+   m_eState.store(bSucceeded ? State::COMPLETED : State::FAILED, std::memory_order_release);
+}
+
+CFTPJobProgress::Values CFTPJobProgress::Load() const {
+   Values oValues;
+   oValues.eState = m_eState.load(std::memory_order_acquire);
+   if (oValues.eState == State::IDLE) return oValues;
+
+   oValues.ullTasks       = m_ullTasks.load(std::memory_order_relaxed);
+   oValues.ullTasksFailed = m_ullTasksFailed.load(std::memory_order_relaxed);
+   oValues.ullTasksDone   = m_ullTasksDone.load(std::memory_order_relaxed);
+   oValues.ullBytesTotal  = m_ullBytesTotal.load(std::memory_order_relaxed);
+   oValues.ullBytesDone   = m_ullBytesDone.load(std::memory_order_relaxed);
+
+   const int64_t llEndUs = m_llEndUs.load(std::memory_order_relaxed);
+   const int64_t llElapsedUs = ((llEndUs != 0) ? llEndUs : NowUs()) - m_llStartUs.load(std::memory_order_relaxed);
+   oValues.dElapsed = (llElapsedUs > 0) ? llElapsedUs / 1e6 : 0;
+   oValues.dRate    = (oValues.dElapsed > 0) ? oValues.ullBytesDone / oValues.dElapsed : 0;
+   if (oValues.eState == State::COMPLETED || (oValues.ullBytesTotal > 0 && oValues.ullBytesDone >= oValues.ullBytesTotal))
+      oValues.dEta = 0;
+   else if (oValues.ullBytesTotal > 0 && oValues.dRate > 0)
+      oValues.dEta = (oValues.ullBytesTotal - oValues.ullBytesDone) / oValues.dRate;
+   return oValues;
+}
+
+}  // namespace embeddedmz
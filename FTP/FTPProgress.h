@@ -0,0 +1,135 @@
+/*
+ * @file FTPProgress.h
+ * @brief transfer rate estimation and progress published to other threads
+ */
+
+#ifndef INCLUDE_FTPPROGRESS_H_
+#define INCLUDE_FTPPROGRESS_H_
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace embeddedmz {
+
+/* Exponentially weighted moving average of a transfer rate. The weight of a measure depends on
+ * its duration (1 - exp(-duration / time constant)) so the estimate doesn't depend on how often
+ * it is updated. The time spent before the first byte (connection, login...) is ignored. */
+class CFTPRateEstimator {
+  public:
+   // dTimeConstant in seconds : the older measures' weight is divided by e every dTimeConstant
+   explicit CFTPRateEstimator(double dTimeConstant = 3.0);
+
+   void Reset();
+
+   // dTime : seconds since any origin, llBytes : bytes transferred since the beginning
+   void Update(double dTime, curl_off_t llBytes);
+
+   // bytes per second, 0 until a measure is available
+   inline double GetRate() const { return m_dRate; }
+   // seconds to transfer the rest of llTotal bytes at the current rate, -1 if unknown
+   double GetEta(curl_off_t llBytes, curl_off_t llTotal) const;
+
+  private:
+   double m_dTimeConstant;
+   double m_dLastTime;
+   curl_off_t m_llLastBytes;
+   double m_dRate;
+   bool m_bMeasured;
+};
+
+/* Progress of a client's requests (see CFTPClient::EnableProgressSnapshot) : written by the
+ * thread performing them, Load() can be called by any thread without lock and always returns
+ * the values of a single update. */
+class CFTPProgressSnapshot {
+  public:
+   enum class State : unsigned char {
+      IDLE,        // nothing was performed yet
+      CONNECTING,  // the request started, no data was transferred yet
+      RUNNING,     // data is being transferred
+      COMPLETED,   // the last request succeeded
+      FAILED       // the last request failed
+   };
+
+   struct Values {
+      Values() : eState(State::IDLE), llBytesDone(0), llBytesTotal(0), dRate(0), dEta(-1), ullSessionBytes(0), ullVersion(0) {}
+      State eState;
+      curl_off_t llBytesDone;    // current (or last) request
+      curl_off_t llBytesTotal;   // 0 if unknown
+      double dRate;              // bytes per second, smoothed
+      double dEta;               // seconds remaining, -1 if unknown
+      uint64_t ullSessionBytes;  // transferred by all the requests of the client
+      uint64_t ullVersion;       // number of updates, a poller can skip unchanged values
+   };
+
+   CFTPProgressSnapshot();
+
+   CFTPProgressSnapshot(const CFTPProgressSnapshot &) = delete;
+   CFTPProgressSnapshot &operator=(const CFTPProgressSnapshot &) = delete;
+
+   // single writer, ullVersion is ignored
+   void Store(const Values &oValues);
+   Values Load() const;
+
+  private:
+   // seqlock : odd while the values are written
+   std::atomic<uint64_t> m_ullSequence;
+   std::atomic<State> m_eState;
+   std::atomic<curl_off_t> m_llBytesDone;
+   std::atomic<curl_off_t> m_llBytesTotal;
+   std::atomic<double> m_dRate;
+   std::atomic<double> m_dEta;
+   std::atomic<uint64_t> m_ullSessionBytes;
+};
+
+/* Progress of a job made of many tasks run by several sessions (e.g. CFTPMirror::Execute) : the
+ * counters are updated by the threads running the tasks and the sessions' requests (see
+ * CFTPClient::SetJobProgress), and read by any thread without lock. Each counter only grows
+ * during a job but Load() doesn't take them at the same instant. */
+class CFTPJobProgress {
+  public:
+   using State = CFTPProgressSnapshot::State;
+
+   struct Values {
+      Values()
+          : eState(State::IDLE), ullTasks(0), ullTasksDone(0), ullTasksFailed(0), ullBytesTotal(0), ullBytesDone(0), dElapsed(0), dRate(0),
+            dEta(-1) {}
+      State eState;  // IDLE, RUNNING, COMPLETED or FAILED
+      uint64_t ullTasks;
+      uint64_t ullTasksDone;    // including the failed ones
+      uint64_t ullTasksFailed;
+      uint64_t ullBytesTotal;   // expected, 0 if unknown
+      uint64_t ullBytesDone;
+      double dElapsed;          // seconds since Start()
+      double dRate;             // average bytes per second since Start()
+      double dEta;              // seconds remaining, -1 if unknown
+   };
+
+   CFTPJobProgress();
+
+   CFTPJobProgress(const CFTPJobProgress &) = delete;
+   CFTPJobProgress &operator=(const CFTPJobProgress &) = delete;
+
+   // resets the counters
+   void Start(uint64_t ullTasks, uint64_t ullBytesTotal);
+   void TaskDone(bool bSucceeded);
+   inline void AddBytes(uint64_t ullBytes) { m_ullBytesDone.fetch_add(ullBytes, std::memory_order_relaxed); }
+   void Finish(bool bSucceeded);
+
+   Values Load() const;
+
+  private:
+   std::atomic<State> m_eState;
+   std::atomic<uint64_t> m_ullTasks;
+   std::atomic<uint64_t> m_ullTasksDone;
+   std::atomic<uint64_t> m_ullTasksFailed;
+   std::atomic<uint64_t> m_ullBytesTotal;
+   std::atomic<uint64_t> m_ullBytesDone;
+   std::atomic<int64_t> m_llStartUs;  // steady clock
+   std::atomic<int64_t> m_llEndUs;    // 0 while running
+};
+
+}  // namespace embeddedmz
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * @file FTPRingBuffer.cpp
+ * @brief implementation of the bounded producer/consumer buffer
+ */
+
+#include "FTPRingBuffer.h"
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace embeddedmz {
+
+CFTPRingBuffer::CFTPRingBuffer(size_t uCapacity)
+    : m_vecData(std::max<size_t>(uCapacity, 1)), m_uHead(0), m_uSize(0), m_bFinished(false), m_bAborted(false), m_bCancelled(false) {}
+
+bool CFTPRingBuffer::Write(const char *pData, size_t uSize) {
+   std::unique_lock<std::mutex> lock(m_Mutex);
+
+   while (uSize > 0) {
+      m_NotFull.wait(lock, [this]() { return m_bCancelled || m_uSize < m_vecData.size(); });
+      if (m_bCancelled) return false;
+
+      // copies up to the end of the free space or of the storage
+      const size_t uTail  = (m_uHead + m_uSize) % m_vecData.size();
+      const size_t uChunk = std::min(uSize, std::min(m_vecData.size() - m_uSize, m_vecData.size() - uTail));
+      memcpy(m_vecData.data() + uTail, pData, uChunk);
+      m_uSize += uChunk;
+      pData += uChunk;
+      uSize -= uChunk;
+
+      m_NotEmpty.notify_one();
+   }
+   return true;
+}
+
+bool CFTPRingBuffer::Finish() {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   m_bFinished = true;
+   m_NotEmpty.notify_all();
+   return !m_bCancelled;
+}
+
+void CFTPRingBuffer::Abort() {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   m_bAborted = true;
+   m_NotEmpty.notify_all();
+}
+
+size_t CFTPRingBuffer::Read(char *pData, size_t uSize) {
+   std::unique_lock<std::mutex> lock(m_Mutex);
+
+   m_NotEmpty.wait(lock, [this]() { return m_bAborted || m_bFinished || m_uSize > 0; });
+   if (m_bAborted) return 0;
+
+   size_t uRead = 0;
+   while (uRead < uSize && m_uSize > 0) {
+      const size_t uChunk = std::min(uSize - uRead, std::min(m_uSize, m_vecData.size() - m_uHead));
+      memcpy(pData + uRead, m_vecData.data() + m_uHead, uChunk);
+      m_uHead = (m_uHead + uChunk) % m_vecData.size();
+      m_uSize -= uChunk;
+      uRead += uChunk;
+   }
+
+   m_NotFull.notify_one();
+   return uRead;
+}
+
+void CFTPRingBuffer::Cancel() {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   m_bCancelled = true;
+   m_NotFull.notify_all();
+}
+
+bool CFTPRingBuffer::IsAborted() const {
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   return m_bAborted;
+}
+
+/**
+ * @brief gives the buffered data to libcurl, blocks until some is available
+ *
+ * @param ptr pointer of max size (size*nmemb) to write data to it
+ * @param size size parameter
+ * @param nmemb memblock parameter
+ * @param data pointer to a CFTPRingBuffer
+ *
+ * @return number of bytes copied, 0 at the end of the data or CURL_READFUNC_ABORT
+ * if the producer failed
+ */
+size_t CFTPRingBuffer::ReadCallback(void *ptr, size_t size, size_t nmemb, void *data) {
+   auto *pBuffer      = reinterpret_cast<CFTPRingBuffer *>(data);
+   const size_t uRead = pBuffer->Read(reinterpret_cast<char *>(ptr), size * nmemb);
+
+   return (uRead == 0 && pBuffer->IsAborted()) ? CURL_READFUNC_ABORT : uRead;
+}
+
+}  // namespace embeddedmz
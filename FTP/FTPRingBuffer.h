@@ -0,0 +1,63 @@
+/*
+ * @file FTPRingBuffer.h
+ * @brief bounded buffer between a download (producer) and an upload (consumer) running concurrently
+ */
+
+#ifndef INCLUDE_FTPRINGBUFFER_H_
+#define INCLUDE_FTPRINGBUFFER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "FTPPipeline.h"
+
+namespace embeddedmz {
+
+/* The producer writes in it as a sink (e.g. CFTPClient::DownloadFile(strRemoteFile, oSink)) and
+ * blocks while it is full, the consumer reads it (e.g. with ReadCallback as an upload's read
+ * function) and blocks while it is empty : the slowest side paces the other one. */
+class CFTPRingBuffer : public CFTPSink {
+  public:
+   explicit CFTPRingBuffer(size_t uCapacity);
+
+   CFTPRingBuffer(const CFTPRingBuffer &) = delete;
+   CFTPRingBuffer &operator=(const CFTPRingBuffer &) = delete;
+
+   // Producer
+   // returns false once the consumer cancelled
+   bool Write(const char *pData, size_t uSize) override;
+   // end of the data
+   bool Finish() override;
+   // the data is incomplete, the consumer's Read() fails
+   void Abort();
+
+   // Consumer
+   /* Returns the number of bytes copied to pData, 0 at the end of the data or if the producer
+    * aborted (see IsAborted()). */
+   size_t Read(char *pData, size_t uSize);
+   // the producer's Write() fails, e.g. the upload failed
+   void Cancel();
+
+   bool IsAborted() const;
+   inline size_t GetCapacity() const { return m_vecData.size(); }
+
+   // CURLOPT_READFUNCTION, CURLOPT_READDATA must be a CFTPRingBuffer*
+   static size_t ReadCallback(void *ptr, size_t size, size_t nmemb, void *data);
+
+  private:
+   std::vector<char> m_vecData;
+   size_t m_uHead;  // next byte to read
+   size_t m_uSize;  // bytes available
+   bool m_bFinished;
+   bool m_bAborted;
+   bool m_bCancelled;
+   mutable std::mutex m_Mutex;
+   std::condition_variable m_NotEmpty;
+   std::condition_variable m_NotFull;
+};
+
+}  // namespace embeddedmz
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * @file FTPSessionPool.cpp
+ * @brief implementation of the FTP sessions pool
+ */
+
+#include "FTPSessionPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace embeddedmz {
+
+CFTPSessionPool::CFTPSessionPool(const CFTPClient &oClient, unsigned uSessions) {
+   for (unsigned i = 0; i < uSessions; ++i) {
+      std::unique_ptr<CFTPClient> pSession = oClient.CloneSession();
+      if (!pSession) break;
+      m_vecSessions.push_back(std::move(pSession));
+   }
+}
+
+CFTPSessionPool::~CFTPSessionPool() {
+   for (auto &pSession : m_vecSessions) pSession->CleanupSession();
+}
+
+size_t CFTPSessionPool::Run(size_t uTasks, const TaskFn &fnTask, CFTPJobProgress *pProgress /* = nullptr */) {
+   if (uTasks == 0) return 0;
+   if (m_vecSessions.empty()) {
+      if (pProgress != nullptr)
+         for (size_t uTask = 0; uTask < uTasks; ++uTask) pProgress->TaskDone(false);
+      return uTasks;
+   }
+
+   std::atomic<size_t> uNextTask(0);
+   std::atomic<size_t> uFailures(0);
+
+   auto Worker = [&](CFTPClient &oSession) {
+      oSession.SetJobProgress(pProgress);
+      for (size_t uTask = uNextTask++; uTask < uTasks; uTask = uNextTask++) {
+         const bool bSucceeded = fnTask(oSession, uTask);
+         if (!bSucceeded) ++uFailures;
+         if (pProgress != nullptr) pProgress->TaskDone(bSucceeded);
+      }
+      oSession.SetJobProgress(nullptr);
+   };
+
+   const size_t uWorkers = std::min(m_vecSessions.size(), uTasks);
+   if (uWorkers == 1) {
+      Worker(*m_vecSessions.front());
+   } else {
+      std::vector<std::thread> vecThreads;
+      vecThreads.reserve(uWorkers);
+      for (size_t i = 0; i < uWorkers; ++i) vecThreads.emplace_back(Worker, std::ref(*m_vecSessions[i]));
+      for (auto &Thread : vecThreads) Thread.join();
+   }
+
+   return uFailures;
+}
+
+}  // namespace embeddedmz
@@ -0,0 +1,45 @@
+/*
+ * @file FTPSessionPool.h
+ * @brief a set of FTP sessions used to run independent requests in parallel
+ */
+
+#ifndef INCLUDE_FTPSESSIONPOOL_H_
+#define INCLUDE_FTPSESSIONPOOL_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "FTPClient.h"
+
+namespace embeddedmz {
+
+class CFTPSessionPool {
+  public:
+   // a task receives a session owned by the pool and its index, it returns false on failure
+   using TaskFn = std::function<bool(CFTPClient &, size_t)>;
+
+   /* Clones uSessions sessions from oClient (see CFTPClient::CloneSession), oClient
+    * itself is not used by the pool. Connections are only established by the first request. */
+   CFTPSessionPool(const CFTPClient &oClient, unsigned uSessions);
+   ~CFTPSessionPool();
+
+   CFTPSessionPool(const CFTPSessionPool &) = delete;
+   CFTPSessionPool &operator=(const CFTPSessionPool &) = delete;
+
+   inline size_t GetSize() const { return m_vecSessions.size(); }
+   inline CFTPClient &GetSession(size_t uIndex) { return *m_vecSessions[uIndex]; }
+
+   /* Runs fnTask for every index in [0, uTasks) : each session is driven by its own
+    * thread which picks the next pending task, so slow transfers don't hold back the others.
+    * The finished tasks and the bytes transferred are added to pProgress if given (its Start()
+    * and Finish() are left to the caller). Returns the number of failed tasks. */
+   size_t Run(size_t uTasks, const TaskFn &fnTask, CFTPJobProgress *pProgress = nullptr);
+
+  private:
+   std::vector<std::unique_ptr<CFTPClient>> m_vecSessions;
+};
+
+}  // namespace embeddedmz
+
+#endif
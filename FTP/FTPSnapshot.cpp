@@ -0,0 +1,288 @@
+/**
+ * @file FTPSnapshot.cpp
+ * @brief implementation of the remote tree snapshot
+ */
+
+#include "FTPSnapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+
+namespace embeddedmz {
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'F', 'T', 'P', 'S', 'N', 'A', 'P', '\0'};
+
+static_assert(sizeof(CFTPSnapshot::Header) == 32, "snapshot header must have a fixed width");
+static_assert(sizeof(CFTPSnapshot::EntryRecord) == 40, "snapshot records must have a fixed width");
+
+inline uint64_t Align8(uint64_t ullValue) { return (ullValue + 7) & ~static_cast<uint64_t>(7); }
+
+inline int ComparePaths(const char *pszA, size_t uLenA, const char *pszB, size_t uLenB) {
+   const int iCmp = memcmp(pszA, pszB, std::min(uLenA, uLenB));
+   if (iCmp != 0) return iCmp;
+   return (uLenA < uLenB) ? -1 : (uLenA > uLenB ? 1 : 0);
+}
+
+}  // namespace
+
+CFTPSnapshot::CFTPSnapshot() : m_pData(nullptr), m_uDataSize(0), m_pHeader(nullptr) {
+   Assign(std::vector<CFTPClient::RemoteEntry>());
+}
+
+CFTPSnapshot::CFTPSnapshot(const std::vector<CFTPClient::RemoteEntry> &vecEntries)
+    : m_pData(nullptr), m_uDataSize(0), m_pHeader(nullptr) {
+   Assign(vecEntries);
+}
+
+CFTPSnapshot::CFTPSnapshot(const CFTPSnapshot &oOther)
+    : m_vecBuffer(oOther.m_vecBuffer), m_pData(oOther.m_pData), m_uDataSize(oOther.m_uDataSize), m_pHeader(oOther.m_pHeader) {
+   // an attached image is shared, an owned one is duplicated
+   if (!m_vecBuffer.empty()) {
+      m_pData   = m_vecBuffer.data();
+      m_pHeader = reinterpret_cast<const Header *>(m_pData);
+   }
+}
+
+CFTPSnapshot &CFTPSnapshot::operator=(const CFTPSnapshot &oOther) {
+   if (this != &oOther) {
+      CFTPSnapshot oCopy(oOther);
+      *this = std::move(oCopy);
+   }
+   return *this;
+}
+
+/**
+ * @brief serializes a list of entries in the snapshot format
+ *
+ * @param [in] vecEntries entries (e.g. CFTPClient::Walk() result), in any order.
+ */
+void CFTPSnapshot::Assign(const std::vector<CFTPClient::RemoteEntry> &vecEntries) {
+   // sort indexes instead of the entries to avoid copying strings
+   std::vector<size_t> vecOrder(vecEntries.size());
+   std::iota(vecOrder.begin(), vecOrder.end(), 0);
+   std::sort(vecOrder.begin(), vecOrder.end(),
+             [&vecEntries](size_t a, size_t b) { return vecEntries[a].strPath < vecEntries[b].strPath; });
+
+   uint64_t ullStringsSize = 0;
+   for (const auto &oEntry : vecEntries) ullStringsSize += oEntry.strPath.size();
+
+   const uint64_t ullStringsOffset = Align8(sizeof(Header) + vecEntries.size() * sizeof(EntryRecord));
+   m_vecBuffer.assign(static_cast<size_t>(Align8(ullStringsOffset + ullStringsSize)), '\0');
+
+   Header *pHeader = reinterpret_cast<Header *>(m_vecBuffer.data());
+   memcpy(pHeader->szMagic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+   pHeader->uVersion             = VERSION;
+   pHeader->uEntryCount          = static_cast<uint32_t>(vecEntries.size());
+   pHeader->ullStringTableOffset = ullStringsOffset;
+   pHeader->ullStringTableSize   = ullStringsSize;
+
+   EntryRecord *pRecords = reinterpret_cast<EntryRecord *>(m_vecBuffer.data() + sizeof(Header));
+   char *pStrings        = m_vecBuffer.data() + ullStringsOffset;
+   uint64_t ullOffset    = 0;
+
+   for (size_t i = 0; i < vecOrder.size(); ++i) {
+      const CFTPClient::RemoteEntry &oEntry = vecEntries[vecOrder[i]];
+      EntryRecord &oRecord                  = pRecords[i];
+
+      oRecord.ullPathOffset = ullOffset;
+      oRecord.uPathLength   = static_cast<uint32_t>(oEntry.strPath.size());
+      oRecord.ullSize       = static_cast<uint64_t>(oEntry.llSize);
+      oRecord.llMTime       = static_cast<int64_t>(oEntry.tMTime);
+      oRecord.uPermissions  = oEntry.uPermissions;
+      oRecord.uFileType     = static_cast<uint8_t>(oEntry.eFileType);
+
+      memcpy(pStrings + ullOffset, oEntry.strPath.data(), oEntry.strPath.size());
+      ullOffset += oEntry.strPath.size();
+   }
+
+   m_pData     = m_vecBuffer.data();
+   m_uDataSize = m_vecBuffer.size();
+   m_pHeader   = pHeader;
+}
+
+/**
+ * @brief writes the snapshot to a file
+ *
+ * @param [in] strFile path of the snapshot file encoded in UTF-8 format.
+ *
+ * @retval true   Successfully saved the snapshot.
+ * @retval false  The file couldn't be written.
+ */
+bool CFTPSnapshot::Save(const std::string &strFile) const {
+   std::ofstream ofsOutput(
+#ifdef LINUX
+       strFile,  // UTF-8
+#else
+       CFTPClient::Utf8ToUtf16(strFile),
+#endif
+       std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+   if (!ofsOutput) return false;
+
+   ofsOutput.write(m_pData, static_cast<std::streamsize>(m_uDataSize));
+   ofsOutput.close();
+
+   return static_cast<bool>(ofsOutput);
+}
+
+/**
+ * @brief reads a snapshot file previously written with Save()
+ *
+ * @param [in] strFile path of the snapshot file encoded in UTF-8 format.
+ *
+ * @retval true   Successfully loaded the snapshot.
+ * @retval false  The file couldn't be read or its content is invalid, the
+ * snapshot is left untouched.
+ */
+bool CFTPSnapshot::Load(const std::string &strFile) {
+   std::ifstream ifsInput(
+#ifdef LINUX
+       strFile,  // UTF-8
+#else
+       CFTPClient::Utf8ToUtf16(strFile),
+#endif
+       std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+   if (!ifsInput) return false;
+
+   const std::streamoff llSize = ifsInput.tellg();
+   if (llSize < static_cast<std::streamoff>(sizeof(Header))) return false;
+
+   std::vector<char> vecBuffer(static_cast<size_t>(llSize));
+   ifsInput.seekg(0, ifsInput.beg);
+   if (!ifsInput.read(vecBuffer.data(), llSize)) return false;
+
+   if (!Validate(vecBuffer.data(), vecBuffer.size())) return false;
+
+   m_vecBuffer.swap(vecBuffer);
+   m_pData     = m_vecBuffer.data();
+   m_uDataSize = m_vecBuffer.size();
+   m_pHeader   = reinterpret_cast<const Header *>(m_pData);
+
+   return true;
+}
+
+/**
+ * @brief uses a snapshot image owned by the caller (e.g. mmap'ed file)
+ *
+ * @param [in] pData 8-byte aligned snapshot image
+ * @param [in] uSize size of the image
+ *
+ * @retval true   The image is a valid snapshot.
+ * @retval false  The image is invalid, the snapshot is left untouched.
+ */
+bool CFTPSnapshot::Attach(const void *pData, size_t uSize) {
+   if (pData == nullptr || (reinterpret_cast<uintptr_t>(pData) & 7) != 0 || !Validate(pData, uSize)) return false;
+
+   m_vecBuffer.clear();
+   m_vecBuffer.shrink_to_fit();
+   m_pData     = static_cast<const char *>(pData);
+   m_uDataSize = uSize;
+   m_pHeader   = reinterpret_cast<const Header *>(m_pData);
+
+   return true;
+}
+
+bool CFTPSnapshot::Validate(const void *pData, size_t uSize) {
+   if (uSize < sizeof(Header)) return false;
+
+   Header oHeader;
+   memcpy(&oHeader, pData, sizeof(Header));
+
+   if (memcmp(oHeader.szMagic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || oHeader.uVersion != VERSION) return false;
+
+   const uint64_t ullRecordsEnd = sizeof(Header) + static_cast<uint64_t>(oHeader.uEntryCount) * sizeof(EntryRecord);
+   if (ullRecordsEnd > uSize || oHeader.ullStringTableOffset < ullRecordsEnd || oHeader.ullStringTableOffset > uSize ||
+       oHeader.ullStringTableSize > uSize - oHeader.ullStringTableOffset)
+      return false;
+
+   // every path must lie inside the string table
+   const EntryRecord *pRecords = reinterpret_cast<const EntryRecord *>(static_cast<const char *>(pData) + sizeof(Header));
+   for (uint32_t i = 0; i < oHeader.uEntryCount; ++i) {
+      if (pRecords[i].ullPathOffset > oHeader.ullStringTableSize ||
+          pRecords[i].uPathLength > oHeader.ullStringTableSize - pRecords[i].ullPathOffset)
+         return false;
+   }
+
+   return true;
+}
+
+CFTPClient::RemoteEntry CFTPSnapshot::ToEntry(const EntryRecord &oRecord) const {
+   CFTPClient::RemoteEntry oEntry;
+   oEntry.strPath.assign(Path(oRecord), oRecord.uPathLength);
+   oEntry.llSize       = static_cast<curl_off_t>(oRecord.ullSize);
+   oEntry.tMTime       = static_cast<time_t>(oRecord.llMTime);
+   oEntry.uPermissions = oRecord.uPermissions;
+   oEntry.eFileType    = static_cast<curlfiletype>(oRecord.uFileType);
+   return oEntry;
+}
+
+CFTPClient::RemoteEntry CFTPSnapshot::GetEntry(size_t uIndex) const {
+   if (uIndex >= GetEntryCount()) return CFTPClient::RemoteEntry();
+   return ToEntry(Records()[uIndex]);
+}
+
+bool CFTPSnapshot::Find(const std::string &strPath, CFTPClient::RemoteEntry &oEntry) const {
+   const EntryRecord *pBegin = Records();
+   const EntryRecord *pEnd   = pBegin + GetEntryCount();
+
+   const EntryRecord *pFound = std::lower_bound(pBegin, pEnd, strPath, [this](const EntryRecord &oRecord, const std::string &strKey) {
+      return ComparePaths(Path(oRecord), oRecord.uPathLength, strKey.data(), strKey.size()) < 0;
+   });
+
+   if (pFound == pEnd || ComparePaths(Path(*pFound), pFound->uPathLength, strPath.data(), strPath.size()) != 0) return false;
+
+   oEntry = ToEntry(*pFound);
+   return true;
+}
+
+/**
+ * @brief computes the entries added, removed or changed between two snapshots
+ *
+ * @param [in] oOld previous snapshot
+ * @param [in] oNew current snapshot
+ * @param [out] oResult added/removed/changed entries
+ *
+ * Example Usage:
+ * @code
+ *    CFTPSnapshot oPrevious;
+ *    oPrevious.Load("pictures.snap");
+ *    std::vector<CFTPClient::RemoteEntry> vecEntries;
+ *    m_pFTPClient->Walk("/pictures", vecEntries);
+ *    CFTPSnapshot oCurrent(vecEntries);
+ *    CFTPSnapshot::DiffResult oDiff;
+ *    CFTPSnapshot::Diff(oPrevious, oCurrent, oDiff);
+ *    oCurrent.Save("pictures.snap");
+ * @endcode
+ */
+void CFTPSnapshot::Diff(const CFTPSnapshot &oOld, const CFTPSnapshot &oNew, DiffResult &oResult) {
+   oResult.vecAdded.clear();
+   oResult.vecRemoved.clear();
+   oResult.vecChanged.clear();
+
+   const EntryRecord *pOld = oOld.Records();
+   const EntryRecord *pNew = oNew.Records();
+   const size_t uOldCount  = oOld.GetEntryCount();
+   const size_t uNewCount  = oNew.GetEntryCount();
+
+   size_t i = 0, j = 0;
+   while (i < uOldCount && j < uNewCount) {
+      const int iCmp = ComparePaths(oOld.Path(pOld[i]), pOld[i].uPathLength, oNew.Path(pNew[j]), pNew[j].uPathLength);
+      if (iCmp < 0) {
+         oResult.vecRemoved.push_back(oOld.ToEntry(pOld[i++]));
+      } else if (iCmp > 0) {
+         oResult.vecAdded.push_back(oNew.ToEntry(pNew[j++]));
+      } else {
+         if (pOld[i].ullSize != pNew[j].ullSize || pOld[i].llMTime != pNew[j].llMTime || pOld[i].uFileType != pNew[j].uFileType)
+            oResult.vecChanged.push_back(oNew.ToEntry(pNew[j]));
+         ++i;
+         ++j;
+      }
+   }
+   for (; i < uOldCount; ++i) oResult.vecRemoved.push_back(oOld.ToEntry(pOld[i]));
+   for (; j < uNewCount; ++j) oResult.vecAdded.push_back(oNew.ToEntry(pNew[j]));
+}
+
+}  // namespace embeddedmz
@@ -0,0 +1,102 @@
+/*
+ * @file FTPSnapshot.h
+ * @brief compact binary snapshot of a remote tree (see CFTPClient::Walk)
+ *
+ * File layout (host byte order, every section is 8-byte aligned) :
+ *    Header | EntryRecord[uEntryCount] (sorted by path) | string table (paths, not null-terminated)
+ *
+ * Records have a fixed width and reference their path by offset in the string
+ * table, so a snapshot can be used in place from a memory mapped file (Attach)
+ * without any parsing.
+ */
+
+#ifndef INCLUDE_FTPSNAPSHOT_H_
+#define INCLUDE_FTPSNAPSHOT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FTPClient.h"
+
+namespace embeddedmz {
+
+class CFTPSnapshot {
+  public:
+   static const uint32_t VERSION = 1;
+
+   struct Header {
+      char szMagic[8];  // "FTPSNAP"
+      uint32_t uVersion;
+      uint32_t uEntryCount;
+      uint64_t ullStringTableOffset;
+      uint64_t ullStringTableSize;
+   };
+
+   struct EntryRecord {
+      uint64_t ullPathOffset;  // in the string table
+      uint64_t ullSize;
+      int64_t llMTime;
+      uint32_t uPathLength;
+      uint32_t uPermissions;
+      uint8_t uFileType;  // curlfiletype
+      uint8_t arrReserved[7];
+   };
+
+   // result of Diff(), entries are taken from the newest snapshot (except the removed ones)
+   struct DiffResult {
+      std::vector<CFTPClient::RemoteEntry> vecAdded;
+      std::vector<CFTPClient::RemoteEntry> vecRemoved;
+      std::vector<CFTPClient::RemoteEntry> vecChanged;
+
+      inline bool Empty() const { return vecAdded.empty() && vecRemoved.empty() && vecChanged.empty(); }
+   };
+
+   CFTPSnapshot();
+   explicit CFTPSnapshot(const std::vector<CFTPClient::RemoteEntry> &vecEntries);
+
+   CFTPSnapshot(const CFTPSnapshot &oOther);
+   CFTPSnapshot &operator=(const CFTPSnapshot &oOther);
+   CFTPSnapshot(CFTPSnapshot &&) = default;
+   CFTPSnapshot &operator=(CFTPSnapshot &&) = default;
+
+   // builds the snapshot from the result of a CFTPClient::Walk()
+   void Assign(const std::vector<CFTPClient::RemoteEntry> &vecEntries);
+
+   bool Save(const std::string &strFile) const;
+   bool Load(const std::string &strFile);
+
+   /* uses an external buffer (e.g. a memory mapped snapshot file) without copying it,
+    * the buffer must outlive the object or the next call to Assign/Load/Attach. */
+   bool Attach(const void *pData, size_t uSize);
+
+   inline size_t GetEntryCount() const { return m_pHeader ? m_pHeader->uEntryCount : 0; }
+   inline const void *GetData() const { return m_pData; }
+   inline size_t GetDataSize() const { return m_uDataSize; }
+
+   CFTPClient::RemoteEntry GetEntry(size_t uIndex) const;
+
+   // looks for an entry by its path (binary search), returns false if it doesn't exist
+   bool Find(const std::string &strPath, CFTPClient::RemoteEntry &oEntry) const;
+
+   /* Merges the sorted records of the two snapshots : the only allocations
+    * made are for the reported changes. Size, mtime and type are compared. */
+   static void Diff(const CFTPSnapshot &oOld, const CFTPSnapshot &oNew, DiffResult &oResult);
+
+  private:
+   bool Validate(const void *pData, size_t uSize);
+   inline const EntryRecord *Records() const { return reinterpret_cast<const EntryRecord *>(m_pData + sizeof(Header)); }
+   inline const char *Path(const EntryRecord &oRecord) const {
+      return m_pData + m_pHeader->ullStringTableOffset + oRecord.ullPathOffset;
+   }
+   CFTPClient::RemoteEntry ToEntry(const EntryRecord &oRecord) const;
+
+   std::vector<char> m_vecBuffer;  // owned storage, unused when attached
+   const char *m_pData;
+   size_t m_uDataSize;
+   const Header *m_pHeader;
+};
+
+}  // namespace embeddedmz
+
+#endif
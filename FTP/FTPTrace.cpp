@@ -0,0 +1,182 @@
+/**
+ * @file FTPTrace.cpp
+ * @brief implementation of the protocol trace
+ */
+
+#include "FTPTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace embeddedmz {
+
+constexpr size_t CFTPTrace::TEXT_SIZE;
+
+namespace {
+
+uint64_t NowUs() {
+   return static_cast<uint64_t>(
+       std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+}  // namespace
+
+CFTPTrace::CFTPTrace(size_t uCapacity)
+    : m_uCapacity(std::max<size_t>(uCapacity, 1)), m_arrSlots(new Slot[m_uCapacity]), m_ullNext(0) {}
+
+void CFTPTrace::Add(RecordType eType, const char *pszText, size_t uSize) {
+   const uint64_t ullTimeUs = NowUs();
+   const uint64_t ullNext   = m_ullNext.load(std::memory_order_relaxed);
+
+   if (eType == RecordType::DATA_IN || eType == RecordType::DATA_OUT) {
+      // the previous record is updated if it's the same kind of data
+      if (ullNext > 0) {
+         Slot &oLast = m_arrSlots[(ullNext - 1) % m_uCapacity];
+         if (oLast.eType == eType) {
+            oLast.uSequence.store(2 * (ullNext - 1) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            oLast.ullBytes += uSize;
+            oLast.ullLastTimeUs = ullTimeUs;
+            ++oLast.uChunks;
+            oLast.uSequence.store(2 * (ullNext - 1) + 2, std::memory_order_release);
+            return;
+         }
+      }
+      Write(ullNext, eType, nullptr, 0, ullTimeUs, uSize);
+   } else {
+      // without the line ending
+      while (uSize > 0 && (pszText[uSize - 1] == '\n' || pszText[uSize - 1] == '\r')) --uSize;
+
+      // the password is never kept
+      if (eType == RecordType::COMMAND && uSize >= 5 && strncmp(pszText, "PASS ", 5) == 0) {
+         pszText = "PASS ****";
+         uSize   = 9;
+      }
+      Write(ullNext, eType, pszText, uSize, ullTimeUs, 0);
+   }
+
+   m_ullNext.store(ullNext + 1, std::memory_order_release);
+}
+
+void CFTPTrace::Write(uint64_t ullRecord, RecordType eType, const char *pszText, size_t uSize, uint64_t ullTimeUs, uint64_t ullBytes) {
+   Slot &oSlot = m_arrSlots[ullRecord % m_uCapacity];
+
+   oSlot.uSequence.store(2 * ullRecord + 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+
+   oSlot.ullTimeUs     = ullTimeUs;
+   oSlot.ullLastTimeUs = ullTimeUs;
+   oSlot.ullBytes      = ullBytes;
+   oSlot.uChunks       = (eType == RecordType::DATA_IN || eType == RecordType::DATA_OUT) ? 1 : 0;
+   oSlot.eType         = eType;
+   oSlot.uLength       = static_cast<unsigned char>(std::min(uSize, TEXT_SIZE));
+   if (oSlot.uLength > 0) memcpy(oSlot.szText, pszText, oSlot.uLength);
+
+   oSlot.uSequence.store(2 * ullRecord + 2, std::memory_order_release);
+}
+
+std::string CFTPTrace::Dump() const {
+   std::string strDump;
+
+   const uint64_t ullEnd = m_ullNext.load(std::memory_order_acquire);
+   uint64_t ullPreviousUs = 0;
+   for (uint64_t ullRecord = (ullEnd > m_uCapacity) ? ullEnd - m_uCapacity : 0; ullRecord < ullEnd; ++ullRecord) {
+      const Slot &oSlot = m_arrSlots[ullRecord % m_uCapacity];
+
+      // copies the slot then checks it was not overwritten meanwhile
+      const uint64_t uSequence = oSlot.uSequence.load(std::memory_order_acquire);
+      if (uSequence != 2 * ullRecord + 2) continue;
+      const uint64_t ullTimeUs   = oSlot.ullTimeUs;
+      const uint64_t ullLastUs   = oSlot.ullLastTimeUs;
+      const uint64_t ullBytes    = oSlot.ullBytes;
+      const uint32_t uChunks     = oSlot.uChunks;
+      const RecordType eType     = oSlot.eType;
+      const unsigned char uLength = oSlot.uLength;
+      char szText[TEXT_SIZE];
+      memcpy(szText, oSlot.szText, uLength);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (oSlot.uSequence.load(std::memory_order_relaxed) != uSequence) continue;
+
+      const time_t tTime = static_cast<time_t>(ullTimeUs / 1000000);
+      struct tm oTime;
+#ifdef WINDOWS
+      localtime_s(&oTime, &tTime);
+#else
+      localtime_r(&tTime, &oTime);
+#endif
+      char szPrefix[64];
+      const size_t uPrefix = strftime(szPrefix, sizeof(szPrefix), "%H:%M:%S", &oTime);
+      const uint64_t ullDeltaUs = (ullPreviousUs == 0 || ullTimeUs < ullPreviousUs) ? 0 : ullTimeUs - ullPreviousUs;
+      snprintf(szPrefix + uPrefix, sizeof(szPrefix) - uPrefix, ".%06u +%u.%06u ", static_cast<unsigned>(ullTimeUs % 1000000),
+               static_cast<unsigned>(ullDeltaUs / 1000000), static_cast<unsigned>(ullDeltaUs % 1000000));
+      ullPreviousUs = ullTimeUs;
+      strDump += szPrefix;
+
+      switch (eType) {
+         case RecordType::INFO:
+            strDump += "== ";
+            break;
+         case RecordType::COMMAND:
+            strDump += "-> ";
+            break;
+         case RecordType::REPLY:
+            strDump += "<- ";
+            break;
+         case RecordType::DATA_OUT:
+         case RecordType::DATA_IN: {
+            char szData[96];
+            snprintf(szData, sizeof(szData), "%s %llu bytes (%u chunks in %.6f s)", (eType == RecordType::DATA_OUT) ? "=>" : "<=",
+                     static_cast<unsigned long long>(ullBytes), uChunks, (ullLastUs - ullTimeUs) / 1e6);
+            strDump += szData;
+            strDump += '\n';
+            continue;
+         }
+      }
+      strDump.append(szText, uLength);
+      strDump += '\n';
+   }
+
+   return strDump;
+}
+
+/**
+ * @brief records libcurl's debug informations
+ *
+ * @param pCurl handle performing the request
+ * @param eType kind of information
+ * @param pszData information, not null terminated
+ * @param uSize size of the information
+ * @param pTrace pointer to a CFTPTrace
+ *
+ * @return 0
+ */
+int CFTPTrace::DebugCallback(CURL * /*pCurl*/, curl_infotype eType, char *pszData, size_t uSize, void *pTrace) {
+   auto *pThis = reinterpret_cast<CFTPTrace *>(pTrace);
+
+   switch (eType) {
+      case CURLINFO_TEXT:
+         pThis->Add(RecordType::INFO, pszData, uSize);
+         break;
+      case CURLINFO_HEADER_OUT:
+         pThis->Add(RecordType::COMMAND, pszData, uSize);
+         break;
+      case CURLINFO_HEADER_IN:
+         pThis->Add(RecordType::REPLY, pszData, uSize);
+         break;
+      case CURLINFO_DATA_OUT:
+         pThis->Add(RecordType::DATA_OUT, nullptr, uSize);
+         break;
+      case CURLINFO_DATA_IN:
+         pThis->Add(RecordType::DATA_IN, nullptr, uSize);
+         break;
+      default:  // encrypted data
+         break;
+   }
+
+   return 0;
+}
+
+}  // namespace embeddedmz
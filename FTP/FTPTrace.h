@@ -0,0 +1,80 @@
+/*
+ * @file FTPTrace.h
+ * @brief fixed-size in-memory trace of the protocol exchanges, enabled at runtime
+ */
+
+#ifndef INCLUDE_FTPTRACE_H_
+#define INCLUDE_FTPTRACE_H_
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace embeddedmz {
+
+/* Keeps the last records of a session : the control connection's commands and replies,
+ * libcurl's informations and the data transferred (consecutive chunks are merged in a
+ * single record). A single thread writes (the one performing the requests) without any
+ * lock or allocation, Dump() can be called from any thread while it writes. */
+class CFTPTrace {
+  public:
+   enum class RecordType : unsigned char {
+      INFO,      // libcurl's informations (connection, TLS, errors...)
+      COMMAND,   // sent on the control connection
+      REPLY,     // received on the control connection
+      DATA_OUT,  // only the number of bytes is kept
+      DATA_IN
+   };
+
+   // commands, replies and informations are truncated to this size
+   static constexpr size_t TEXT_SIZE = 110;
+
+   explicit CFTPTrace(size_t uCapacity);
+
+   CFTPTrace(const CFTPTrace &) = delete;
+   CFTPTrace &operator=(const CFTPTrace &) = delete;
+
+   // writer
+   void Add(RecordType eType, const char *pszText, size_t uSize);
+
+   /* Returns the records still in the buffer, one per line, e.g.
+    * "14:02:11.520143 +0.000212 -> RETR file.txt". */
+   std::string Dump() const;
+
+   inline size_t GetCapacity() const { return m_uCapacity; }
+   // number of records written since the creation (merged chunks are counted once)
+   inline uint64_t GetCount() const { return m_ullNext.load(std::memory_order_acquire); }
+
+   // CURLOPT_DEBUGFUNCTION, CURLOPT_DEBUGDATA must be a CFTPTrace*
+   static int DebugCallback(CURL *pCurl, curl_infotype eType, char *pszData, size_t uSize, void *pTrace);
+
+  private:
+   /* seqlock : uSequence is 2 * record number + 1 while the slot is written and
+    * 2 * record number + 2 once it is complete. */
+   struct Slot {
+      Slot() : uSequence(0), ullTimeUs(0), ullLastTimeUs(0), ullBytes(0), uChunks(0), eType(RecordType::INFO), uLength(0) {}
+
+      std::atomic<uint64_t> uSequence;
+      uint64_t ullTimeUs;      // since the epoch
+      uint64_t ullLastTimeUs;  // data records : last chunk
+      uint64_t ullBytes;       // data records
+      uint32_t uChunks;        // data records
+      RecordType eType;
+      unsigned char uLength;
+      char szText[TEXT_SIZE];
+   };
+
+   void Write(uint64_t ullRecord, RecordType eType, const char *pszText, size_t uSize, uint64_t ullTimeUs, uint64_t ullBytes);
+
+   size_t m_uCapacity;
+   std::unique_ptr<Slot[]> m_arrSlots;
+   std::atomic<uint64_t> m_ullNext;  // number of the next record
+};
+
+}  // namespace embeddedmz
+
+#endif
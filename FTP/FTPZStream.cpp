@@ -0,0 +1,102 @@
+/**
+ * @file FTPZStream.cpp
+ * @brief implementation of the MODE Z streams
+ */
+
+#include "FTPZStream.h"
+
+#ifdef FTPCLIENT_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace embeddedmz {
+
+#ifdef FTPCLIENT_WITH_ZLIB
+
+namespace {
+
+const size_t ZSTREAM_CHUNK_SIZE = 16 * 1024;
+
+}  // namespace
+
+CFTPZStream::CFTPZStream(Mode eMode, int iLevel /* = -1 */)
+    : m_eMode(eMode), m_pStream(nullptr), m_bFinished(false), m_bError(false) {
+   z_stream *pStream = new z_stream();
+   pStream->zalloc   = Z_NULL;
+   pStream->zfree    = Z_NULL;
+   pStream->opaque   = Z_NULL;
+
+   if (iLevel < Z_DEFAULT_COMPRESSION || iLevel > Z_BEST_COMPRESSION) iLevel = Z_DEFAULT_COMPRESSION;
+
+   const int iRet = (eMode == Mode::DEFLATE) ? deflateInit(pStream, iLevel) : inflateInit(pStream);
+   if (iRet == Z_OK)
+      m_pStream = pStream;
+   else
+      delete pStream;
+}
+
+CFTPZStream::~CFTPZStream() {
+   z_stream *pStream = static_cast<z_stream *>(m_pStream);
+   if (pStream == nullptr) return;
+
+   if (m_eMode == Mode::DEFLATE)
+      deflateEnd(pStream);
+   else
+      inflateEnd(pStream);
+   delete pStream;
+}
+
+bool CFTPZStream::Process(const void *pData, size_t uSize, bool bFinish, const OutputFn &fnOutput) {
+   if (!IsValid()) return false;
+
+   z_stream *pStream = static_cast<z_stream *>(m_pStream);
+   unsigned char arrChunk[ZSTREAM_CHUNK_SIZE];
+
+   // bytes following the end of an inflated stream are ignored
+   if (m_bFinished) return m_eMode == Mode::INFLATE;
+
+   pStream->next_in  = static_cast<Bytef *>(const_cast<void *>(pData));
+   pStream->avail_in = static_cast<uInt>(uSize);
+
+   for (;;) {
+      pStream->next_out  = arrChunk;
+      pStream->avail_out = sizeof(arrChunk);
+
+      int iRet;
+      if (m_eMode == Mode::DEFLATE)
+         iRet = deflate(pStream, bFinish ? Z_FINISH : Z_NO_FLUSH);
+      else
+         iRet = inflate(pStream, Z_NO_FLUSH);
+
+      if (iRet == Z_STREAM_END)
+         m_bFinished = true;
+      else if (iRet != Z_OK && iRet != Z_BUF_ERROR) {
+         m_bError = true;
+         return false;
+      }
+
+      const size_t uProduced = sizeof(arrChunk) - pStream->avail_out;
+      if (uProduced > 0 && !fnOutput(reinterpret_cast<const char *>(arrChunk), uProduced)) return false;
+
+      // the output buffer wasn't filled : the input is consumed (or the stream is over)
+      if (m_bFinished || (pStream->avail_out != 0 && pStream->avail_in == 0 && (!bFinish || m_eMode == Mode::INFLATE))) break;
+   }
+
+   return true;
+}
+
+bool CFTPZStream::IsAvailable() { return true; }
+
+#else
+
+CFTPZStream::CFTPZStream(Mode eMode, int /* iLevel = -1 */) : m_eMode(eMode), m_pStream(nullptr), m_bFinished(false), m_bError(true) {}
+
+CFTPZStream::~CFTPZStream() {}
+
+bool CFTPZStream::Process(const void *, size_t, bool, const OutputFn &) { return false; }
+
+bool CFTPZStream::IsAvailable() { return false; }
+
+#endif
+
+}  // namespace embeddedmz
@@ -0,0 +1,51 @@
+/*
+ * @file FTPZStream.h
+ * @brief zlib streams used by MODE Z transfers
+ */
+
+#ifndef INCLUDE_FTPZSTREAM_H_
+#define INCLUDE_FTPZSTREAM_H_
+
+#include <cstddef>
+#include <functional>
+
+namespace embeddedmz {
+
+/* A MODE Z data connection carries a single zlib stream (RFC 1950) per transfer.
+ * Needs the library to be built with zlib (FTPCLIENT_WITH_ZLIB), otherwise IsValid()
+ * is always false. */
+class CFTPZStream {
+  public:
+   enum class Mode : unsigned char { DEFLATE, INFLATE };
+
+   // receives the produced bytes, returns false to abort
+   using OutputFn = std::function<bool(const char *, size_t)>;
+
+   // iLevel : 0 (stored) to 9 (best), -1 is zlib's default (6), ignored by INFLATE
+   explicit CFTPZStream(Mode eMode, int iLevel = -1);
+   ~CFTPZStream();
+
+   CFTPZStream(const CFTPZStream &) = delete;
+   CFTPZStream &operator=(const CFTPZStream &) = delete;
+
+   inline Mode GetMode() const { return m_eMode; }
+   inline bool IsValid() const { return m_pStream != nullptr && !m_bError; }
+   // the end of the zlib stream was produced (DEFLATE) or reached (INFLATE)
+   inline bool IsFinished() const { return m_bFinished; }
+
+   /* Feeds uSize bytes, bFinish (DEFLATE only) terminates the stream once the input is consumed.
+    * Returns false on a corrupted input (IsValid() becomes false) or if fnOutput aborted. */
+   bool Process(const void *pData, size_t uSize, bool bFinish, const OutputFn &fnOutput);
+
+   static bool IsAvailable();
+
+  private:
+   Mode m_eMode;
+   void *m_pStream;  // z_stream, opaque so that zlib stays an optional dependency
+   bool m_bFinished;
+   bool m_bError;
+};
+
+}  // namespace embeddedmz
+
+#endif
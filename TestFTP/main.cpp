@@ -3,6 +3,19 @@
 
 // Test subject (SUT)
 #include "FTPClient.h"
+#include "FTPLogSink.h"
+#include "FTPMetrics.h"
+#include "FTPMirror.h"
+#include "FTPPipeline.h"
+#include "FTPProgress.h"
+#include "FTPRingBuffer.h"
+#include "FTPSnapshot.h"
+#include "FTPTrace.h"
+
+#ifdef LINUX
+#include "test_server.h"
+#include "wan_relay.h"
+#endif
 
 #define PRINT_LOG [](const std::string& strLogMsg) { std::cout << strLogMsg << std::endl; }
 
@@ -101,6 +114,41 @@ class SFTPClientTest : public ::testing::Test {
    }
 };
 
+#ifdef LINUX
+// fixture for tests using their own in-process FTP server (see test_server.h)
+class EmbeddedServerTest : public ::testing::Test {
+  protected:
+   std::string m_strRootDir;
+   std::unique_ptr<CFTPTestServer> m_pServer;
+   std::unique_ptr<CFTPClient> m_pFTPClient;
+
+   virtual void SetUp() {
+      m_strRootDir = MakeTempDir();
+      ASSERT_FALSE(m_strRootDir.empty());
+      m_pServer.reset(new CFTPTestServer(m_strRootDir));
+      ASSERT_TRUE(m_pServer->Start());
+
+      m_pFTPClient.reset(new CFTPClient(PRINT_LOG));
+      m_pFTPClient->InitSession("127.0.0.1", m_pServer->GetPort(), m_pServer->GetUserName(), m_pServer->GetPassword(),
+                                CFTPClient::FTP_PROTOCOL::FTP, CFTPClient::SettingsFlag::ENABLE_LOG);
+   }
+
+   virtual void TearDown() {
+      if (m_pFTPClient.get() != nullptr) {
+         m_pFTPClient->CleanupSession();
+         m_pFTPClient.reset();
+      }
+      m_pServer.reset();
+      if (!m_strRootDir.empty()) RemoveDirTree(m_strRootDir);
+   }
+
+   std::string ReadLocal(const std::string& strPath) const {
+      std::ifstream ifsFile(m_strRootDir + strPath, std::ifstream::binary);
+      return std::string(std::istreambuf_iterator<char>(ifsFile), std::istreambuf_iterator<char>());
+   }
+};
+#endif
+
 // Unit tests
 
 // Tests without a fixture (testing setters/getters and init./cleanup session)
@@ -184,6 +232,702 @@ TEST(FTPClient, TestCleanUpWithoutInit) {
    ASSERT_FALSE(FTPClient.CleanupSession());
 }
 
+TEST(FTPClient, TestBuildURL) {
+   CFTPClient FTPClient(PRINT_LOG);
+   std::string strURL;
+
+   ASSERT_TRUE(FTPClient.InitSession("127.0.0.1", 21, "user", "password"));
+   FTPClient.BuildURL(strURL, "documents/info.txt");
+   EXPECT_EQ("ftp://127.0.0.1//documents//info.txt", strURL);
+   FTPClient.BuildURL(strURL, "");
+   EXPECT_EQ("ftp://127.0.0.1//", strURL);
+   FTPClient.BuildURL(strURL, "/my docs/100% #1?;type=a.txt");
+   EXPECT_EQ("ftp://127.0.0.1////my%20docs//100%25%20%231%3F%3Btype=a.txt", strURL);
+   FTPClient.BuildURL(strURL, "r\xC3\xA9sum\xC3\xA9 [v2] (old)'s+copy,~@x");
+   EXPECT_EQ("ftp://127.0.0.1//r%C3%A9sum%C3%A9%20%5Bv2%5D%20(old)'s+copy,~@x", strURL);
+   // the pattern is left to libcurl
+   FTPClient.BuildURL(strURL, "my docs/[ab]*.t?t", true);
+   EXPECT_EQ("ftp://127.0.0.1//my%20docs//[ab]*.t?t", strURL);
+   FTPClient.BuildURL(strURL, "a b*", true);
+   EXPECT_EQ("ftp://127.0.0.1//a%20b*", strURL);
+   EXPECT_TRUE(FTPClient.CleanupSession());
+
+   // scheme and path given with the host
+   ASSERT_TRUE(FTPClient.InitSession("ftps://example.com/base dir", 990, "user", "password"));
+   FTPClient.BuildURL(strURL, "info.txt");
+   EXPECT_EQ("ftps://example.com//base%20dir//info.txt", strURL);
+   EXPECT_TRUE(FTPClient.CleanupSession());
+
+   ASSERT_TRUE(FTPClient.InitSession("example.com", 22, "user", "password", CFTPClient::FTP_PROTOCOL::SFTP));
+   FTPClient.BuildURL(strURL, "info.txt");
+   EXPECT_EQ("sftp://example.com//info.txt", strURL);
+   EXPECT_TRUE(FTPClient.CleanupSession());
+}
+
+TEST(FTPClient, TestSnapshotDiff) {
+   std::vector<CFTPClient::RemoteEntry> vecEntries(3);
+   vecEntries[0].strPath   = "b/file2.txt";
+   vecEntries[0].llSize    = 20;
+   vecEntries[1].strPath   = "a.txt";
+   vecEntries[1].llSize    = 10;
+   vecEntries[2].strPath   = "b";
+   vecEntries[2].eFileType = CURLFILETYPE_DIRECTORY;
+
+   CFTPSnapshot oOld(vecEntries);
+   ASSERT_TRUE(oOld.Save("test_snapshot.snap"));
+
+   CFTPSnapshot oLoaded;
+   ASSERT_TRUE(oLoaded.Load("test_snapshot.snap"));
+   ASSERT_EQ(3u, oLoaded.GetEntryCount());
+   EXPECT_EQ("a.txt", oLoaded.GetEntry(0).strPath);  // records are sorted by path
+
+   CFTPClient::RemoteEntry oEntry;
+   ASSERT_TRUE(oLoaded.Find("b/file2.txt", oEntry));
+   EXPECT_EQ(20, oEntry.llSize);
+   EXPECT_FALSE(oLoaded.Find("c.txt", oEntry));
+
+   // a.txt is modified, b/file2.txt removed and c.txt added
+   vecEntries[0].strPath = "c.txt";
+   vecEntries[1].tMTime  = 1000;
+
+   CFTPSnapshot::DiffResult oDiff;
+   CFTPSnapshot::Diff(oLoaded, CFTPSnapshot(vecEntries), oDiff);
+   ASSERT_EQ(1u, oDiff.vecAdded.size());
+   ASSERT_EQ(1u, oDiff.vecRemoved.size());
+   ASSERT_EQ(1u, oDiff.vecChanged.size());
+   EXPECT_EQ("c.txt", oDiff.vecAdded[0].strPath);
+   EXPECT_EQ("b/file2.txt", oDiff.vecRemoved[0].strPath);
+   EXPECT_EQ("a.txt", oDiff.vecChanged[0].strPath);
+
+   CFTPSnapshot::Diff(oLoaded, oOld, oDiff);
+   EXPECT_TRUE(oDiff.Empty());
+
+   EXPECT_TRUE(remove("test_snapshot.snap") == 0);
+}
+
+TEST(FTPClient, TestWildcardFilter) {
+   EXPECT_TRUE(CFTPClient::WildcardFilter::GlobMatch("*.jpg", "holidays.jpg"));
+   EXPECT_FALSE(CFTPClient::WildcardFilter::GlobMatch("*.jpg", "holidays.jpg.part"));
+   EXPECT_TRUE(CFTPClient::WildcardFilter::GlobMatch("img_??[0-9].*", "img_ab7.png"));
+   EXPECT_FALSE(CFTPClient::WildcardFilter::GlobMatch("img_[!a]*", "img_a.png"));
+   EXPECT_TRUE(CFTPClient::WildcardFilter::GlobMatch("a*b*c", "aXbYbZc"));
+   EXPECT_TRUE(CFTPClient::WildcardFilter::GlobMatch("\\*", "*"));
+
+   CFTPClient::WildcardFilter oFilter;
+   oFilter.vecIncludeGlobs.push_back("*.txt");
+   oFilter.vecExcludeRegexes.push_back(std::regex("^tmp/"));
+   oFilter.llMaxSize  = 100;
+   oFilter.tNewerThan = 1000;
+
+   CFTPClient::RemoteEntry oEntry;
+   oEntry.eFileType = CURLFILETYPE_FILE;
+   oEntry.strPath   = "docs/readme.txt";
+   oEntry.llSize    = 10;
+   oEntry.tMTime    = 2000;
+   EXPECT_TRUE(oFilter.Matches(oEntry));
+
+   oEntry.llSize = 101;
+   EXPECT_FALSE(oFilter.Matches(oEntry));
+   oEntry.llSize = 10;
+   oEntry.tMTime = 500;
+   EXPECT_FALSE(oFilter.Matches(oEntry));
+   oEntry.tMTime  = 2000;
+   oEntry.strPath = "docs/readme.md";
+   EXPECT_FALSE(oFilter.Matches(oEntry));
+
+   // include rules and limits don't apply to folders, excludes do
+   oEntry.eFileType = CURLFILETYPE_DIRECTORY;
+   EXPECT_TRUE(oFilter.Matches(oEntry));
+   oEntry.strPath = "tmp/cache";
+   EXPECT_FALSE(oFilter.Matches(oEntry));
+
+   oEntry.strPath      = "docs";
+   oFilter.fnPredicate = [](const CFTPClient::RemoteEntry& oEntry) { return oEntry.eFileType != CURLFILETYPE_DIRECTORY; };
+   EXPECT_FALSE(oFilter.Matches(oEntry));
+}
+
+TEST(FTPClient, TestHash) {
+   const std::string strCheck = "123456789";
+   EXPECT_EQ("e3069283", CFTPHash::Compute(CFTPHash::Algorithm::CRC32C, strCheck.data(), strCheck.size()));
+   EXPECT_EQ("a9993e364706816aba3e25717850c26c9cd0d89d", CFTPHash::Compute(CFTPHash::Algorithm::SHA1, "abc", 3));
+   EXPECT_EQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", CFTPHash::Compute(CFTPHash::Algorithm::SHA256, "abc", 3));
+   EXPECT_EQ("ef46db3751d8e999", CFTPHash::Compute(CFTPHash::Algorithm::XXH64, "", 0));
+   EXPECT_EQ("44bc2cf5ad770999", CFTPHash::Compute(CFTPHash::Algorithm::XXH64, "abc", 3));
+   EXPECT_EQ("cbf43926", CFTPHash::Compute(CFTPHash::Algorithm::CRC32, strCheck.data(), strCheck.size()));
+   EXPECT_EQ("900150983cd24fb0d6963f7d28e17f72", CFTPHash::Compute(CFTPHash::Algorithm::MD5, "abc", 3));
+   EXPECT_TRUE(CFTPHash::Compute(CFTPHash::Algorithm::NONE, "abc", 3).empty());
+
+   // fed in odd-sized chunks, like the transfer callbacks do
+   const std::vector<char> vecData(1000000, 'a');
+   const CFTPHash::Algorithm arrAlgorithms[6] = {CFTPHash::Algorithm::CRC32C, CFTPHash::Algorithm::SHA1, CFTPHash::Algorithm::SHA256,
+                                                 CFTPHash::Algorithm::XXH64,  CFTPHash::Algorithm::CRC32, CFTPHash::Algorithm::MD5};
+   for (const auto eAlgorithm : arrAlgorithms) {
+      CFTPHash oHash(eAlgorithm);
+      for (size_t uOffset = 0; uOffset < vecData.size(); uOffset += 997)
+         oHash.Update(vecData.data() + uOffset, std::min<size_t>(997, vecData.size() - uOffset));
+      EXPECT_EQ(CFTPHash::Compute(eAlgorithm, vecData.data(), vecData.size()), oHash.Final()) << CFTPHash::GetName(eAlgorithm);
+   }
+   EXPECT_EQ("34aa973cd4c4daa4f61eeb2bdbad27316534016f", CFTPHash::Compute(CFTPHash::Algorithm::SHA1, vecData.data(), vecData.size()));
+   EXPECT_EQ("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+             CFTPHash::Compute(CFTPHash::Algorithm::SHA256, vecData.data(), vecData.size()));
+}
+
+TEST(FTPClient, TestZStream) {
+   if (!CFTPZStream::IsAvailable()) {
+      CFTPZStream oStream(CFTPZStream::Mode::DEFLATE);
+      EXPECT_FALSE(oStream.IsValid());
+      return;
+   }
+
+   std::string strData;
+   for (int i = 0; i < 20000; ++i) strData += "line " + std::to_string(i % 100) + " of the MODE Z test\n";
+
+   std::string strDeflated, strInflated;
+   CFTPZStream oDeflate(CFTPZStream::Mode::DEFLATE, 9);
+   for (size_t uOffset = 0; uOffset < strData.size(); uOffset += 997) {
+      ASSERT_TRUE(oDeflate.Process(strData.data() + uOffset, std::min<size_t>(997, strData.size() - uOffset), false,
+                                   [&strDeflated](const char* p, size_t n) { return strDeflated.append(p, n), true; }));
+   }
+   EXPECT_FALSE(oDeflate.IsFinished());
+   ASSERT_TRUE(oDeflate.Process(nullptr, 0, true, [&strDeflated](const char* p, size_t n) { return strDeflated.append(p, n), true; }));
+   EXPECT_TRUE(oDeflate.IsFinished());
+   EXPECT_LT(strDeflated.size() * 10, strData.size());
+
+   CFTPZStream oInflate(CFTPZStream::Mode::INFLATE);
+   for (size_t uOffset = 0; uOffset < strDeflated.size(); uOffset += 101) {
+      ASSERT_TRUE(oInflate.Process(strDeflated.data() + uOffset, std::min<size_t>(101, strDeflated.size() - uOffset), false,
+                                   [&strInflated](const char* p, size_t n) { return strInflated.append(p, n), true; }));
+   }
+   EXPECT_TRUE(oInflate.IsFinished());
+   EXPECT_EQ(strData, strInflated);
+
+   // corrupted stream
+   CFTPZStream oCorrupted(CFTPZStream::Mode::INFLATE);
+   EXPECT_FALSE(oCorrupted.Process(strData.data(), strData.size(), false, [](const char*, size_t) { return true; }));
+   EXPECT_FALSE(oCorrupted.IsValid());
+}
+
+TEST(FTPClient, TestPipeline) {
+   const std::string strText = "first line\r\nsecond line\r\n\r\nlone \r in a line\r\nlast line";
+
+   // every split position, a CRLF can be cut between two buffers
+   for (size_t uSplit = 0; uSplit <= strText.size(); ++uSplit) {
+      std::string strLF, strCRLF, strCopy;
+      CFTPStringSink oLFSink(strLF), oCRLFSink(strCRLF), oCopySink(strCopy);
+      CFTPHash oHash(CFTPHash::Algorithm::SHA1);
+
+      CFTPPipeline oToLF(oLFSink);
+      oToLF.Emplace<CFTPTeeStage>(oCopySink);
+      oToLF.Emplace<CFTPLineEndingStage>(CFTPLineEndingStage::Mode::TO_LF);
+      oToLF.Emplace<CFTPHashStage>(oHash);
+      CFTPPipeline oToCRLF(oCRLFSink);
+      oToCRLF.Emplace<CFTPLineEndingStage>(CFTPLineEndingStage::Mode::TO_CRLF);
+
+      for (auto* pPipeline : {&oToLF, &oToCRLF}) {
+         ASSERT_TRUE(pPipeline->Write(strText.data(), uSplit));
+         ASSERT_TRUE(pPipeline->Write(strText.data() + uSplit, strText.size() - uSplit));
+         ASSERT_TRUE(pPipeline->Finish());
+      }
+
+      EXPECT_EQ("first line\nsecond line\n\nlone \r in a line\nlast line", strLF) << uSplit;
+      EXPECT_EQ(strText, strCRLF) << uSplit;
+      EXPECT_EQ(strText, strCopy) << uSplit;
+      EXPECT_EQ(CFTPHash::Compute(CFTPHash::Algorithm::SHA1, strLF.data(), strLF.size()), oHash.Final());
+   }
+
+   std::string strCRLF;
+   CFTPStringSink oSink(strCRLF);
+   CFTPPipeline oPipeline(oSink);
+   oPipeline.Emplace<CFTPLineEndingStage>(CFTPLineEndingStage::Mode::TO_CRLF);
+   ASSERT_TRUE(oPipeline.Write("a\nb\n", 4) && oPipeline.Finish());
+   EXPECT_EQ("a\r\nb\r\n", strCRLF);
+
+   // a failing sink aborts the chain
+   CFTPFunctionSink oFailingSink([](const char*, size_t) { return false; });
+   CFTPPipeline oFailing(oFailingSink);
+   oFailing.Emplace<CFTPLineEndingStage>(CFTPLineEndingStage::Mode::TO_LF);
+   EXPECT_FALSE(oFailing.Write("abc", 3));
+
+   if (CFTPZStream::IsAvailable()) {
+      std::string strDeflated, strInflated;
+      CFTPZStream oDeflate(CFTPZStream::Mode::DEFLATE);
+      ASSERT_TRUE(oDeflate.Process(strText.data(), strText.size(), true,
+                                   [&strDeflated](const char* p, size_t n) { return strDeflated.append(p, n), true; }));
+
+      CFTPStringSink oInflatedSink(strInflated);
+      CFTPPipeline oInflate(oInflatedSink);
+      oInflate.Emplace<CFTPInflateStage>();
+      oInflate.Emplace<CFTPLineEndingStage>(CFTPLineEndingStage::Mode::TO_LF);
+      ASSERT_TRUE(oInflate.Write(strDeflated.data(), strDeflated.size() / 2));
+      EXPECT_FALSE(oInflate.Finish());  // truncated
+      ASSERT_TRUE(oInflate.Write(strDeflated.data() + strDeflated.size() / 2, strDeflated.size() - strDeflated.size() / 2));
+      ASSERT_TRUE(oInflate.Finish());
+      EXPECT_EQ("first line\nsecond line\n\nlone \r in a line\nlast line", strInflated);
+   }
+}
+
+TEST(FTPClient, TestRingBuffer) {
+   std::string strInput;
+   for (int i = 0; i < 100000; ++i) strInput += std::to_string(i) + ",";
+
+   /* much smaller than the data : the producer waits for the consumer */
+   CFTPRingBuffer oBuffer(1000);
+   std::thread oProducer([&]() {
+      for (size_t uPos = 0; uPos < strInput.size(); uPos += 777) oBuffer.Write(strInput.data() + uPos, std::min<size_t>(777, strInput.size() - uPos));
+      oBuffer.Finish();
+   });
+
+   std::string strOutput;
+   char szChunk[300];
+   size_t uRead;
+   while ((uRead = CFTPRingBuffer::ReadCallback(szChunk, 1, sizeof(szChunk), &oBuffer)) > 0) strOutput.append(szChunk, uRead);
+   oProducer.join();
+   EXPECT_EQ(strInput, strOutput);
+
+   /* a cancelled consumer unblocks the producer, an aborted producer fails the consumer */
+   CFTPRingBuffer oCancelled(10);
+   std::thread oBlocked([&]() { EXPECT_FALSE(oCancelled.Write(strInput.data(), 100)); });
+   oCancelled.Cancel();
+   oBlocked.join();
+
+   CFTPRingBuffer oAborted(10);
+   oAborted.Abort();
+   EXPECT_EQ(size_t(CURL_READFUNC_ABORT), CFTPRingBuffer::ReadCallback(szChunk, 1, sizeof(szChunk), &oAborted));
+}
+
+TEST(FTPClient, TestMetrics) {
+   /* the upper bounds are inclusive and increasing */
+   EXPECT_EQ(0u, CFTPMetrics::GetBucketIndex(0));
+   EXPECT_EQ(0u, CFTPMetrics::GetBucketIndex(256));
+   EXPECT_EQ(1u, CFTPMetrics::GetBucketIndex(257));
+   for (size_t i = 0; i + 1 < CFTPMetrics::HISTOGRAM_BUCKETS; ++i) {
+      const uint64_t ullBound = CFTPMetrics::GetBucketUpperBound(i);
+      EXPECT_EQ(i, CFTPMetrics::GetBucketIndex(ullBound));
+      EXPECT_EQ(i + 1, CFTPMetrics::GetBucketIndex(ullBound + 1));
+   }
+   EXPECT_EQ(CFTPMetrics::HISTOGRAM_BUCKETS - 1, CFTPMetrics::GetBucketIndex(uint64_t(1) << 40));
+
+   /* each thread has its own shard, they are merged on read */
+   CFTPMetrics &oMetrics  = CFTPMetrics::GetInstance();
+   const size_t uHost     = oMetrics.GetHostIndex("metrics.test:21");
+   EXPECT_EQ(uHost, oMetrics.GetHostIndex("metrics.test:21"));
+
+   std::vector<std::thread> vecThreads;
+   for (unsigned t = 0; t < 4; ++t) {
+      vecThreads.emplace_back([&oMetrics, uHost, t]() {
+         for (unsigned i = 0; i < 1000; ++i) {
+            CFTPMetrics::Sample oSample;
+            oSample.bSucceeded         = (i % 10 != 0);
+            oSample.ullDurationUs      = 1000 * (t + 1);
+            oSample.ullBytesDownloaded = 10;
+            oSample.uNewConnections    = (i == 0) ? 1 : 0;
+            oSample.ullConnectUs       = 500;
+            oMetrics.Record(CFTPMetrics::Operation::DOWNLOAD, uHost, oSample);
+         }
+      });
+   }
+   for (auto& oThread : vecThreads) oThread.join();
+
+   const CFTPMetrics::Counters oCounters = oMetrics.Get(CFTPMetrics::Operation::DOWNLOAD, "metrics.test:21");
+   EXPECT_EQ(4000u, oCounters.ullRequests);
+   EXPECT_EQ(400u, oCounters.ullFailures);
+   EXPECT_EQ(40000u, oCounters.ullBytesDownloaded);
+   EXPECT_EQ(4u, oCounters.ullConnections);
+   EXPECT_EQ(4000u, oCounters.oDuration.ullCount);
+   EXPECT_EQ(10000000u, oCounters.oDuration.ullSumUs);
+   EXPECT_EQ(1000u, oCounters.oDuration.vecBuckets[CFTPMetrics::GetBucketIndex(3000)]);
+   EXPECT_EQ(4u, oCounters.oConnect.ullCount);
+   EXPECT_EQ(0u, oMetrics.Get(CFTPMetrics::Operation::UPLOAD, "metrics.test:21").ullRequests);
+
+   const std::string strText = oMetrics.ToPrometheus();
+   EXPECT_NE(std::string::npos, strText.find("# TYPE ftpclient_request_duration_seconds histogram\n"));
+   EXPECT_NE(std::string::npos, strText.find("ftpclient_requests_total{operation=\"download\",host=\"metrics.test:21\"} 4000\n"));
+   EXPECT_NE(std::string::npos, strText.find("ftpclient_request_duration_seconds_bucket{operation=\"download\",host=\"metrics.test:21\",le=\"0.001024\"} 1000\n"));
+   EXPECT_NE(std::string::npos, strText.find("ftpclient_request_duration_seconds_bucket{operation=\"download\",host=\"metrics.test:21\",le=\"+Inf\"} 4000\n"));
+   EXPECT_NE(std::string::npos, strText.find("ftpclient_request_duration_seconds_sum{operation=\"download\",host=\"metrics.test:21\"} 10\n"));
+}
+
+TEST(FTPClient, TestTrace) {
+   CFTPTrace oTrace(4);
+   EXPECT_TRUE(oTrace.Dump().empty());
+
+   char szPass[] = "PASS secret\r\n";
+   char szReply[] = "230 Logged in\r\n";
+   CFTPTrace::DebugCallback(nullptr, CURLINFO_HEADER_OUT, szPass, strlen(szPass), &oTrace);
+   CFTPTrace::DebugCallback(nullptr, CURLINFO_HEADER_IN, szReply, strlen(szReply), &oTrace);
+   /* consecutive chunks are merged, encrypted data is ignored */
+   for (int i = 0; i < 10; ++i) CFTPTrace::DebugCallback(nullptr, CURLINFO_DATA_IN, nullptr, 100, &oTrace);
+   CFTPTrace::DebugCallback(nullptr, CURLINFO_SSL_DATA_IN, nullptr, 100, &oTrace);
+   EXPECT_EQ(3u, oTrace.GetCount());
+
+   std::string strDump = oTrace.Dump();
+   EXPECT_EQ(std::string::npos, strDump.find("secret"));
+   EXPECT_NE(std::string::npos, strDump.find(" -> PASS ****\n"));
+   EXPECT_NE(std::string::npos, strDump.find(" <- 230 Logged in\n"));
+   EXPECT_NE(std::string::npos, strDump.find(" <= 1000 bytes (10 chunks in "));
+
+   /* only the last records are kept */
+   char szCommand[] = "NOOP";
+   for (int i = 0; i < 3; ++i) CFTPTrace::DebugCallback(nullptr, CURLINFO_HEADER_OUT, szCommand, strlen(szCommand), &oTrace);
+   strDump = oTrace.Dump();
+   EXPECT_EQ(std::string::npos, strDump.find("PASS"));
+   EXPECT_EQ(4, std::count(strDump.begin(), strDump.end(), '\n'));
+
+   /* dumps while a thread writes only return complete records */
+   CFTPTrace oConcurrent(64);
+   std::atomic<bool> bDone(false);
+   std::thread oWriter([&]() {
+      char szLine[] = "RETR abcdefghijklmnopqrstuvwxyz";
+      for (int i = 0; i < 200000; ++i) oConcurrent.Add(CFTPTrace::RecordType::COMMAND, szLine, strlen(szLine));
+      bDone = true;
+   });
+   while (!bDone) {
+      std::istringstream issDump(oConcurrent.Dump());
+      std::string strLine;
+      while (std::getline(issDump, strLine)) {
+         ASSERT_GT(strLine.size(), 31u);
+         EXPECT_EQ("-> RETR abcdefghijklmnopqrstuvwxyz", strLine.substr(strLine.size() - 34));
+      }
+   }
+   oWriter.join();
+}
+
+TEST(FTPClient, TestLogSink) {
+   std::mutex mtxLogs;
+   std::vector<std::string> vecLogs;
+   auto fnOutput = [&](const std::string& strMessage) {
+      std::lock_guard<std::mutex> lock(mtxLogs);
+      vecLogs.push_back(strMessage);
+   };
+
+   {
+      CFTPLogSink oSink(fnOutput);
+      /* the C strings are copied, the formatting is done later by the sink's thread */
+      {
+         std::string strFile("file.txt");
+         char szCommand[] = "RETR";
+         ASSERT_TRUE(oSink.Push("%s %s failed (%d)", szCommand, strFile.c_str(), 550));
+         szCommand[0] = 'X';
+         strFile      = "overwritten";
+      }
+      std::vector<std::thread> vecThreads;
+      for (int i = 0; i < 4; ++i)
+         vecThreads.emplace_back([&oSink, i]() {
+            for (int j = 0; j < 500; ++j) oSink.Push("thread %d message %d", i, j);
+         });
+      for (auto& oThread : vecThreads) oThread.join();
+      oSink.Flush();
+
+      std::lock_guard<std::mutex> lock(mtxLogs);
+      ASSERT_EQ(2001u, vecLogs.size());
+      EXPECT_EQ("RETR file.txt failed (550)", vecLogs[0]);
+      EXPECT_EQ(1, std::count(vecLogs.begin(), vecLogs.end(), "thread 3 message 499"));
+      EXPECT_EQ(0u, oSink.GetDropped());
+   }
+
+   /* messages are dropped, not waited for, when the queue is full */
+   vecLogs.clear();
+   std::atomic<bool> bBlocked(true);
+   {
+      CFTPLogSink oSink(
+          [&](const std::string& strMessage) {
+             while (bBlocked) std::this_thread::yield();
+             fnOutput(strMessage);
+          },
+          2);
+      unsigned uPushed = 0;
+      for (int i = 0; i < 10; ++i) uPushed += oSink.Push("message %d", i) ? 1 : 0;
+      EXPECT_LE(uPushed, 3u);
+      EXPECT_EQ(10u - uPushed, oSink.GetDropped());
+      /* the destructor writes the queued messages */
+      bBlocked = false;
+   }
+   EXPECT_EQ("message 0", vecLogs.front());
+   EXPECT_LE(vecLogs.size(), 3u);
+}
+
+TEST(FTPClient, TestRateEstimator) {
+   CFTPRateEstimator oEstimator(3.0);
+   EXPECT_EQ(0, oEstimator.GetRate());
+   EXPECT_EQ(-1, oEstimator.GetEta(0, 1000));
+
+   /* the time before the first byte is ignored */
+   oEstimator.Update(0.0, 0);
+   oEstimator.Update(1.0, 0);
+   oEstimator.Update(1.5, 500);
+   EXPECT_DOUBLE_EQ(1000, oEstimator.GetRate());
+   oEstimator.Update(2.5, 1500);
+   EXPECT_DOUBLE_EQ(1000, oEstimator.GetRate());
+   EXPECT_DOUBLE_EQ(1, oEstimator.GetEta(1500, 2500));
+   EXPECT_EQ(-1, oEstimator.GetEta(1500, 0));
+   EXPECT_EQ(0, oEstimator.GetEta(2500, 2500));
+
+   /* a stall during one time constant */
+   oEstimator.Update(5.5, 1500);
+   EXPECT_NEAR(1000 * std::exp(-1.0), oEstimator.GetRate(), 1e-9);
+   /* too short measures are merged with the next one */
+   oEstimator.Update(5.51, 2500);
+   EXPECT_NEAR(1000 * std::exp(-1.0), oEstimator.GetRate(), 1e-9);
+
+   /* a new transfer */
+   oEstimator.Update(6.0, 100);
+   oEstimator.Update(7.0, 300);
+   EXPECT_DOUBLE_EQ(200, oEstimator.GetRate());
+}
+
+TEST(FTPClient, TestProgressSnapshot) {
+   CFTPProgressSnapshot oSnapshot;
+   EXPECT_EQ(CFTPProgressSnapshot::State::IDLE, oSnapshot.Load().eState);
+   EXPECT_EQ(0u, oSnapshot.Load().ullVersion);
+
+   /* a reader never gets the values of different updates */
+   std::atomic<bool> bDone(false);
+   std::thread oWriter([&]() {
+      CFTPProgressSnapshot::Values oValues;
+      oValues.eState = CFTPProgressSnapshot::State::RUNNING;
+      for (int i = 1; i <= 200000; ++i) {
+         oValues.llBytesDone     = i;
+         oValues.llBytesTotal    = 2 * static_cast<curl_off_t>(i);
+         oValues.dRate           = 3.0 * i;
+         oValues.ullSessionBytes = 4 * static_cast<uint64_t>(i);
+         oSnapshot.Store(oValues);
+      }
+      bDone = true;
+   });
+   uint64_t ullLastVersion = 0;
+   while (!bDone) {
+      const CFTPProgressSnapshot::Values oValues = oSnapshot.Load();
+      EXPECT_GE(oValues.ullVersion, ullLastVersion);
+      ullLastVersion = oValues.ullVersion;
+      if (oValues.ullVersion == 0) continue;
+      ASSERT_EQ(static_cast<curl_off_t>(oValues.ullVersion), oValues.llBytesDone);
+      ASSERT_EQ(2 * oValues.llBytesDone, oValues.llBytesTotal);
+      ASSERT_EQ(3.0 * oValues.llBytesDone, oValues.dRate);
+      ASSERT_EQ(4 * static_cast<uint64_t>(oValues.llBytesDone), oValues.ullSessionBytes);
+   }
+   oWriter.join();
+   EXPECT_EQ(200000u, oSnapshot.Load().ullVersion);
+
+   CFTPJobProgress oJob;
+   EXPECT_EQ(CFTPJobProgress::State::IDLE, oJob.Load().eState);
+   oJob.Start(3, 1000);
+   oJob.AddBytes(400);
+   oJob.TaskDone(true);
+   oJob.TaskDone(false);
+   CFTPJobProgress::Values oValues = oJob.Load();
+   EXPECT_EQ(CFTPJobProgress::State::RUNNING, oValues.eState);
+   EXPECT_EQ(3u, oValues.ullTasks);
+   EXPECT_EQ(2u, oValues.ullTasksDone);
+   EXPECT_EQ(1u, oValues.ullTasksFailed);
+   EXPECT_EQ(400u, oValues.ullBytesDone);
+   EXPECT_GE(oValues.dElapsed, 0);
+   oJob.TaskDone(true);
+   oJob.Finish(false);
+   oValues = oJob.Load();
+   EXPECT_EQ(CFTPJobProgress::State::FAILED, oValues.eState);
+   EXPECT_EQ(3u, oValues.ullTasksDone);
+   /* the elapsed time stops with the job */
+   EXPECT_EQ(oValues.dElapsed, oJob.Load().dElapsed);
+}
+
+#ifdef LINUX
+TEST_F(EmbeddedServerTest, TestCommands) {
+   /* USER/PASS */
+   CFTPClient oIntruder(PRINT_LOG);
+   ASSERT_TRUE(oIntruder.InitSession("127.0.0.1", m_pServer->GetPort(), m_pServer->GetUserName(), "wrong password"));
+   std::string strList;
+   EXPECT_FALSE(oIntruder.List("/", strList));
+   oIntruder.CleanupSession();
+
+   /* MKD, STOR, SIZE/MDTM */
+   ASSERT_TRUE(m_pFTPClient->CreateDir("/docs"));
+   std::istringstream issContent("hello world");
+   ASSERT_TRUE(m_pFTPClient->UploadFile(issContent, "/docs/a.txt", false, 11));
+   EXPECT_EQ("hello world", ReadLocal("/docs/a.txt"));
+   CFTPClient::FileInfo oInfo = {0, 0.0};
+   ASSERT_TRUE(m_pFTPClient->Info("/docs/a.txt", oInfo));
+   EXPECT_EQ(11, oInfo.dFileSize);
+   EXPECT_GT(oInfo.tFileMTime, 0);
+
+   /* APPE */
+   std::ofstream("embedded_append.txt", std::ofstream::binary) << "hello world, appended";
+   CFTPClient::TransferOptions oOptions;
+   oOptions.eResume = CFTPClient::ResumeMode::AUTO;
+   ASSERT_TRUE(m_pFTPClient->UploadFile("embedded_append.txt", "/docs/a.txt", false, oOptions));
+   EXPECT_EQ(11, oOptions.llResumedFrom);
+   EXPECT_EQ("hello world, appended", ReadLocal("/docs/a.txt"));
+   EXPECT_EQ(0, remove("embedded_append.txt"));
+
+   /* RETR */
+   std::vector<char> vecData;
+   ASSERT_TRUE(m_pFTPClient->DownloadFile("/docs/a.txt", vecData));
+   EXPECT_EQ("hello world, appended", std::string(vecData.begin(), vecData.end()));
+
+   /* NLST, LIST, MLSD */
+   ASSERT_TRUE(m_pFTPClient->List("/docs/", strList, true));
+   EXPECT_EQ("a.txt", strList.substr(0, strList.find_first_of("\r\n")));
+   ASSERT_TRUE(m_pFTPClient->List("/docs/", strList, false));
+   EXPECT_NE(std::string::npos, strList.find(" a.txt"));
+   std::vector<CFTPClient::RemoteEntry> vecEntries;
+   ASSERT_TRUE(m_pFTPClient->Walk("/", vecEntries));
+   ASSERT_EQ(2u, vecEntries.size());
+
+   /* RNFR/RNTO, DELE, RMD */
+   std::vector<CFTPClient::CommandResult> vecResults;
+   ASSERT_TRUE(m_pFTPClient->Rename({{"/docs/a.txt", "/docs/b.txt"}}, vecResults));
+   EXPECT_EQ("hello world, appended", ReadLocal("/docs/b.txt"));
+   EXPECT_TRUE(m_pFTPClient->RemoveFile("/docs/b.txt"));
+   EXPECT_TRUE(m_pFTPClient->RemoveDir("/docs"));
+   struct stat st;
+   EXPECT_NE(0, stat((m_strRootDir + "/docs").c_str(), &st));
+
+   EXPECT_GE(m_pServer->GetSessionsCount(), 2u);
+}
+
+TEST_F(EmbeddedServerTest, TestReservedCharacters) {
+   const std::string strName = "/100% #1?;type=a [draft].txt";
+   std::istringstream issContent("reserved");
+   ASSERT_TRUE(m_pFTPClient->UploadFile(issContent, strName, false, 8));
+   EXPECT_EQ("reserved", ReadLocal(strName));
+
+   std::vector<char> vecData;
+   ASSERT_TRUE(m_pFTPClient->DownloadFile(strName, vecData));
+   EXPECT_EQ("reserved", std::string(vecData.begin(), vecData.end()));
+   CFTPClient::FileInfo oInfo = {0, 0.0};
+   ASSERT_TRUE(m_pFTPClient->Info(strName, oInfo));
+   EXPECT_EQ(8, oInfo.dFileSize);
+   EXPECT_TRUE(m_pFTPClient->RemoveFile(strName));
+}
+
+TEST_F(EmbeddedServerTest, TestRemoteHashReplies) {
+   std::ofstream(m_strRootDir + "/hashed.txt", std::ofstream::binary) << "remote hash";
+   std::string strExpected;
+   ASSERT_TRUE(CFTPHash::ComputeFile(CFTPHash::Algorithm::CRC32, m_strRootDir + "/hashed.txt", strExpected));
+   ASSERT_EQ(CFTPHash::Algorithm::SHA256, m_pFTPClient->GetRemoteHashAlgorithm());
+
+   /* a new control connection : the greeting and the login replies are received with the checksum */
+   m_pServer->SetWelcomeMessage("FTP server abc ready.");
+   const unsigned uPort = m_pServer->GetPort();
+   m_pServer->Stop();
+   ASSERT_TRUE(m_pServer->Start(uPort));
+
+   std::string strHash;
+   ASSERT_TRUE(m_pFTPClient->RemoteHash("/hashed.txt", CFTPHash::Algorithm::CRC32, strHash));
+   EXPECT_EQ(strExpected, strHash);
+   EXPECT_FALSE(m_pFTPClient->RemoteHash("/missing.txt", CFTPHash::Algorithm::CRC32, strHash));
+   EXPECT_TRUE(strHash.empty());
+}
+
+TEST_F(EmbeddedServerTest, TestCopyFallbackLogLevel) {
+   std::vector<std::string> vecLogs;
+   CFTPClient oClient([&](const std::string& strMessage) { vecLogs.push_back(strMessage); });
+   ASSERT_TRUE(oClient.InitSession("127.0.0.1", m_pServer->GetPort(), m_pServer->GetUserName(), m_pServer->GetPassword(),
+                                   CFTPClient::FTP_PROTOCOL::FTP, CFTPClient::ENABLE_LOG));
+   const std::string strInvalidFile = "/copy.txt\r\nDELE /source.txt";
+
+   /* CopyMode::AUTO : the FXP failure is recovered by the relay (which fails too here) */
+   oClient.SetLogLevel(CFTPClient::LogLevel::WARN);
+   EXPECT_FALSE(CFTPClient::CopyBetweenServers(oClient, "/source.txt", oClient, strInvalidFile));
+   ASSERT_FALSE(vecLogs.empty());
+   EXPECT_EQ(0u, vecLogs[0].find("[FTPClient][Warning] FXP copy of /source.txt"));
+   vecLogs.clear();
+   oClient.SetLogLevel(CFTPClient::LogLevel::ERR);
+   EXPECT_FALSE(CFTPClient::CopyBetweenServers(oClient, "/source.txt", oClient, strInvalidFile));
+   for (const auto& strLog : vecLogs) EXPECT_EQ(std::string::npos, strLog.find("FXP copy")) << strLog;
+
+   /* CopyMode::FXP : the call fails */
+   vecLogs.clear();
+   EXPECT_FALSE(CFTPClient::CopyBetweenServers(oClient, "/source.txt", oClient, strInvalidFile, CFTPClient::CopyMode::FXP));
+   ASSERT_EQ(1u, vecLogs.size());
+   EXPECT_EQ(0u, vecLogs[0].find("[FTPClient][Error] FXP copy of /source.txt"));
+   oClient.CleanupSession();
+}
+
+TEST_F(EmbeddedServerTest, TestFailedResumeKeepsLocalFile) {
+   std::ofstream(m_strRootDir + "/data.bin", std::ofstream::binary) << std::string(256 * 1024, 'n');
+   const std::string strLocalFile = m_strRootDir + "_previous.bin";
+   std::ofstream(strLocalFile, std::ofstream::binary) << "previous copy";
+
+   /* no MDTM : the partial file can't be identified, the download times out (64 KiB/s) */
+   m_pServer->SetMDTMEnabled(false);
+   CWanRelay::Conditions oConditions;
+   oConditions.ullBytesPerSecond = 64 * 1024;
+   CWanRelay oRelay("127.0.0.1", m_pServer->GetPort(), oConditions);
+   ASSERT_TRUE(oRelay.Start());
+
+   CFTPClient oClient(PRINT_LOG);
+   ASSERT_TRUE(oClient.InitSession("127.0.0.1", oRelay.GetPort(), m_pServer->GetUserName(), m_pServer->GetPassword()));
+   oClient.SetTimeout(1);
+   CFTPClient::TransferOptions oOptions;
+   oOptions.eResume = CFTPClient::ResumeMode::AUTO;
+   EXPECT_FALSE(oClient.DownloadFile(strLocalFile, "/data.bin", oOptions));
+
+   std::ifstream ifsLocal(strLocalFile, std::ifstream::binary);
+   EXPECT_EQ("previous copy", std::string(std::istreambuf_iterator<char>(ifsLocal), std::istreambuf_iterator<char>()));
+   ifsLocal.close();
+   EXPECT_FALSE(std::ifstream(strLocalFile + ".part"));
+   EXPECT_FALSE(std::ifstream(strLocalFile + ".part.info"));
+
+   /* the remote size and mtime can't be recorded (a directory has the name) : nothing is kept either */
+   m_pServer->SetMDTMEnabled(true);
+   ASSERT_EQ(0, mkdir((strLocalFile + ".part.info").c_str(), 0755));
+   EXPECT_FALSE(oClient.DownloadFile(strLocalFile, "/data.bin", oOptions));
+   EXPECT_FALSE(std::ifstream(strLocalFile + ".part"));
+   rmdir((strLocalFile + ".part.info").c_str());
+
+   /* with MDTM, the partial file is kept and continued by the next call */
+   EXPECT_FALSE(oClient.DownloadFile(strLocalFile, "/data.bin", oOptions));
+   oClient.CleanupSession();
+   oRelay.Stop();
+   EXPECT_TRUE(std::ifstream(strLocalFile + ".part.info"));
+
+   ASSERT_TRUE(m_pFTPClient->DownloadFile(strLocalFile, "/data.bin", oOptions));
+   EXPECT_GT(oOptions.llResumedFrom, 0);
+   ifsLocal.open(strLocalFile, std::ifstream::binary);
+   EXPECT_EQ(std::string(256 * 1024, 'n'), std::string(std::istreambuf_iterator<char>(ifsLocal), std::istreambuf_iterator<char>()));
+   ifsLocal.close();
+   EXPECT_FALSE(std::ifstream(strLocalFile + ".part.info"));
+   EXPECT_EQ(0, remove(strLocalFile.c_str()));
+}
+
+TEST_F(EmbeddedServerTest, TestWanRelay) {
+   std::ofstream(m_strRootDir + "/data.bin", std::ofstream::binary) << std::string(256 * 1024, 'w');
+
+   CWanRelay::Conditions oConditions;
+   oConditions.uRttMs = 100;
+   CWanRelay oRelay("127.0.0.1", m_pServer->GetPort(), oConditions);
+   ASSERT_TRUE(oRelay.Start());
+
+   CFTPClient oClient(PRINT_LOG);
+   ASSERT_TRUE(oClient.InitSession("127.0.0.1", oRelay.GetPort(), m_pServer->GetUserName(), m_pServer->GetPassword()));
+
+   /* the login and the informations need several round trips */
+   auto tStart                = std::chrono::steady_clock::now();
+   CFTPClient::FileInfo oInfo = {0, 0.0};
+   ASSERT_TRUE(oClient.Info("/data.bin", oInfo));
+   EXPECT_EQ(256 * 1024, oInfo.dFileSize);
+   EXPECT_GE(std::chrono::steady_clock::now() - tStart, std::chrono::milliseconds(300));
+
+   /* the passive data connection goes through the relay too */
+   std::vector<char> vecData;
+   ASSERT_TRUE(oClient.DownloadFile("/data.bin", vecData));
+   EXPECT_EQ(256u * 1024u, vecData.size());
+   EXPECT_EQ(2u, oRelay.GetConnectionsCount());
+
+   /* bandwidth cap of the next data connection : 256 KiB at 512 KiB/s */
+   oConditions.uRttMs            = 0;
+   oConditions.ullBytesPerSecond = 512 * 1024;
+   oRelay.SetConditions(oConditions);
+   tStart = std::chrono::steady_clock::now();
+   ASSERT_TRUE(oClient.DownloadFile("/data.bin", vecData));
+   EXPECT_EQ(256u * 1024u, vecData.size());
+   EXPECT_GE(std::chrono::steady_clock::now() - tStart, std::chrono::milliseconds(400));
+
+   oClient.CleanupSession();
+   oRelay.Stop();
+}
+#endif
+
 TEST(FTPClient, TestMultithreading) {
    const char* arrDataArray[3] = {"Thread 1", "Thread 2", "Thread 3"};
 
@@ -235,6 +979,689 @@ TEST_F(FTPClientTest, TestDownloadFile) {
       std::cout << "FTP tests are disabled !" << std::endl;
 }
 
+TEST_F(FTPClientTest, TestTransferHash) {
+   if (FTP_TEST_ENABLED) {
+      {
+         std::ofstream ofTestUpload("test_hash.txt", std::ofstream::binary);
+         for (int i = 0; i < 10000; ++i) ofTestUpload << "line " << i << " of the streaming hash test\n";
+      }
+
+      CFTPClient::TransferOptions oOptions;
+      oOptions.eHashAlgorithm = CFTPHash::Algorithm::SHA256;
+      ASSERT_TRUE(m_pFTPClient->UploadFile("test_hash.txt", FTP_REMOTE_UPLOAD_FOLDER + "test_hash.txt", false, oOptions));
+
+      std::string strExpected;
+      ASSERT_TRUE(CFTPHash::ComputeFile(CFTPHash::Algorithm::SHA256, "test_hash.txt", strExpected));
+      EXPECT_EQ(strExpected, oOptions.strHash);
+
+      oOptions.eHashAlgorithm = CFTPHash::Algorithm::SHA1;
+      ASSERT_TRUE(m_pFTPClient->DownloadFile("downloaded_hash.txt", FTP_REMOTE_UPLOAD_FOLDER + "test_hash.txt", oOptions));
+      std::string strSha1Sum = sha1sum("test_hash.txt");
+      std::transform(strSha1Sum.begin(), strSha1Sum.end(), strSha1Sum.begin(), ::tolower);
+      EXPECT_EQ(strSha1Sum, oOptions.strHash);
+
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(FTP_REMOTE_UPLOAD_FOLDER + "test_hash.txt"));
+      EXPECT_TRUE(remove("test_hash.txt") == 0);
+      EXPECT_TRUE(remove("downloaded_hash.txt") == 0);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestResumeDownload) {
+   if (FTP_TEST_ENABLED) {
+      std::string strContent;
+      for (int i = 0; i < 10000; ++i) strContent += "line " + std::to_string(i) + " of the resume test\n";
+      std::ofstream("test_resume.txt", std::ofstream::binary) << strContent;
+
+      ASSERT_TRUE(m_pFTPClient->UploadFile("test_resume.txt", FTP_REMOTE_UPLOAD_FOLDER + "test_resume.txt"));
+      CFTPClient::FileInfo oInfo = {0, 0.0};
+      ASSERT_TRUE(m_pFTPClient->Info(FTP_REMOTE_UPLOAD_FOLDER + "test_resume.txt", oInfo));
+
+      /* partial file left by a killed process, with the remote size and mtime recorded when it was created */
+      std::ofstream("downloaded_resume.txt.part", std::ofstream::binary) << strContent.substr(0, 1000);
+      std::ofstream("downloaded_resume.txt.part.info") << static_cast<long long>(oInfo.dFileSize) << ' '
+                                                       << static_cast<long long>(oInfo.tFileMTime) << '\n';
+
+      CFTPClient::TransferOptions oOptions;
+      oOptions.eResume        = CFTPClient::ResumeMode::AUTO;
+      oOptions.eHashAlgorithm = CFTPHash::Algorithm::SHA256;
+      ASSERT_TRUE(m_pFTPClient->DownloadFile("downloaded_resume.txt", FTP_REMOTE_UPLOAD_FOLDER + "test_resume.txt", oOptions));
+      EXPECT_EQ(1000, oOptions.llResumedFrom);
+
+      std::string strExpected;
+      ASSERT_TRUE(CFTPHash::ComputeFile(CFTPHash::Algorithm::SHA256, "test_resume.txt", strExpected));
+      EXPECT_EQ(strExpected, oOptions.strHash);
+      std::ifstream ifsDownloaded("downloaded_resume.txt", std::ifstream::binary);
+      EXPECT_EQ(strContent, std::string(std::istreambuf_iterator<char>(ifsDownloaded), std::istreambuf_iterator<char>()));
+      ifsDownloaded.close();
+      EXPECT_FALSE(std::ifstream("downloaded_resume.txt.part"));
+      EXPECT_FALSE(std::ifstream("downloaded_resume.txt.part.info"));
+
+      /* a partial file of a previous version of the remote file is discarded */
+      std::ofstream("downloaded_resume.txt.part", std::ofstream::binary) << "stale content";
+      std::ofstream("downloaded_resume.txt.part.info") << static_cast<long long>(oInfo.dFileSize) << ' '
+                                                       << static_cast<long long>(oInfo.tFileMTime - 3600) << '\n';
+      ASSERT_TRUE(m_pFTPClient->DownloadFile("downloaded_resume.txt", FTP_REMOTE_UPLOAD_FOLDER + "test_resume.txt", oOptions));
+      EXPECT_EQ(0, oOptions.llResumedFrom);
+      EXPECT_EQ(strExpected, oOptions.strHash);
+      EXPECT_FALSE(std::ifstream("downloaded_resume.txt.part.info"));
+
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(FTP_REMOTE_UPLOAD_FOLDER + "test_resume.txt"));
+      EXPECT_TRUE(remove("test_resume.txt") == 0);
+      EXPECT_TRUE(remove("downloaded_resume.txt") == 0);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestResumeUpload) {
+   if (FTP_TEST_ENABLED) {
+      std::string strContent;
+      for (int i = 0; i < 10000; ++i) strContent += "line " + std::to_string(i) + " of the resumed upload test\n";
+      std::ofstream("test_resume_upload.txt", std::ofstream::binary) << strContent;
+      const std::string strRemoteFile = FTP_REMOTE_UPLOAD_FOLDER + "test_resume_upload.txt";
+
+      /* interrupted upload */
+      std::istringstream issPrefix(strContent.substr(0, 1000));
+      ASSERT_TRUE(m_pFTPClient->UploadFile(issPrefix, strRemoteFile, false, 1000));
+
+      CFTPClient::TransferOptions oOptions;
+      oOptions.eResume           = CFTPClient::ResumeMode::AUTO_HASH;
+      oOptions.bVerifyRemoteHash = true;
+      ASSERT_TRUE(m_pFTPClient->UploadFile("test_resume_upload.txt", strRemoteFile, false, oOptions));
+      EXPECT_EQ(1000, oOptions.llResumedFrom);
+      EXPECT_EQ(CFTPHash::Compute(oOptions.eHashAlgorithm, strContent.data(), strContent.size()), oOptions.strHash);
+
+      /* the remote part differs from the local file */
+      std::istringstream issOther(std::string(1000, 'x'));
+      ASSERT_TRUE(m_pFTPClient->UploadFile(issOther, strRemoteFile, false, 1000));
+      ASSERT_TRUE(m_pFTPClient->UploadFile("test_resume_upload.txt", strRemoteFile, false, oOptions));
+      EXPECT_EQ(0, oOptions.llResumedFrom);
+
+      std::vector<char> vecDownloaded;
+      ASSERT_TRUE(m_pFTPClient->DownloadFile(strRemoteFile, vecDownloaded));
+      EXPECT_EQ(strContent, std::string(vecDownloaded.begin(), vecDownloaded.end()));
+
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(strRemoteFile));
+      EXPECT_TRUE(remove("test_resume_upload.txt") == 0);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestAtomicUpload) {
+   if (FTP_TEST_ENABLED) {
+      std::string strContent;
+      for (int i = 0; i < 10000; ++i) strContent += "line " + std::to_string(i) + " of the atomic upload test\n";
+      std::ofstream("test_atomic.txt", std::ofstream::binary) << strContent;
+      const std::string strRemoteFile = FTP_REMOTE_UPLOAD_FOLDER + "test_atomic.txt";
+
+      /* temporary file left by an interrupted upload */
+      std::istringstream issPrefix(strContent.substr(0, 1000));
+      ASSERT_TRUE(m_pFTPClient->UploadFile(issPrefix, strRemoteFile + ".part", false, 1000));
+
+      CFTPClient::TransferOptions oOptions;
+      oOptions.bAtomic = true;
+      oOptions.eResume = CFTPClient::ResumeMode::AUTO;
+      ASSERT_TRUE(m_pFTPClient->UploadFile("test_atomic.txt", strRemoteFile, false, oOptions));
+      EXPECT_EQ(1000, oOptions.llResumedFrom);
+
+      CFTPClient::FileInfo oInfo = {0, 0.0};
+      EXPECT_FALSE(m_pFTPClient->Info(strRemoteFile + ".part", oInfo));
+      std::vector<char> vecDownloaded;
+      ASSERT_TRUE(m_pFTPClient->DownloadFile(strRemoteFile, vecDownloaded));
+      EXPECT_EQ(strContent, std::string(vecDownloaded.begin(), vecDownloaded.end()));
+
+      /* an existing file is replaced */
+      ASSERT_TRUE(m_pFTPClient->UploadFile("test_atomic.txt", strRemoteFile, false, oOptions));
+      EXPECT_EQ(0, oOptions.llResumedFrom);
+
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(strRemoteFile));
+      EXPECT_TRUE(remove("test_atomic.txt") == 0);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestCopyBetweenServers) {
+   if (FTP_TEST_ENABLED) {
+      std::string strContent;
+      for (int i = 0; i < 10000; ++i) strContent += "line " + std::to_string(i) + " of the server to server copy test\n";
+      std::istringstream issContent(strContent);
+      const std::string strSourceFile = FTP_REMOTE_UPLOAD_FOLDER + "test_copy_source.txt";
+      const std::string strCopyFile   = FTP_REMOTE_UPLOAD_FOLDER + "test_copy.txt";
+      ASSERT_TRUE(m_pFTPClient->UploadFile(issContent, strSourceFile, false, strContent.size()));
+
+      auto pDestination = m_pFTPClient->CloneSession();
+      ASSERT_TRUE(pDestination != nullptr);
+
+      std::vector<char> vecCopy;
+      /* servers usually refuse FXP */
+      if (CFTPClient::CopyBetweenServers(*m_pFTPClient, strSourceFile, *pDestination, strCopyFile, CFTPClient::CopyMode::FXP)) {
+         ASSERT_TRUE(pDestination->DownloadFile(strCopyFile, vecCopy));
+         EXPECT_EQ(strContent, std::string(vecCopy.begin(), vecCopy.end()));
+         EXPECT_TRUE(pDestination->RemoveFile(strCopyFile));
+      } else
+         std::cout << "FXP is refused by the server." << std::endl;
+
+      /* no command can be injected through the file names */
+      EXPECT_FALSE(CFTPClient::CopyBetweenServers(*m_pFTPClient, strSourceFile, *pDestination, strCopyFile + "\r\nDELE " + strSourceFile,
+                                                  CFTPClient::CopyMode::FXP));
+      CFTPClient::FileInfo oInfo = {0, 0.0};
+      EXPECT_TRUE(m_pFTPClient->Info(strSourceFile, oInfo));
+
+      ASSERT_TRUE(CFTPClient::CopyBetweenServers(*m_pFTPClient, strSourceFile, *pDestination, strCopyFile, CFTPClient::CopyMode::RELAY));
+      vecCopy.clear();
+      ASSERT_TRUE(pDestination->DownloadFile(strCopyFile, vecCopy));
+      EXPECT_EQ(strContent, std::string(vecCopy.begin(), vecCopy.end()));
+
+      EXPECT_TRUE(CFTPClient::CopyBetweenServers(*m_pFTPClient, strSourceFile, *pDestination, strCopyFile));
+      /* same session for both sides */
+      EXPECT_TRUE(CFTPClient::CopyBetweenServers(*m_pFTPClient, strSourceFile, *m_pFTPClient, strCopyFile, CFTPClient::CopyMode::RELAY));
+      pDestination->CleanupSession();
+
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(strCopyFile));
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(strSourceFile));
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestBatches) {
+   if (FTP_TEST_ENABLED) {
+      const std::string strDir = FTP_REMOTE_UPLOAD_FOLDER + "batch_test";
+      std::vector<CFTPClient::CommandResult> vecResults;
+      ASSERT_TRUE(m_pFTPClient->CreateDirs({strDir, strDir + "/sub"}, vecResults));
+      ASSERT_EQ(2u, vecResults.size());
+      EXPECT_EQ(257, vecResults[0].iCode);
+
+      std::vector<std::string> vecFiles;
+      std::vector<std::pair<std::string, std::string>> vecRenames;
+      for (int i = 0; i < 5; ++i) {
+         const std::string strFile = strDir + "/file" + std::to_string(i) + ".txt";
+         std::istringstream issContent("batch " + std::to_string(i));
+         ASSERT_TRUE(m_pFTPClient->UploadFile(issContent, strFile));
+         vecRenames.push_back(std::make_pair(strFile, strDir + "/sub/file" + std::to_string(i) + ".txt"));
+         vecFiles.push_back(vecRenames.back().second);
+      }
+      ASSERT_TRUE(m_pFTPClient->Rename(vecRenames, vecResults));
+      EXPECT_EQ(5u, vecResults.size());
+
+      /* a failure doesn't stop the batch */
+      vecFiles.insert(vecFiles.begin() + 2, strDir + "/inexistent_file.txt");
+      EXPECT_FALSE(m_pFTPClient->RemoveFiles(vecFiles, vecResults));
+      ASSERT_EQ(6u, vecResults.size());
+      for (size_t i = 0; i < vecResults.size(); ++i) EXPECT_EQ(i != 2, vecResults[i].bSucceeded) << vecResults[i].strReply;
+      EXPECT_EQ(550, vecResults[2].iCode);
+
+      /* no command can be injected through the paths : nothing is sent */
+      EXPECT_FALSE(m_pFTPClient->RemoveFiles({strDir + "/none.txt\r\nRMD " + strDir + "/sub", strDir + "/other.txt"}, vecResults));
+      ASSERT_EQ(2u, vecResults.size());
+      EXPECT_FALSE(vecResults[0].bSucceeded);
+      EXPECT_FALSE(vecResults[1].bSucceeded);
+
+      EXPECT_TRUE(m_pFTPClient->RemoveDirs({strDir + "/sub", strDir}, vecResults));
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestRemoveTree) {
+   if (FTP_TEST_ENABLED) {
+      const std::string strDir = FTP_REMOTE_UPLOAD_FOLDER + "tree_test";
+      std::vector<CFTPClient::CommandResult> vecResults;
+      ASSERT_TRUE(m_pFTPClient->CreateDirs({strDir, strDir + "/a", strDir + "/a/b", strDir + "/c"}, vecResults));
+      for (const std::string strSub : {"/", "/a/", "/a/b/", "/c/"}) {
+         for (int i = 0; i < 3; ++i) {
+            std::istringstream issContent("tree " + std::to_string(i));
+            ASSERT_TRUE(m_pFTPClient->UploadFile(issContent, strDir + strSub + "file" + std::to_string(i) + ".txt"));
+         }
+      }
+
+      EXPECT_TRUE(m_pFTPClient->RemoveTree(strDir + "/", 2));
+
+      std::vector<CFTPClient::RemoteEntry> vecEntries;
+      ASSERT_TRUE(m_pFTPClient->Walk(FTP_REMOTE_UPLOAD_FOLDER, vecEntries, false));
+      for (const auto& oEntry : vecEntries) EXPECT_NE("tree_test", oEntry.strPath);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestModeZ) {
+   if (FTP_TEST_ENABLED) {
+      if (!m_pFTPClient->IsModeZSupported()) {
+         std::cout << "MODE Z isn't supported !" << std::endl;
+         return;
+      }
+
+      {
+         std::ofstream ofTestUpload("test_mode_z.txt", std::ofstream::binary);
+         for (int i = 0; i < 20000; ++i) ofTestUpload << "line " << i << " of the MODE Z test\n";
+      }
+
+      m_pFTPClient->SetModeZ(true);
+      m_pFTPClient->SetCompressionLevel(9);
+
+      CFTPClient::TransferOptions oOptions;
+      oOptions.eHashAlgorithm = CFTPHash::Algorithm::SHA256;
+      ASSERT_TRUE(m_pFTPClient->UploadFile("test_mode_z.txt", FTP_REMOTE_UPLOAD_FOLDER + "test_mode_z.txt", false, oOptions));
+      const std::string strUploadHash = oOptions.strHash;
+
+      ASSERT_TRUE(m_pFTPClient->DownloadFile("downloaded_mode_z.txt", FTP_REMOTE_UPLOAD_FOLDER + "test_mode_z.txt", oOptions));
+      EXPECT_EQ(strUploadHash, oOptions.strHash);
+
+      std::vector<char> vecData;
+      ASSERT_TRUE(m_pFTPClient->DownloadFile(FTP_REMOTE_UPLOAD_FOLDER + "test_mode_z.txt", vecData));
+      EXPECT_EQ(strUploadHash, CFTPHash::Compute(CFTPHash::Algorithm::SHA256, vecData.data(), vecData.size()));
+
+      std::string strList;
+      EXPECT_TRUE(m_pFTPClient->List(FTP_REMOTE_UPLOAD_FOLDER, strList));
+      EXPECT_NE(std::string::npos, strList.find("test_mode_z.txt"));
+
+      // the stream mode is restored after each transfer
+      m_pFTPClient->SetModeZ(false);
+      strList.clear();
+      EXPECT_TRUE(m_pFTPClient->List(FTP_REMOTE_UPLOAD_FOLDER, strList));
+      EXPECT_NE(std::string::npos, strList.find("test_mode_z.txt"));
+
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(FTP_REMOTE_UPLOAD_FOLDER + "test_mode_z.txt"));
+      EXPECT_TRUE(remove("test_mode_z.txt") == 0);
+      EXPECT_TRUE(remove("downloaded_mode_z.txt") == 0);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestDownloadPipeline) {
+   if (FTP_TEST_ENABLED) {
+      {
+         std::ofstream ofTestUpload("test_pipeline.txt", std::ofstream::binary);
+         for (int i = 0; i < 10000; ++i) ofTestUpload << "line " << i << " of the pipeline test\r\n";
+      }
+      ASSERT_TRUE(m_pFTPClient->UploadFile("test_pipeline.txt", FTP_REMOTE_UPLOAD_FOLDER + "test_pipeline.txt"));
+
+      // converted and hashed while written, the raw data is kept in memory
+      std::vector<char> vecRaw;
+      CFTPHash oHash(CFTPHash::Algorithm::SHA256);
+      {
+         std::ofstream ofsOutput("downloaded_pipeline.txt", std::ofstream::binary);
+         CFTPStreamSink oFileSink(ofsOutput);
+         CFTPMemorySink oRawSink(vecRaw);
+         CFTPPipeline oPipeline(oFileSink);
+         oPipeline.Emplace<CFTPTeeStage>(oRawSink);
+         oPipeline.Emplace<CFTPLineEndingStage>(CFTPLineEndingStage::Mode::TO_LF);
+         oPipeline.Emplace<CFTPHashStage>(oHash);
+         ASSERT_TRUE(m_pFTPClient->DownloadFile(FTP_REMOTE_UPLOAD_FOLDER + "test_pipeline.txt", oPipeline));
+      }
+
+      std::ifstream ifsUploaded("test_pipeline.txt", std::ifstream::binary);
+      const std::string strUploaded((std::istreambuf_iterator<char>(ifsUploaded)), std::istreambuf_iterator<char>());
+      EXPECT_EQ(strUploaded, std::string(vecRaw.begin(), vecRaw.end()));
+
+      std::string strConverted;
+      for (int i = 0; i < 10000; ++i) strConverted += "line " + std::to_string(i) + " of the pipeline test\n";
+      std::string strDigest;
+      ASSERT_TRUE(CFTPHash::ComputeFile(CFTPHash::Algorithm::SHA256, "downloaded_pipeline.txt", strDigest));
+      EXPECT_EQ(CFTPHash::Compute(CFTPHash::Algorithm::SHA256, strConverted.data(), strConverted.size()), strDigest);
+      EXPECT_EQ(strDigest, oHash.Final());
+
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(FTP_REMOTE_UPLOAD_FOLDER + "test_pipeline.txt"));
+      EXPECT_TRUE(remove("test_pipeline.txt") == 0);
+      EXPECT_TRUE(remove("downloaded_pipeline.txt") == 0);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestRemoteHash) {
+   if (FTP_TEST_ENABLED) {
+      if (m_pFTPClient->GetRemoteHashAlgorithm() == CFTPHash::Algorithm::NONE) {
+         std::cout << "The FTP server doesn't compute checksums !" << std::endl;
+         return;
+      }
+
+      {
+         std::ofstream ofTestUpload("test_remote_hash.txt", std::ofstream::binary);
+         for (int i = 0; i < 1000; ++i) ofTestUpload << "line " << i << " of the remote hash test\n";
+      }
+
+      // the algorithm is chosen by the client
+      CFTPClient::TransferOptions oOptions;
+      oOptions.bVerifyRemoteHash = true;
+      ASSERT_TRUE(m_pFTPClient->UploadFile("test_remote_hash.txt", FTP_REMOTE_UPLOAD_FOLDER + "test_remote_hash.txt", false, oOptions));
+      EXPECT_EQ(m_pFTPClient->GetRemoteHashAlgorithm(), oOptions.eHashAlgorithm);
+      EXPECT_FALSE(oOptions.strHash.empty());
+
+      ASSERT_TRUE(m_pFTPClient->DownloadFile("downloaded_remote_hash.txt", FTP_REMOTE_UPLOAD_FOLDER + "test_remote_hash.txt", oOptions));
+
+      std::string strRemoteHash;
+      EXPECT_TRUE(m_pFTPClient->RemoteHash(FTP_REMOTE_UPLOAD_FOLDER + "test_remote_hash.txt", oOptions.eHashAlgorithm, strRemoteHash));
+      EXPECT_EQ(oOptions.strHash, strRemoteHash);
+
+      EXPECT_FALSE(m_pFTPClient->RemoteHash(FTP_REMOTE_UPLOAD_FOLDER + "inexistent_file.txt", oOptions.eHashAlgorithm, strRemoteHash));
+      EXPECT_FALSE(m_pFTPClient->RemoteHash(FTP_REMOTE_UPLOAD_FOLDER + "test_remote_hash.txt", CFTPHash::Algorithm::XXH64, strRemoteHash));
+
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(FTP_REMOTE_UPLOAD_FOLDER + "test_remote_hash.txt"));
+      EXPECT_TRUE(remove("test_remote_hash.txt") == 0);
+      EXPECT_TRUE(remove("downloaded_remote_hash.txt") == 0);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestLastStats) {
+   if (FTP_TEST_ENABLED) {
+      std::string strContent(100000, 's');
+      std::istringstream issContent(strContent);
+      const std::string strRemoteFile = FTP_REMOTE_UPLOAD_FOLDER + "test_stats.txt";
+      ASSERT_TRUE(m_pFTPClient->UploadFile(issContent, strRemoteFile, false, strContent.size()));
+      EXPECT_EQ(static_cast<curl_off_t>(strContent.size()), m_pFTPClient->GetLastStats().llBytesUploaded);
+
+      std::vector<char> vecData;
+      ASSERT_TRUE(m_pFTPClient->DownloadFile(strRemoteFile, vecData));
+      const CFTPClient::TransferStats& oStats = m_pFTPClient->GetLastStats();
+      EXPECT_EQ(CURLE_OK, oStats.eResult);
+      EXPECT_EQ(226, oStats.lResponseCode);
+      EXPECT_EQ(static_cast<curl_off_t>(strContent.size()), oStats.llBytesDownloaded);
+      EXPECT_LE(oStats.llNameLookupUs, oStats.llConnectUs);
+      EXPECT_LE(oStats.llPreTransferUs, oStats.llStartTransferUs);
+      EXPECT_LE(oStats.llStartTransferUs, oStats.llTotalUs);
+      EXPECT_FALSE(oStats.strURL.empty());
+
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(strRemoteFile));
+      CFTPClient::FileInfo oInfo = {0, 0.0};
+      EXPECT_FALSE(m_pFTPClient->Info(strRemoteFile, oInfo));
+      EXPECT_EQ(CURLE_REMOTE_FILE_NOT_FOUND, m_pFTPClient->GetLastStats().eResult);
+      EXPECT_EQ(550, m_pFTPClient->GetLastStats().lResponseCode);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestMetricsRecorded) {
+   if (FTP_TEST_ENABLED) {
+      std::string strHost = FTP_SERVER.substr((FTP_SERVER.find("://") != std::string::npos) ? FTP_SERVER.find("://") + 3 : 0);
+      strHost             = strHost.substr(0, strHost.find('/')) + ":" + std::to_string(FTP_SERVER_PORT);
+
+      CFTPMetrics &oMetrics                = CFTPMetrics::GetInstance();
+      const CFTPMetrics::Counters oUploads = oMetrics.Get(CFTPMetrics::Operation::UPLOAD, strHost);
+      const CFTPMetrics::Counters oRemoves = oMetrics.Get(CFTPMetrics::Operation::REMOVE, strHost);
+      const CFTPMetrics::Counters oInfos   = oMetrics.Get(CFTPMetrics::Operation::INFO, strHost);
+
+      std::istringstream issContent("metrics");
+      const std::string strRemoteFile = FTP_REMOTE_UPLOAD_FOLDER + "test_metrics.txt";
+      ASSERT_TRUE(m_pFTPClient->UploadFile(issContent, strRemoteFile, false, 7));
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(strRemoteFile));
+      CFTPClient::FileInfo oInfo = {0, 0.0};
+      EXPECT_FALSE(m_pFTPClient->Info(strRemoteFile, oInfo));
+
+      EXPECT_EQ(oUploads.ullRequests + 1, oMetrics.Get(CFTPMetrics::Operation::UPLOAD, strHost).ullRequests);
+      EXPECT_EQ(oUploads.ullBytesUploaded + 7, oMetrics.Get(CFTPMetrics::Operation::UPLOAD, strHost).ullBytesUploaded);
+      EXPECT_EQ(oRemoves.ullRequests + 1, oMetrics.Get(CFTPMetrics::Operation::REMOVE, strHost).ullRequests);
+      EXPECT_EQ(oInfos.ullFailures + 1, oMetrics.Get(CFTPMetrics::Operation::INFO, strHost).ullFailures);
+      EXPECT_NE(std::string::npos, oMetrics.ToPrometheus().find("operation=\"upload\",host=\"" + strHost + "\""));
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestProtocolTrace) {
+   if (FTP_TEST_ENABLED) {
+      std::vector<std::string> vecLogs;
+      CFTPClient FTPClient([&vecLogs](const std::string& strMessage) { vecLogs.push_back(strMessage); });
+      ASSERT_TRUE(FTPClient.InitSession(FTP_SERVER, FTP_SERVER_PORT, FTP_USERNAME, FTP_PASSWORD));
+      EXPECT_FALSE(FTPClient.IsTraceEnabled());
+      EXPECT_TRUE(FTPClient.DumpTrace().empty());
+
+      FTPClient.EnableTrace(256, true);
+      std::istringstream issContent("traced");
+      const std::string strRemoteFile = FTP_REMOTE_UPLOAD_FOLDER + "test_trace.txt";
+      ASSERT_TRUE(FTPClient.UploadFile(issContent, strRemoteFile, false, 6));
+      EXPECT_TRUE(vecLogs.empty());
+
+      const std::string strDump = FTPClient.DumpTrace();
+      EXPECT_NE(std::string::npos, strDump.find("-> USER " + FTP_USERNAME + "\n"));
+      EXPECT_NE(std::string::npos, strDump.find("-> PASS ****\n"));
+      EXPECT_EQ(std::string::npos, strDump.find("PASS " + FTP_PASSWORD + "\n"));
+      EXPECT_NE(std::string::npos, strDump.find("-> STOR test_trace.txt\n"));
+      EXPECT_NE(std::string::npos, strDump.find("=> 6 bytes"));
+
+      /* the trace is logged when a request fails */
+      EXPECT_TRUE(FTPClient.RemoveFile(strRemoteFile));
+      CFTPClient::FileInfo oInfo = {0, 0.0};
+      EXPECT_FALSE(FTPClient.Info(strRemoteFile, oInfo));
+      ASSERT_EQ(1u, vecLogs.size());
+      EXPECT_NE(std::string::npos, vecLogs[0].find("-> DELE test_trace.txt\n"));
+
+      FTPClient.DisableTrace();
+      EXPECT_TRUE(FTPClient.DumpTrace().empty());
+      FTPClient.CleanupSession();
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestLogLevels) {
+   if (FTP_TEST_ENABLED) {
+      std::mutex mtxLogs;
+      std::vector<std::string> vecLogs;
+      auto fnLogger = [&](const std::string& strMessage) {
+         std::lock_guard<std::mutex> lock(mtxLogs);
+         vecLogs.push_back(strMessage);
+      };
+      CFTPClient FTPClient(fnLogger);
+      ASSERT_TRUE(FTPClient.InitSession(FTP_SERVER, FTP_SERVER_PORT, FTP_USERNAME, FTP_PASSWORD, CFTPClient::FTP_PROTOCOL::FTP,
+                                        CFTPClient::ENABLE_LOG));
+      EXPECT_EQ(CFTPClient::LogLevel::WARN, FTPClient.GetLogLevel());
+
+      std::string strContent;
+      for (int i = 0; i < 1000; ++i) strContent += "line " + std::to_string(i) + " of the log levels test\n";
+      std::ofstream("test_log_levels.txt", std::ofstream::binary) << strContent;
+      const std::string strRemoteFile = FTP_REMOTE_UPLOAD_FOLDER + "test_log_levels.txt";
+
+      /* informations are only logged at the INFO level */
+      CFTPClient::TransferOptions oOptions;
+      oOptions.eResume = CFTPClient::ResumeMode::AUTO;
+      for (auto eLevel : {CFTPClient::LogLevel::WARN, CFTPClient::LogLevel::INFO}) {
+         std::istringstream issPrefix(strContent.substr(0, 1000));
+         ASSERT_TRUE(FTPClient.UploadFile(issPrefix, strRemoteFile, false, 1000));
+         FTPClient.SetLogLevel(eLevel);
+         ASSERT_TRUE(FTPClient.UploadFile("test_log_levels.txt", strRemoteFile, false, oOptions));
+         EXPECT_EQ(1000, oOptions.llResumedFrom);
+      }
+      ASSERT_EQ(1u, vecLogs.size());
+      EXPECT_NE(std::string::npos, vecLogs[0].find("[Info] Resuming the transfer of " + strRemoteFile + " at byte 1000."));
+      vecLogs.clear();
+
+      /* the sink's thread writes the messages, the clones share it */
+      auto pSink = std::make_shared<CFTPLogSink>(fnLogger);
+      FTPClient.SetLogLevel(CFTPClient::LogLevel::ERR);
+      FTPClient.SetLogSink(pSink);
+      auto pClone = FTPClient.CloneSession();
+      ASSERT_TRUE(pClone != nullptr);
+      EXPECT_EQ(pSink, pClone->GetLogSink());
+      EXPECT_EQ(CFTPClient::LogLevel::ERR, pClone->GetLogLevel());
+
+      EXPECT_TRUE(FTPClient.RemoveFile(strRemoteFile));
+      CFTPClient::FileInfo oInfo = {0, 0.0};
+      EXPECT_FALSE(pClone->Info(strRemoteFile, oInfo));
+      pSink->Flush();
+      {
+         std::lock_guard<std::mutex> lock(mtxLogs);
+         ASSERT_FALSE(vecLogs.empty());
+         EXPECT_NE(std::string::npos, vecLogs[0].find("[FTPClient][Error]"));
+      }
+
+      pClone->CleanupSession();
+      FTPClient.CleanupSession();
+      EXPECT_TRUE(remove("test_log_levels.txt") == 0);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+namespace {
+class CRecordingObserver : public CFTPClient::RequestObserver {
+  public:
+   void OnRequestStart(CFTPMetrics::Operation eOperation, const std::string&) override {
+      m_vecEvents.push_back(std::string("start ") + CFTPMetrics::GetName(eOperation));
+   }
+   void OnConnected(CFTPMetrics::Operation, const std::string&, const std::string& strServerIP, int iServerPort) override {
+      m_vecEvents.push_back("connected");
+      EXPECT_FALSE(strServerIP.empty());
+      EXPECT_GT(iServerPort, 0);
+   }
+   void OnFirstByte(CFTPMetrics::Operation, const std::string&) override { m_vecEvents.push_back("first byte"); }
+   void OnRequestEnd(CFTPMetrics::Operation, const std::string& strURL, const CFTPClient::TransferStats& oStats) override {
+      m_vecEvents.push_back(std::string("end ") + ((oStats.eResult == CURLE_OK) ? "ok" : "failed"));
+      m_strLastURL = strURL;
+   }
+
+   std::vector<std::string> m_vecEvents;
+   std::string m_strLastURL;
+};
+
+int CountingProgressCallback(void* ptr, double, double, double, double) {
+   ++*reinterpret_cast<int*>(reinterpret_cast<CFTPClient::ProgressFnStruct*>(ptr)->pOwner);
+   return 0;
+}
+}  // namespace
+
+TEST_F(FTPClientTest, TestRequestObserver) {
+   if (FTP_TEST_ENABLED) {
+      CRecordingObserver oObserver;
+      m_pFTPClient->SetRequestObserver(&oObserver);
+      int iProgressCalls = 0;
+      m_pFTPClient->SetProgressFnCallback(&iProgressCalls, &CountingProgressCallback);
+
+      std::istringstream issContent("observed");
+      const std::string strRemoteFile = FTP_REMOTE_UPLOAD_FOLDER + "test_observer.txt";
+      ASSERT_TRUE(m_pFTPClient->UploadFile(issContent, strRemoteFile, false, 8));
+      EXPECT_EQ((std::vector<std::string>{"start upload", "connected", "first byte", "end ok"}), oObserver.m_vecEvents);
+      EXPECT_NE(std::string::npos, oObserver.m_strLastURL.find("test_observer.txt"));
+      // the progress function is still called
+      EXPECT_GT(iProgressCalls, 0);
+
+      oObserver.m_vecEvents.clear();
+      std::vector<char> vecData;
+      ASSERT_TRUE(m_pFTPClient->DownloadFile(strRemoteFile, vecData));
+      EXPECT_EQ((std::vector<std::string>{"start download", "connected", "first byte", "end ok"}), oObserver.m_vecEvents);
+
+      /* no data */
+      oObserver.m_vecEvents.clear();
+      ASSERT_TRUE(m_pFTPClient->RemoveFile(strRemoteFile));
+      EXPECT_EQ((std::vector<std::string>{"start remove", "connected", "end ok"}), oObserver.m_vecEvents);
+
+      oObserver.m_vecEvents.clear();
+      CFTPClient::FileInfo oInfo = {0, 0.0};
+      EXPECT_FALSE(m_pFTPClient->Info(strRemoteFile, oInfo));
+      EXPECT_EQ((std::vector<std::string>{"start info", "connected", "end failed"}), oObserver.m_vecEvents);
+
+      m_pFTPClient->SetRequestObserver(nullptr);
+      m_pFTPClient->SetProgressFnCallback(nullptr, &CountingProgressCallback, false);
+      oObserver.m_vecEvents.clear();
+      EXPECT_FALSE(m_pFTPClient->Info(strRemoteFile, oInfo));
+      EXPECT_TRUE(oObserver.m_vecEvents.empty());
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestXferInfoCallback) {
+   if (FTP_TEST_ENABLED) {
+      const std::string strContent(1 << 20, 'x');
+      const std::string strRemoteFile = FTP_REMOTE_UPLOAD_FOLDER + "test_xferinfo.txt";
+
+      /* any callable, every report without throttling */
+      std::vector<CFTPClient::TransferProgress> vecProgress;
+      m_pFTPClient->SetXferInfoFnCallback(
+          [&vecProgress](const CFTPClient::TransferProgress& oProgress) {
+             vecProgress.push_back(oProgress);
+             return 0;
+          },
+          0);
+      std::istringstream issContent(strContent);
+      ASSERT_TRUE(m_pFTPClient->UploadFile(issContent, strRemoteFile, false, strContent.size()));
+      ASSERT_FALSE(vecProgress.empty());
+      for (size_t i = 1; i < vecProgress.size(); ++i) {
+         EXPECT_GE(vecProgress[i].llUploaded, vecProgress[i - 1].llUploaded);
+         EXPECT_GE(vecProgress[i].dElapsed, vecProgress[i - 1].dElapsed);
+      }
+      EXPECT_EQ(static_cast<curl_off_t>(strContent.size()), vecProgress.back().llUploaded);
+      EXPECT_EQ(static_cast<curl_off_t>(strContent.size()), vecProgress.back().llUploadTotal);
+      EXPECT_EQ(0, vecProgress.back().dEta);
+
+      /* throttled : only the completion is reported */
+      vecProgress.clear();
+      m_pFTPClient->SetXferInfoFnCallback(
+          [&vecProgress](const CFTPClient::TransferProgress& oProgress) {
+             vecProgress.push_back(oProgress);
+             return 0;
+          },
+          60000);
+      std::vector<char> vecData;
+      ASSERT_TRUE(m_pFTPClient->DownloadFile(strRemoteFile, vecData));
+      ASSERT_EQ(1u, vecProgress.size());
+      EXPECT_EQ(static_cast<curl_off_t>(strContent.size()), vecProgress[0].llDownloaded);
+
+      /* a non-zero result aborts the transfer */
+      m_pFTPClient->SetXferInfoFnCallback([](const CFTPClient::TransferProgress&) { return 1; }, 0);
+      vecData.clear();
+      EXPECT_FALSE(m_pFTPClient->DownloadFile(strRemoteFile, vecData));
+      EXPECT_EQ(CURLE_ABORTED_BY_CALLBACK, m_pFTPClient->GetLastStats().eResult);
+      m_pFTPClient->SetXferInfoFnCallback(nullptr);
+
+      /* the legacy progress function can be a capturing lambda too */
+      int iProgressCalls = 0;
+      m_pFTPClient->SetProgressFnCallback(nullptr, [&iProgressCalls](void*, double, double, double, double) {
+         ++iProgressCalls;
+         return 0;
+      });
+      EXPECT_EQ(nullptr, m_pFTPClient->GetProgressFnCallback());
+      vecData.clear();
+      ASSERT_TRUE(m_pFTPClient->DownloadFile(strRemoteFile, vecData));
+      EXPECT_GT(iProgressCalls, 0);
+      m_pFTPClient->SetProgressFnCallback(nullptr, nullptr, false);
+
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(strRemoteFile));
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestProgressSnapshot) {
+   if (FTP_TEST_ENABLED) {
+      const std::string strContent(4 << 20, 'x');
+      const std::string strRemoteFile = FTP_REMOTE_UPLOAD_FOLDER + "test_snapshot.txt";
+      EXPECT_EQ(CFTPProgressSnapshot::State::IDLE, m_pFTPClient->GetProgressSnapshot().eState);
+      m_pFTPClient->EnableProgressSnapshot();
+
+      /* polled by another thread during the transfer */
+      std::atomic<bool> bDone(false);
+      curl_off_t llMaxPolled = 0;
+      std::thread oPoller([&]() {
+         while (!bDone) {
+            const CFTPProgressSnapshot::Values oValues = m_pFTPClient->GetProgressSnapshot();
+            EXPECT_LE(oValues.llBytesDone, static_cast<curl_off_t>(strContent.size()));
+            llMaxPolled = std::max(llMaxPolled, oValues.llBytesDone);
+            std::this_thread::yield();
+         }
+      });
+      std::istringstream issContent(strContent);
+      const bool bUploaded = m_pFTPClient->UploadFile(issContent, strRemoteFile, false, strContent.size());
+      bDone = true;
+      oPoller.join();
+      ASSERT_TRUE(bUploaded);
+      EXPECT_GT(llMaxPolled, 0);
+
+      CFTPProgressSnapshot::Values oValues = m_pFTPClient->GetProgressSnapshot();
+      EXPECT_EQ(CFTPProgressSnapshot::State::COMPLETED, oValues.eState);
+      EXPECT_EQ(static_cast<curl_off_t>(strContent.size()), oValues.llBytesDone);
+      EXPECT_EQ(static_cast<curl_off_t>(strContent.size()), oValues.llBytesTotal);
+      EXPECT_EQ(strContent.size(), oValues.ullSessionBytes);
+      EXPECT_GT(oValues.ullVersion, 2u);
+
+      std::vector<char> vecData;
+      ASSERT_TRUE(m_pFTPClient->DownloadFile(strRemoteFile, vecData));
+      EXPECT_EQ(2 * strContent.size(), m_pFTPClient->GetProgressSnapshot().ullSessionBytes);
+
+      EXPECT_TRUE(m_pFTPClient->RemoveFile(strRemoteFile));
+      CFTPClient::FileInfo oInfo = {0, 0.0};
+      EXPECT_FALSE(m_pFTPClient->Info(strRemoteFile, oInfo));
+      oValues = m_pFTPClient->GetProgressSnapshot();
+      EXPECT_EQ(CFTPProgressSnapshot::State::FAILED, oValues.eState);
+      EXPECT_EQ(2 * strContent.size(), oValues.ullSessionBytes);
+      m_pFTPClient->EnableProgressSnapshot(false);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
 #ifdef WINDOWS
 TEST_F(FTPClientTest, TestSaveFileNameWithAccents) {
    if (FTP_TEST_ENABLED) {
@@ -636,6 +2063,85 @@ TEST_F(FTPClientTest, TestList) {
       std::cout << "FTP tests are disabled !" << std::endl;
 }
 
+TEST_F(FTPClientTest, TestWalk) {
+   if (FTP_TEST_ENABLED) {
+      std::vector<CFTPClient::RemoteEntry> vecEntries;
+
+      /* walk root directory */
+      ASSERT_TRUE(m_pFTPClient->Walk("/", vecEntries, false));
+
+      auto itFile = std::find_if(vecEntries.begin(), vecEntries.end(),
+                                 [](const CFTPClient::RemoteEntry& oEntry) { return oEntry.strPath == FTP_REMOTE_FILE; });
+      ASSERT_TRUE(itFile != vecEntries.end());
+      EXPECT_EQ(CURLFILETYPE_FILE, itFile->eFileType);
+      EXPECT_GT(itFile->tMTime, 0);
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
+TEST_F(FTPClientTest, TestMirror) {
+   if (FTP_TEST_ENABLED) {
+#ifdef LINUX
+      mkdir("Mirror", ACCESSPERMS);
+      mkdir("Mirror/sub", ACCESSPERMS);
+#else
+      _mkdir("Mirror");
+      _mkdir("Mirror\\sub");
+#endif
+      std::ofstream("Mirror/a.txt") << "mirror a";
+      std::ofstream("Mirror/sub/b.txt") << "mirror b";
+
+      const std::string strRemoteDir = FTP_REMOTE_UPLOAD_FOLDER + "mirror_test";
+      CFTPMirror oMirror(*m_pFTPClient, "Mirror", strRemoteDir, CFTPMirror::Direction::UPLOAD);
+      oMirror.SetDeleteExtraneous(true);
+      oMirror.SetSessions(2);
+      EXPECT_EQ(CFTPJobProgress::State::IDLE, oMirror.GetProgress().eState);
+      ASSERT_TRUE(oMirror.Run());
+
+      const CFTPJobProgress::Values oProgress = oMirror.GetProgress();
+      EXPECT_EQ(CFTPJobProgress::State::COMPLETED, oProgress.eState);
+      EXPECT_GT(oProgress.ullTasks, 0u);
+      EXPECT_EQ(oProgress.ullTasks, oProgress.ullTasksDone);
+      EXPECT_EQ(0u, oProgress.ullTasksFailed);
+      EXPECT_EQ(16u, oProgress.ullBytesTotal);
+      EXPECT_EQ(16u, oProgress.ullBytesDone);
+      EXPECT_EQ(0, oProgress.dEta);
+
+      /* nothing left to do */
+      CFTPMirror::Plan oPlan;
+      ASSERT_TRUE(oMirror.ComputePlan(oPlan));
+      EXPECT_TRUE(oPlan.Empty());
+
+      oMirror.SetCompareMode(CFTPMirror::CompareMode::SIZE_AND_HASH);
+      ASSERT_TRUE(oMirror.ComputePlan(oPlan));
+      EXPECT_TRUE(oPlan.Empty());
+
+      /* a local removal is propagated */
+      EXPECT_EQ(0, remove("Mirror/sub/b.txt"));
+      ASSERT_TRUE(oMirror.ComputePlan(oPlan));
+      ASSERT_EQ(1u, oPlan.vecActions.size());
+      EXPECT_EQ(CFTPMirror::Action::REMOVE_FILE, oPlan.vecActions[0].eType);
+      EXPECT_EQ("sub/b.txt", oPlan.vecActions[0].strPath);
+      EXPECT_TRUE(oMirror.Execute(oPlan));
+
+      /* empty the remote folder */
+      EXPECT_EQ(0, remove("Mirror/a.txt"));
+#ifdef LINUX
+      EXPECT_EQ(0, rmdir("Mirror/sub"));
+#else
+      EXPECT_EQ(0, _rmdir("Mirror\\sub"));
+#endif
+      EXPECT_TRUE(oMirror.Run());
+      EXPECT_TRUE(m_pFTPClient->RemoveDir(strRemoteDir));
+#ifdef LINUX
+      rmdir("Mirror");
+#else
+      _rmdir("Mirror");
+#endif
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
 TEST_F(FTPClientTest, TestWildcardedURL) {
 #ifdef LINUX
    mkdir("Wildcard", ACCESSPERMS);
@@ -655,6 +2161,33 @@ TEST_F(FTPClientTest, TestWildcardedURL) {
       std::cout << "FTP tests are disabled !" << std::endl;
 }
 
+TEST_F(FTPClientTest, TestWildcardedURLFilter) {
+#ifdef LINUX
+   mkdir("WildcardFilter", ACCESSPERMS);
+#else
+   _mkdir("WildcardFilter");
+#endif
+
+   if (FTP_TEST_ENABLED) {
+      std::vector<CFTPClient::RemoteEntry> vecEntries;
+      ASSERT_TRUE(m_pFTPClient->Walk("/", vecEntries, false));
+
+      // only FTP_REMOTE_FILE is accepted, nothing else is transferred or created
+      CFTPClient::WildcardFilter oFilter;
+      oFilter.fnPredicate = [](const CFTPClient::RemoteEntry& oEntry) { return oEntry.strPath == FTP_REMOTE_FILE; };
+      ASSERT_TRUE(m_pFTPClient->DownloadWildcard("WildcardFilter", "/*", oFilter));
+
+      size_t uLocalEntries = 0;
+      for (const auto& oEntry : vecEntries) {
+         std::ifstream ifsLocal("WildcardFilter/" + oEntry.strPath);
+         if (ifsLocal.is_open()) ++uLocalEntries;
+      }
+      EXPECT_EQ(1u, uLocalEntries);
+      EXPECT_EQ(0, remove(("WildcardFilter/" + FTP_REMOTE_FILE).c_str()));
+   } else
+      std::cout << "FTP tests are disabled !" << std::endl;
+}
+
 // check for failure
 TEST_F(FTPClientTest, TestWildcardedURLFailure) {
    if (FTP_TEST_ENABLED) {
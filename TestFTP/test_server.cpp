@@ -0,0 +1,723 @@
+#include "test_server.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "FTPHash.h"
+#include "FTPZStream.h"
+
+using embeddedmz::CFTPHash;
+using embeddedmz::CFTPZStream;
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+// a data connection must be established within this delay
+const int DATA_CONNECTION_TIMEOUT_MS = 10000;
+
+const size_t TRANSFER_BUFFER_SIZE = 64 * 1024;
+
+bool SendAll(int iSocket, const char* pData, size_t uSize) {
+   while (uSize > 0) {
+      ssize_t iSent = send(iSocket, pData, uSize, SEND_FLAGS);
+      if (iSent < 0 && errno == EINTR) continue;
+      if (iSent <= 0) return false;
+      pData += iSent;
+      uSize -= static_cast<size_t>(iSent);
+   }
+   return true;
+}
+
+// sends the bytes as is or through the MODE Z stream (bLast ends it)
+bool SendData(int iSocket, CFTPZStream* pZStream, const char* pData, size_t uSize, bool bLast) {
+   if (pZStream == nullptr) return SendAll(iSocket, pData, uSize);
+
+   return pZStream->Process(pData, uSize, bLast, [iSocket](const char* pChunk, size_t uChunk) { return SendAll(iSocket, pChunk, uChunk); });
+}
+
+int CreateListenSocket(unsigned uPort, unsigned& uBoundPort) {
+   int iSocket = socket(AF_INET, SOCK_STREAM, 0);
+   if (iSocket < 0) return -1;
+
+#ifdef SO_NOSIGPIPE
+   int iNoSigPipe = 1;
+   setsockopt(iSocket, SOL_SOCKET, SO_NOSIGPIPE, &iNoSigPipe, sizeof(iNoSigPipe));
+#endif
+   int iReuse = 1;
+   setsockopt(iSocket, SOL_SOCKET, SO_REUSEADDR, &iReuse, sizeof(iReuse));
+
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_port        = htons(static_cast<uint16_t>(uPort));
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   if (bind(iSocket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(iSocket, 64) != 0) {
+      close(iSocket);
+      return -1;
+   }
+
+   socklen_t addrLen = sizeof(addr);
+   getsockname(iSocket, reinterpret_cast<sockaddr*>(&addr), &addrLen);
+   uBoundPort = ntohs(addr.sin_port);
+
+   return iSocket;
+}
+
+std::string FormatMTime(time_t tTime) {
+   char szDate[32];
+   struct tm tmTime;
+   gmtime_r(&tTime, &tmTime);
+   strftime(szDate, sizeof(szDate), "%Y%m%d%H%M%S", &tmTime);
+   return szDate;
+}
+
+// "ls -l" like line, the format understood by libcurl's wildcard list parser
+std::string FormatListLine(const std::string& strName, const struct stat& st) {
+   char szPerms[11] = "----------";
+   if (S_ISDIR(st.st_mode)) szPerms[0] = 'd';
+   const char* pszFlags = "rwxrwxrwx";
+   for (int i = 0; i < 9; ++i) {
+      if (st.st_mode & (1 << (8 - i))) szPerms[i + 1] = pszFlags[i];
+   }
+
+   char szDate[32];
+   struct tm tmTime;
+   gmtime_r(&st.st_mtime, &tmTime);
+   const time_t tNow = time(nullptr);
+   if (tNow - st.st_mtime < 180 * 24 * 3600 && st.st_mtime <= tNow)
+      strftime(szDate, sizeof(szDate), "%b %e %H:%M", &tmTime);
+   else
+      strftime(szDate, sizeof(szDate), "%b %e  %Y", &tmTime);
+
+   char szLine[128];
+   snprintf(szLine, sizeof(szLine), "%s    1 ftp      ftp      %13lld %s ", szPerms, static_cast<long long>(st.st_size), szDate);
+   return szLine + strName + "\r\n";
+}
+
+std::string FormatMlsdLine(const std::string& strName, const struct stat& st) {
+   std::ostringstream ssLine;
+   ssLine << "type=" << (S_ISDIR(st.st_mode) ? "dir" : "file") << ";size=" << static_cast<long long>(st.st_size)
+          << ";modify=" << FormatMTime(st.st_mtime) << "; " << strName << "\r\n";
+   return ssLine.str();
+}
+
+std::string ToUpper(std::string str) {
+   std::transform(str.begin(), str.end(), str.begin(), ::toupper);
+   return str;
+}
+
+}  // namespace
+
+class CFTPTestServer::CSession {
+  public:
+   CSession(CFTPTestServer& oServer, int iSocket)
+       : m_oServer(oServer),
+         m_iSocket(iSocket),
+         m_iPasvSocket(-1),
+         m_bActiveMode(false),
+         m_bLogged(false),
+         m_llRestOffset(0),
+         m_eHashAlgorithm(CFTPHash::Algorithm::SHA256),
+         m_bModeZ(false),
+         m_iZLevel(-1),
+         m_strCwd("/"),
+         m_bDone(false) {
+      memset(&m_ActiveAddr, 0, sizeof(m_ActiveAddr));
+      m_Thread = std::thread(&CSession::Run, this);
+   }
+
+   ~CSession() {
+      Shutdown();
+      if (m_Thread.joinable()) m_Thread.join();
+      if (m_iPasvSocket >= 0) close(m_iPasvSocket);
+      close(m_iSocket);
+   }
+
+   void Shutdown() { shutdown(m_iSocket, SHUT_RDWR); }
+   bool IsDone() const { return m_bDone.load(); }
+
+  private:
+   void Run();
+   bool ReadLine(std::string& strLine);
+   bool Reply(const std::string& strReply) {
+      const std::string strBuf = strReply + "\r\n";
+      return SendAll(m_iSocket, strBuf.c_str(), strBuf.length());
+   }
+
+   void Dispatch(const std::string& strCmd, const std::string& strArg);
+
+   std::string ResolveVirtual(const std::string& strPath) const;
+   std::string ToLocal(const std::string& strVirtualPath) const { return m_oServer.m_strRootDir + strVirtualPath; }
+
+   int OpenDataConnection();
+   void SendDirectory(const std::string& strArg, int iKind);
+   void SendFile(const std::string& strArg);
+   void ReceiveFile(const std::string& strArg, bool bAppend);
+   void SetPasv(bool bExtended);
+   void SetPort(const std::string& strArg, bool bExtended);
+   void SendHash(const std::string& strArg, CFTPHash::Algorithm eAlgorithm, bool bHashCommand);
+
+   CFTPTestServer& m_oServer;
+   int m_iSocket;
+   int m_iPasvSocket;
+   bool m_bActiveMode;
+   sockaddr_in m_ActiveAddr;
+   bool m_bLogged;
+   long long m_llRestOffset;
+   CFTPHash::Algorithm m_eHashAlgorithm;  // selected with OPTS HASH
+   bool m_bModeZ;                         // MODE Z data connections
+   int m_iZLevel;                         // set with OPTS MODE Z LEVEL
+   std::string m_strCwd;
+   std::string m_strUser;
+   std::string m_strRenameFrom;
+   std::string m_strBuffer;
+   std::atomic<bool> m_bDone;
+   std::thread m_Thread;
+};
+
+void CFTPTestServer::CSession::Run() {
+   Reply("220 " + m_oServer.m_strWelcomeMessage);
+
+   std::string strLine;
+   while (ReadLine(strLine)) {
+      std::string strCmd, strArg;
+      const size_t uSpace = strLine.find(' ');
+      if (uSpace == std::string::npos) {
+         strCmd = ToUpper(strLine);
+      } else {
+         strCmd = ToUpper(strLine.substr(0, uSpace));
+         strArg = strLine.substr(uSpace + 1);
+      }
+
+      if (strCmd == "QUIT") {
+         Reply("221 Goodbye.");
+         break;
+      }
+      Dispatch(strCmd, strArg);
+   }
+
+   m_bDone = true;
+}
+
+bool CFTPTestServer::CSession::ReadLine(std::string& strLine) {
+   for (;;) {
+      const size_t uEol = m_strBuffer.find('\n');
+      if (uEol != std::string::npos) {
+         strLine = m_strBuffer.substr(0, uEol);
+         if (!strLine.empty() && strLine.back() == '\r') strLine.pop_back();
+         m_strBuffer.erase(0, uEol + 1);
+         return true;
+      }
+
+      char szBuf[1024];
+      ssize_t iRead = recv(m_iSocket, szBuf, sizeof(szBuf), 0);
+      if (iRead < 0 && errno == EINTR) continue;
+      if (iRead <= 0) return false;
+      m_strBuffer.append(szBuf, static_cast<size_t>(iRead));
+   }
+}
+
+std::string CFTPTestServer::CSession::ResolveVirtual(const std::string& strPath) const {
+   const std::string strFull = (!strPath.empty() && strPath[0] == '/') ? strPath : m_strCwd + "/" + strPath;
+
+   std::vector<std::string> vecParts;
+   std::string strPart;
+   std::istringstream ssPath(strFull);
+   while (std::getline(ssPath, strPart, '/')) {
+      if (strPart.empty() || strPart == ".") continue;
+      if (strPart == "..") {
+         if (!vecParts.empty()) vecParts.pop_back();
+      } else
+         vecParts.push_back(strPart);
+   }
+
+   std::string strResult;
+   for (const auto& strItem : vecParts) strResult += "/" + strItem;
+   return strResult.empty() ? "/" : strResult;
+}
+
+void CFTPTestServer::CSession::Dispatch(const std::string& strCmd, const std::string& strArg) {
+   if (strCmd == "USER") {
+      m_strUser  = strArg;
+      m_bLogged  = false;
+      Reply("331 Password required.");
+      return;
+   }
+   if (strCmd == "PASS") {
+      m_bLogged = (m_strUser == m_oServer.m_strUserName && strArg == m_oServer.m_strPassword);
+      Reply(m_bLogged ? "230 Login successful." : "530 Login incorrect.");
+      return;
+   }
+   if (strCmd == "FEAT") {
+      Reply("211-Features:");
+      Reply(" EPSV");
+      Reply(std::string(" HASH ") + (m_eHashAlgorithm == CFTPHash::Algorithm::SHA256 ? "SHA-256*;SHA-1;MD5;CRC32" : "SHA-256;SHA-1*;MD5;CRC32"));
+      if (m_oServer.m_bMDTMEnabled) Reply(" MDTM");
+      Reply(" MLST type*;size*;modify*;");
+      if (CFTPZStream::IsAvailable()) Reply(" MODE Z");
+      Reply(" REST STREAM");
+      Reply(" SIZE");
+      Reply(" UTF8");
+      Reply(" XCRC");
+      Reply(" XMD5");
+      Reply(" XSHA1");
+      Reply("211 End");
+      return;
+   }
+   if (strCmd == "NOOP") {
+      Reply("200 NOOP ok.");
+      return;
+   }
+   if (strCmd == "SYST") {
+      Reply("215 UNIX Type: L8");
+      return;
+   }
+   if (!m_bLogged) {
+      Reply("530 Please login with USER and PASS.");
+      return;
+   }
+
+   if (strCmd == "PWD" || strCmd == "XPWD") {
+      Reply("257 \"" + m_strCwd + "\" is the current directory.");
+   } else if (strCmd == "CWD" || strCmd == "CDUP") {
+      const std::string strDir = ResolveVirtual(strCmd == "CDUP" ? ".." : strArg);
+      struct stat st;
+      if (stat(ToLocal(strDir).c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+         m_strCwd = strDir;
+         Reply("250 Directory successfully changed.");
+      } else
+         Reply("550 Failed to change directory.");
+   } else if (strCmd == "TYPE" || strCmd == "STRU") {
+      Reply("200 Switching to Binary mode.");
+   } else if (strCmd == "MODE") {
+      if (ToUpper(strArg) == "S" || (ToUpper(strArg) == "Z" && CFTPZStream::IsAvailable())) {
+         m_bModeZ = (ToUpper(strArg) == "Z");
+         Reply("200 Mode set to " + ToUpper(strArg) + ".");
+      } else
+         Reply("504 Unsupported mode.");
+   } else if (strCmd == "OPTS") {
+      const std::string strOption = ToUpper(strArg);
+      if (strOption.compare(0, 5, "HASH ") == 0) {
+         const std::string strName = strOption.substr(5);
+         bool bKnown               = false;
+         for (const auto eAlgorithm : {CFTPHash::Algorithm::SHA256, CFTPHash::Algorithm::SHA1, CFTPHash::Algorithm::MD5,
+                                       CFTPHash::Algorithm::CRC32}) {
+            if (strName == CFTPHash::GetName(eAlgorithm)) {
+               m_eHashAlgorithm = eAlgorithm;
+               bKnown           = true;
+            }
+         }
+         Reply(bKnown ? "200 " + strName : std::string("501 Unknown algorithm."));
+      } else if (strOption.compare(0, 13, "MODE Z LEVEL ") == 0) {
+         m_iZLevel = atoi(strOption.c_str() + 13);
+         Reply("200 MODE Z LEVEL set to " + std::to_string(m_iZLevel) + ".");
+      } else
+         Reply("200 OPTS ok.");
+   } else if (strCmd == "HASH") {
+      SendHash(strArg, m_eHashAlgorithm, true);
+   } else if (strCmd == "XCRC") {
+      SendHash(strArg, CFTPHash::Algorithm::CRC32, false);
+   } else if (strCmd == "XMD5") {
+      SendHash(strArg, CFTPHash::Algorithm::MD5, false);
+   } else if (strCmd == "XSHA1") {
+      SendHash(strArg, CFTPHash::Algorithm::SHA1, false);
+   } else if (strCmd == "PASV") {
+      SetPasv(false);
+   } else if (strCmd == "EPSV") {
+      SetPasv(true);
+   } else if (strCmd == "PORT") {
+      SetPort(strArg, false);
+   } else if (strCmd == "EPRT") {
+      SetPort(strArg, true);
+   } else if (strCmd == "REST") {
+      m_llRestOffset = atoll(strArg.c_str());
+      Reply("350 Restart position accepted (" + std::to_string(m_llRestOffset) + ").");
+   } else if (strCmd == "LIST") {
+      SendDirectory(strArg, 0);
+   } else if (strCmd == "NLST") {
+      SendDirectory(strArg, 1);
+   } else if (strCmd == "MLSD") {
+      SendDirectory(strArg, 2);
+   } else if (strCmd == "RETR") {
+      SendFile(strArg);
+   } else if (strCmd == "STOR") {
+      ReceiveFile(strArg, false);
+   } else if (strCmd == "APPE") {
+      ReceiveFile(strArg, true);
+   } else if (strCmd == "MDTM" && !m_oServer.m_bMDTMEnabled) {
+      Reply("502 Command not implemented.");
+   } else if (strCmd == "SIZE" || strCmd == "MDTM") {
+      struct stat st;
+      if (stat(ToLocal(ResolveVirtual(strArg)).c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+         if (strCmd == "SIZE")
+            Reply("213 " + std::to_string(static_cast<long long>(st.st_size)));
+         else
+            Reply("213 " + FormatMTime(st.st_mtime));
+      } else
+         Reply("550 Could not get file information.");
+   } else if (strCmd == "MKD") {
+      const std::string strDir = ResolveVirtual(strArg);
+      if (mkdir(ToLocal(strDir).c_str(), 0755) == 0)
+         Reply("257 \"" + strDir + "\" created.");
+      else
+         Reply("550 Create directory operation failed.");
+   } else if (strCmd == "RMD") {
+      if (rmdir(ToLocal(ResolveVirtual(strArg)).c_str()) == 0)
+         Reply("250 Remove directory operation successful.");
+      else
+         Reply("550 Remove directory operation failed.");
+   } else if (strCmd == "DELE") {
+      if (unlink(ToLocal(ResolveVirtual(strArg)).c_str()) == 0)
+         Reply("250 Delete operation successful.");
+      else
+         Reply("550 Delete operation failed.");
+   } else if (strCmd == "RNFR") {
+      struct stat st;
+      m_strRenameFrom = ResolveVirtual(strArg);
+      if (stat(ToLocal(m_strRenameFrom).c_str(), &st) == 0)
+         Reply("350 Ready for RNTO.");
+      else {
+         m_strRenameFrom.clear();
+         Reply("550 RNFR command failed.");
+      }
+   } else if (strCmd == "RNTO") {
+      if (!m_strRenameFrom.empty() && rename(ToLocal(m_strRenameFrom).c_str(), ToLocal(ResolveVirtual(strArg)).c_str()) == 0)
+         Reply("250 Rename successful.");
+      else
+         Reply("550 Rename failed.");
+      m_strRenameFrom.clear();
+   } else if (strCmd == "ABOR") {
+      Reply("225 No transfer to ABOR.");
+   } else {
+      Reply("502 Command not implemented.");
+   }
+}
+
+void CFTPTestServer::CSession::SendHash(const std::string& strArg, CFTPHash::Algorithm eAlgorithm, bool bHashCommand) {
+   const std::string strFile = ResolveVirtual(strArg);
+   struct stat st;
+   std::string strDigest;
+   if (stat(ToLocal(strFile).c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+       !CFTPHash::ComputeFile(eAlgorithm, ToLocal(strFile), strDigest)) {
+      Reply("550 Could not compute the checksum.");
+      return;
+   }
+
+   if (bHashCommand)
+      Reply(std::string("213 ") + CFTPHash::GetName(eAlgorithm) + " 0-" + std::to_string(static_cast<long long>(st.st_size)) + " " +
+            strDigest + " " + strArg);
+   else
+      Reply("250 " + strDigest);
+}
+
+void CFTPTestServer::CSession::SetPasv(bool bExtended) {
+   if (m_iPasvSocket >= 0) close(m_iPasvSocket);
+   m_bActiveMode = false;
+
+   unsigned uPort = 0;
+   m_iPasvSocket  = CreateListenSocket(0, uPort);
+   if (m_iPasvSocket < 0) {
+      Reply("425 Can't open passive connection.");
+      return;
+   }
+
+   char szReply[128];
+   if (bExtended)
+      snprintf(szReply, sizeof(szReply), "229 Entering Extended Passive Mode (|||%u|)", uPort);
+   else
+      snprintf(szReply, sizeof(szReply), "227 Entering Passive Mode (127,0,0,1,%u,%u).", uPort >> 8, uPort & 0xFF);
+   Reply(szReply);
+}
+
+void CFTPTestServer::CSession::SetPort(const std::string& strArg, bool bExtended) {
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+
+   if (bExtended) {
+      // EPRT |1|132.235.1.2|6275|
+      if (strArg.size() < 2) {
+         Reply("501 Syntax error.");
+         return;
+      }
+      const char cDelim = strArg[0];
+      std::vector<std::string> vecFields;
+      std::string strField;
+      std::istringstream ssArg(strArg.substr(1));
+      while (std::getline(ssArg, strField, cDelim)) vecFields.push_back(strField);
+      if (vecFields.size() < 3 || vecFields[0] != "1" || inet_pton(AF_INET, vecFields[1].c_str(), &addr.sin_addr) != 1) {
+         Reply("522 Network protocol not supported, use (1)");
+         return;
+      }
+      addr.sin_port = htons(static_cast<uint16_t>(atoi(vecFields[2].c_str())));
+   } else {
+      unsigned h1, h2, h3, h4, p1, p2;
+      if (sscanf(strArg.c_str(), "%u,%u,%u,%u,%u,%u", &h1, &h2, &h3, &h4, &p1, &p2) != 6) {
+         Reply("501 Syntax error.");
+         return;
+      }
+      addr.sin_addr.s_addr = htonl((h1 << 24) | (h2 << 16) | (h3 << 8) | h4);
+      addr.sin_port        = htons(static_cast<uint16_t>((p1 << 8) | p2));
+   }
+
+   if (!m_oServer.m_bAllowForeignDataPeer) {
+      // only the control connection's peer can be the target of a data connection
+      sockaddr_in peer;
+      socklen_t peerLen = sizeof(peer);
+      getpeername(m_iSocket, reinterpret_cast<sockaddr*>(&peer), &peerLen);
+      if (peer.sin_addr.s_addr != addr.sin_addr.s_addr) {
+         Reply("500 Illegal PORT command.");
+         return;
+      }
+   }
+
+   if (m_iPasvSocket >= 0) {
+      close(m_iPasvSocket);
+      m_iPasvSocket = -1;
+   }
+   m_ActiveAddr  = addr;
+   m_bActiveMode = true;
+   Reply(bExtended ? "200 EPRT command successful." : "200 PORT command successful.");
+}
+
+int CFTPTestServer::CSession::OpenDataConnection() {
+   int iDataSocket = -1;
+   if (m_bActiveMode) {
+      iDataSocket = socket(AF_INET, SOCK_STREAM, 0);
+      if (iDataSocket >= 0 && connect(iDataSocket, reinterpret_cast<sockaddr*>(&m_ActiveAddr), sizeof(m_ActiveAddr)) != 0) {
+         close(iDataSocket);
+         iDataSocket = -1;
+      }
+      m_bActiveMode = false;
+   } else if (m_iPasvSocket >= 0) {
+      pollfd pfd = {m_iPasvSocket, POLLIN, 0};
+      if (poll(&pfd, 1, DATA_CONNECTION_TIMEOUT_MS) == 1) iDataSocket = accept(m_iPasvSocket, nullptr, nullptr);
+      close(m_iPasvSocket);
+      m_iPasvSocket = -1;
+   }
+
+#ifdef SO_NOSIGPIPE
+   if (iDataSocket >= 0) {
+      int iNoSigPipe = 1;
+      setsockopt(iDataSocket, SOL_SOCKET, SO_NOSIGPIPE, &iNoSigPipe, sizeof(iNoSigPipe));
+   }
+#endif
+   return iDataSocket;
+}
+
+void CFTPTestServer::CSession::SendDirectory(const std::string& strArg, int iKind) {
+   // ignore "ls" options (e.g. LIST -a)
+   const std::string strTarget = (!strArg.empty() && strArg[0] == '-') ? std::string() : strArg;
+   const std::string strDir    = ResolveVirtual(strTarget);
+
+   std::string strListing;
+   DIR* pDir = opendir(ToLocal(strDir).c_str());
+   if (pDir == nullptr) {
+      Reply("550 Failed to open directory.");
+      return;
+   }
+
+   std::vector<std::string> vecNames;
+   while (struct dirent* pEntry = readdir(pDir)) {
+      const std::string strName = pEntry->d_name;
+      if (strName == "." || strName == "..") continue;
+      vecNames.push_back(strName);
+   }
+   closedir(pDir);
+   std::sort(vecNames.begin(), vecNames.end());
+
+   for (const auto& strName : vecNames) {
+      struct stat st;
+      if (stat((ToLocal(strDir) + "/" + strName).c_str(), &st) != 0) continue;
+      if (iKind == 0)
+         strListing += FormatListLine(strName, st);
+      else if (iKind == 1)
+         strListing += strName + "\r\n";
+      else
+         strListing += FormatMlsdLine(strName, st);
+   }
+
+   Reply("150 Here comes the directory listing.");
+   int iDataSocket = OpenDataConnection();
+   if (iDataSocket < 0) {
+      Reply("425 Can't open data connection.");
+      return;
+   }
+   std::unique_ptr<CFTPZStream> pZStream(m_bModeZ ? new CFTPZStream(CFTPZStream::Mode::DEFLATE, m_iZLevel) : nullptr);
+   const bool bSent = SendData(iDataSocket, pZStream.get(), strListing.data(), strListing.size(), true);
+   close(iDataSocket);
+   Reply(bSent ? "226 Directory send OK." : "426 Connection closed; transfer aborted.");
+}
+
+void CFTPTestServer::CSession::SendFile(const std::string& strArg) {
+   const long long llOffset = m_llRestOffset;
+   m_llRestOffset           = 0;
+
+   std::ifstream ifsFile(ToLocal(ResolveVirtual(strArg)), std::ios::binary);
+   struct stat st;
+   if (!ifsFile || stat(ToLocal(ResolveVirtual(strArg)).c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+      Reply("550 Failed to open file.");
+      return;
+   }
+   if (llOffset > 0) ifsFile.seekg(llOffset);
+
+   Reply("150 Opening BINARY mode data connection for " + strArg + " (" + std::to_string(static_cast<long long>(st.st_size)) + " bytes).");
+   int iDataSocket = OpenDataConnection();
+   if (iDataSocket < 0) {
+      Reply("425 Can't open data connection.");
+      return;
+   }
+
+   std::unique_ptr<CFTPZStream> pZStream(m_bModeZ ? new CFTPZStream(CFTPZStream::Mode::DEFLATE, m_iZLevel) : nullptr);
+   std::vector<char> vecBuffer(TRANSFER_BUFFER_SIZE);
+   bool bOk = true;
+   while (bOk && ifsFile) {
+      ifsFile.read(vecBuffer.data(), vecBuffer.size());
+      const size_t uRead = static_cast<size_t>(ifsFile.gcount());
+      if (uRead == 0) break;
+      bOk = SendData(iDataSocket, pZStream.get(), vecBuffer.data(), uRead, false);
+   }
+   if (bOk && pZStream) bOk = SendData(iDataSocket, pZStream.get(), nullptr, 0, true);
+   close(iDataSocket);
+   Reply(bOk ? "226 Transfer complete." : "426 Connection closed; transfer aborted.");
+}
+
+void CFTPTestServer::CSession::ReceiveFile(const std::string& strArg, bool bAppend) {
+   const long long llOffset = m_llRestOffset;
+   m_llRestOffset           = 0;
+
+   const std::string strLocal = ToLocal(ResolveVirtual(strArg));
+   std::ios::openmode eMode   = std::ios::binary | std::ios::out;
+   if (bAppend)
+      eMode |= std::ios::app;
+   else if (llOffset > 0)
+      eMode |= std::ios::in;  // keeps the existing content
+   else
+      eMode |= std::ios::trunc;
+
+   std::fstream fsFile(strLocal, eMode);
+   if (!fsFile) {
+      Reply("553 Could not create file.");
+      return;
+   }
+   if (!bAppend && llOffset > 0) fsFile.seekp(llOffset);
+
+   Reply("150 Ok to send data.");
+   int iDataSocket = OpenDataConnection();
+   if (iDataSocket < 0) {
+      Reply("425 Can't open data connection.");
+      return;
+   }
+
+   std::unique_ptr<CFTPZStream> pZStream(m_bModeZ ? new CFTPZStream(CFTPZStream::Mode::INFLATE) : nullptr);
+   std::vector<char> vecBuffer(TRANSFER_BUFFER_SIZE);
+   long long llWritten = 0;
+   bool bOk            = true;
+   const auto fnWrite  = [&fsFile, &llWritten](const char* pData, size_t uSize) {
+      fsFile.write(pData, uSize);
+      llWritten += static_cast<long long>(uSize);
+      return true;
+   };
+   for (;;) {
+      ssize_t iRead = recv(iDataSocket, vecBuffer.data(), vecBuffer.size(), 0);
+      if (iRead < 0 && errno == EINTR) continue;
+      if (iRead < 0) bOk = false;
+      if (iRead <= 0) break;
+      if (pZStream)
+         bOk = pZStream->Process(vecBuffer.data(), static_cast<size_t>(iRead), false, fnWrite) && bOk;
+      else
+         fnWrite(vecBuffer.data(), static_cast<size_t>(iRead));
+   }
+   if (pZStream && !pZStream->IsFinished()) bOk = false;
+   close(iDataSocket);
+   fsFile.close();
+
+   // STOR after REST drops what follows the written data
+   if (!bAppend && llOffset > 0 && truncate(strLocal.c_str(), llOffset + llWritten) != 0) bOk = false;
+
+   Reply(bOk && fsFile ? "226 Transfer complete." : "451 Local error in processing.");
+}
+
+CFTPTestServer::CFTPTestServer(const std::string& strRootDir, const std::string& strUserName, const std::string& strPassword)
+    : m_strRootDir(strRootDir),
+      m_strUserName(strUserName),
+      m_strPassword(strPassword),
+      m_strWelcomeMessage("CFTPTestServer ready."),
+      m_uPort(0),
+      m_iListenSocket(-1),
+      m_bAllowForeignDataPeer(true),
+      m_bMDTMEnabled(true),
+      m_bRunning(false),
+      m_uSessionsCount(0) {
+   while (m_strRootDir.size() > 1 && m_strRootDir.back() == '/') m_strRootDir.pop_back();
+}
+
+CFTPTestServer::~CFTPTestServer() { Stop(); }
+
+bool CFTPTestServer::Start(unsigned uPort /* = 0 */) {
+   if (m_bRunning) return false;
+
+   struct stat st;
+   if (stat(m_strRootDir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return false;
+
+   m_iListenSocket = CreateListenSocket(uPort, m_uPort);
+   if (m_iListenSocket < 0) return false;
+
+   m_bRunning       = true;
+   m_uSessionsCount = 0;
+   m_AcceptThread   = std::thread(&CFTPTestServer::AcceptLoop, this);
+   return true;
+}
+
+void CFTPTestServer::Stop() {
+   if (!m_bRunning.exchange(false)) return;
+
+   shutdown(m_iListenSocket, SHUT_RDWR);
+   close(m_iListenSocket);
+   m_iListenSocket = -1;
+   if (m_AcceptThread.joinable()) m_AcceptThread.join();
+
+   std::lock_guard<std::mutex> lock(m_mtxSessions);
+   m_lstSessions.clear();
+}
+
+void CFTPTestServer::AcceptLoop() {
+   while (m_bRunning) {
+      pollfd pfd = {m_iListenSocket, POLLIN, 0};
+      if (poll(&pfd, 1, 100) != 1) continue;
+
+      int iSocket = accept(m_iListenSocket, nullptr, nullptr);
+      if (iSocket < 0) continue;
+#ifdef SO_NOSIGPIPE
+      int iNoSigPipe = 1;
+      setsockopt(iSocket, SOL_SOCKET, SO_NOSIGPIPE, &iNoSigPipe, sizeof(iNoSigPipe));
+#endif
+
+      std::lock_guard<std::mutex> lock(m_mtxSessions);
+      // reap finished sessions
+      m_lstSessions.remove_if([](const std::unique_ptr<CSession>& pSession) { return pSession->IsDone(); });
+      m_lstSessions.emplace_back(new CSession(*this, iSocket));
+      ++m_uSessionsCount;
+   }
+}
@@ -0,0 +1,75 @@
+#ifndef INCLUDE_TEST_SERVER_H_
+#define INCLUDE_TEST_SERVER_H_
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/* Minimal FTP server serving a local directory on the loopback interface.
+ * It understands enough of RFC 959/2389/3659 (plus a few common extensions) for
+ * libcurl and CFTPClient : USER/PASS, PASV/EPSV/PORT, LIST/MLSD/NLST,
+ * RETR/STOR/APPE/REST, SIZE/MDTM, MKD/RMD/DELE/RNFR/RNTO...
+ *
+ * Each control connection is served by its own thread, data connections are
+ * handled synchronously inside the session thread. It is meant for tests and
+ * benchmarks only : no TLS, no ASCII conversion, a single user account.
+ */
+class CFTPTestServer {
+  public:
+   CFTPTestServer(const std::string& strRootDir, const std::string& strUserName = "test",
+                  const std::string& strPassword = "test");
+   ~CFTPTestServer();
+
+   CFTPTestServer(const CFTPTestServer&) = delete;
+   CFTPTestServer& operator=(const CFTPTestServer&) = delete;
+
+   // listens on 127.0.0.1, uPort = 0 picks an ephemeral port
+   bool Start(unsigned uPort = 0);
+   void Stop();
+
+   inline unsigned GetPort() const { return m_uPort; }
+   inline const std::string& GetRootDir() const { return m_strRootDir; }
+   inline const std::string& GetUserName() const { return m_strUserName; }
+   inline const std::string& GetPassword() const { return m_strPassword; }
+
+   // when disabled, PORT/EPRT to another address than the client's one is refused (no FXP)
+   inline void SetAllowForeignDataPeer(const bool& bAllow) { m_bAllowForeignDataPeer = bAllow; }
+   inline bool GetAllowForeignDataPeer() const { return m_bAllowForeignDataPeer; }
+
+   // text of the 220 greeting sent to the new control connections
+   inline void SetWelcomeMessage(const std::string& strMessage) { m_strWelcomeMessage = strMessage; }
+   inline const std::string& GetWelcomeMessage() const { return m_strWelcomeMessage; }
+
+   // when disabled, MDTM is refused and not announced by FEAT (the modification times are unknown)
+   inline void SetMDTMEnabled(const bool& bEnabled) { m_bMDTMEnabled = bEnabled; }
+   inline bool GetMDTMEnabled() const { return m_bMDTMEnabled; }
+
+   // number of control connections accepted since Start()
+   inline unsigned GetSessionsCount() const { return m_uSessionsCount.load(); }
+
+  private:
+   class CSession;
+
+   void AcceptLoop();
+
+   std::string m_strRootDir;
+   std::string m_strUserName;
+   std::string m_strPassword;
+   std::string m_strWelcomeMessage;
+   unsigned m_uPort;
+   int m_iListenSocket;
+   bool m_bAllowForeignDataPeer;
+   bool m_bMDTMEnabled;
+
+   std::atomic<bool> m_bRunning;
+   std::atomic<unsigned> m_uSessionsCount;
+   std::thread m_AcceptThread;
+
+   std::mutex m_mtxSessions;
+   std::list<std::unique_ptr<CSession>> m_lstSessions;
+};
+
+#endif
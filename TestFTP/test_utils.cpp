@@ -1,5 +1,12 @@
 #include "test_utils.h"
 
+#ifdef LINUX
+#include <ftw.h>
+#include <unistd.h>
+
+#include "test_server.h"
+#endif
+
 // Test configuration constants (to be loaded from an INI file)
 bool FTP_TEST_ENABLED;
 bool SFTP_TEST_ENABLED;
@@ -34,6 +41,58 @@ std::string PROXY_SERVER_FAKE;
 
 std::mutex g_mtxConsoleMutex;
 
+#ifdef LINUX
+namespace {
+// [tests] ftp=embedded : the FTP tests use this server and its temporary directory
+std::unique_ptr<CFTPTestServer> s_pEmbeddedFTPServer;
+std::string s_strEmbeddedFTPRootDir;
+
+bool WriteTestFile(const std::string& strPath, const std::string& strContent) {
+   std::ofstream ofsFile(strPath, std::ofstream::binary);
+   ofsFile << strContent;
+   return static_cast<bool>(ofsFile);
+}
+
+/* Serves a temporary directory with the layout expected by the FTP tests and
+ * overrides the [ftp] parameters of the INI file. */
+bool StartEmbeddedFTPServer() {
+   s_strEmbeddedFTPRootDir = MakeTempDir();
+   if (s_strEmbeddedFTPRootDir.empty()) return false;
+
+   std::string strInfo;
+   for (int i = 0; i < 2000; ++i) strInfo += "line " + std::to_string(i) + " of the file served by the embedded FTP server\n";
+   const std::string& strRoot = s_strEmbeddedFTPRootDir;
+   if (mkdir((strRoot + "/upload").c_str(), 0755) != 0 || mkdir((strRoot + "/pictures").c_str(), 0755) != 0 ||
+       mkdir((strRoot + "/pictures/sub").c_str(), 0755) != 0 || !WriteTestFile(strRoot + "/info.txt", strInfo) ||
+       !WriteTestFile(strRoot + "/pictures/a.txt", "picture a\n") || !WriteTestFile(strRoot + "/pictures/sub/b.txt", "picture b\n"))
+      return false;
+
+   s_pEmbeddedFTPServer.reset(new CFTPTestServer(strRoot));
+   if (!s_pEmbeddedFTPServer->Start()) return false;
+
+   FTP_SERVER                 = "127.0.0.1";
+   FTP_SERVER_PORT            = s_pEmbeddedFTPServer->GetPort();
+   FTP_USERNAME               = s_pEmbeddedFTPServer->GetUserName();
+   FTP_PASSWORD               = s_pEmbeddedFTPServer->GetPassword();
+   FTP_REMOTE_FILE            = "info.txt";
+   FTP_REMOTE_FILE_SHA1SUM    = sha1sum(strRoot + "/info.txt");
+   std::transform(FTP_REMOTE_FILE_SHA1SUM.begin(), FTP_REMOTE_FILE_SHA1SUM.end(), FTP_REMOTE_FILE_SHA1SUM.begin(), ::tolower);
+   FTP_REMOTE_UPLOAD_FOLDER   = "/upload/";
+   FTP_REMOTE_DOWNLOAD_FOLDER = "pictures/";
+   return true;
+}
+
+int RemoveEntry(const char* pszPath, const struct stat*, int, struct FTW*) { return remove(pszPath); }
+}  // namespace
+
+std::string MakeTempDir() {
+   std::string strTemplate = "/tmp/ftpclient_test_XXXXXX";
+   return (mkdtemp(&strTemplate[0]) != nullptr) ? strTemplate : std::string();
+}
+
+bool RemoveDirTree(const std::string& strDir) { return nftw(strDir.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS) == 0; }
+#endif
+
 bool GlobalTestInit(const std::string& strConfFile) {
    CSimpleIniA ini;
    if (ini.LoadFile(strConfFile.c_str()) != SI_Error::SI_OK) return false;
@@ -41,7 +100,8 @@ bool GlobalTestInit(const std::string& strConfFile) {
    std::string strTmp;
    strTmp = ini.GetValue("tests", "ftp", "");
    std::transform(strTmp.begin(), strTmp.end(), strTmp.begin(), ::toupper);
-   FTP_TEST_ENABLED = (strTmp == "YES") ? true : false;
+   const bool bEmbeddedFTP = (strTmp == "EMBEDDED");
+   FTP_TEST_ENABLED        = (strTmp == "YES" || bEmbeddedFTP) ? true : false;
 
    strTmp = ini.GetValue("tests", "sftp", "");
    std::transform(strTmp.begin(), strTmp.end(), strTmp.begin(), ::toupper);
@@ -71,6 +131,18 @@ bool GlobalTestInit(const std::string& strConfFile) {
    FTP_REMOTE_UPLOAD_FOLDER   = ini.GetValue("ftp", "remote_upload_folder", "");
    FTP_REMOTE_DOWNLOAD_FOLDER = ini.GetValue("ftp", "remote_download_folder", "");
 
+   if (bEmbeddedFTP) {
+#ifdef LINUX
+      if (!StartEmbeddedFTPServer()) {
+         std::clog << "[ERROR] Unable to start the embedded FTP server." << std::endl;
+         return false;
+      }
+#else
+      std::clog << "[ERROR] The embedded FTP server is only available on Linux." << std::endl;
+      return false;
+#endif
+   }
+
    SFTP_SERVER                 = ini.GetValue("sftp", "host", "");
    SFTP_SERVER_PORT            = atoi(ini.GetValue("sftp", "port", "0"));
    SFTP_USERNAME               = ini.GetValue("sftp", "username", "");
@@ -116,7 +188,14 @@ bool GlobalTestInit(const std::string& strConfFile) {
    return true;
 }
 
-void GlobalTestCleanUp(void) { return; }
+void GlobalTestCleanUp(void) {
+#ifdef LINUX
+   if (s_pEmbeddedFTPServer) {
+      s_pEmbeddedFTPServer.reset();
+      RemoveDirTree(s_strEmbeddedFTPRootDir);
+   }
+#endif
+}
 
 void TimeStampTest(std::ostringstream& ssTimestamp) {
    time_t tRawTime;
@@ -13,6 +13,7 @@
 #include <sys/stat.h>
 #include <algorithm>
 #include <cerrno>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -48,4 +49,10 @@ long long FdGetFileSize(int fd);
 std::string sha1sum(const std::vector<char>& memData);
 std::string sha1sum(const std::string& filename);
 
+#ifdef LINUX
+// empty on failure
+std::string MakeTempDir();
+bool RemoveDirTree(const std::string& strDir);
+#endif
+
 #endif
@@ -0,0 +1,388 @@
+#include "wan_relay.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <random>
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// the announced data connection must be established within this delay
+const int DATA_CONNECTION_TIMEOUT_MS = 10000;
+
+// bandwidth and stalls are applied to chunks of at most this size
+const size_t CHUNK_SIZE = 16 * 1024;
+
+bool SendAll(int iSocket, const char* pData, size_t uSize) {
+   while (uSize > 0) {
+      ssize_t iSent = send(iSocket, pData, uSize, SEND_FLAGS);
+      if (iSent < 0 && errno == EINTR) continue;
+      if (iSent <= 0) return false;
+      pData += iSent;
+      uSize -= static_cast<size_t>(iSent);
+   }
+   return true;
+}
+
+void SetSocketOptions(int iSocket) {
+#ifdef SO_NOSIGPIPE
+   int iNoSigPipe = 1;
+   setsockopt(iSocket, SOL_SOCKET, SO_NOSIGPIPE, &iNoSigPipe, sizeof(iNoSigPipe));
+#endif
+   // the relay must not add its own delays to the small writes (replies, commands)
+   int iNoDelay = 1;
+   setsockopt(iSocket, IPPROTO_TCP, TCP_NODELAY, &iNoDelay, sizeof(iNoDelay));
+}
+
+int CreateListenSocket(unsigned uPort, unsigned& uBoundPort) {
+   int iSocket = socket(AF_INET, SOCK_STREAM, 0);
+   if (iSocket < 0) return -1;
+
+   int iReuse = 1;
+   setsockopt(iSocket, SOL_SOCKET, SO_REUSEADDR, &iReuse, sizeof(iReuse));
+
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_port        = htons(static_cast<uint16_t>(uPort));
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   if (bind(iSocket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(iSocket, 64) != 0) {
+      close(iSocket);
+      return -1;
+   }
+
+   socklen_t addrLen = sizeof(addr);
+   getsockname(iSocket, reinterpret_cast<sockaddr*>(&addr), &addrLen);
+   uBoundPort = ntohs(addr.sin_port);
+
+   return iSocket;
+}
+
+int ConnectTo(const std::string& strHost, unsigned uPort) {
+   addrinfo hints;
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family   = AF_INET;
+   hints.ai_socktype = SOCK_STREAM;
+
+   addrinfo* pResult = nullptr;
+   if (getaddrinfo(strHost.c_str(), std::to_string(uPort).c_str(), &hints, &pResult) != 0) return -1;
+
+   int iSocket = -1;
+   for (addrinfo* pAddr = pResult; pAddr != nullptr && iSocket < 0; pAddr = pAddr->ai_next) {
+      iSocket = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+      if (iSocket >= 0 && connect(iSocket, pAddr->ai_addr, pAddr->ai_addrlen) != 0) {
+         close(iSocket);
+         iSocket = -1;
+      }
+   }
+   freeaddrinfo(pResult);
+
+   if (iSocket >= 0) SetSocketOptions(iSocket);
+   return iSocket;
+}
+
+}  // namespace
+
+/* A relayed connection : each direction has a reader, which timestamps the received chunks,
+ * and a writer, which sends them once they are due, at the capped rate. */
+class CWanRelay::CLink {
+  public:
+   CLink(CWanRelay& oRelay, int iClientSocket, int iServerSocket, bool bControl, const Conditions& oConditions)
+       : m_oRelay(oRelay),
+         m_iClientSocket(iClientSocket),
+         m_iServerSocket(iServerSocket),
+         m_oConditions(oConditions),
+         m_uFinishedThreads(0),
+         m_bStop(false) {
+      m_Upstream.iFrom     = iClientSocket;
+      m_Upstream.iTo       = iServerSocket;
+      m_Downstream.iFrom   = iServerSocket;
+      m_Downstream.iTo     = iClientSocket;
+      m_Downstream.bReplies = bControl;
+
+      for (Direction* pDirection : {&m_Upstream, &m_Downstream}) {
+         pDirection->Reader = std::thread(&CLink::Read, this, std::ref(*pDirection));
+         pDirection->Writer = std::thread(&CLink::Write, this, std::ref(*pDirection));
+      }
+   }
+
+   ~CLink() {
+      m_bStop = true;
+      shutdown(m_iClientSocket, SHUT_RDWR);
+      shutdown(m_iServerSocket, SHUT_RDWR);
+      for (Direction* pDirection : {&m_Upstream, &m_Downstream}) {
+         {
+            std::lock_guard<std::mutex> lock(pDirection->mtxChunks);
+            pDirection->cvChunks.notify_all();
+         }
+         pDirection->Reader.join();
+         pDirection->Writer.join();
+      }
+      close(m_iClientSocket);
+      close(m_iServerSocket);
+   }
+
+   bool IsDone() const { return m_uFinishedThreads.load() == 4; }
+
+  private:
+   struct Chunk {
+      Clock::time_point tDue;
+      std::string strData;  // empty : end of the stream
+   };
+
+   struct Direction {
+      Direction() : iFrom(-1), iTo(-1), bReplies(false) {}
+
+      int iFrom;
+      int iTo;
+      bool bReplies;        // server to client on a control connection : the passive replies are rewritten
+      std::string strLine;  // incomplete reply
+      std::mutex mtxChunks;
+      std::condition_variable cvChunks;
+      std::deque<Chunk> queChunks;
+      std::thread Reader;
+      std::thread Writer;
+   };
+
+   void Push(Direction& oDirection, std::string&& strData) {
+      const Clock::time_point tDue = Clock::now() + std::chrono::microseconds(m_oConditions.uRttMs * 500ULL);
+      std::lock_guard<std::mutex> lock(oDirection.mtxChunks);
+      oDirection.queChunks.push_back(Chunk{tDue, std::move(strData)});
+      oDirection.cvChunks.notify_one();
+   }
+
+   void Read(Direction& oDirection) {
+      char szBuf[CHUNK_SIZE];
+      for (;;) {
+         ssize_t iRead = recv(oDirection.iFrom, szBuf, sizeof(szBuf), 0);
+         if (iRead < 0 && errno == EINTR) continue;
+         if (iRead <= 0) break;
+
+         std::string strData = oDirection.bReplies ? RewriteReplies(oDirection, szBuf, static_cast<size_t>(iRead))
+                                                   : std::string(szBuf, static_cast<size_t>(iRead));
+         if (!strData.empty()) Push(oDirection, std::move(strData));
+      }
+      if (!oDirection.strLine.empty()) Push(oDirection, std::move(oDirection.strLine));
+      Push(oDirection, std::string());
+      ++m_uFinishedThreads;
+   }
+
+   void Write(Direction& oDirection) {
+      std::mt19937 oRandom(std::random_device{}());
+      std::bernoulli_distribution oStall(std::min(std::max(m_oConditions.dStallProbability, 0.0), 1.0));
+      Clock::time_point tNextSend = Clock::now();
+
+      for (;;) {
+         Chunk oChunk;
+         {
+            std::unique_lock<std::mutex> lock(oDirection.mtxChunks);
+            oDirection.cvChunks.wait(lock, [&] { return m_bStop || !oDirection.queChunks.empty(); });
+            if (m_bStop) break;
+            oChunk = std::move(oDirection.queChunks.front());
+            oDirection.queChunks.pop_front();
+         }
+         std::this_thread::sleep_until(oChunk.tDue);
+         if (oChunk.strData.empty()) {
+            shutdown(oDirection.iTo, SHUT_WR);
+            break;
+         }
+
+         if (oStall(oRandom)) std::this_thread::sleep_for(std::chrono::milliseconds(m_oConditions.uStallMs));
+         if (m_oConditions.ullBytesPerSecond > 0) {
+            tNextSend = std::max(tNextSend, Clock::now());
+            std::this_thread::sleep_until(tNextSend);
+            tNextSend += std::chrono::microseconds(oChunk.strData.size() * 1000000ULL / m_oConditions.ullBytesPerSecond);
+         }
+
+         if (m_bStop || !SendAll(oDirection.iTo, oChunk.strData.data(), oChunk.strData.size())) {
+            // nothing more can be delivered : the reader is stopped too
+            shutdown(oDirection.iFrom, SHUT_RD);
+            break;
+         }
+      }
+      ++m_uFinishedThreads;
+   }
+
+   // forwards the complete replies, the passive ones announcing a port of the relay
+   std::string RewriteReplies(Direction& oDirection, const char* pData, size_t uSize) {
+      oDirection.strLine.append(pData, uSize);
+
+      std::string strOutput;
+      size_t uEol;
+      while ((uEol = oDirection.strLine.find('\n')) != std::string::npos) {
+         std::string strReply = oDirection.strLine.substr(0, uEol + 1);
+         oDirection.strLine.erase(0, uEol + 1);
+
+         unsigned h1, h2, h3, h4, p1, p2, uPort;
+         const size_t uParenthesis = strReply.find('(');
+         if (strReply.compare(0, 4, "227 ") == 0 && uParenthesis != std::string::npos &&
+             sscanf(strReply.c_str() + uParenthesis, "(%u,%u,%u,%u,%u,%u)", &h1, &h2, &h3, &h4, &p1, &p2) == 6) {
+            const std::string strHost = std::to_string(h1) + "." + std::to_string(h2) + "." + std::to_string(h3) + "." + std::to_string(h4);
+            const unsigned uRelayPort = m_oRelay.RelayDataConnection(strHost, (p1 << 8) | p2);
+            if (uRelayPort != 0)
+               strReply = strReply.substr(0, uParenthesis) + "(127,0,0,1," + std::to_string(uRelayPort >> 8) + "," +
+                          std::to_string(uRelayPort & 0xFF) + ").\r\n";
+         } else if (strReply.compare(0, 4, "229 ") == 0 && uParenthesis != std::string::npos &&
+                    sscanf(strReply.c_str() + uParenthesis, "(|||%u|)", &uPort) == 1) {
+            const unsigned uRelayPort = m_oRelay.RelayDataConnection(m_oRelay.m_strServerHost, uPort);
+            if (uRelayPort != 0) strReply = strReply.substr(0, uParenthesis) + "(|||" + std::to_string(uRelayPort) + "|)\r\n";
+         }
+         strOutput += strReply;
+      }
+      return strOutput;
+   }
+
+   CWanRelay& m_oRelay;
+   int m_iClientSocket;
+   int m_iServerSocket;
+   const Conditions m_oConditions;
+   std::atomic<unsigned> m_uFinishedThreads;
+   std::atomic<bool> m_bStop;
+   Direction m_Upstream;
+   Direction m_Downstream;
+};
+
+CWanRelay::CWanRelay(const std::string& strServerHost, unsigned uServerPort, const Conditions& oConditions /* = Conditions() */)
+    : m_strServerHost(strServerHost),
+      m_uServerPort(uServerPort),
+      m_uPort(0),
+      m_iListenSocket(-1),
+      m_bRunning(false),
+      m_uConnectionsCount(0),
+      m_oConditions(oConditions),
+      m_uDataAcceptors(0) {}
+
+CWanRelay::~CWanRelay() { Stop(); }
+
+bool CWanRelay::Start(unsigned uPort /* = 0 */) {
+   if (m_bRunning) return false;
+
+   m_iListenSocket = CreateListenSocket(uPort, m_uPort);
+   if (m_iListenSocket < 0) return false;
+
+   m_bRunning          = true;
+   m_uConnectionsCount = 0;
+   m_AcceptThread      = std::thread(&CWanRelay::AcceptLoop, this);
+   return true;
+}
+
+void CWanRelay::Stop() {
+   if (!m_bRunning.exchange(false)) return;
+
+   if (m_AcceptThread.joinable()) m_AcceptThread.join();
+   close(m_iListenSocket);
+   m_iListenSocket = -1;
+
+   // the links' readers can call RelayDataConnection : they are stopped without holding the lock
+   std::list<std::unique_ptr<CLink>> lstLinks;
+   {
+      std::unique_lock<std::mutex> lock(m_mtxLinks);
+      m_cvDataAcceptors.wait(lock, [this] { return m_uDataAcceptors == 0; });
+      lstLinks.swap(m_lstLinks);
+   }
+   lstLinks.clear();
+}
+
+void CWanRelay::SetConditions(const Conditions& oConditions) {
+   std::lock_guard<std::mutex> lock(m_mtxLinks);
+   m_oConditions = oConditions;
+}
+
+CWanRelay::Conditions CWanRelay::GetConditions() const {
+   std::lock_guard<std::mutex> lock(m_mtxLinks);
+   return m_oConditions;
+}
+
+void CWanRelay::AcceptLoop() {
+   while (m_bRunning) {
+      pollfd pfd = {m_iListenSocket, POLLIN, 0};
+      if (poll(&pfd, 1, 100) != 1) continue;
+
+      int iClientSocket = accept(m_iListenSocket, nullptr, nullptr);
+      if (iClientSocket < 0) continue;
+      SetSocketOptions(iClientSocket);
+
+      int iServerSocket = ConnectTo(m_strServerHost, m_uServerPort);
+      if (iServerSocket < 0) {
+         close(iClientSocket);
+         continue;
+      }
+      AddLink(iClientSocket, iServerSocket, true);
+   }
+}
+
+void CWanRelay::AddLink(int iClientSocket, int iServerSocket, bool bControl) {
+   std::list<std::unique_ptr<CLink>> lstDone;
+   {
+      std::lock_guard<std::mutex> lock(m_mtxLinks);
+      if (!m_bRunning) {
+         close(iClientSocket);
+         close(iServerSocket);
+         return;
+      }
+      // reap the finished links (destroyed once the lock is released)
+      for (auto itLink = m_lstLinks.begin(); itLink != m_lstLinks.end();) {
+         auto itNext = std::next(itLink);
+         if ((*itLink)->IsDone()) lstDone.splice(lstDone.end(), m_lstLinks, itLink);
+         itLink = itNext;
+      }
+      m_lstLinks.emplace_back(new CLink(*this, iClientSocket, iServerSocket, bControl, m_oConditions));
+      ++m_uConnectionsCount;
+   }
+}
+
+unsigned CWanRelay::RelayDataConnection(const std::string& strHost, unsigned uPort) {
+   std::lock_guard<std::mutex> lock(m_mtxLinks);
+   if (!m_bRunning) return 0;
+
+   unsigned uRelayPort = 0;
+   int iListenSocket   = CreateListenSocket(0, uRelayPort);
+   if (iListenSocket < 0) return 0;
+
+   // detached : Stop() waits for the count of the running ones to drop to 0
+   ++m_uDataAcceptors;
+   std::thread([this, iListenSocket, strHost, uPort]() {
+      int iClientSocket = -1;
+      for (int iWaited = 0; m_bRunning && iClientSocket < 0 && iWaited < DATA_CONNECTION_TIMEOUT_MS; iWaited += 100) {
+         pollfd pfd = {iListenSocket, POLLIN, 0};
+         if (poll(&pfd, 1, 100) == 1) iClientSocket = accept(iListenSocket, nullptr, nullptr);
+      }
+      close(iListenSocket);
+
+      if (iClientSocket >= 0) {
+         SetSocketOptions(iClientSocket);
+         int iServerSocket = ConnectTo(strHost, uPort);
+         if (iServerSocket >= 0)
+            AddLink(iClientSocket, iServerSocket, false);
+         else
+            close(iClientSocket);
+      }
+
+      std::lock_guard<std::mutex> lock(m_mtxLinks);
+      --m_uDataAcceptors;
+      m_cvDataAcceptors.notify_all();
+   }).detach();
+   return uRelayPort;
+}
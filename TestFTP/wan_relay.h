@@ -0,0 +1,76 @@
+#ifndef INCLUDE_WAN_RELAY_H_
+#define INCLUDE_WAN_RELAY_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/* TCP relay standing between a FTP client and a server (e.g. CFTPTestServer) to emulate a long
+ * distance link : the relayed bytes are delayed by half the round-trip time in each direction,
+ * the throughput of each connection and direction can be capped and random stalls emulate the
+ * retransmission timeouts following packet losses.
+ *
+ * The passive mode replies (227 and 229) are rewritten so that the data connections go through
+ * the relay too. With the active mode (PORT/EPRT), only the control connection is affected.
+ *
+ * Meant for tests and benchmarks only : POSIX sockets, four threads per relayed connection.
+ */
+class CWanRelay {
+  public:
+   struct Conditions {
+      Conditions() : uRttMs(0), ullBytesPerSecond(0), dStallProbability(0.0), uStallMs(200) {}
+
+      unsigned uRttMs;                       // round-trip time added to the one of the real link
+      unsigned long long ullBytesPerSecond;  // per connection and direction, 0 : unlimited
+      double dStallProbability;              // for each chunk of at most 16 KiB relayed
+      unsigned uStallMs;                     // duration of a stall
+   };
+
+   CWanRelay(const std::string& strServerHost, unsigned uServerPort, const Conditions& oConditions = Conditions());
+   ~CWanRelay();
+
+   CWanRelay(const CWanRelay&) = delete;
+   CWanRelay& operator=(const CWanRelay&) = delete;
+
+   // listens on 127.0.0.1, uPort = 0 picks an ephemeral port
+   bool Start(unsigned uPort = 0);
+   void Stop();
+
+   inline unsigned GetPort() const { return m_uPort; }
+
+   // only applies to the connections accepted afterwards
+   void SetConditions(const Conditions& oConditions);
+   Conditions GetConditions() const;
+
+   // control and data connections relayed since Start()
+   inline unsigned GetConnectionsCount() const { return m_uConnectionsCount.load(); }
+
+  private:
+   class CLink;
+
+   void AcceptLoop();
+   void AddLink(int iClientSocket, int iServerSocket, bool bControl);
+   // listens for the data connection announced by a passive reply, returns the relay's port (0 on failure)
+   unsigned RelayDataConnection(const std::string& strHost, unsigned uPort);
+
+   std::string m_strServerHost;
+   unsigned m_uServerPort;
+   unsigned m_uPort;
+   int m_iListenSocket;
+
+   std::atomic<bool> m_bRunning;
+   std::atomic<unsigned> m_uConnectionsCount;
+   std::thread m_AcceptThread;
+
+   mutable std::mutex m_mtxLinks;
+   Conditions m_oConditions;
+   std::list<std::unique_ptr<CLink>> m_lstLinks;
+   unsigned m_uDataAcceptors;  // threads waiting for a data connection
+   std::condition_variable m_cvDataAcceptors;
+};
+
+#endif
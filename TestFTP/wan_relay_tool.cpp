@@ -0,0 +1,84 @@
+/* Command line front end of CWanRelay, e.g. a link with 150 ms of RTT, 2 MB/s and 1% of stalls
+ * between a client connecting to 127.0.0.1:2121 and the server ftp.example.com :
+ *
+ *    wan_relay ftp.example.com 21 --port 2121 --rtt 150 --bandwidth 2000000 --stall-probability 0.01
+ *
+ * It runs until it receives SIGINT or SIGTERM.
+ */
+
+#include <signal.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "wan_relay.h"
+
+namespace {
+
+void PrintUsage(const char* pszProgram) {
+   std::cerr << "Usage : " << pszProgram << " <server host> <server port> [options]" << std::endl
+             << "   --port <port>                 listening port on 127.0.0.1 (default : ephemeral)" << std::endl
+             << "   --rtt <ms>                    added round-trip time" << std::endl
+             << "   --bandwidth <bytes/s>         per connection and direction (default : unlimited)" << std::endl
+             << "   --stall-probability <0..1>    for each chunk of at most 16 KiB relayed" << std::endl
+             << "   --stall <ms>                  duration of a stall (default : 200)" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+   if (argc < 3) {
+      PrintUsage(argv[0]);
+      return 1;
+   }
+
+   unsigned uPort = 0;
+   CWanRelay::Conditions oConditions;
+   for (int i = 3; i < argc; i += 2) {
+      if (i + 1 >= argc) {
+         PrintUsage(argv[0]);
+         return 1;
+      }
+      const std::string strOption = argv[i];
+      const char* pszValue        = argv[i + 1];
+      if (strOption == "--port")
+         uPort = static_cast<unsigned>(atoi(pszValue));
+      else if (strOption == "--rtt")
+         oConditions.uRttMs = static_cast<unsigned>(atoi(pszValue));
+      else if (strOption == "--bandwidth")
+         oConditions.ullBytesPerSecond = strtoull(pszValue, nullptr, 10);
+      else if (strOption == "--stall-probability")
+         oConditions.dStallProbability = atof(pszValue);
+      else if (strOption == "--stall")
+         oConditions.uStallMs = static_cast<unsigned>(atoi(pszValue));
+      else {
+         PrintUsage(argv[0]);
+         return 1;
+      }
+   }
+
+   // blocked in every thread, waited for by the main one
+   sigset_t sigSet;
+   sigemptyset(&sigSet);
+   sigaddset(&sigSet, SIGINT);
+   sigaddset(&sigSet, SIGTERM);
+   pthread_sigmask(SIG_BLOCK, &sigSet, nullptr);
+
+   CWanRelay oRelay(argv[1], static_cast<unsigned>(atoi(argv[2])), oConditions);
+   if (!oRelay.Start(uPort)) {
+      std::cerr << "[ERROR] Unable to listen on the port " << uPort << " !" << std::endl;
+      return 1;
+   }
+   std::cout << "Relaying 127.0.0.1:" << oRelay.GetPort() << " to " << argv[1] << ":" << argv[2] << " (RTT " << oConditions.uRttMs
+             << " ms, " << oConditions.ullBytesPerSecond << " bytes/s, stalls " << oConditions.dStallProbability << " x "
+             << oConditions.uStallMs << " ms)" << std::endl;
+
+   int iSignal = 0;
+   sigwait(&sigSet, &iSignal);
+
+   oRelay.Stop();
+   std::cout << oRelay.GetConnectionsCount() << " connections relayed." << std::endl;
+   return 0;
+}